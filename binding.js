@@ -0,0 +1,17 @@
+"use strict"
+
+const bindings = require('bindings')
+
+let binding
+
+if (process.platform === 'win32') {
+  binding = bindings('rtaudio-js-win32')
+} else if (process.platform === 'linux') {
+  binding = bindings('rtaudio-js-linux.node')
+} else if (process.platform === 'darwin') {
+  binding = bindings('rtaudio-js-darwin.node')
+} else {
+  throw 'RtAudio.js supports win32, darwin and linux only.'
+}
+
+module.exports = binding
@@ -5,8 +5,8 @@
  * a warning is issued and an instance of an available API
  * is created. If available API is found, the routine will abort
  * If no API argument is specified and multiple API
- * support has been compiled, the default order of use is ALSA,
- * (Linux systems) and WASAPI, DS (Windows systems).
+ * support has been compiled, the default order of use is PulseAudio,
+ * JACK, ALSA (Linux systems) and WASAPI, DS (Windows systems).
  */
 export declare class RtAudio {
   /**
@@ -68,19 +68,78 @@ export declare class RtAudio {
    * 
    * @param callback A function that will be invoked
    * when input data is available and/or output data is needed.
+   * In {@link RtAudioStreamMode.BUFFERED} mode this is an optional
+   * {@link RtAudioWatermarkCallback} instead. With the `worker` option the
+   * stream callback is exported by the worker script and this is an optional
+   * {@link RtAudioWorkerEventCallback}. Without a callback the output is silent
+   * apart from native sources such as `startPlayback()`.
    * 
    * @returns The actual bufferFrames value used by the device.
    */
-  openStream(
+  openStream<T extends RtAudioBuffer = Uint8Array>(
     outputParameters: StreamParameters | null,
     inputParameters: StreamParameters | null,
     format: RtAudioFormat,
     sampleRate: number,
     bufferFrames: number,
     options: StreamOptions | null,
-    callback: RtAudioCallback,
+    callback: RtAudioCallback<T> | RtAudioWatermarkCallback | RtAudioWorkerEventCallback | null,
   ): number
 
+  /**
+   * Like `openStream()`, but the backend opens the stream on a libuv worker thread, so
+   * slow backends don't block the event loop. The other stream methods throw until the
+   * promise settles.
+   *
+   * @returns The actual bufferFrames value used by the device. Rejects with RtAudio's
+   * error text if the stream couldn't be opened.
+   */
+  openStreamAsync<T extends RtAudioBuffer = Uint8Array>(
+    outputParameters: StreamParameters | null,
+    inputParameters: StreamParameters | null,
+    format: RtAudioFormat,
+    sampleRate: number,
+    bufferFrames: number,
+    options: StreamOptions | null,
+    callback: RtAudioCallback<T> | RtAudioWatermarkCallback | RtAudioWorkerEventCallback | null,
+  ): Promise<number>
+
+  /**
+   * Moves an open stream to other devices and/or another buffer size, keeping
+   * everything but the backend stream: the callbacks, buffer pools, the worker, native
+   * sources and mixer voices. A running stream is restarted. The backend work runs on a
+   * libuv worker thread.
+   *
+   * The stream time carries on from where it was, advanced by the time the restart took,
+   * so scheduled clips keep their start frames and frames from `hrtimeToStreamFrame()`
+   * stay valid. Clips due during the restart start late.
+   *
+   * The format, sample rate, options and number of channels stay the same. If the
+   * device settles on another buffer size, playback, the processing graph and mixer
+   * voices carry on and analysis starts over. Recording, encoding and decoding carry on
+   * as long as their ring holds two of the new periods and, for the first two, the
+   * stream is interleaved. Otherwise they are stopped and their callback gets an
+   * `error` event. In {@link RtAudioStreamMode.WORKER} mode the buffer size can't
+   * change.
+   *
+   * Until the promise settles, methods that use the backend stream or its buffer size,
+   * e.g. `getStreamTime()`, `getStreamLatency()`, `startRecording()` or `createVoice()`,
+   * throw, and `getStreamClock()` returns null.
+   *
+   * @param outputParameters New output parameters, undefined to keep the current ones.
+   * @param inputParameters New input parameters, undefined to keep the current ones.
+   * @param bufferFrames New buffer size, undefined to keep the current one.
+   * @returns The actual bufferFrames value used by the device.
+   */
+  reconfigureStream(
+    outputParameters?: StreamParameters | null,
+    inputParameters?: StreamParameters | null,
+    bufferFrames?: number
+  ): Promise<number>
+
+  /** Returns how long the last open, start and restart took. */
+  getStartupStats(): StartupStats
+
   /**
    * A function that closes a stream and frees any associated stream memory.
    * 
@@ -92,6 +151,9 @@ export declare class RtAudio {
    */
   closeStream(): void
 
+  /** Like `closeStream()`, the backend closes the stream on a libuv worker thread. */
+  closeStreamAsync(): Promise<void>
+
   /**
    * A function that starts a stream.
    * 
@@ -101,6 +163,12 @@ export declare class RtAudio {
    */
   startStream(): void
 
+  /**
+   * Like `startStream()`, the backend starts the stream on a libuv worker thread.
+   * Rejects with RtAudio's error text if it couldn't.
+   */
+  startStreamAsync(): Promise<void>
+
   /**
    * Stop a stream, allowing any samples remaining in the output queue to be played.
    * 
@@ -110,6 +178,12 @@ export declare class RtAudio {
    */
   stopStream(): void
 
+  /**
+   * Like `stopStream()`, the backend drains and stops the stream on a libuv worker
+   * thread. Rejects with RtAudio's error text if it couldn't.
+   */
+  stopStreamAsync(): Promise<void>
+
   /**
    * Stop a stream, discarding any samples remaining in the input/output queue.
    * 
@@ -133,6 +207,28 @@ export declare class RtAudio {
    */
   getDevices(): DeviceInfo[]
 
+  /**
+   * Like `getDevices()`, but the system query runs on a libuv worker thread, so slow
+   * backends don't block the event loop. The result also refreshes the device list
+   * `openStream()` validates device IDs against.
+   */
+  getDevicesAsync(): Promise<DeviceInfo[]>
+
+  /**
+   * Get notified when devices appear, disappear or change, e.g. the default device.
+   * RtAudio has no hotplug notifications, so a native thread queries the devices every
+   * `intervalMs` and only calls `callback` when the list changed. A device disconnect
+   * error triggers a query right away. Watching doesn't keep the process alive.
+   *
+   * @param callback Called on the JS thread with the new list and the devices that were
+   * added or removed, null to stop watching.
+   * @param intervalMs Milliseconds between queries, at least 10 (default = 1000).
+   */
+  setDeviceChangeCallback(
+    callback: ((event: DeviceChangeEvent) => void) | null,
+    intervalMs?: number
+  ): void
+
   /**
    * A function that returns the ID of the default input device.
    * 
@@ -170,7 +266,9 @@ export declare class RtAudio {
    * For duplex streams, the returned value will represent the sum of
    * the input and output latencies.  If a stream is not open, the
    * returned value will be invalid.  If the API does not report
-   * latency, the return value will be zero.
+   * latency, the return value will be zero. The buffering added by the
+   * `periodsPerCallback` option and the resampler filters of `clientSampleRate`
+   * are included.
    */
   getStreamLatency(): number
 
@@ -206,6 +304,361 @@ export declare class RtAudio {
    */
   getErrorText(): string
 
+  /**
+   * Queue output frames on a stream opened in {@link RtAudioStreamMode.BUFFERED} mode.
+   * 
+   * The data is copied into the output ring buffer, which the audio thread drains
+   * one period at a time. Only whole frames are taken. If JS falls behind, the audio
+   * thread plays silence for the missing frames.
+   * 
+   * @param data interleaved PCM samples in the stream format
+   * 
+   * @returns the number of frames accepted, which is less than the frames in `data`
+   * when the ring buffer is full.
+   */
+  write(data: ArrayBufferView): number
+
+  /**
+   * Dequeue captured input frames from a stream opened in
+   * {@link RtAudioStreamMode.BUFFERED} mode.
+   * 
+   * If JS falls behind and the input ring buffer fills up, the newest input is dropped.
+   * 
+   * @param data buffer to copy interleaved PCM samples in the stream format into
+   * 
+   * @returns the number of frames copied into `data`.
+   */
+  read(data: ArrayBufferView): number
+
+  /**
+   * Returns the fill levels of the ring buffers of a stream opened in
+   * {@link RtAudioStreamMode.BUFFERED} mode, in frames.
+   */
+  getBufferedFrames(): BufferedFrames
+
+  /**
+   * Returns the number of periods since the stream was opened in which the callback
+   * missed its deadline and the output was concealed (see the `deadline` option).
+   */
+  getDeadlineMisses(): number
+
+  /**
+   * Returns counters and timing histograms collected on the realtime thread since the
+   * stream was opened or `resetStreamStats()` was last called.
+   */
+  getStreamStats(): StreamStats
+
+  /**
+   * Copies the stream statistics into a preallocated array of at least
+   * {@link STREAM_STATS_SNAPSHOT_LENGTH} elements, without allocating.
+   *
+   * The layout is `callbacks, inputOverflows, outputUnderflows, deadlineMisses,
+   * ringUnderruns, ringOverruns`, followed by the `dispatchLatency`, `jsExecution` and
+   * `turnaround` histograms, each as `count, sum (us), max (us)` and the bucket counts.
+   *
+   * @returns `snapshot`.
+   */
+  getStreamStats(snapshot: Float64Array): Float64Array
+
+  /**
+   * Resets all counters and histograms returned by `getStreamStats()`,
+   * `getMixerStats()` and `getGateStats()`.
+   */
+  resetStreamStats(): void
+
+  /** Returns the state and counters of the silence gate, see the `gate` option. */
+  getGateStats(): GateStats
+
+  /**
+   * Returns how far an offline stream has rendered, see the `offline` option, or null if
+   * the stream isn't offline.
+   */
+  getOfflineProgress(): OfflineResult | null
+
+  /**
+   * Start recording the stream input to a file, natively.
+   *
+   * The audio thread copies each input period into a ring buffer and a background
+   * thread writes it out in large batches, so the recording neither goes through JS nor
+   * depends on the event loop. WAV headers are kept up to date while recording. The
+   * stream callback, if any, still runs as usual.
+   *
+   * @param path file to write, an existing file is overwritten
+   * @param options recording options
+   * @param callback invoked with progress and error events
+   */
+  startRecording(
+    path: string,
+    options?: RecordingOptions | null,
+    callback?: RtAudioRecordingCallback | null
+  ): void
+
+  /**
+   * Stop recording, flushing everything captured so far and finalizing the file.
+   * Closing the stream stops the recording as well.
+   */
+  stopRecording(): RecordingInfo
+
+  /**
+   * Start playing a WAV or raw PCM file into the stream output, natively.
+   *
+   * The file is memory-mapped and mixed into the output on the audio thread, converted
+   * to the stream format, so no JS runs per period while it plays. A mono file plays on
+   * every output channel, other files channel by channel. The sample rate is not
+   * converted. Starting another playback replaces the current one.
+   *
+   * @param path file to play
+   * @param options playback options
+   * @param callback invoked with `end` once the file has played to the end
+   *
+   * @returns the layout of the file.
+   */
+  startPlayback(
+    path: string,
+    options?: PlaybackOptions | null,
+    callback?: RtAudioPlaybackCallback | null
+  ): PlaybackInfo
+
+  /** Stop the current playback. */
+  stopPlayback(): void
+
+  /**
+   * Continue playback from the given frame of the file, from the next period on.
+   * Seeking after the end restarts a finished playback.
+   */
+  seekPlayback(frame: number): void
+
+  /** Returns the frame of the file that plays next. */
+  getPlaybackPosition(): number
+
+  /**
+   * Start encoding the stream input to Opus or FLAC, natively.
+   *
+   * The audio thread copies each input period into a ring buffer and a background
+   * thread encodes the first `channels` input channels, so no PCM goes through JS.
+   * Packets are handed to the callback in batches every `batchInterval` milliseconds,
+   * and the rest once the encoder stops. The stream callback, if any, still runs as
+   * usual.
+   *
+   * The codecs come from the system's libopus and libFLAC, loaded on first use; this
+   * throws if the library isn't found. Opus needs a stream rate of 8, 12, 16, 24 or
+   * 48 kHz.
+   *
+   * @param options encoder options
+   * @param callback invoked with the packets and errors
+   */
+  startEncoder(options: EncoderOptions, callback: RtAudioEncoderCallback): void
+
+  /**
+   * Stop encoding. The last packets, including a padded Opus packet for the remaining
+   * frames, are still handed to the callback. Closing the stream stops the encoder as
+   * well.
+   */
+  stopEncoder(): EncoderInfo
+
+  /**
+   * Start playing Opus or FLAC packets, queued with `queueEncoded()`, into the stream
+   * output, natively.
+   *
+   * A background thread decodes the packets ahead into a buffer, which the audio thread
+   * mixes into the output like `startPlayback()` does: a mono stream plays on every
+   * output channel, other streams channel by channel. The packets have to be at the
+   * stream rate. Starting another decoder replaces the current one.
+   *
+   * @param options decoder options, as passed to `startEncoder()` on the sending side
+   * @param callback invoked with `end` once everything queued has played after
+   * `queueEncoded(null)`, or with errors
+   */
+  startDecoder(options: DecoderOptions, callback?: RtAudioDecoderCallback | null): void
+
+  /**
+   * Queue a packet for the decoder, e.g. the `data` of an `EncodedPacket`. An empty
+   * packet stands for a lost Opus packet, whose audio is concealed; null marks the end
+   * of the stream.
+   *
+   * @returns the packets waiting to be decoded.
+   */
+  queueEncoded(packet: Uint8Array | null): number
+
+  /** Stop the decoder, dropping whatever hasn't played yet. */
+  stopDecoder(): DecoderInfo
+
+  /**
+   * Add a voice to the native output mixer.
+   *
+   * Every voice has its own queue of float32 samples at the stream rate, filled with
+   * `queueVoice()`, and a gain and pan. The audio thread sums the voices into the first
+   * two output channels after the callback and any playback, so many sounds can play
+   * at once without a JS call per period. Adding and removing voices never blocks the
+   * audio thread; there are `maxVoices` slots (see the stream options).
+   *
+   * @param options voice options
+   *
+   * @returns the voice id.
+   */
+  createVoice(options?: VoiceOptions | null): number
+
+  /**
+   * Queue interleaved float32 samples for a voice. Only whole frames that fit into the
+   * queue are taken.
+   *
+   * @returns the number of frames queued, 0 if the voice has finished.
+   */
+  queueVoice(voice: number, samples: Float32Array): number
+
+  /**
+   * Set the gain of a voice, ramped in over the next period.
+   *
+   * @returns false if the voice has finished.
+   */
+  setVoiceGain(voice: number, gain: number): boolean
+
+  /**
+   * Set the pan of a voice, from -1 (left) to 1 (right), ramped in over the next period.
+   * Mono voices use a constant power pan law, stereo ones a balance.
+   *
+   * @returns false if the voice has finished.
+   */
+  setVoicePan(voice: number, pan: number): boolean
+
+  /**
+   * Remove a voice. It fades out over the next period, or with `drain` plays what's
+   * queued and then finishes. No more samples can be queued either way.
+   *
+   * @returns false if the voice had already finished.
+   */
+  removeVoice(voice: number, drain?: boolean): boolean
+
+  /** Returns the frames queued for a voice, or -1 if it has finished. */
+  getVoiceQueuedFrames(voice: number): number
+
+  /** Returns the voice counts and render timings of the output mixer. */
+  getMixerStats(): MixerStats
+
+  /**
+   * Load float32 samples at the stream rate for `scheduleClip()`. The samples are copied,
+   * and clips stay loaded across streams until `unloadClip()`.
+   *
+   * @param samples Interleaved samples.
+   * @param channels 1 or 2 (default = 1).
+   *
+   * @returns the clip id.
+   */
+  loadClip(samples: Float32Array, channels?: number): number
+
+  /**
+   * Unload a clip. Voices that are playing it finish normally.
+   *
+   * @returns false if the clip wasn't loaded.
+   */
+  unloadClip(clip: number): boolean
+
+  /**
+   * Play a loaded clip, or a copy of the given samples, through the output mixer from a
+   * stream frame on. The audio thread starts it at that exact frame, also within a
+   * period, with no JS calls after this one.
+   *
+   * Stream frames count like `getStreamTime()` at the stream rate. To start at a
+   * `process.hrtime.bigint()` time, see `hrtimeToStreamFrame()`. A clip whose start
+   * frame has already passed when the audio thread gets to it skips the frames it
+   * missed, so it stays aligned, and is counted in {@link MixerStats.lateStarts}.
+   *
+   * @param clip A clip id from `loadClip()`, or interleaved samples.
+   * @param options clip options
+   *
+   * @returns the voice id, which works with `setVoiceGain()`, `setVoicePan()`,
+   * `removeVoice()` and `getVoiceQueuedFrames()`.
+   */
+  scheduleClip(clip: number | Float32Array, options?: ClipOptions | null): number
+
+  /**
+   * Returns how stream frames currently map to `process.hrtime`, or null before the
+   * first period of an open stream. The callback times are smoothed with a delay-locked
+   * loop, so the mapping follows the device clock without the callback jitter.
+   */
+  getStreamClock(): StreamClock | null
+
+  /**
+   * Returns the `process.hrtime.bigint()` time the audio thread processes a stream frame
+   * at, see `getStreamClock()`. Add `getStreamLatency()` for the time it is heard.
+   */
+  streamFrameToHrtime(frame: number): bigint
+
+  /** Returns the stream frame the audio thread processes at a `process.hrtime.bigint()` time. */
+  hrtimeToStreamFrame(time: bigint): number
+
+  /**
+   * Run a native processing graph on the audio thread, or remove it with `null`.
+   *
+   * Nodes are evaluated in order every period, each node may only take inputs from
+   * earlier ones. The output of the last node is added to the stream output after the
+   * callback, a mono last node on every output channel. Together with a `null` stream
+   * callback, e.g. a monitor or echo path then runs without any JS per period:
+   *
+   * ```js
+   * rtAudio.setProcessingGraph([
+   *   { type: 'input' },
+   *   { type: 'delay', input: 0, delay: 24000, feedback: 0.4 },
+   *   { type: 'mix', inputs: [0, 1], gains: [1, 0.5] },
+   * ])
+   * ```
+   *
+   * The graph replaces the current one at the start of the next period. Closing the
+   * stream removes it.
+   *
+   * @param nodes the graph nodes
+   */
+  setProcessingGraph(nodes: DspNode[] | null): void
+
+  /**
+   * Change a parameter of a node of the current processing graph.
+   *
+   * Changes are passed to the audio thread through a lock-free queue and applied at
+   * the start of the next period, gains ramp in over that period.
+   *
+   * @param node index of the node
+   * @param parameter `gain` of gain and mix nodes (`index` picks the mix input),
+   * `frequency`, `q` and `filterGain` of biquad nodes, `delay` and `feedback` of delay
+   * nodes
+   * @param value the new value
+   * @param index input of a mix node (default = 0)
+   *
+   * @returns false if the queue is full and the change was dropped.
+   */
+  setGraphParameter(
+    node: number,
+    parameter: 'gain' | 'frequency' | 'q' | 'filterGain' | 'delay' | 'feedback',
+    value: number,
+    index?: number
+  ): boolean
+
+  /**
+   * Start metering the stream input or output.
+   *
+   * The audio thread only copies each period into a ring, levels and the spectrum are
+   * computed on a separate thread. `callback` is called `rate` times a second with a
+   * Float32Array that holds the peak level of every channel, then the RMS level of
+   * every channel, then with `fftSize` set the `fftSize / 2` magnitudes of the spectrum
+   * of the channel average (bin `k` is at `k * sampleRate / fftSize` Hz, a full scale
+   * sine peaks at 1). Levels are linear, 1 is full scale.
+   *
+   * The same array is reused for every call, copy it to keep results. Results a busy
+   * event loop didn't pick up are replaced by newer ones rather than queued. Starting
+   * again replaces the current analysis, closing the stream stops it.
+   *
+   * @param options analysis options
+   * @param callback called with the latest results
+   *
+   * @returns the results array passed to `callback`.
+   */
+  startAnalysis(
+    options: AnalysisOptions | null,
+    callback: (results: Float32Array) => void
+  ): Float32Array
+
+  /** Stop metering, see `startAnalysis()`. */
+  stopAnalysis(): void
+
   /** A static function to determine the current RtAudio version. */
   static getVersion(): string
 
@@ -234,13 +687,185 @@ export declare class RtAudio {
    * @param api the API id
    */
   static getApiName(api: RtAudioApi): string
+
+  /**
+   * Converts samples between two formats with the same kernels `jsFormat` uses.
+   * Converts as many samples as both arrays hold, in host byte order.
+   * 
+   * @param from The samples to convert.
+   * @param fromFormat The format of `from`.
+   * @param to Where the converted samples are written.
+   * @param toFormat The format of `to`.
+   * @param options `dither` adds TPDF dither when quantizing to 8, 16 or 24 bits,
+   * `reference` uses the scalar kernels instead of the SIMD ones, for comparisons.
+   */
+  static convertSamples(
+    from: ArrayBufferView,
+    fromFormat: RtAudioFormat,
+    to: ArrayBufferView,
+    toFormat: RtAudioFormat,
+    options?: { dither?: boolean; reference?: boolean }
+  ): void
+
+  /**
+   * Returns the instruction set the sample conversion kernels use on this CPU:
+   * "avx2", "sse2", "neon" or "scalar".
+   */
+  static getSampleConversionIsa(): string
+}
+
+/**
+ * An input stream over several devices, e.g. a handful of USB microphones, delivered
+ * to one callback as a single interleaved Float32Array with every device's channels
+ * side by side, in the order the devices were given.
+ * 
+ * Each device runs its own stream. The first one is the clock master and drives the
+ * callback; every other device feeds a lock-free ring from its own audio thread, so
+ * none of them waits for another, and is resampled to the master's clock. The
+ * resampling ratio follows the drift between the clocks, estimated from the fill
+ * level of the device's ring (see `getDriftStats()`).
+ * 
+ * The secondary devices lag the master by a constant `targetFrames` plus 16 frames
+ * of resampler delay; capture is aligned in rate, not in absolute time.
+ */
+export declare class RtAudioAggregate {
+  /**
+   * @param api The audio API all devices are opened with, see {@link RtAudio}.
+   */
+  constructor(api?: RtAudioApi)
+
+  /**
+   * Opens a stream on every device.
+   * 
+   * @param devices The devices to capture from, the first one being the clock master.
+   * @param sampleRate The sample rate all devices run at.
+   * @param bufferFrames The desired number of frames per callback.
+   * @param options Stream options.
+   * @param callback Called with every aggregate period.
+   * 
+   * @returns The number of frames per callback, as settled on by the master device.
+   */
+  openStream(
+    devices: AggregateDeviceParameters[],
+    sampleRate: number,
+    bufferFrames: number,
+    options: AggregateStreamOptions | null,
+    callback: RtAudioAggregateCallback | null
+  ): number
+
+  /** Closes every device's stream. */
+  closeStream(): void
+
+  /** Starts every device, the secondary ones first. */
+  startStream(): void
+
+  /** Stops every device. */
+  stopStream(): void
+
+  /** Returns true if the stream is open. */
+  isStreamOpen(): boolean
+
+  /** Returns true if the stream is running. */
+  isStreamRunning(): boolean
+
+  /**
+   * Returns the largest input latency over the devices in frames, including the ring
+   * and resampler delay of the secondary ones.
+   */
+  getStreamLatency(): number
+
+  /** Returns the clock tracking state of each secondary device. */
+  getDriftStats(): AggregateDriftStats[]
+}
+
+/** A device of an aggregate stream. */
+export declare interface AggregateDeviceParameters {
+  /** Device id as provided by `getDevices`. */
+  deviceId: number
+
+  /** Number of input channels. */
+  nChannels: number
+
+  /** First channel index on device (default = 0). */
+  firstChannel?: number
+}
+
+/** Options of `RtAudioAggregate.openStream()`. */
+export declare interface AggregateStreamOptions {
+  /** A bit-mask of stream flags, RTAUDIO_NONINTERLEAVED is ignored. */
+  flags?: number
+
+  /** Number of stream buffers, per device. */
+  numberOfBuffers?: number
+
+  /** Stream name (for JACK). */
+  streamName?: string
+
+  /**
+   * Follow the clock drift of the secondary devices (default = true). Without it
+   * their rings eventually run dry or overflow, which re-syncs them with a gap.
+   */
+  driftCorrection?: boolean
+}
+
+/** Clock tracking state of a secondary device, see `getDriftStats()`. */
+export declare interface AggregateDriftStats {
+  deviceId: number
+
+  /** How much faster the device's clock runs than the master's, in ppm. */
+  driftPpm: number
+
+  /** Smoothed fill level of the device's ring, in frames. */
+  bufferedFrames: number
+
+  /** The fill level the drift correction steers to, in frames. */
+  targetFrames: number
+
+  /** Master periods the ring had too few frames for, filled with silence. */
+  underruns: number
+
+  /** Device periods that didn't fit into the ring and were dropped. */
+  overruns: number
 }
 
+/**
+ * Aggregate stream callback.
+ * 
+ * @param input The interleaved frames of all devices, `nFrames` frames of the sum of
+ * all devices' channels. Buffers are reused every other period.
+ * @param nFrames The number of frames.
+ * @param streamTime The master device's stream time in seconds.
+ * @param status Status flags of any of the devices, see {@link RtAudioStreamStatus}.
+ * 
+ * @returns Zero or undefined to keep the stream running, non-zero to stop it.
+ */
+export declare type RtAudioAggregateCallback = (
+  input: Float32Array,
+  nFrames: number,
+  streamTime: number,
+  status: RtAudioStreamStatus
+) => number | void
+
 /** Audio API specifier arguments */
 export declare enum RtAudioApi {
-  /** Search for a working compiled API. */
+  /**
+   * Search for a working compiled API. On Linux PulseAudio is tried first, then JACK and
+   * ALSA.
+   */
   UNSPECIFIED = 0,
 
+  /**
+   * The Advanced Linux Sound Architecture API. Devices other than `default` are opened
+   * directly, without the buffering of a sound server.
+   */
+  LINUX_ALSA = 2,
+
+  /**
+   * The JACK Low-Latency Audio Server API. libjack is loaded when it is first used, so
+   * without it this API just has no devices.
+   */
+  UNIX_JACK = 3,
+
   /** The Linux PulseAudio API. */
   LINUX_PULSE = 4,
 
@@ -249,6 +874,12 @@ export declare enum RtAudioApi {
 
   /** The Microsoft DirectSound API. */
   WINDOWS_DS = 8,
+
+  /**
+   * RtAudio's dummy API. Builds with the `RTAUDIO_JS_LOOPBACK` CMake option back it with
+   * a headless loopback device that captures its own output.
+   */
+  RTAUDIO_DUMMY = 9,
 }
 
 /** 
@@ -330,12 +961,34 @@ export declare enum RtAudioStreamFlags {
   RTAUDIO_JACK_DONT_CONNECT = 0x20,
 }
 
-/** RtAudio error types */
-export declare enum RtAudioErrorType {
-  /** A non-critical error. */
-  WARNING,
+/** How audio is exchanged between the realtime audio thread and JS. */
+export declare enum RtAudioStreamMode {
+  /**
+   * The callback is invoked for every period and the audio thread waits for it
+   * to return (default).
+   */
+  CALLBACK = 0,
 
-  /** A non-critical error which might be useful for debugging. */
+  /**
+   * The audio thread only moves data through preallocated lock-free ring buffers,
+   * JS pushes output with `write()` and pulls input with `read()` at its own pace.
+   */
+  BUFFERED = 1,
+
+  /**
+   * The callback runs in a worker_threads Worker and exchanges audio with the
+   * audio thread through SharedArrayBuffers. Set automatically when the `worker`
+   * option is given.
+   */
+  WORKER = 2,
+}
+
+/** RtAudio error types */
+export declare enum RtAudioErrorType {
+  /** A non-critical error. */
+  WARNING,
+
+  /** A non-critical error which might be useful for debugging. */
   DEBUG_WARNING,
 
   /** The default, unspecified error type. */
@@ -377,6 +1030,38 @@ export declare enum RtAudioStreamStatus {
   RTAUDIO_INPUT_OVERFLOW = 1,
   /** The output buffer ran low, likely producing a break in the output sound. */
   RTAUDIO_OUTPUT_UNDERFLOW = 2,
+  /**
+   * The callback missed the deadline of an earlier period (see the `deadline`
+   * option) and the output of that period was concealed.
+   */
+  RTAUDIO_DEADLINE_MISSED = 0x10,
+}
+
+/** What is played instead of the callback's output when it misses its deadline. */
+export declare enum RtAudioConcealment {
+  /** Play silence. */
+  SILENCE = 0,
+
+  /** Repeat the last output buffer. */
+  REPEAT = 1,
+
+  /** Fade the last output buffer out, then play silence. */
+  FADE_OUT = 2,
+}
+
+/**
+ * Filter length of the `clientSampleRate` resampler. Longer filters reject more
+ * aliasing and add more latency, see `getStreamLatency()`.
+ */
+export declare enum RtAudioResamplerQuality {
+  /** 16 taps per phase, about 60 dB of stopband attenuation. */
+  FAST = 0,
+
+  /** 32 taps per phase, about 85 dB of stopband attenuation. */
+  MEDIUM = 1,
+
+  /** 64 taps per phase, about 110 dB of stopband attenuation. */
+  BEST = 2,
 }
 
 /** Stream options */
@@ -392,6 +1077,671 @@ export declare type StreamOptions = {
 
   /** Scheduling priority of callback thread (only used with flag RTAUDIO_SCHEDULE_REALTIME). */
   priority?: number
+
+  /** How audio is exchanged with JS (default = {@link RtAudioStreamMode.CALLBACK}). */
+  mode?: RtAudioStreamMode
+
+  /** Depth of each ring buffer in frames, buffered mode only (default = 4 * bufferFrames). */
+  ringBufferFrames?: number
+
+  /**
+   * The watermark callback fires when the output ring holds this many frames or less,
+   * or the input ring holds this many frames or more. Buffered mode only
+   * (default = ringBufferFrames / 2).
+   */
+  watermarkFrames?: number
+
+  /**
+   * Number of preallocated output/input buffers that are handed to the callback
+   * round-robin instead of allocating new ones every period, callback mode only
+   * (default = 0, i.e. no pooling).
+   * 
+   * A buffer passed to the callback is overwritten `bufferPoolSize` periods later,
+   * so copy its contents if they are needed for longer than that.
+   */
+  bufferPoolSize?: number
+
+  /**
+   * Deliver callback buffers as typed arrays matching the stream format (Int8Array,
+   * Int16Array, Int32Array, Float32Array or Float64Array) instead of Uint8Array.
+   * With RTAUDIO_NONINTERLEAVED, each buffer is delivered as an array holding one
+   * typed array per channel. Callback mode only (default = false).
+   * 
+   * The views are built once and reused, so this implies a `bufferPoolSize` of 2
+   * if none is given.
+   */
+  typedBuffers?: boolean
+
+  /**
+   * Sample format of the buffers JS works with, if it should differ from the
+   * stream format (default = 0, i.e. the stream format). Samples are converted
+   * natively on the way in and out with SIMD kernels, so e.g. a device running
+   * RTAUDIO_SINT16 can be processed as Float32Array with `typedBuffers`. Applies
+   * to the callback, `write`/`read` and worker buffers; recordings and playback
+   * stay in the stream format. Conversions to integers clip.
+   */
+  jsFormat?: RtAudioFormat
+
+  /**
+   * Add TPDF dither when `jsFormat` samples are quantized to an 8, 16 or 24-bit
+   * stream format (default = false).
+   */
+  dither?: boolean
+
+  /**
+   * Path of a script to run the stream callback in, on a dedicated worker_threads
+   * Worker instead of the main thread. The script should export an
+   * {@link RtAudioCallback} (`module.exports = (output, input, ...) => { ... }`).
+   * 
+   * The audio thread exchanges input and output with the worker through
+   * SharedArrayBuffers, the main thread is only notified of control events through
+   * {@link RtAudioWorkerEventCallback}. `typedBuffers` applies to the worker's
+   * buffers as well.
+   */
+  worker?: string
+
+  /**
+   * How long the audio thread waits for the callback, as a fraction of a period
+   * (`bufferFrames / sampleRate`). If the callback hasn't returned by then, the
+   * output is concealed natively (see `concealment`) and the stream carries on
+   * without waiting. Callback mode only (default = 0, i.e. wait forever).
+   * 
+   * While a late callback is still running no new one is dispatched, so the
+   * input of those periods is not delivered. Misses are counted by
+   * `getDeadlineMisses()` and flagged to the next callback with
+   * {@link RtAudioStreamStatus.RTAUDIO_DEADLINE_MISSED}.
+   */
+  deadline?: number
+
+  /** What to play when the deadline is missed (default = {@link RtAudioConcealment.SILENCE}). */
+  concealment?: RtAudioConcealment
+
+  /**
+   * Play the output of a callback that missed its deadline in the following period,
+   * if that period misses its deadline as well, instead of concealing it
+   * (default = false, i.e. late output is discarded).
+   */
+  applyLateResults?: boolean
+
+  /**
+   * Invoke the callback once per this many device periods, with one contiguous block of
+   * `periodsPerCallback * bufferFrames` frames (default = 1).
+   *
+   * This keeps the device period small while paying the cost of a JS call only once
+   * per block. The binding double-buffers the blocks, so JS has a whole block's time to
+   * produce its output. In exchange, output plays one block later and input reaches JS
+   * up to one block minus one period late. `getStreamLatency()` includes both. Only
+   * supported in {@link RtAudioStreamMode.CALLBACK} mode without a `deadline`.
+   */
+  periodsPerCallback?: number
+
+  /**
+   * Sample rate the callback works at, if it should differ from the stream's
+   * (default = 0, i.e. the stream rate). A native polyphase resampler sits between
+   * the device and the callback buffers, so e.g. a 48000 Hz device can feed a
+   * 16000 Hz pipeline. The callback's `nFrames` is then the client frame count,
+   * which alternates between the two nearest integers when `bufferFrames` doesn't
+   * divide evenly. Periods of the smaller size get views of their own length over
+   * the pooled buffers, so both sizes reuse the pool's memory.
+   * 
+   * Only supported in {@link RtAudioStreamMode.CALLBACK} mode without a `deadline`
+   * or `periodsPerCallback`.
+   */
+  clientSampleRate?: number
+
+  /** Filter quality of the `clientSampleRate` resampler (default = {@link RtAudioResamplerQuality.MEDIUM}). */
+  resamplerQuality?: RtAudioResamplerQuality
+
+  /**
+   * Voice slots of the output mixer, see `createVoice()` (default = 32). 0 disables the
+   * mixer.
+   */
+  maxVoices?: number
+
+  /**
+   * Skip the callback while the input is silent. The gate decides on the audio thread,
+   * so silent periods never wake JS. When it opens, the period that opened it is
+   * delivered together with up to `preRoll` seconds of the periods before it, in one
+   * call whose `nFrames` and `streamTime` cover all of them.
+   *
+   * Only supported on input-only streams in {@link RtAudioStreamMode.CALLBACK} mode
+   * without a `deadline`, `periodsPerCallback` or `clientSampleRate`.
+   */
+  gate?: GateOptions | null
+
+  /**
+   * The input channels JS gets, in order. Channels are numbered from `firstChannel`
+   * of the input parameters and may repeat. Only these channels are copied into the
+   * callback's input buffer, which has one channel per entry. For example, channels 3
+   * and 17 of a 32 channel stream:
+   *
+   * ```js
+   * { inputChannelMap: [3, 17] }
+   * ```
+   *
+   * Only supported in {@link RtAudioStreamMode.CALLBACK} mode (default = all channels).
+   */
+  inputChannelMap?: number[]
+
+  /**
+   * The output channels every channel of the callback's output buffer is played on,
+   * a channel number or an array of them to play it on several. Unmapped output
+   * channels are silent. For example, a stereo buffer on channels 8 and 9 with the left
+   * channel copied to channel 0:
+   *
+   * ```js
+   * { outputChannelMap: [[8, 0], 9] }
+   * ```
+   *
+   * Only supported in {@link RtAudioStreamMode.CALLBACK} mode (default = all channels).
+   */
+  outputChannelMap?: (number | number[])[]
+
+  /**
+   * Render on a virtual device as fast as the callback allows instead of in realtime,
+   * for batch jobs and tests. Input is read from a file or buffer, output written to a
+   * file and/or kept in memory, and the stream time passed to the callback is exact:
+   * it advances by one period per call however long the call takes. The device IDs of
+   * the stream parameters are ignored, device queries keep answering for the devices.
+   *
+   * The stream stops by itself when rendering ends, and `callback` is called. Close it
+   * from there, or after the stream callback returned 1. `stopStream()` pauses
+   * rendering after the current period and returns right away; the stream is stopped,
+   * and can be resumed with `startStream()`, once `callback` was called. Closing a
+   * running offline stream drops the pending callback call.
+   *
+   * Only supported in {@link RtAudioStreamMode.CALLBACK} mode without a deadline.
+   */
+  offline?: OfflineOptions | null
+}
+
+/** Options of offline rendering, see {@link StreamOptions.offline}. */
+export declare interface OfflineOptions {
+  /**
+   * Frames to render, rounded up to whole periods. Without it rendering ends with the
+   * input (default = 0).
+   */
+  frames?: number
+
+  /**
+   * A WAV or raw PCM file with the stream's channel count, or interleaved samples in the
+   * stream format, which are copied. The input is silent without it.
+   */
+  input?: string | ArrayBufferView
+
+  /** Container of the input file, raw files are in the stream format (default = 'wav'). */
+  inputContainer?: 'wav' | 'raw'
+
+  /** File the output is written to, every period of it. */
+  output?: string
+
+  /** Container of the output file (default = 'wav'). */
+  outputContainer?: 'wav' | 'raw'
+
+  /** Keep the output in memory and pass it to `callback`, needs an interleaved stream (default = false). */
+  keepOutput?: boolean
+
+  /** Called on the JS thread when rendering ends. */
+  callback?: (result: OfflineResult) => void
+}
+
+/** Result of offline rendering, see {@link OfflineOptions.callback}. */
+export declare interface OfflineResult {
+  /** Frames rendered so far. */
+  frames: number;
+
+  /** Seconds of audio rendered so far. */
+  duration: number;
+
+  /** Seconds of wall clock time spent rendering. */
+  elapsed: number;
+
+  /** `duration` over `elapsed`, how many times faster than realtime the stream rendered. */
+  speedup: number;
+
+  /** Rendering reached `frames` or the end of the input, rather than being stopped. */
+  finished: boolean;
+
+  /** Set if writing the output file failed. */
+  error?: string;
+
+  /** The output with `keepOutput` set, interleaved in the stream format. */
+  output?: Uint8Array | Int8Array | Int16Array | Int32Array | Float32Array | Float64Array;
+}
+
+/** Options of the silence gate, see {@link StreamOptions.gate}. */
+export declare interface GateOptions {
+  /** Level in dBFS that opens the gate, the mean power of all channels (default = -40). */
+  threshold?: number
+
+  /** Level in dBFS the input has to stay below for the gate to close (default = threshold - 6). */
+  closeThreshold?: number
+
+  /** Seconds the gate stays open after the level dropped below `closeThreshold` (default = 0.5). */
+  hold?: number
+
+  /** Seconds of audio before the opening period that are delivered with it, up to 10 (default = 0.2). */
+  preRoll?: number
+
+  /**
+   * Also require the 300-3400 Hz band to be well above its tracked noise floor, so that
+   * steady noise louder than `threshold` doesn't hold the gate open (default = false).
+   */
+  vad?: boolean
+
+  /** Called on the JS thread when the gate opens or closes, with the level of that period in dBFS. */
+  callback?: (event: 'open' | 'close', streamTime: number, level: number) => void
+}
+
+/** State of the silence gate, see `getGateStats()`. */
+export declare interface GateStats {
+  open: boolean;
+
+  opens: number;
+
+  closes: number;
+
+  /** Periods that weren't delivered to the callback. */
+  suppressedPeriods: number;
+
+  suppressedFrames: number;
+
+  /** Periods that were delivered, pre-roll not included. */
+  deliveredPeriods: number;
+
+  /** Level of the last period in dBFS. */
+  level: number;
+
+  /** Speech band noise floor in dBFS, with `vad` set. */
+  noiseFloor: number;
+}
+
+/** Options of `startRecording()`. */
+export declare interface RecordingOptions {
+  /** File format, a WAV file or headerless PCM in the stream format (default = 'wav'). */
+  container?: 'wav' | 'raw'
+
+  /**
+   * Size of the buffer between the audio thread and the writer thread, in frames
+   * (default = 2 seconds). Periods that don't fit are dropped and counted.
+   */
+  bufferFrames?: number
+
+  /** Milliseconds between progress events, 0 disables them (default = 1000). */
+  progressInterval?: number
+}
+
+/** Options of `startPlayback()`. */
+export declare interface PlaybackOptions {
+  /** File format, a WAV file or headerless PCM (default = 'wav'). */
+  container?: 'wav' | 'raw'
+
+  /** Sample format of a raw file (default = the stream format). */
+  format?: RtAudioFormat
+
+  /** Channel count of a raw file (default = the stream output channels). */
+  channels?: number
+
+  /** Loop between `loopStart` and `loopEnd` instead of stopping at the end. */
+  loop?: boolean
+
+  /** First frame of the loop (default = 0). */
+  loopStart?: number
+
+  /** Frame after the last one of the loop (default = end of the file). */
+  loopEnd?: number
+}
+
+/** Codec options of `startEncoder()` and `startDecoder()`. */
+export declare interface CodecOptions {
+  codec: 'opus' | 'flac'
+
+  /**
+   * Encoded channels, the first ones of the stream (default = all of them, up to 2 for
+   * Opus and 8 for FLAC).
+   */
+  channels?: number
+
+  /** Opus: bits per second (default = the encoder's choice). */
+  bitrate?: number
+
+  /** Opus: milliseconds per packet, 2.5, 5, 10, 20, 40 or 60 (default = 20). */
+  frameDuration?: number
+
+  /** Opus: what the encoder tunes for (default = 'audio'). */
+  application?: 'voip' | 'audio' | 'lowdelay'
+
+  /** FLAC: 16 or 24 (default = 16). */
+  bitsPerSample?: number
+
+  /** FLAC: 0 (fastest) to 8 (smallest) (default = 5). */
+  compressionLevel?: number
+
+  /** Path of libopus or libFLAC (default = the usual names on this platform). */
+  library?: string
+}
+
+/** Options of `startEncoder()`. */
+export declare interface EncoderOptions extends CodecOptions {
+  /** Milliseconds between packet batches (default = 100). */
+  batchInterval?: number
+
+  /**
+   * Size of the buffer between the audio thread and the encoder thread, in frames
+   * (default = 1 second). Periods that don't fit are dropped and counted.
+   */
+  bufferFrames?: number
+}
+
+/** Options of `startDecoder()`. */
+export declare interface DecoderOptions extends CodecOptions {
+  /** Decoded frames buffered ahead of the output (default = 200 ms). */
+  bufferFrames?: number
+
+  /**
+   * Frames that have to be decoded before playing starts, and starts again after the
+   * decoder ran dry, to ride out packets that arrive unevenly (default = 0).
+   */
+  prebufferFrames?: number
+}
+
+/** Options of `createVoice()`. */
+export declare interface VoiceOptions {
+  /** 1 or 2 (default = 1). */
+  channels?: number
+
+  /** Capacity of the voice's sample queue in frames (default = one second). */
+  queueFrames?: number
+
+  /** Linear gain (default = 1). */
+  gain?: number
+
+  /** From -1 (left) to 1 (right) (default = 0). */
+  pan?: number
+
+  /**
+   * Stream frame the voice starts at, see {@link MixerStats.frame} (default = now).
+   * Frames before it are silent, a frame in the past starts the voice right away.
+   */
+  startFrame?: number
+}
+
+/** Options of `scheduleClip()`. */
+export declare interface ClipOptions {
+  /** Channels of the samples, 1 or 2 (default = 1). Loaded clips have their own. */
+  channels?: number
+
+  /** Stream frame the clip starts at, see {@link MixerStats.frame} (default = now). */
+  startFrame?: number
+
+  /** First frame of the clip to play (default = 0). */
+  offset?: number
+
+  /** Frames of the clip to play (default = the rest of the clip). */
+  frames?: number
+
+  /** Linear gain (default = 1). */
+  gain?: number
+
+  /** From -1 (left) to 1 (right) (default = 0). */
+  pan?: number
+}
+
+/** See `getStreamClock()`. */
+export declare interface StreamClock {
+  /** Stream frame of the last period. */
+  frame: number
+
+  /** Smoothed `process.hrtime` time in nanoseconds the last period was processed at. */
+  time: number
+
+  nanosecondsPerFrame: number
+
+  /** The sample rate measured against `process.hrtime`. */
+  sampleRate: number
+}
+
+/**
+ * A node of a processing graph, see `setProcessingGraph()`. Inputs are indices of
+ * earlier nodes, nodes have the channel count of their input unless noted otherwise.
+ *
+ * - `input`: the stream input, no inputs.
+ * - `gain`: `input` scaled by `gain`.
+ * - `mix`: the sum of `inputs`, each scaled by its entry of `gains`. Has the channel
+ *   count of its widest input, mono inputs are mixed into every channel.
+ * - `biquad`: `input` through a `filter` at `frequency` Hz with `q`, and `filterGain` dB
+ *   for the peaking and shelving filters.
+ * - `delay`: `input` delayed by `delay` frames, with `feedback` of the delayed signal
+ *   fed back into the line. Only the delayed signal is output, mix it with the input
+ *   for an echo.
+ * - `passthrough`: `input` unchanged.
+ * - `route`: a channel of `input` for every entry of `channels`, -1 for silence.
+ */
+export declare interface DspNode {
+  type: 'input' | 'gain' | 'mix' | 'biquad' | 'delay' | 'passthrough' | 'route'
+
+  input?: number
+
+  inputs?: number[]
+
+  /** Gain nodes (default = 1). */
+  gain?: number
+
+  /** Mix nodes, one per input (default = 1). */
+  gains?: number[]
+
+  /** Biquad nodes (default = 'lowpass'). */
+  filter?: 'lowpass' | 'highpass' | 'bandpass' | 'notch' | 'peaking' | 'lowshelf' |
+    'highshelf' | 'allpass'
+
+  /** Biquad nodes, in Hz (default = 1000). */
+  frequency?: number
+
+  /** Biquad nodes (default = 0.7071). */
+  q?: number
+
+  /** Peaking and shelving biquad nodes, in dB (default = 0). */
+  filterGain?: number
+
+  /** Delay nodes, in frames (default = 0). */
+  delay?: number
+
+  /** Delay nodes, the longest `delay` it can be set to in frames (default = max(delay, one second)). */
+  maxDelay?: number
+
+  /** Delay nodes (default = 0). */
+  feedback?: number
+
+  /** Route nodes. */
+  channels?: number[]
+}
+
+/** Options of `startAnalysis()`. */
+export declare interface AnalysisOptions {
+  /** The stream direction to meter (default = 'input'). */
+  source?: 'input' | 'output';
+
+  /** Results per second, up to 1000 (default = 30). */
+  rate?: number;
+
+  /** Frames per spectrum, 0 or a power of two between 64 and 16384 (default = 0, no spectrum). */
+  fftSize?: number;
+}
+
+/** State of the output mixer, see `getMixerStats()`. */
+export declare interface MixerStats {
+  /** Voices that haven't finished. */
+  voices: number;
+
+  /** Voices mixed in the last period. */
+  activeVoices: number;
+
+  maxVoices: number;
+
+  /**
+   * Stream frame of the next period, `getStreamTime()` times the sample rate. This is
+   * the clock of `startFrame`.
+   */
+  frame: number;
+
+  /** Times a playing voice ran out of queued samples. */
+  underruns: number;
+
+  /** Clips that started after their start frame and skipped the frames they missed. */
+  lateStarts: number;
+
+  /** Time the audio thread spends mixing each period. */
+  renderTime: LatencyHistogram;
+
+  /** Mean render time as a fraction of the period. */
+  load: number;
+}
+
+/** Layout of a file played with `startPlayback()`. */
+export declare interface PlaybackInfo {
+  frames: number;
+  channels: number;
+  sampleRate: number;
+  format: RtAudioFormat;
+}
+
+/** A packet from `startEncoder()`. */
+export declare interface EncodedPacket {
+  data: Uint8Array;
+
+  /**
+   * Encoded frame the packet starts at. Frames dropped because the encoder didn't keep
+   * up aren't counted.
+   */
+  frame: number;
+
+  /** Frames the packet holds, 0 for the FLAC stream header. */
+  frames: number;
+}
+
+/** State of an encoder. */
+export declare interface EncoderInfo {
+  packets: number;
+  bytes: number;
+  framesEncoded: number;
+
+  /** Frames dropped because the encoder didn't keep up. */
+  droppedFrames: number;
+
+  /** Set if encoding failed, nothing is encoded after that. */
+  error?: string;
+}
+
+/** State of a decoder. */
+export declare interface DecoderInfo {
+  packets: number;
+  framesDecoded: number;
+
+  /** Periods the decoder couldn't fill once playing. */
+  underruns: number;
+
+  /** Set if decoding failed. */
+  error?: string;
+}
+
+/** State of a recording. */
+export declare interface RecordingInfo {
+  /** Frames written to the file. */
+  framesWritten: number;
+
+  /** Frames dropped because the writer didn't keep up. */
+  droppedFrames: number;
+
+  /** Set if writing failed, nothing is written after that. */
+  error?: string;
+}
+
+/** Ring buffer fill levels of a buffered stream, in frames. */
+export declare interface BufferedFrames {
+  /** Frames queued for playback. */
+  output: number;
+
+  /** Captured frames waiting to be read. */
+  input: number;
+
+  /** Capacity of each ring buffer. */
+  capacity: number;
+}
+
+/**
+ * A histogram of durations, in microseconds. Bucket 0 counts durations below 1us,
+ * bucket `i` those between 2^(i-1) and 2^i us; the last bucket also counts everything
+ * above. Percentiles are estimated from the buckets.
+ */
+export declare interface LatencyHistogram {
+  count: number;
+  mean: number;
+  p50: number;
+  p99: number;
+  max: number;
+  buckets: number[];
+}
+
+/** Stream statistics, see `getStreamStats()`. */
+export declare interface StreamStats {
+  /** Periods handled by the realtime thread. */
+  callbacks: number;
+
+  /** Periods flagged with {@link RtAudioStreamStatus.RTAUDIO_INPUT_OVERFLOW}. */
+  inputOverflows: number;
+
+  /** Periods flagged with {@link RtAudioStreamStatus.RTAUDIO_OUTPUT_UNDERFLOW}. */
+  outputUnderflows: number;
+
+  /** Periods in which the callback missed its deadline, see the `deadline` option. */
+  deadlineMisses: number;
+
+  /** Buffered mode: periods the output ring buffer couldn't fill. */
+  ringUnderruns: number;
+
+  /** Buffered mode: periods whose input didn't fit into the input ring buffer. */
+  ringOverruns: number;
+
+  /** From the realtime thread handing a period to JS until the callback starts. */
+  dispatchLatency: LatencyHistogram;
+
+  /** Time spent in the JS callback. */
+  jsExecution: LatencyHistogram;
+
+  /** Time the realtime thread spends on each period, JS included. */
+  turnaround: LatencyHistogram;
+}
+
+/** Length of the array filled by `getStreamStats(snapshot)`. */
+export declare const STREAM_STATS_SNAPSHOT_LENGTH: number;
+
+/** See `setDeviceChangeCallback()`. */
+export declare interface DeviceChangeEvent {
+  devices: DeviceInfo[];
+
+  /** Devices whose ID wasn't in the previous list. */
+  added: DeviceInfo[];
+
+  /** Devices whose ID isn't in the new list. */
+  removed: DeviceInfo[];
+}
+
+/** See `getStartupStats()`, all times in milliseconds. */
+export declare interface StartupStats {
+  /** Time the backend took to open the stream, for a reconfigure to stop, close and reopen it. */
+  open: number;
+
+  /** Time the backend took to start the stream. */
+  start: number;
+
+  /** From the start request to the first callback, null until there was one. */
+  startToFirstCallback: number | null;
+
+  /** From the open or reconfigure request to the first callback, null until there was one. */
+  openToFirstCallback: number | null;
+
+  /** `reconfigureStream()` calls since the stream was opened. */
+  restarts: number;
 }
 
 /** The public device information structure for returning queried values. */
@@ -441,6 +1791,15 @@ export declare interface StreamParameters {
   firstChannel?: number;
 }
 
+/**
+ * The buffer type handed to the callback. It is a Uint8Array by default and a
+ * typed array matching the stream format (or `jsFormat`) with the `typedBuffers` option, or an
+ * array of per-channel typed arrays if the stream is also non-interleaved.
+ */
+export declare type RtAudioBuffer =
+  Uint8Array | Int8Array | Int16Array | Int32Array | Float32Array | Float64Array |
+  Array<Uint8Array | Int8Array | Int16Array | Int32Array | Float32Array | Float64Array>
+
 /**
  * A function that will be invoked when input data is 
  * available and/or output data is needed.
@@ -469,10 +1828,68 @@ export declare interface StreamParameters {
  * or a non-zero value to stop the stream.
  * 
  */
-export declare type RtAudioCallback =
+export declare type RtAudioCallback<T extends RtAudioBuffer = Uint8Array> =
   (
-    output: Uint8Array,
-    input: Uint8Array,
+    output: T,
+    input: T,
     nFrames: number,
     streamTime: number,
-    status: RtAudioStreamStatus) => number | undefined
\ No newline at end of file
+    status: RtAudioStreamStatus) => number | undefined
+
+/**
+ * A function that will be invoked on a buffered stream when the output ring buffer
+ * runs low or the input ring buffer fills up (see `watermarkFrames`).
+ * 
+ * It is a notification only, the audio thread never waits for it. Use
+ * `getBufferedFrames()` to see how much to write or read.
+ */
+export declare type RtAudioWatermarkCallback = () => void
+
+/**
+ * A function that will be invoked on the main thread for control events of a stream
+ * whose callback runs in a worker (see the `worker` option).
+ * 
+ * - `stop`: the worker callback returned a non-zero value.
+ * - `error`: the worker script threw, `detail` is the error.
+ * - `exit`: the worker exited, `detail` is the exit code. A running stream is aborted.
+ */
+export declare type RtAudioWorkerEventCallback =
+  (event: 'stop' | 'error' | 'exit', detail?: unknown) => void
+
+/**
+ * A function that will be invoked on the main thread for events of a recording started
+ * with `startRecording()`.
+ *
+ * - `progress`: sent every `progressInterval` milliseconds, `detail` is the recording
+ *   state.
+ * - `error`: writing the file failed, `detail` is the error.
+ */
+export declare type RtAudioRecordingCallback =
+  (event: 'progress' | 'error', detail: RecordingInfo | Error) => void
+
+/**
+ * A function that will be invoked on the main thread for events of a playback started
+ * with `startPlayback()`.
+ *
+ * - `end`: the file has played to the end.
+ */
+export declare type RtAudioPlaybackCallback = (event: 'end') => void
+
+/**
+ * A function that will be invoked on the main thread for events of an encoder started
+ * with `startEncoder()`.
+ *
+ * - `packets`: `detail` holds the packets since the last event, in order.
+ * - `error`: encoding failed, `detail` is the error.
+ */
+export declare type RtAudioEncoderCallback =
+  (event: 'packets' | 'error', detail: EncodedPacket[] | Error) => void
+
+/**
+ * A function that will be invoked on the main thread for events of a decoder started
+ * with `startDecoder()`.
+ *
+ * - `end`: everything queued before `queueEncoded(null)` has played.
+ * - `error`: decoding failed, `detail` is the error.
+ */
+export declare type RtAudioDecoderCallback = (event: 'end' | 'error', detail?: Error) => void
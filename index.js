@@ -1,26 +1,193 @@
 "use strict"
 
-const bindings = require('bindings')
-
-let RtAudio
-
-if (process.platform === 'win32') {
-  RtAudio = bindings('rtaudio-js-win32').NodeRtAudio
-} else if (process.platform === 'linux') {
-  RtAudio = bindings('rtaudio-js-linux-pulse.node').NodeRtAudio
-} else if (process.platform === 'darwin') {
-  RtAudio = bindings('rtaudio-js-darwin.node').NodeRtAudio
-} else {
-  throw 'RtAudio.js supports win32, darwin and linux only.'
+const path = require('path')
+const { Worker } = require('worker_threads')
+const { NodeRtAudio, NodeRtAudioAggregate } = require('./binding')
+
+/** Sample size in bytes of each RtAudioFormat. */
+const formatByteSize = { 0x1: 1, 0x2: 2, 0x4: 3, 0x8: 4, 0x10: 4, 0x20: 8 }
+
+class RtAudio extends NodeRtAudio {
+  #worker = null
+
+  openStream(outputParameters, inputParameters, format, sampleRate, bufferFrames, options, callback) {
+    if (!options || options.worker === undefined) {
+      return super.openStream(outputParameters, inputParameters, format, sampleRate, bufferFrames, options, callback)
+    }
+
+    this.#checkWorkerOptions(options, callback)
+
+    const frames = super.openStream(
+      outputParameters,
+      inputParameters,
+      format,
+      sampleRate,
+      bufferFrames,
+      { ...options, mode: module.exports.RtAudioStreamMode.WORKER },
+      null
+    )
+
+    if (!this.isStreamOpen()) {
+      return frames
+    }
+
+    this.#startWorker(frames, outputParameters, inputParameters, format, options, callback)
+
+    return frames
+  }
+
+  /** Like `openStream()`, the backend opens the stream on a libuv worker thread. */
+  async openStreamAsync(outputParameters, inputParameters, format, sampleRate, bufferFrames, options, callback) {
+    if (!options || options.worker === undefined) {
+      return super.openStreamAsync(outputParameters, inputParameters, format, sampleRate, bufferFrames, options, callback)
+    }
+
+    this.#checkWorkerOptions(options, callback)
+
+    const frames = await super.openStreamAsync(
+      outputParameters,
+      inputParameters,
+      format,
+      sampleRate,
+      bufferFrames,
+      { ...options, mode: module.exports.RtAudioStreamMode.WORKER },
+      null
+    )
+
+    this.#startWorker(frames, outputParameters, inputParameters, format, options, callback)
+
+    return frames
+  }
+
+  closeStream() {
+    const worker = this.#worker
+
+    this.#worker = null
+    super.closeStream()
+
+    if (worker) {
+      worker.terminate()
+    }
+  }
+
+  async closeStreamAsync() {
+    const worker = this.#worker
+
+    this.#worker = null
+    await super.closeStreamAsync()
+
+    if (worker) {
+      worker.terminate()
+    }
+  }
+
+  /** Returns the `process.hrtime.bigint()` time the audio thread processes a stream frame at. */
+  streamFrameToHrtime(frame) {
+    const clock = this.#streamClock()
+
+    return BigInt(clock.time) + BigInt(Math.round((frame - clock.frame) * clock.nanosecondsPerFrame))
+  }
+
+  /** Returns the stream frame processed at a `process.hrtime.bigint()` time. */
+  hrtimeToStreamFrame(time) {
+    const clock = this.#streamClock()
+
+    return clock.frame + Math.round(Number(time - BigInt(clock.time)) / clock.nanosecondsPerFrame)
+  }
+
+  #streamClock() {
+    const clock = this.getStreamClock()
+
+    if (!clock) {
+      throw new Error('The stream clock starts with the first period of an open stream')
+    }
+
+    return clock
+  }
+
+  #checkWorkerOptions(options, callback) {
+    if (typeof options.worker !== 'string') {
+      throw new TypeError('options.worker should be a path to a script.')
+    }
+
+    if (callback !== null && callback !== undefined && typeof callback !== 'function') {
+      throw new TypeError('callback should be a function or null')
+    }
+  }
+
+  #startWorker(frames, outputParameters, inputParameters, format, options, callback) {
+    // The buffers can only be sized once the device has settled on bufferFrames. They
+    // hold `jsFormat` samples, the audio thread converts from and to the stream format.
+    const jsFormat = options.jsFormat || format
+    const sampleSize = formatByteSize[jsFormat] || 2
+    const control = new SharedArrayBuffer(Float64Array.BYTES_PER_ELEMENT * 3)
+    const output = outputParameters ? new SharedArrayBuffer(frames * outputParameters.nChannels * sampleSize) : null
+    const input = inputParameters ? new SharedArrayBuffer(frames * inputParameters.nChannels * sampleSize) : null
+
+    super.setWorkerBuffers(
+      new Float64Array(control),
+      output && new Uint8Array(output),
+      input && new Uint8Array(input)
+    )
+
+    const worker = new Worker(path.join(__dirname, 'worker.js'), {
+      workerData: {
+        script: path.resolve(options.worker),
+        control,
+        output,
+        input,
+        format: jsFormat,
+        outputChannels: outputParameters ? outputParameters.nChannels : 0,
+        inputChannels: inputParameters ? inputParameters.nChannels : 0,
+        typedBuffers: !!options.typedBuffers,
+        nonInterleaved: !!(options.flags & module.exports.RtAudioStreamFlags.RTAUDIO_NONINTERLEAVED),
+      },
+    })
+
+    const notify = (event, detail) => callback && callback(event, detail)
+
+    worker.on('message', (message) => message === 'stop' && notify('stop'))
+    worker.on('error', (err) => notify('error', err))
+    worker.on('exit', (code) => {
+      // Don't leave the device running against a worker that is gone.
+      if (this.#worker === worker) {
+        this.#worker = null
+        if (this.isStreamRunning()) this.abortStream()
+      }
+      notify('exit', code)
+    })
+
+    this.#worker = worker
+  }
 }
 
 module.exports.RtAudio = RtAudio
 
+/** An input stream over several devices, delivered to one callback. */
+class RtAudioAggregate extends NodeRtAudioAggregate {}
+
+module.exports.RtAudioAggregate = RtAudioAggregate
+
 /** Audio API specifier arguments */
 module.exports.RtAudioApi = {
-  /** Search for a working compiled API. */
+  /**
+   * Search for a working compiled API. On Linux PulseAudio is tried first, then JACK and
+   * ALSA.
+   */
   UNSPECIFIED: 0,
 
+  /**
+   * The Advanced Linux Sound Architecture API. Devices other than `default` are opened
+   * directly, without the buffering of a sound server.
+   */
+  LINUX_ALSA: 2,
+
+  /**
+   * The JACK Low-Latency Audio Server API. libjack is loaded when it is first used, so
+   * without it this API just has no devices.
+   */
+  UNIX_JACK: 3,
+
   /** The Linux PulseAudio API. */
   LINUX_PULSE: 4,
 
@@ -29,6 +196,12 @@ module.exports.RtAudioApi = {
 
   /** The Microsoft DirectSound API. */
   WINDOWS_DS: 8,
+
+  /**
+   * RtAudio's dummy API. Builds with the `RTAUDIO_JS_LOOPBACK` CMake option back it with
+   * a headless loopback device that captures its own output.
+   */
+  RTAUDIO_DUMMY: 9,
 }
 
 /** 
@@ -110,6 +283,28 @@ module.exports.RtAudioStreamFlags = {
   RTAUDIO_JACK_DONT_CONNECT: 0x20,
 }
 
+/** How audio is exchanged between the realtime audio thread and JS. */
+module.exports.RtAudioStreamMode = {
+  /**
+   * The callback is invoked for every period and the audio thread waits for it
+   * to return (default).
+   */
+  CALLBACK: 0,
+
+  /**
+   * The audio thread only moves data through preallocated lock-free ring buffers,
+   * JS pushes output with `write()` and pulls input with `read()` at its own pace.
+   */
+  BUFFERED: 1,
+
+  /**
+   * The callback runs in a worker_threads Worker and exchanges audio with the
+   * audio thread through SharedArrayBuffers. Set automatically when the `worker`
+   * option is given.
+   */
+  WORKER: 2,
+}
+
 /** RtAudio error types */
 module.exports.RtAudioErrorType = {
   /** A non-critical error. */
@@ -157,4 +352,36 @@ module.exports.RtAudioStreamStatus = {
   RTAUDIO_INPUT_OVERFLOW: 1,
   /** The output buffer ran low, likely producing a break in the output sound. */
   RTAUDIO_OUTPUT_UNDERFLOW: 2,
+  /**
+   * The callback missed the deadline of an earlier period (see the `deadline`
+   * option) and the output of that period was concealed.
+   */
+  RTAUDIO_DEADLINE_MISSED: 0x10,
+}
+
+/** Length of the array filled by `getStreamStats(snapshot)`. */
+module.exports.STREAM_STATS_SNAPSHOT_LENGTH = NodeRtAudio.STREAM_STATS_SNAPSHOT_LENGTH
+
+/** What is played instead of the callback's output when it misses its deadline. */
+module.exports.RtAudioConcealment = {
+  /** Play silence. */
+  SILENCE: 0,
+
+  /** Repeat the last output buffer. */
+  REPEAT: 1,
+
+  /** Fade the last output buffer out, then play silence. */
+  FADE_OUT: 2,
+}
+
+/** Filter length of the `clientSampleRate` resampler. */
+module.exports.RtAudioResamplerQuality = {
+  /** 16 taps per phase, about 60 dB of stopband attenuation. */
+  FAST: 0,
+
+  /** 32 taps per phase, about 85 dB of stopband attenuation. */
+  MEDIUM: 1,
+
+  /** 64 taps per phase, about 110 dB of stopband attenuation. */
+  BEST: 2,
 }
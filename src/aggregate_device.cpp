@@ -0,0 +1,154 @@
+#include "aggregate_device.hpp"
+#include <algorithm>
+
+namespace {
+
+// Fill level smoothing per master period, the level saw-tooths by up to a device period
+// depending on where the two callbacks fall.
+const double FillSmoothing = 0.01;
+
+// Proportional and integral gains, as the fraction of the fill error (in frames)
+// corrected per master period. Critically damped, settling in a few hundred periods.
+const double ProportionalGain = 0.002;
+const double IntegralGain = ProportionalGain * ProportionalGain / 4;
+
+// Largest correction, as a deviation of the ratio from 1. Real clocks are within a
+// few hundred ppm of each other.
+const double MaxDrift = 0.001;
+
+} // namespace
+
+AggregateDevice::AggregateDevice()
+    : nChannels(0), target(0), driftCorrection(true), locked(false), fill(0),
+      integral(0), ratio(1), smoothedFill(0), underrunCount(0), overrunCount(0),
+      status(0) {}
+
+void AggregateDevice::configure(unsigned int nChannels, unsigned int deviceFrames,
+                                unsigned int masterFrames, bool driftCorrection) {
+  // Enough for the device to deliver a period right before the master consumes one,
+  // at any phase between the two callbacks.
+  size_t maxInputFrames = (size_t)(masterFrames * (1 + MaxDrift)) + 2;
+
+  this->nChannels = nChannels;
+  this->target = deviceFrames + masterFrames;
+  this->driftCorrection = driftCorrection;
+  this->ring.allocate((size_t)this->target * 4 * nChannels * sizeof(float));
+  this->resampler.configure(nChannels, maxInputFrames);
+  this->scratch.assign(maxInputFrames * nChannels, 0);
+  this->resampled.assign((size_t)masterFrames * nChannels, 0);
+
+  reset();
+}
+
+void AggregateDevice::reset() {
+  this->ring.reset();
+  this->resampler.reset();
+  this->locked = false;
+  this->fill = 0;
+  this->integral = 0;
+  this->ratio.store(1);
+  this->smoothedFill.store(0);
+  this->underrunCount.store(0);
+  this->overrunCount.store(0);
+  this->status.store(0);
+}
+
+void AggregateDevice::push(const float *input, unsigned int nFrames,
+                           RtAudioStreamStatus status) {
+  size_t byteCount = (size_t)nFrames * this->nChannels * sizeof(float);
+
+  if (status != 0) {
+    this->status.fetch_or(status, std::memory_order_relaxed);
+  }
+
+  // A period that doesn't fit is dropped as a whole, a partial one would splice the
+  // stream.
+  if (input != nullptr && this->ring.writeAvailable() >= byteCount) {
+    this->ring.write(input, byteCount);
+  } else {
+    this->overrunCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+RtAudioStreamStatus AggregateDevice::align(float *frame, unsigned int frameChannels,
+                                           unsigned int channelOffset,
+                                           unsigned int nFrames) {
+  size_t frameSize = this->nChannels * sizeof(float);
+  size_t available = this->ring.readAvailable() / frameSize;
+  const float *samples = nullptr;
+
+  if (!this->locked && available >= this->target) {
+    // Start out at the target, the stream start order may have left extra frames.
+    this->ring.skip((available - this->target) * frameSize);
+    this->resampler.reset();
+    this->locked = true;
+    this->fill = this->target;
+    this->integral = 0;
+    available = this->target;
+  }
+
+  if (this->locked) {
+    this->fill += FillSmoothing * (available - this->fill);
+    double ratio = 1;
+
+    if (this->driftCorrection) {
+      // Correct the fill error by a fraction per period, spread over the period.
+      double error = this->fill - this->target;
+      double limit = MaxDrift * nFrames / IntegralGain;
+      this->integral = std::clamp(this->integral + error, -limit, limit);
+      ratio += std::clamp(
+          (ProportionalGain * error + IntegralGain * this->integral) / nFrames, -MaxDrift,
+          MaxDrift);
+    }
+
+    size_t inputFrames = this->resampler.inputFramesFor(nFrames, ratio);
+
+    if (inputFrames <= available &&
+        inputFrames * this->nChannels <= this->scratch.size() &&
+        nFrames * this->nChannels <= this->resampled.size()) {
+      this->ring.read(this->scratch.data(), inputFrames * frameSize);
+      this->resampler.process(this->scratch.data(), this->resampled.data(), nFrames,
+                              ratio);
+      samples = this->resampled.data();
+    } else {
+      // Ran dry, wait for the ring to fill up to the target again.
+      this->underrunCount.fetch_add(1, std::memory_order_relaxed);
+      this->locked = false;
+    }
+
+    this->ratio.store(ratio, std::memory_order_relaxed);
+    this->smoothedFill.store(this->fill, std::memory_order_relaxed);
+  }
+
+  for (unsigned int i = 0; i < nFrames; i++) {
+    float *out = frame + (size_t)i * frameChannels + channelOffset;
+
+    for (unsigned int channel = 0; channel < this->nChannels; channel++) {
+      out[channel] = samples != nullptr ? samples[i * this->nChannels + channel] : 0.0f;
+    }
+  }
+
+  return this->status.exchange(0, std::memory_order_relaxed);
+}
+
+double AggregateDevice::driftPpm() const {
+  return (this->ratio.load(std::memory_order_relaxed) - 1) * 1e6;
+}
+
+double AggregateDevice::bufferedFrames() const {
+  return this->smoothedFill.load(std::memory_order_relaxed);
+}
+
+unsigned int AggregateDevice::targetFrames() const { return this->target; }
+
+uint64_t AggregateDevice::underruns() const {
+  return this->underrunCount.load(std::memory_order_relaxed);
+}
+
+uint64_t AggregateDevice::overruns() const {
+  return this->overrunCount.load(std::memory_order_relaxed);
+}
+
+double AggregateDevice::latency() const {
+  return this->target + this->resampler.latency();
+}
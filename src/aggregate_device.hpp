@@ -0,0 +1,70 @@
+#ifndef __NODE_ADDON_AGGREGATE_DEVICE_H__
+#define __NODE_ADDON_AGGREGATE_DEVICE_H__
+
+#include "resampler.hpp"
+#include "ring_buffer.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// One secondary device of an aggregate stream, see `NodeRtAudioAggregate`.
+//
+// The device's own realtime thread `push`es its input into a lock-free ring, so it never
+// waits for the other devices. The clock master's thread `align`s it on every master
+// period: it reads the ring through a `VariableResampler` whose ratio follows the drift
+// between the two clocks, estimated from how far the ring's fill level strays from its
+// target.
+class AggregateDevice {
+public:
+  AggregateDevice();
+
+  // Allocates for a device delivering `deviceFrames` per period to a master running
+  // `masterFrames` per period. Must not be called while the stream runs.
+  void configure(unsigned int nChannels, unsigned int deviceFrames,
+                 unsigned int masterFrames, bool driftCorrection);
+  void reset();
+
+  // Device thread.
+  void push(const float *input, unsigned int nFrames, RtAudioStreamStatus status);
+
+  // Master thread. Writes `nFrames` frames of this device's channels into the
+  // interleaved `frame` of `frameChannels` channels, starting at `channelOffset`, and
+  // returns the status flags the device reported since the last call.
+  RtAudioStreamStatus align(float *frame, unsigned int frameChannels,
+                            unsigned int channelOffset, unsigned int nFrames);
+
+  // Any thread, see `getDriftStats`.
+  double driftPpm() const;
+  double bufferedFrames() const;
+  unsigned int targetFrames() const;
+  uint64_t underruns() const;
+  uint64_t overruns() const;
+
+  // Delay between this device's input and the aggregate frame, in frames.
+  double latency() const;
+
+private:
+  unsigned int nChannels;
+  unsigned int target;
+  bool driftCorrection;
+
+  RingBuffer ring;
+  VariableResampler resampler;
+  std::vector<float> scratch;
+  std::vector<float> resampled;
+
+  // Master thread only. The device is locked once its ring first reaches the target,
+  // and unlocked again when it runs dry.
+  bool locked;
+  double fill;
+  double integral;
+
+  std::atomic<double> ratio;
+  std::atomic<double> smoothedFill;
+  std::atomic<uint64_t> underrunCount;
+  std::atomic<uint64_t> overrunCount;
+  std::atomic<RtAudioStreamStatus> status;
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "analyzer.hpp"
+#include "sample_format.hpp"
+#include "sample_kernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const double Pi = 3.14159265358979323846;
+
+// Bytes drained from the ring at a time.
+const size_t MaxReadBytes = 64 * 1024;
+
+} // namespace
+
+Analyzer::Analyzer()
+    : frameSize{0}, unitSize{0}, accumulatedFrames{0}, historyIndex{0},
+      resultsPending{false}, active{false}, pushing{false}, dropped{0}, stopping{false} {}
+
+Analyzer::~Analyzer() { stop(); }
+
+void Analyzer::restart(unsigned int periodFrames) {
+  AnalysisSettings settings = this->settings;
+  Listener listener = this->listener;
+
+  stop();
+  settings.periodFrames = periodFrames;
+  start(settings, listener);
+}
+
+void Analyzer::start(const AnalysisSettings &settings, Listener listener) {
+  unsigned int channels = settings.channels;
+  unsigned int fftSize = settings.fftSize;
+
+  this->settings = settings;
+  this->listener = listener;
+  this->frameSize = channels * sampleByteSize(settings.format);
+  this->unitSize =
+      settings.interleaved ? this->frameSize : this->frameSize * settings.periodFrames;
+
+  // Room for a few reports worth of frames, in whole periods.
+  unsigned int reportFrames = (unsigned int)(settings.sampleRate / settings.rate);
+  unsigned int ringFrames = std::max(settings.periodFrames * 8, reportFrames * 4);
+  ringFrames = (ringFrames + settings.periodFrames - 1) / settings.periodFrames *
+               settings.periodFrames;
+  size_t batch = std::max(this->unitSize, MaxReadBytes / this->unitSize * this->unitSize);
+
+  this->ring.allocate((size_t)ringFrames * this->frameSize);
+  this->readBuffer.assign(batch, 0);
+  this->floatBuffer.assign(batch / sampleByteSize(settings.format), 0);
+  this->channelBuffer.assign(batch / this->frameSize * 2, 0);
+
+  this->peaks.assign(channels, 0);
+  this->powers.assign(channels, 0);
+  this->accumulatedFrames = 0;
+  this->history.assign(fftSize, 0);
+  this->historyIndex = 0;
+  this->window.resize(fftSize);
+  this->cosTable.resize(fftSize / 2);
+  this->sinTable.resize(fftSize / 2);
+  this->bitReversal.resize(fftSize);
+  this->real.assign(fftSize, 0);
+  this->imag.assign(fftSize, 0);
+
+  for (unsigned int i = 0; i < fftSize; i++) {
+    unsigned int reversed = 0;
+
+    for (unsigned int bit = 1; bit < fftSize; bit <<= 1) {
+      reversed = (reversed << 1) | ((i & bit) ? 1 : 0);
+    }
+
+    this->window[i] = (float)(0.5 - 0.5 * std::cos(2 * Pi * i / fftSize));
+    this->bitReversal[i] = reversed;
+
+    if (i < fftSize / 2) {
+      this->cosTable[i] = (float)std::cos(2 * Pi * i / fftSize);
+      this->sinTable[i] = (float)std::sin(2 * Pi * i / fftSize);
+    }
+  }
+
+  this->results.assign(resultLength(), 0);
+  this->resultsPending = false;
+  this->dropped = 0;
+  this->stopping = false;
+
+  this->thread = std::thread(&Analyzer::run, this);
+  this->active = true;
+}
+
+void Analyzer::stop() {
+  if (!this->thread.joinable()) {
+    return;
+  }
+
+  this->active = false;
+
+  while (this->pushing) {
+    std::this_thread::yield();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+
+  this->stopRequested.notify_one();
+  this->thread.join();
+}
+
+bool Analyzer::isRunning() const { return this->active; }
+
+size_t Analyzer::resultLength() const {
+  return (size_t)this->settings.channels * 2 + this->settings.fftSize / 2;
+}
+
+void Analyzer::copyResults(float *to) {
+  std::lock_guard<std::mutex> lock(this->resultsMutex);
+
+  memcpy(to, this->results.data(), this->results.size() * sizeof(float));
+  this->resultsPending = false;
+}
+
+uint64_t Analyzer::droppedFrames() const { return this->dropped; }
+
+void Analyzer::push(const void *input, const void *output, unsigned int nFrames) {
+  this->pushing = true;
+
+  // The settings are only stable while the analyzer is active.
+  if (this->active) {
+    const void *samples = this->settings.output ? output : input;
+    size_t byteCount = nFrames * this->frameSize;
+
+    if (samples != nullptr) {
+      if (this->ring.writeAvailable() >= byteCount) {
+        this->ring.write(samples, byteCount);
+      } else {
+        this->dropped.fetch_add(nFrames, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  this->pushing = false;
+}
+
+void Analyzer::run() {
+  using clock = std::chrono::steady_clock;
+
+  auto interval = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(1 / this->settings.rate));
+  auto nextReport = clock::now() + interval;
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  for (;;) {
+    bool finishing = this->stopRequested.wait_until(lock, nextReport,
+                                                    [this] { return this->stopping; });
+
+    lock.unlock();
+    drain();
+
+    if (!finishing) {
+      report();
+
+      // Skip reports that are already late instead of catching up.
+      nextReport = std::max(nextReport + interval, clock::now());
+    }
+
+    lock.lock();
+
+    if (finishing) {
+      break;
+    }
+  }
+}
+
+void Analyzer::drain() {
+  unsigned int channels = this->settings.channels;
+
+  while (this->ring.readAvailable() >= this->unitSize) {
+    size_t units =
+        std::min(this->readBuffer.size(), this->ring.readAvailable()) / this->unitSize;
+    size_t byteCount = units * this->unitSize;
+
+    this->ring.read(this->readBuffer.data(), byteCount);
+    samplesToFloat(this->readBuffer.data(), this->settings.format,
+                   this->floatBuffer.data(), byteCount / this->frameSize * channels);
+
+    if (this->settings.interleaved) {
+      accumulate(this->floatBuffer.data(), byteCount / this->frameSize, channels, 1);
+      continue;
+    }
+
+    // Non-interleaved buffers hold one period per unit.
+    size_t periodSamples = (size_t)this->settings.periodFrames * channels;
+
+    for (size_t offset = 0; offset < byteCount / this->frameSize * channels;
+         offset += periodSamples) {
+      accumulate(this->floatBuffer.data() + offset, this->settings.periodFrames, 1,
+                 this->settings.periodFrames);
+    }
+  }
+}
+
+void Analyzer::accumulate(const float *samples, size_t nFrames, size_t stride,
+                          size_t channelOffset) {
+  const SampleKernels &kernels = sampleKernels();
+  unsigned int channels = this->settings.channels;
+  size_t fftSize = this->settings.fftSize;
+  float *channel = this->channelBuffer.data();
+  float *average = channel + nFrames;
+
+  for (unsigned int c = 0; c < channels; c++) {
+    const float *from = samples + c * channelOffset;
+
+    for (size_t i = 0; i < nFrames; i++) {
+      channel[i] = from[i * stride];
+    }
+
+    this->peaks[c] = std::max(this->peaks[c], kernels.peak(channel, nFrames));
+    this->powers[c] += kernels.dotProduct(channel, channel, nFrames);
+
+    if (fftSize == 0) {
+      continue;
+    }
+
+    if (c == 0) {
+      memset(average, 0, nFrames * sizeof(float));
+    }
+
+    kernels.mixRamp(channel, average, nFrames, 1.0f / channels, 0);
+  }
+
+  this->accumulatedFrames += nFrames;
+
+  for (size_t i = 0; i < nFrames && fftSize > 0; i++) {
+    this->history[this->historyIndex] = average[i];
+    this->historyIndex = (this->historyIndex + 1) % fftSize;
+  }
+}
+
+void Analyzer::report() {
+  unsigned int channels = this->settings.channels;
+  unsigned int fftSize = this->settings.fftSize;
+
+  if (this->accumulatedFrames == 0)
+    return;
+
+  if (fftSize > 0) {
+    // Radix-2 FFT of the windowed history, oldest frame first.
+    for (unsigned int i = 0; i < fftSize; i++) {
+      size_t index = (this->historyIndex + i) % fftSize;
+
+      this->real[this->bitReversal[i]] = this->history[index] * this->window[i];
+      this->imag[this->bitReversal[i]] = 0;
+    }
+
+    for (unsigned int size = 2; size <= fftSize; size <<= 1) {
+      unsigned int half = size / 2;
+      unsigned int step = fftSize / size;
+
+      for (unsigned int start = 0; start < fftSize; start += size) {
+        for (unsigned int k = 0; k < half; k++) {
+          float wr = this->cosTable[k * step];
+          float wi = -this->sinTable[k * step];
+          unsigned int a = start + k;
+          unsigned int b = a + half;
+          float tr = wr * this->real[b] - wi * this->imag[b];
+          float ti = wr * this->imag[b] + wi * this->real[b];
+
+          this->real[b] = this->real[a] - tr;
+          this->imag[b] = this->imag[a] - ti;
+          this->real[a] += tr;
+          this->imag[a] += ti;
+        }
+      }
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->resultsMutex);
+
+    for (unsigned int c = 0; c < channels; c++) {
+      this->results[c] = this->peaks[c];
+      this->results[channels + c] =
+          (float)std::sqrt(this->powers[c] / this->accumulatedFrames);
+    }
+
+    // The Hann window sums to fftSize / 2.
+    float scale = 4.0f / fftSize;
+    float *spectrum = this->results.data() + channels * 2;
+
+    for (unsigned int k = 0; k < fftSize / 2; k++) {
+      spectrum[k] = std::sqrt(this->real[k] * this->real[k] +
+                              this->imag[k] * this->imag[k]) *
+                    scale;
+    }
+  }
+
+  std::fill(this->peaks.begin(), this->peaks.end(), 0.0f);
+  std::fill(this->powers.begin(), this->powers.end(), 0.0);
+  this->accumulatedFrames = 0;
+
+  if (this->listener && !this->resultsPending.exchange(true)) {
+    this->listener();
+  }
+}
@@ -0,0 +1,109 @@
+#ifndef __NODE_ADDON_ANALYZER_H__
+#define __NODE_ADDON_ANALYZER_H__
+
+#include "ring_buffer.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AnalysisSettings {
+  RtAudioFormat format = RTAUDIO_SINT16;
+  unsigned int channels = 0;
+  // Frames per period, non-interleaved buffers are read back a period at a time.
+  unsigned int periodFrames = 0;
+  bool interleaved = true;
+  unsigned int sampleRate = 0;
+  // Analyze the stream output instead of the input.
+  bool output = false;
+  // Reports per second.
+  double rate = 30;
+  // 0 = no spectrum, otherwise a power of two.
+  unsigned int fftSize = 0;
+};
+
+// Meters the stream input or output off the realtime thread.
+//
+// The realtime thread only copies each period into a preallocated ring, like
+// `FileRecorder` does. An analysis thread drains it, keeps the per-channel peak and
+// power since the last report with the vectorized kernels, and `rate` times a second
+// publishes the peak and RMS level of every channel followed, with `fftSize` set, by
+// the magnitude spectrum of the latest `fftSize` frames of the channel average (Hann
+// window, scaled so that a full scale sine peaks at 1).
+//
+// The listener is called on the analysis thread when new results are ready. It isn't
+// called again until `copyResults` has picked them up, so a slow reader gets the
+// latest results instead of a backlog.
+class Analyzer {
+public:
+  using Listener = std::function<void()>;
+
+  static const unsigned int MinFftSize = 64;
+  static const unsigned int MaxFftSize = 16384;
+
+  Analyzer();
+  ~Analyzer();
+
+  // JS thread
+  void start(const AnalysisSettings &settings, Listener listener);
+  // Starts over with periods of `periodFrames`, keeping the other settings and the
+  // listener. Levels since the last report are lost.
+  void restart(unsigned int periodFrames);
+  void stop();
+  bool isRunning() const;
+  size_t resultLength() const;
+  void copyResults(float *to);
+  uint64_t droppedFrames() const;
+
+  // Realtime thread
+  void push(const void *input, const void *output, unsigned int nFrames);
+
+private:
+  void run();
+  void drain();
+  void accumulate(const float *samples, size_t nFrames, size_t stride,
+                  size_t channelOffset);
+  void report();
+
+  AnalysisSettings settings;
+  Listener listener;
+  RingBuffer ring;
+  size_t frameSize;
+  size_t unitSize;
+  std::vector<uint8_t> readBuffer;
+  std::vector<float> floatBuffer;
+  std::vector<float> channelBuffer;
+
+  // Analysis thread: levels since the last report, and the latest `fftSize` frames of
+  // the channel average.
+  std::vector<float> peaks;
+  std::vector<double> powers;
+  uint64_t accumulatedFrames;
+  std::vector<float> history;
+  size_t historyIndex;
+  std::vector<float> window;
+  std::vector<float> cosTable;
+  std::vector<float> sinTable;
+  std::vector<unsigned int> bitReversal;
+  std::vector<float> real;
+  std::vector<float> imag;
+
+  // Published results, guarded by `resultsMutex`.
+  std::vector<float> results;
+  std::mutex resultsMutex;
+  std::atomic<bool> resultsPending;
+
+  std::atomic<bool> active;
+  std::atomic<bool> pushing;
+  std::atomic<uint64_t> dropped;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable stopRequested;
+  bool stopping;
+};
+
+#endif
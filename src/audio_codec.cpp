@@ -0,0 +1,661 @@
+#include "audio_codec.hpp"
+#include "shared_library.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+// The parts of the libopus and libFLAC C APIs the codecs use, declared here so that
+// neither library is needed to build.
+
+struct OpusEncoderHandle;
+struct OpusDecoderHandle;
+
+const int OpusSetBitrateRequest = 4002;
+// Largest packet of the 120 ms the Opus API allows per packet.
+const size_t OpusMaxPacketBytes = 4000;
+
+struct OpusApi {
+  SharedLibrary library;
+  OpusEncoderHandle *(*encoderCreate)(int32_t, int, int, int *);
+  int32_t (*encodeFloat)(OpusEncoderHandle *, const float *, int, unsigned char *,
+                         int32_t);
+  int (*encoderCtl)(OpusEncoderHandle *, int, ...);
+  void (*encoderDestroy)(OpusEncoderHandle *);
+  OpusDecoderHandle *(*decoderCreate)(int32_t, int, int *);
+  int (*decodeFloat)(OpusDecoderHandle *, const unsigned char *, int32_t, float *, int,
+                     int);
+  void (*decoderDestroy)(OpusDecoderHandle *);
+  const char *(*strerror)(int);
+};
+
+struct FlacEncoderHandle;
+struct FlacDecoderHandle;
+
+// The start of FLAC__Frame, its header.
+struct FlacFrameHeader {
+  uint32_t blocksize;
+  uint32_t sampleRate;
+  uint32_t channels;
+  int channelAssignment;
+  uint32_t bitsPerSample;
+};
+
+using FlacEncoderWrite = int (*)(const FlacEncoderHandle *, const uint8_t *, size_t,
+                                 uint32_t, uint32_t, void *);
+using FlacDecoderRead = int (*)(const FlacDecoderHandle *, uint8_t *, size_t *, void *);
+using FlacDecoderWrite = int (*)(const FlacDecoderHandle *, const FlacFrameHeader *,
+                                 const int32_t *const *, void *);
+using FlacDecoderError = void (*)(const FlacDecoderHandle *, int, void *);
+
+// FLAC__STREAM_ENCODER_WRITE_STATUS_OK, FLAC__STREAM_DECODER_READ_STATUS_CONTINUE and
+// _END_OF_STREAM, FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE and _ABORT.
+const int FlacWriteOk = 0;
+const int FlacReadContinue = 0;
+const int FlacReadEnd = 1;
+const int FlacDecodeContinue = 0;
+const int FlacDecodeAbort = 1;
+
+struct FlacApi {
+  SharedLibrary library;
+  FlacEncoderHandle *(*encoderNew)();
+  int (*encoderSetChannels)(FlacEncoderHandle *, uint32_t);
+  int (*encoderSetBitsPerSample)(FlacEncoderHandle *, uint32_t);
+  int (*encoderSetSampleRate)(FlacEncoderHandle *, uint32_t);
+  int (*encoderSetCompressionLevel)(FlacEncoderHandle *, uint32_t);
+  int (*encoderInitStream)(FlacEncoderHandle *, FlacEncoderWrite, void *, void *, void *,
+                           void *);
+  int (*encoderProcessInterleaved)(FlacEncoderHandle *, const int32_t *, uint32_t);
+  int (*encoderFinish)(FlacEncoderHandle *);
+  void (*encoderDelete)(FlacEncoderHandle *);
+  FlacDecoderHandle *(*decoderNew)();
+  int (*decoderInitStream)(FlacDecoderHandle *, FlacDecoderRead, void *, void *, void *,
+                           void *, FlacDecoderWrite, void *, FlacDecoderError, void *);
+  int (*decoderProcessUntilEndOfStream)(FlacDecoderHandle *);
+  int (*decoderFinish)(FlacDecoderHandle *);
+  void (*decoderDelete)(FlacDecoderHandle *);
+};
+
+#if defined(_WIN32)
+const std::vector<std::string> OpusLibraries = {"opus.dll", "libopus-0.dll"};
+const std::vector<std::string> FlacLibraries = {"FLAC.dll", "libFLAC.dll",
+                                                "libFLAC-12.dll", "libFLAC-8.dll"};
+#elif defined(__APPLE__)
+const std::vector<std::string> OpusLibraries = {"libopus.0.dylib",
+                                                "/opt/homebrew/lib/libopus.0.dylib",
+                                                "/usr/local/lib/libopus.0.dylib"};
+const std::vector<std::string> FlacLibraries = {
+    "libFLAC.12.dylib", "libFLAC.8.dylib", "/opt/homebrew/lib/libFLAC.12.dylib",
+    "/usr/local/lib/libFLAC.12.dylib", "/usr/local/lib/libFLAC.8.dylib"};
+#else
+const std::vector<std::string> OpusLibraries = {"libopus.so.0"};
+const std::vector<std::string> FlacLibraries = {"libFLAC.so.12", "libFLAC.so.8"};
+#endif
+
+template <typename Function>
+bool bindSymbol(const SharedLibrary &library, const char *name, Function *function,
+                std::string *error) {
+  *function = reinterpret_cast<Function>(library.symbol(name));
+
+  if (*function == nullptr) {
+    *error = std::string("The codec library has no ") + name;
+    return false;
+  }
+
+  return true;
+}
+
+// Loaded libraries are kept for the lifetime of the process, the first one that loads
+// wins.
+const OpusApi *loadOpus(const std::string &path, std::string *error) {
+  static std::mutex mutex;
+  static OpusApi *loaded = nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (loaded != nullptr) {
+    return loaded;
+  }
+
+  auto api = std::make_unique<OpusApi>();
+
+  if (!api->library.open(path.empty() ? OpusLibraries : std::vector<std::string>{path},
+                         error)) {
+    *error += ", Opus needs libopus";
+    return nullptr;
+  }
+
+  if (!bindSymbol(api->library, "opus_encoder_create", &api->encoderCreate, error) ||
+      !bindSymbol(api->library, "opus_encode_float", &api->encodeFloat, error) ||
+      !bindSymbol(api->library, "opus_encoder_ctl", &api->encoderCtl, error) ||
+      !bindSymbol(api->library, "opus_encoder_destroy", &api->encoderDestroy, error) ||
+      !bindSymbol(api->library, "opus_decoder_create", &api->decoderCreate, error) ||
+      !bindSymbol(api->library, "opus_decode_float", &api->decodeFloat, error) ||
+      !bindSymbol(api->library, "opus_decoder_destroy", &api->decoderDestroy, error) ||
+      !bindSymbol(api->library, "opus_strerror", &api->strerror, error)) {
+    return nullptr;
+  }
+
+  loaded = api.release();
+
+  return loaded;
+}
+
+const FlacApi *loadFlac(const std::string &path, std::string *error) {
+  static std::mutex mutex;
+  static FlacApi *loaded = nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (loaded != nullptr) {
+    return loaded;
+  }
+
+  auto api = std::make_unique<FlacApi>();
+  const SharedLibrary &library = api->library;
+
+  if (!api->library.open(path.empty() ? FlacLibraries : std::vector<std::string>{path},
+                         error)) {
+    *error += ", FLAC needs libFLAC";
+    return nullptr;
+  }
+
+  if (!bindSymbol(library, "FLAC__stream_encoder_new", &api->encoderNew, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_set_channels",
+                  &api->encoderSetChannels, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_set_bits_per_sample",
+                  &api->encoderSetBitsPerSample, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_set_sample_rate",
+                  &api->encoderSetSampleRate, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_set_compression_level",
+                  &api->encoderSetCompressionLevel, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_init_stream",
+                  &api->encoderInitStream, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_process_interleaved",
+                  &api->encoderProcessInterleaved, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_finish", &api->encoderFinish, error) ||
+      !bindSymbol(library, "FLAC__stream_encoder_delete", &api->encoderDelete, error) ||
+      !bindSymbol(library, "FLAC__stream_decoder_new", &api->decoderNew, error) ||
+      !bindSymbol(library, "FLAC__stream_decoder_init_stream",
+                  &api->decoderInitStream, error) ||
+      !bindSymbol(library, "FLAC__stream_decoder_process_until_end_of_stream",
+                  &api->decoderProcessUntilEndOfStream, error) ||
+      !bindSymbol(library, "FLAC__stream_decoder_finish", &api->decoderFinish, error) ||
+      !bindSymbol(library, "FLAC__stream_decoder_delete", &api->decoderDelete, error)) {
+    return nullptr;
+  }
+
+  loaded = api.release();
+
+  return loaded;
+}
+
+bool isOpusRate(unsigned int sampleRate) {
+  return sampleRate == 8000 || sampleRate == 12000 || sampleRate == 16000 ||
+         sampleRate == 24000 || sampleRate == 48000;
+}
+
+class OpusAudioEncoder : public AudioEncoder {
+public:
+  OpusAudioEncoder(const OpusApi *api, OpusEncoderHandle *encoder,
+                   const CodecSettings &settings)
+      : api{api}, encoder{encoder}, channels{settings.channels},
+        packetFrames{settings.packetFrames}, pendingFrames{0},
+        pending((size_t)settings.packetFrames * settings.channels, 0),
+        packet(OpusMaxPacketBytes, 0) {}
+
+  ~OpusAudioEncoder() { this->api->encoderDestroy(this->encoder); }
+
+  bool encode(const float *frames, unsigned int nFrames, const Writer &write,
+              std::string *error) override {
+    unsigned int done = 0;
+
+    while (done < nFrames) {
+      unsigned int count =
+          std::min(nFrames - done, this->packetFrames - this->pendingFrames);
+
+      memcpy(this->pending.data() + (size_t)this->pendingFrames * this->channels,
+             frames + (size_t)done * this->channels,
+             (size_t)count * this->channels * sizeof(float));
+      this->pendingFrames += count;
+      done += count;
+
+      if (this->pendingFrames == this->packetFrames && !encodePacket(write, error)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool finish(const Writer &write, std::string *error) override {
+    if (this->pendingFrames == 0) {
+      return true;
+    }
+
+    std::fill(this->pending.begin() + (size_t)this->pendingFrames * this->channels,
+              this->pending.end(), 0.0f);
+
+    return encodePacket(write, error);
+  }
+
+private:
+  bool encodePacket(const Writer &write, std::string *error) {
+    int32_t size = this->api->encodeFloat(this->encoder, this->pending.data(),
+                                          (int)this->packetFrames, this->packet.data(),
+                                          (int32_t)this->packet.size());
+
+    this->pendingFrames = 0;
+
+    if (size < 0) {
+      *error = std::string("Opus encoding failed: ") + this->api->strerror(size);
+      return false;
+    }
+
+    write(this->packet.data(), (size_t)size, this->packetFrames);
+
+    return true;
+  }
+
+  const OpusApi *api;
+  OpusEncoderHandle *encoder;
+  unsigned int channels;
+  unsigned int packetFrames;
+  unsigned int pendingFrames;
+  std::vector<float> pending;
+  std::vector<uint8_t> packet;
+};
+
+class OpusAudioDecoder : public AudioDecoder {
+public:
+  OpusAudioDecoder(const OpusApi *api, OpusDecoderHandle *decoder,
+                   const CodecSettings &settings)
+      : api{api}, decoder{decoder}, settings{settings} {}
+
+  ~OpusAudioDecoder() { this->api->decoderDestroy(this->decoder); }
+
+  bool run(const Reader &read, const Writer &write, std::string *error) override {
+    // Up to 120 ms per packet.
+    int maxFrames = (int)(this->settings.sampleRate * 120 / 1000);
+    int lastFrames = (int)this->settings.packetFrames;
+    std::vector<float> frames((size_t)maxFrames * this->settings.channels, 0);
+    std::vector<uint8_t> packet;
+
+    while (read(&packet)) {
+      // Concealment has to be asked for the length of the lost packet.
+      int count = this->api->decodeFloat(
+          this->decoder, packet.empty() ? nullptr : packet.data(), (int32_t)packet.size(),
+          frames.data(), packet.empty() ? lastFrames : maxFrames, 0);
+
+      if (count < 0) {
+        *error = std::string("Opus decoding failed: ") + this->api->strerror(count);
+        return false;
+      }
+
+      lastFrames = count;
+
+      if (!write(frames.data(), (unsigned int)count)) {
+        break;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  const OpusApi *api;
+  OpusDecoderHandle *decoder;
+  CodecSettings settings;
+};
+
+class FlacAudioEncoder : public AudioEncoder {
+public:
+  FlacAudioEncoder(const FlacApi *api, FlacEncoderHandle *encoder,
+                   const CodecSettings &settings)
+      : api{api}, encoder{encoder}, settings{settings}, writer{nullptr},
+        initialized{false} {}
+
+  ~FlacAudioEncoder() {
+    // Whatever is left isn't delivered anymore.
+    this->writer = nullptr;
+
+    if (this->initialized) {
+      this->api->encoderFinish(this->encoder);
+    }
+
+    this->api->encoderDelete(this->encoder);
+  }
+
+  bool encode(const float *frames, unsigned int nFrames, const Writer &write,
+              std::string *error) override {
+    this->writer = &write;
+
+    // The stream header is written while initializing.
+    if (!this->initialized) {
+      if (this->api->encoderInitStream(this->encoder, &FlacAudioEncoder::onWrite, nullptr,
+                                       nullptr, nullptr, this) != 0) {
+        *error = "Couldn't initialize the FLAC encoder";
+        return false;
+      }
+
+      this->initialized = true;
+    }
+
+    size_t sampleCount = (size_t)nFrames * this->settings.channels;
+    float scale = (float)((1 << (this->settings.bitsPerSample - 1)) - 1);
+
+    this->samples.resize(sampleCount);
+
+    for (size_t i = 0; i < sampleCount; i++) {
+      this->samples[i] = (int32_t)std::lrint(std::clamp(frames[i], -1.0f, 1.0f) * scale);
+    }
+
+    bool encoded = this->api->encoderProcessInterleaved(this->encoder,
+                                                        this->samples.data(), nFrames);
+
+    this->writer = nullptr;
+
+    if (!encoded) {
+      *error = "FLAC encoding failed";
+    }
+
+    return encoded;
+  }
+
+  bool finish(const Writer &write, std::string *error) override {
+    if (!this->initialized) {
+      return true;
+    }
+
+    this->writer = &write;
+    this->initialized = false;
+
+    bool finished = this->api->encoderFinish(this->encoder);
+
+    // A stream without frames still gets its header.
+    if (finished) {
+      writeHeader();
+    }
+
+    this->writer = nullptr;
+
+    if (!finished) {
+      *error = "FLAC encoding failed";
+    }
+
+    return finished;
+  }
+
+private:
+  static int onWrite(const FlacEncoderHandle *encoder, const uint8_t *buffer,
+                     size_t bytes, uint32_t samples, uint32_t currentFrame,
+                     void *client) {
+    FlacAudioEncoder *that = (FlacAudioEncoder *)client;
+
+    // The marker and the metadata blocks come in separate writes without samples, they
+    // are collected into one header packet.
+    if (samples == 0) {
+      that->header.insert(that->header.end(), buffer, buffer + bytes);
+      return FlacWriteOk;
+    }
+
+    that->writeHeader();
+
+    if (that->writer != nullptr) {
+      (*that->writer)(buffer, bytes, samples);
+    }
+
+    return FlacWriteOk;
+  }
+
+  void writeHeader() {
+    if (this->header.empty()) {
+      return;
+    }
+
+    if (this->writer != nullptr) {
+      (*this->writer)(this->header.data(), this->header.size(), 0);
+    }
+
+    this->header.clear();
+  }
+
+  const FlacApi *api;
+  FlacEncoderHandle *encoder;
+  CodecSettings settings;
+  const Writer *writer;
+  bool initialized;
+  std::vector<int32_t> samples;
+  std::vector<uint8_t> header;
+};
+
+class FlacAudioDecoder : public AudioDecoder {
+public:
+  FlacAudioDecoder(const FlacApi *api, FlacDecoderHandle *decoder,
+                   const CodecSettings &settings)
+      : api{api}, decoder{decoder}, settings{settings}, reader{nullptr}, writer{nullptr},
+        offset{0} {}
+
+  ~FlacAudioDecoder() { this->api->decoderDelete(this->decoder); }
+
+  bool run(const Reader &read, const Writer &write, std::string *error) override {
+    this->reader = &read;
+    this->writer = &write;
+    this->failure.clear();
+
+    if (this->api->decoderInitStream(
+            this->decoder, &FlacAudioDecoder::onRead, nullptr, nullptr, nullptr, nullptr,
+            &FlacAudioDecoder::onWrite, nullptr, &FlacAudioDecoder::onError, this) != 0) {
+      *error = "Couldn't initialize the FLAC decoder";
+      return false;
+    }
+
+    this->api->decoderProcessUntilEndOfStream(this->decoder);
+    this->api->decoderFinish(this->decoder);
+
+    if (!this->failure.empty()) {
+      *error = this->failure;
+      return false;
+    }
+
+    return true;
+  }
+
+private:
+  // libFLAC pulls the stream, packets are handed over as it asks for bytes.
+  static int onRead(const FlacDecoderHandle *decoder, uint8_t *buffer, size_t *bytes,
+                    void *client) {
+    FlacAudioDecoder *that = (FlacAudioDecoder *)client;
+
+    while (that->offset == that->packet.size()) {
+      if (!(*that->reader)(&that->packet)) {
+        *bytes = 0;
+        return FlacReadEnd;
+      }
+
+      that->offset = 0;
+    }
+
+    size_t count = std::min(*bytes, that->packet.size() - that->offset);
+
+    memcpy(buffer, that->packet.data() + that->offset, count);
+    that->offset += count;
+    *bytes = count;
+
+    return FlacReadContinue;
+  }
+
+  static int onWrite(const FlacDecoderHandle *decoder, const FlacFrameHeader *frame,
+                     const int32_t *const *buffer, void *client) {
+    FlacAudioDecoder *that = (FlacAudioDecoder *)client;
+    unsigned int channels = that->settings.channels;
+
+    if (frame->channels != channels || frame->sampleRate != that->settings.sampleRate) {
+      that->failure = "The FLAC stream has " + std::to_string(frame->channels) +
+                      " channels at " + std::to_string(frame->sampleRate) +
+                      " Hz, expected " + std::to_string(channels) + " at " +
+                      std::to_string(that->settings.sampleRate) + " Hz";
+      return FlacDecodeAbort;
+    }
+
+    float scale = 1.0f / (float)(1 << (frame->bitsPerSample - 1));
+
+    that->frames.resize((size_t)frame->blocksize * channels);
+
+    for (uint32_t i = 0; i < frame->blocksize; i++) {
+      for (unsigned int channel = 0; channel < channels; channel++) {
+        that->frames[(size_t)i * channels + channel] = buffer[channel][i] * scale;
+      }
+    }
+
+    return (*that->writer)(that->frames.data(), frame->blocksize) ? FlacDecodeContinue
+                                                                  : FlacDecodeAbort;
+  }
+
+  // libFLAC looks for the next frame by itself after an error, a damaged frame is just
+  // skipped.
+  static void onError(const FlacDecoderHandle *decoder, int status, void *client) {}
+
+  const FlacApi *api;
+  FlacDecoderHandle *decoder;
+  CodecSettings settings;
+  const Reader *reader;
+  const Writer *writer;
+  std::vector<uint8_t> packet;
+  size_t offset;
+  std::vector<float> frames;
+  std::string failure;
+};
+
+bool checkSettings(const CodecSettings &settings, std::string *error) {
+  if (settings.type == CodecType::Opus) {
+    if (!isOpusRate(settings.sampleRate)) {
+      *error = "Opus needs a sample rate of 8000, 12000, 16000, 24000 or 48000 Hz";
+      return false;
+    }
+
+    if (settings.channels < 1 || settings.channels > 2) {
+      *error = "Opus streams have 1 or 2 channels";
+      return false;
+    }
+
+    // 2.5, 5, 10, 20, 40 or 60 ms.
+    unsigned int halfMilliseconds =
+        (unsigned int)((uint64_t)settings.packetFrames * 2000 / settings.sampleRate);
+
+    if ((uint64_t)settings.packetFrames * 2000 % settings.sampleRate != 0 ||
+        (halfMilliseconds != 5 && halfMilliseconds != 10 && halfMilliseconds != 20 &&
+         halfMilliseconds != 40 && halfMilliseconds != 80 && halfMilliseconds != 120)) {
+      *error = "Opus packets last 2.5, 5, 10, 20, 40 or 60 ms";
+      return false;
+    }
+
+    return true;
+  }
+
+  if (settings.channels < 1 || settings.channels > 8) {
+    *error = "FLAC streams have 1 to 8 channels";
+    return false;
+  }
+
+  if (settings.bitsPerSample != 16 && settings.bitsPerSample != 24) {
+    *error = "FLAC samples have 16 or 24 bits";
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace
+
+std::unique_ptr<AudioEncoder> createEncoder(const CodecSettings &settings,
+                                            std::string *error) {
+  if (!checkSettings(settings, error)) {
+    return nullptr;
+  }
+
+  if (settings.type == CodecType::Opus) {
+    const OpusApi *api = loadOpus(settings.library, error);
+
+    if (api == nullptr) {
+      return nullptr;
+    }
+
+    int status = 0;
+    OpusEncoderHandle *encoder =
+        api->encoderCreate((int32_t)settings.sampleRate, (int)settings.channels,
+                           (int)settings.application, &status);
+
+    if (encoder == nullptr) {
+      *error = std::string("Couldn't create the Opus encoder: ") + api->strerror(status);
+      return nullptr;
+    }
+
+    if (settings.bitrate > 0) {
+      api->encoderCtl(encoder, OpusSetBitrateRequest, (int32_t)settings.bitrate);
+    }
+
+    return std::make_unique<OpusAudioEncoder>(api, encoder, settings);
+  }
+
+  const FlacApi *api = loadFlac(settings.library, error);
+
+  if (api == nullptr) {
+    return nullptr;
+  }
+
+  FlacEncoderHandle *encoder = api->encoderNew();
+
+  if (encoder == nullptr) {
+    *error = "Couldn't create the FLAC encoder";
+    return nullptr;
+  }
+
+  api->encoderSetChannels(encoder, settings.channels);
+  api->encoderSetBitsPerSample(encoder, settings.bitsPerSample);
+  api->encoderSetSampleRate(encoder, settings.sampleRate);
+  api->encoderSetCompressionLevel(encoder, std::min(settings.compressionLevel, 8u));
+
+  return std::make_unique<FlacAudioEncoder>(api, encoder, settings);
+}
+
+std::unique_ptr<AudioDecoder> createDecoder(const CodecSettings &settings,
+                                            std::string *error) {
+  if (!checkSettings(settings, error)) {
+    return nullptr;
+  }
+
+  if (settings.type == CodecType::Opus) {
+    const OpusApi *api = loadOpus(settings.library, error);
+
+    if (api == nullptr) {
+      return nullptr;
+    }
+
+    int status = 0;
+    OpusDecoderHandle *decoder =
+        api->decoderCreate((int32_t)settings.sampleRate, (int)settings.channels, &status);
+
+    if (decoder == nullptr) {
+      *error = std::string("Couldn't create the Opus decoder: ") + api->strerror(status);
+      return nullptr;
+    }
+
+    return std::make_unique<OpusAudioDecoder>(api, decoder, settings);
+  }
+
+  const FlacApi *api = loadFlac(settings.library, error);
+
+  if (api == nullptr) {
+    return nullptr;
+  }
+
+  FlacDecoderHandle *decoder = api->decoderNew();
+
+  if (decoder == nullptr) {
+    *error = "Couldn't create the FLAC decoder";
+    return nullptr;
+  }
+
+  return std::make_unique<FlacAudioDecoder>(api, decoder, settings);
+}
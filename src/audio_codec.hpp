@@ -0,0 +1,73 @@
+#ifndef __NODE_ADDON_AUDIO_CODEC_H__
+#define __NODE_ADDON_AUDIO_CODEC_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class CodecType { Opus = 0, Flac = 1 };
+
+enum class OpusApplication { Voip = 2048, Audio = 2049, LowDelay = 2051 };
+
+struct CodecSettings {
+  CodecType type = CodecType::Opus;
+  unsigned int sampleRate = 48000;
+  unsigned int channels = 1;
+  // Path of the codec library, empty for the usual names on this platform.
+  std::string library;
+
+  // Opus: bits/s, 0 = the encoder's default, and frames per packet.
+  unsigned int bitrate = 0;
+  unsigned int packetFrames = 960;
+  OpusApplication application = OpusApplication::Audio;
+
+  // FLAC: 16 or 24 bit samples, compression level 0-8.
+  unsigned int bitsPerSample = 16;
+  unsigned int compressionLevel = 5;
+};
+
+// Encodes interleaved float32 frames into packets.
+//
+// Opus packets hold `packetFrames` frames each, the frames of the last, partial packet
+// are padded with silence by `finish`. FLAC packets are one header packet, with the
+// marker and all metadata blocks, and then one packet per FLAC frame, so their
+// concatenation is a streamable .flac file.
+class AudioEncoder {
+public:
+  // Gets each packet with the number of frames it holds, 0 for the FLAC header.
+  using Writer =
+      std::function<void(const uint8_t *data, size_t size, unsigned int frames)>;
+
+  virtual ~AudioEncoder() = default;
+
+  virtual bool encode(const float *frames, unsigned int nFrames, const Writer &write,
+                      std::string *error) = 0;
+  virtual bool finish(const Writer &write, std::string *error) = 0;
+};
+
+// Decodes packets from `AudioEncoder` back into interleaved float32 frames.
+class AudioDecoder {
+public:
+  // Waits for the next packet, false once there are no more. An empty Opus packet
+  // stands for a lost one, its audio is concealed.
+  using Reader = std::function<bool(std::vector<uint8_t> *packet)>;
+  // False to stop decoding.
+  using Writer = std::function<bool(const float *frames, unsigned int nFrames)>;
+
+  virtual ~AudioDecoder() = default;
+
+  // Decodes until `read` or `write` return false. False if decoding failed.
+  virtual bool run(const Reader &read, const Writer &write, std::string *error) = 0;
+};
+
+// libopus and libFLAC aren't linked, they are loaded on first use. Without them these
+// fail with an error saying which library is missing.
+std::unique_ptr<AudioEncoder> createEncoder(const CodecSettings &settings,
+                                            std::string *error);
+std::unique_ptr<AudioDecoder> createDecoder(const CodecSettings &settings,
+                                            std::string *error);
+
+#endif
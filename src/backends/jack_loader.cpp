@@ -0,0 +1,185 @@
+// The JACK client functions RtAudio calls, forwarded to libjack loaded at runtime.
+//
+// Linux builds compile RtAudio's JACK API in without linking libjack, so the binding
+// still loads on hosts that don't have JACK installed. The library is opened on the
+// first call. Without it `jack_client_open` fails like it does when no server is
+// running, and RtAudio reports no JACK devices.
+//
+// This file is compiled into the rtaudio library rather than the binding, see
+// CMakeLists.txt.
+
+#include <cstdarg>
+#include <dlfcn.h>
+#include <jack/jack.h>
+
+namespace {
+
+void *library() {
+  static void *handle = [] {
+    void *handle = dlopen("libjack.so.0", RTLD_NOW | RTLD_LOCAL);
+    return handle != nullptr ? handle : dlopen("libjack.so", RTLD_NOW | RTLD_LOCAL);
+  }();
+
+  return handle;
+}
+
+template <typename Function> Function *resolve(const char *name) {
+  void *handle = library();
+  return handle != nullptr ? reinterpret_cast<Function *>(dlsym(handle, name)) : nullptr;
+}
+
+} // namespace
+
+// Looks the function up once and calls it, or returns `fallback` without libjack.
+#define JACK_FORWARD(name, fallback, ...)                                              \
+  static auto *function = resolve<decltype(name)>(#name);                              \
+  return function != nullptr ? function(__VA_ARGS__) : fallback
+
+#define JACK_FORWARD_VOID(name, ...)                                                   \
+  static auto *function = resolve<decltype(name)>(#name);                              \
+  if (function != nullptr)                                                             \
+  function(__VA_ARGS__)
+
+extern "C" {
+
+jack_client_t *jack_client_open(const char *client_name, jack_options_t options,
+                                jack_status_t *status, ...) {
+  static auto *function = resolve<decltype(jack_client_open)>("jack_client_open");
+
+  if (function == nullptr) {
+    if (status != nullptr) {
+      *status = static_cast<jack_status_t>(JackFailure | JackServerFailed);
+    }
+
+    return nullptr;
+  }
+
+  // The only variadic argument is the server name.
+  if (options & JackServerName) {
+    va_list args;
+    va_start(args, status);
+    const char *server_name = va_arg(args, const char *);
+    va_end(args);
+
+    return function(client_name, options, status, server_name);
+  }
+
+  return function(client_name, options, status);
+}
+
+int jack_client_close(jack_client_t *client) {
+  JACK_FORWARD(jack_client_close, -1, client);
+}
+
+int jack_client_name_size(void) { JACK_FORWARD(jack_client_name_size, 0); }
+
+char *jack_get_client_name(jack_client_t *client) {
+  JACK_FORWARD(jack_get_client_name, nullptr, client);
+}
+
+int jack_activate(jack_client_t *client) { JACK_FORWARD(jack_activate, -1, client); }
+
+int jack_deactivate(jack_client_t *client) { JACK_FORWARD(jack_deactivate, -1, client); }
+
+jack_nframes_t jack_get_sample_rate(jack_client_t *client) {
+  JACK_FORWARD(jack_get_sample_rate, 0, client);
+}
+
+jack_nframes_t jack_get_buffer_size(jack_client_t *client) {
+  JACK_FORWARD(jack_get_buffer_size, 0, client);
+}
+
+int jack_set_process_callback(jack_client_t *client, JackProcessCallback process_callback,
+                              void *arg) {
+  JACK_FORWARD(jack_set_process_callback, -1, client, process_callback, arg);
+}
+
+int jack_set_xrun_callback(jack_client_t *client, JackXRunCallback xrun_callback,
+                           void *arg) {
+  JACK_FORWARD(jack_set_xrun_callback, -1, client, xrun_callback, arg);
+}
+
+void jack_on_shutdown(jack_client_t *client, JackShutdownCallback shutdown_callback,
+                      void *arg) {
+  JACK_FORWARD_VOID(jack_on_shutdown, client, shutdown_callback, arg);
+}
+
+void jack_set_error_function(void (*func)(const char *)) {
+  JACK_FORWARD_VOID(jack_set_error_function, func);
+}
+
+void jack_set_info_function(void (*func)(const char *)) {
+  JACK_FORWARD_VOID(jack_set_info_function, func);
+}
+
+jack_port_t *jack_port_register(jack_client_t *client, const char *port_name,
+                                const char *port_type, unsigned long flags,
+                                unsigned long buffer_size) {
+  JACK_FORWARD(jack_port_register, nullptr, client, port_name, port_type, flags,
+               buffer_size);
+}
+
+int jack_port_unregister(jack_client_t *client, jack_port_t *port) {
+  JACK_FORWARD(jack_port_unregister, -1, client, port);
+}
+
+void *jack_port_get_buffer(jack_port_t *port, jack_nframes_t nframes) {
+  JACK_FORWARD(jack_port_get_buffer, nullptr, port, nframes);
+}
+
+const char *jack_port_name(const jack_port_t *port) {
+  JACK_FORWARD(jack_port_name, nullptr, port);
+}
+
+const char *jack_port_short_name(const jack_port_t *port) {
+  JACK_FORWARD(jack_port_short_name, nullptr, port);
+}
+
+int jack_port_flags(const jack_port_t *port) { JACK_FORWARD(jack_port_flags, 0, port); }
+
+int jack_port_name_size(void) { JACK_FORWARD(jack_port_name_size, 0); }
+
+int jack_port_connected(const jack_port_t *port) {
+  JACK_FORWARD(jack_port_connected, 0, port);
+}
+
+const char **jack_port_get_connections(const jack_port_t *port) {
+  JACK_FORWARD(jack_port_get_connections, nullptr, port);
+}
+
+int jack_port_rename(jack_client_t *client, jack_port_t *port, const char *port_name) {
+  JACK_FORWARD(jack_port_rename, -1, client, port, port_name);
+}
+
+void jack_port_get_latency_range(jack_port_t *port, jack_latency_callback_mode_t mode,
+                                 jack_latency_range_t *range) {
+  if (range != nullptr) {
+    range->min = range->max = 0;
+  }
+
+  JACK_FORWARD_VOID(jack_port_get_latency_range, port, mode, range);
+}
+
+jack_port_t *jack_port_by_name(jack_client_t *client, const char *port_name) {
+  JACK_FORWARD(jack_port_by_name, nullptr, client, port_name);
+}
+
+const char **jack_get_ports(jack_client_t *client, const char *port_name_pattern,
+                            const char *type_name_pattern, unsigned long flags) {
+  JACK_FORWARD(jack_get_ports, nullptr, client, port_name_pattern, type_name_pattern,
+               flags);
+}
+
+int jack_connect(jack_client_t *client, const char *source_port,
+                 const char *destination_port) {
+  JACK_FORWARD(jack_connect, -1, client, source_port, destination_port);
+}
+
+int jack_disconnect(jack_client_t *client, const char *source_port,
+                    const char *destination_port) {
+  JACK_FORWARD(jack_disconnect, -1, client, source_port, destination_port);
+}
+
+void jack_free(void *ptr) { JACK_FORWARD_VOID(jack_free, ptr); }
+
+} // extern "C"
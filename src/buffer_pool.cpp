@@ -0,0 +1,48 @@
+#include "buffer_pool.hpp"
+
+BufferPool::BufferPool() : size{0}, index{0} {}
+
+void BufferPool::allocate(Napi::Env env, size_t slotCount, size_t slotSize,
+                          const ViewFactory &createView) {
+  release();
+
+  for (size_t i = 0; i < slotCount; i++) {
+    uint8_t *data = new uint8_t[slotSize]();
+    Napi::ArrayBuffer buffer;
+
+    try {
+      buffer = Napi::ArrayBuffer::New(env, data, slotSize, [](Napi::Env env, void *data) {
+        delete[] (uint8_t *)data;
+      });
+    } catch (const Napi::Error &) {
+      // Runtimes with the V8 memory cage (e.g. Electron >= 21) don't allow external
+      // buffers. A V8 owned buffer that is allocated once is just as good for pooling.
+      delete[] data;
+      buffer = Napi::ArrayBuffer::New(env, slotSize);
+    }
+
+    slots.push_back({(uint8_t *)buffer.Data(),
+                     Napi::Reference<Napi::ArrayBuffer>::New(buffer, 1),
+                     Napi::Reference<Napi::Object>::New(createView(buffer), 1)});
+  }
+
+  size = slotSize;
+}
+
+void BufferPool::release() {
+  slots.clear();
+  size = 0;
+  index = 0;
+}
+
+bool BufferPool::empty() const { return slots.empty(); }
+
+size_t BufferPool::slotSize() const { return size; }
+
+const BufferPool::Slot &BufferPool::next() {
+  const Slot &slot = slots[index];
+
+  index = (index + 1) % slots.size();
+
+  return slot;
+}
@@ -0,0 +1,46 @@
+#ifndef __NODE_ADDON_BUFFER_POOL_H__
+#define __NODE_ADDON_BUFFER_POOL_H__
+
+#include <functional>
+#include <napi.h>
+#include <vector>
+
+// A fixed set of buffers over natively allocated (external) memory that are handed to
+// JS round-robin, so no ArrayBuffer has to be allocated per audio period.
+//
+// Every slot carries the JS value that is passed to the callback, built once by the
+// `ViewFactory` when the pool is allocated (e.g. a Uint8Array, a typed array matching
+// the stream format, or an array of per-channel views). Periods shorter than a slot can
+// still use its memory through views built over `buffer` per call.
+//
+// All methods must be called on the JS thread. The native memory of a slot is owned by
+// its ArrayBuffer and freed by the finalizer, so JS may safely keep a slot around after
+// the pool is released; it will just not be reused anymore.
+class BufferPool {
+public:
+  using ViewFactory = std::function<Napi::Object(Napi::ArrayBuffer buffer)>;
+
+  struct Slot {
+    uint8_t *data;
+    Napi::Reference<Napi::ArrayBuffer> buffer;
+    Napi::Reference<Napi::Object> view;
+  };
+
+  BufferPool();
+
+  void allocate(Napi::Env env, size_t slotCount, size_t slotSize,
+                const ViewFactory &createView);
+  void release();
+
+  bool empty() const;
+  size_t slotSize() const;
+
+  const Slot &next();
+
+private:
+  std::vector<Slot> slots;
+  size_t size;
+  size_t index;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "channel_map.hpp"
+#include "sample_kernels.hpp"
+#include <cstring>
+
+ChannelMap::ChannelMap() : sourceChannels{0}, sampleSize{0}, interleaved{true} {}
+
+void ChannelMap::configure(const std::vector<int> &sources, unsigned int sourceChannels,
+                           size_t sampleSize, bool interleaved) {
+  this->sources = sources;
+  this->sourceChannels = sourceChannels;
+  this->sampleSize = sampleSize;
+  this->interleaved = interleaved;
+  this->pattern.clear();
+
+  if (!interleaved || sampleSize != 4) {
+    return;
+  }
+
+  for (unsigned int frame = 0; frame < 8; frame++) {
+    for (int source : sources) {
+      this->pattern.push_back(source < 0 ? -1
+                                         : (int32_t)(frame * sourceChannels + source));
+    }
+  }
+}
+
+void ChannelMap::clear() {
+  this->sources.clear();
+  this->pattern.clear();
+}
+
+bool ChannelMap::isActive() const { return !this->sources.empty(); }
+
+unsigned int ChannelMap::channels() const { return (unsigned int)this->sources.size(); }
+
+void ChannelMap::apply(const void *from, void *to, unsigned int nFrames) const {
+  const uint8_t *source = (const uint8_t *)from;
+  uint8_t *target = (uint8_t *)to;
+  size_t channels = this->sources.size();
+  size_t sampleSize = this->sampleSize;
+
+  if (!this->interleaved) {
+    size_t planeSize = nFrames * sampleSize;
+
+    for (size_t i = 0; i < channels; i++) {
+      if (this->sources[i] < 0) {
+        memset(target + i * planeSize, 0, planeSize);
+      } else {
+        memcpy(target + i * planeSize, source + this->sources[i] * planeSize, planeSize);
+      }
+    }
+
+    return;
+  }
+
+  if (!this->pattern.empty()) {
+    sampleKernels().gather32((const uint32_t *)from, (uint32_t *)to, nFrames * channels,
+                             this->pattern.data(), this->pattern.size(),
+                             (size_t)this->sourceChannels * 8);
+    return;
+  }
+
+  size_t frameSize = this->sourceChannels * sampleSize;
+
+  for (unsigned int frame = 0; frame < nFrames; frame++) {
+    for (size_t i = 0; i < channels; i++, target += sampleSize) {
+      if (this->sources[i] < 0) {
+        memset(target, 0, sampleSize);
+      } else {
+        memcpy(target, source + this->sources[i] * sampleSize, sampleSize);
+      }
+    }
+
+    source += frameSize;
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef __NODE_ADDON_CHANNEL_MAP_H__
+#define __NODE_ADDON_CHANNEL_MAP_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Picks, reorders and duplicates channels while copying frames between the device
+// buffers and the buffers JS sees, see `inputChannelMap` and `outputChannelMap`.
+//
+// Channel `i` of the result is channel `sources[i]` of the source buffer, or silence
+// for -1. Interleaved 32-bit samples go through the `gather32` kernel with a pattern
+// that covers 8 frames, other sample sizes through a plain loop, and non-interleaved
+// buffers are copied plane by plane.
+class ChannelMap {
+public:
+  ChannelMap();
+
+  // JS thread, while the stream is closed.
+  void configure(const std::vector<int> &sources, unsigned int sourceChannels,
+                 size_t sampleSize, bool interleaved);
+  void clear();
+  bool isActive() const;
+  unsigned int channels() const;
+
+  // Copies `nFrames` frames, non-interleaved planes are `nFrames` long.
+  void apply(const void *from, void *to, unsigned int nFrames) const;
+
+private:
+  std::vector<int> sources;
+  unsigned int sourceChannels;
+  size_t sampleSize;
+  bool interleaved;
+  // Sample indices of 8 frames for `gather32`.
+  std::vector<int32_t> pattern;
+};
+
+#endif
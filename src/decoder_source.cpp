@@ -0,0 +1,265 @@
+#include "decoder_source.hpp"
+#include "sample_format.hpp"
+#include <algorithm>
+#include <chrono>
+
+DecoderSource::DecoderSource()
+    : frameSize{0}, pollInterval{1}, active{false}, rendering{false}, finished{false},
+      playing{false}, packetCount{0}, framesDecoded{0}, underruns{0}, ended{false},
+      stopping{false} {}
+
+DecoderSource::~DecoderSource() { stop(); }
+
+bool DecoderSource::start(const DecoderSourceSettings &settings, Listener listener,
+                          std::string *error) {
+  stop();
+
+  this->decoder = createDecoder(settings.codec, error);
+
+  if (!this->decoder) {
+    return false;
+  }
+
+  this->settings = settings;
+  this->listener = listener;
+  this->frameSize = sizeof(float) * settings.codec.channels;
+  // About twice a period.
+  this->pollInterval = std::chrono::milliseconds(std::clamp<unsigned int>(
+      settings.maxFrames * 500 / std::max(1u, settings.codec.sampleRate), 1, 20));
+  this->ring.allocate((size_t)settings.ringFrames * this->frameSize);
+  this->decodeBuffer.assign((size_t)settings.maxFrames * settings.codec.channels, 0);
+  this->mixBuffer.assign((size_t)settings.maxFrames * settings.channels, 0);
+  this->finished = false;
+  this->playing = false;
+  this->packetCount = 0;
+  this->framesDecoded = 0;
+  this->underruns = 0;
+  this->error.clear();
+  this->packets.clear();
+  this->ended = false;
+  this->stopping = false;
+
+  this->thread = std::thread(&DecoderSource::run, this);
+  this->active = true;
+
+  return true;
+}
+
+DecoderStats DecoderSource::stop() {
+  if (!this->thread.joinable()) {
+    return stats();
+  }
+
+  // Wait for the realtime thread to leave `render` before the ring goes away.
+  this->active = false;
+
+  while (this->rendering) {
+    std::this_thread::yield();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+
+  this->changed.notify_one();
+  this->thread.join();
+  this->decoder = nullptr;
+
+  return stats();
+}
+
+bool DecoderSource::isDecoding() const { return this->active; }
+
+size_t DecoderSource::queue(std::vector<uint8_t> packet) {
+  size_t queued;
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->packets.push_back(std::move(packet));
+    queued = this->packets.size();
+  }
+
+  this->changed.notify_one();
+
+  return queued;
+}
+
+void DecoderSource::end() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->ended = true;
+  }
+
+  this->changed.notify_one();
+}
+
+bool DecoderSource::resize(unsigned int maxFrames) {
+  if (this->settings.ringFrames < maxFrames * 2) {
+    return false;
+  }
+
+  // The decoder thread only uses the ring, the poll interval stays as it was.
+  this->settings.maxFrames = maxFrames;
+  this->decodeBuffer.assign((size_t)maxFrames * this->settings.codec.channels, 0);
+  this->mixBuffer.assign((size_t)maxFrames * this->settings.channels, 0);
+
+  return true;
+}
+
+void DecoderSource::run() {
+  std::string error;
+  bool decoded = this->decoder->run(
+      [this](std::vector<uint8_t> *packet) { return readPacket(packet); },
+      [this](const float *frames, unsigned int nFrames) {
+        return writeFrames(frames, nFrames);
+      },
+      &error);
+
+  if (!decoded) {
+    this->error = error;
+    this->finished = true;
+
+    if (this->listener) {
+      this->listener(error);
+    }
+
+    return;
+  }
+
+  this->finished = true;
+  waitForDrain();
+}
+
+void DecoderSource::waitForDrain() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  while (!this->changed.wait_for(lock, this->pollInterval,
+                                 [this] { return this->stopping; })) {
+    if (this->ring.readAvailable() == 0) {
+      lock.unlock();
+
+      if (this->listener) {
+        this->listener(std::string());
+      }
+
+      return;
+    }
+  }
+}
+
+bool DecoderSource::readPacket(std::vector<uint8_t> *packet) {
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  this->changed.wait(lock, [this] {
+    return this->stopping || this->ended || !this->packets.empty();
+  });
+
+  if (this->stopping || this->packets.empty()) {
+    return false;
+  }
+
+  *packet = std::move(this->packets.front());
+  this->packets.pop_front();
+  this->packetCount.fetch_add(1, std::memory_order_relaxed);
+
+  return true;
+}
+
+bool DecoderSource::writeFrames(const float *frames, unsigned int nFrames) {
+  const uint8_t *from = (const uint8_t *)frames;
+  size_t byteCount = nFrames * this->frameSize;
+
+  while (byteCount > 0) {
+    size_t room = this->ring.writeAvailable() / this->frameSize * this->frameSize;
+
+    if (room == 0) {
+      std::unique_lock<std::mutex> lock(this->mutex);
+
+      if (this->changed.wait_for(lock, this->pollInterval,
+                                 [this] { return this->stopping; })) {
+        return false;
+      }
+
+      continue;
+    }
+
+    size_t count = this->ring.write(from, std::min(room, byteCount));
+
+    from += count;
+    byteCount -= count;
+  }
+
+  this->framesDecoded.fetch_add(nFrames, std::memory_order_relaxed);
+
+  return true;
+}
+
+void DecoderSource::render(void *output, unsigned int nFrames) {
+  this->rendering = true;
+
+  if (this->active && nFrames <= this->settings.maxFrames) {
+    renderFrames(output, nFrames);
+  }
+
+  this->rendering = false;
+}
+
+void DecoderSource::renderFrames(void *output, unsigned int nFrames) {
+  unsigned int channels = this->settings.channels;
+  unsigned int codecChannels = this->settings.codec.channels;
+  size_t available = this->ring.readAvailable() / this->frameSize;
+  bool done = this->finished;
+
+  // Wait for the prebuffer, unless nothing more is coming.
+  if (!this->playing && !done &&
+      available < std::max(1u, this->settings.prebufferFrames)) {
+    return;
+  }
+
+  unsigned int count = (unsigned int)std::min<size_t>(nFrames, available);
+
+  // Running dry means waiting for the prebuffer again.
+  this->playing = count == nFrames;
+
+  if (count < nFrames && !done) {
+    this->underruns.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  // Only the decoded frames go through float, the rest of the output stays untouched.
+  float *mixed = this->mixBuffer.data();
+  size_t sampleCount = (size_t)(this->settings.interleaved ? count : nFrames) * channels;
+
+  this->ring.read(this->decodeBuffer.data(), count * this->frameSize);
+  std::fill(mixed, mixed + sampleCount, 0.0f);
+
+  for (unsigned int i = 0; i < count; i++) {
+    for (unsigned int channel = 0; channel < channels; channel++) {
+      unsigned int codecChannel = codecChannels == 1 ? 0 : channel;
+
+      if (codecChannel >= codecChannels)
+        break;
+
+      size_t index = this->settings.interleaved ? i * channels + channel
+                                                : channel * nFrames + i;
+      mixed[index] = this->decodeBuffer[i * codecChannels + codecChannel];
+    }
+  }
+
+  mixFloatIntoSamples(mixed, output, this->settings.format, sampleCount);
+}
+
+DecoderStats DecoderSource::stats() {
+  DecoderStats stats;
+
+  stats.packets = this->packetCount.load();
+  stats.framesDecoded = this->framesDecoded.load();
+  stats.underruns = this->underruns.load();
+  stats.error = this->error;
+
+  return stats;
+}
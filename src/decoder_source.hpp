@@ -0,0 +1,112 @@
+#ifndef __NODE_ADDON_DECODER_SOURCE_H__
+#define __NODE_ADDON_DECODER_SOURCE_H__
+
+#include "audio_codec.hpp"
+#include "ring_buffer.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct DecoderSourceSettings {
+  CodecSettings codec;
+
+  // Stream side.
+  RtAudioFormat format = RTAUDIO_SINT16;
+  unsigned int channels = 0;
+  bool interleaved = true;
+  unsigned int maxFrames = 0;
+  // Decoded frames buffered ahead of the output, and how many of them there have to be
+  // before playing starts, or starts again after running dry.
+  unsigned int ringFrames = 0;
+  unsigned int prebufferFrames = 0;
+};
+
+struct DecoderStats {
+  uint64_t packets = 0;
+  uint64_t framesDecoded = 0;
+  uint64_t underruns = 0;
+  // Set once decoding failed.
+  std::string error;
+};
+
+// Plays Opus or FLAC packets queued from JS into the stream output.
+//
+// A decoder thread takes the queued packets, decodes them and keeps a ring of decoded
+// float32 frames filled. `render` runs on the realtime thread and mixes the ring into
+// whatever is already in the output buffer in the stream format, so the output is only
+// requantized where decoded audio is added: a mono stream plays on every channel, other
+// streams channel by channel. Periods the ring can't fill after playing started are
+// counted as underruns. The sample rate isn't converted.
+//
+// The listener is called on the decoder thread, once all queued audio has played after
+// `end`, or with the error once decoding failed.
+class DecoderSource {
+public:
+  using Listener = std::function<void(const std::string &error)>;
+
+  DecoderSource();
+  ~DecoderSource();
+
+  // JS thread
+  bool start(const DecoderSourceSettings &settings, Listener listener,
+             std::string *error);
+  DecoderStats stop();
+  bool isDecoding() const;
+  // An empty packet stands for a lost one. Returns the packets waiting to be decoded.
+  size_t queue(std::vector<uint8_t> packet);
+  // No more packets follow.
+  void end();
+  // Only while the stream is stopped. False if the ring can't hold two periods of
+  // `maxFrames`, decoding has to be started over then.
+  bool resize(unsigned int maxFrames);
+
+  // Realtime thread
+  void render(void *output, unsigned int nFrames);
+
+private:
+  void run();
+  bool readPacket(std::vector<uint8_t> *packet);
+  bool writeFrames(const float *frames, unsigned int nFrames);
+  void waitForDrain();
+  void renderFrames(void *output, unsigned int nFrames);
+  DecoderStats stats();
+
+  DecoderSourceSettings settings;
+  Listener listener;
+  std::unique_ptr<AudioDecoder> decoder;
+  RingBuffer ring;
+  size_t frameSize;
+  // How often the decoder thread checks on the ring, which the realtime thread drains
+  // without signalling.
+  std::chrono::milliseconds pollInterval;
+  std::vector<float> decodeBuffer;
+  std::vector<float> mixBuffer;
+
+  std::atomic<bool> active;
+  std::atomic<bool> rendering;
+  // Set by the decoder thread once it is done, the realtime thread stops waiting for the
+  // prebuffer after that.
+  std::atomic<bool> finished;
+  bool playing;
+  std::atomic<uint64_t> packetCount;
+  std::atomic<uint64_t> framesDecoded;
+  std::atomic<uint64_t> underruns;
+  std::string error;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::vector<uint8_t>> packets;
+  bool ended;
+  bool stopping;
+};
+
+#endif
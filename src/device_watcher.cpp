@@ -0,0 +1,96 @@
+#include "device_watcher.hpp"
+#include <chrono>
+
+DeviceWatcher::DeviceWatcher()
+    : intervalMs{1000}, stopping{false}, wakeRequested{false} {}
+
+DeviceWatcher::~DeviceWatcher() { stop(); }
+
+void DeviceWatcher::start(unsigned int intervalMs,
+                          const std::vector<RtAudio::DeviceInfo> &devices, Probe probe,
+                          Listener listener) {
+  stop();
+
+  this->intervalMs = intervalMs;
+  this->devices = devices;
+  this->probe = probe;
+  this->listener = listener;
+  this->stopping = false;
+  this->wakeRequested = false;
+  this->thread = std::thread(&DeviceWatcher::run, this);
+}
+
+void DeviceWatcher::stop() {
+  if (!this->thread.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+
+  this->stateChanged.notify_one();
+  this->thread.join();
+  this->probe = nullptr;
+  this->listener = nullptr;
+}
+
+bool DeviceWatcher::isWatching() const { return this->thread.joinable(); }
+
+void DeviceWatcher::wake() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->wakeRequested = true;
+  }
+
+  this->stateChanged.notify_one();
+}
+
+bool DeviceWatcher::sameDevices(const std::vector<RtAudio::DeviceInfo> &a,
+                                const std::vector<RtAudio::DeviceInfo> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].ID != b[i].ID || a[i].name != b[i].name ||
+        a[i].outputChannels != b[i].outputChannels ||
+        a[i].inputChannels != b[i].inputChannels ||
+        a[i].duplexChannels != b[i].duplexChannels ||
+        a[i].isDefaultOutput != b[i].isDefaultOutput ||
+        a[i].isDefaultInput != b[i].isDefaultInput ||
+        a[i].sampleRates != b[i].sampleRates ||
+        a[i].preferredSampleRate != b[i].preferredSampleRate ||
+        a[i].nativeFormats != b[i].nativeFormats) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void DeviceWatcher::run() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  for (;;) {
+    this->stateChanged.wait_for(lock, std::chrono::milliseconds(this->intervalMs),
+                                [this] { return this->stopping || this->wakeRequested; });
+
+    if (this->stopping) {
+      break;
+    }
+
+    this->wakeRequested = false;
+    lock.unlock();
+
+    std::vector<RtAudio::DeviceInfo> devices = this->probe();
+
+    if (!sameDevices(devices, this->devices)) {
+      this->devices = devices;
+      this->listener(this->devices);
+    }
+
+    lock.lock();
+  }
+}
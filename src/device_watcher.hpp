@@ -0,0 +1,51 @@
+#ifndef __NODE_ADDON_DEVICE_WATCHER_H__
+#define __NODE_ADDON_DEVICE_WATCHER_H__
+
+#include <RtAudio.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Watches the device list for devices that appear, disappear or change, off the JS
+// thread.
+//
+// RtAudio has no hotplug notifications, so a background thread enumerates the devices
+// every `intervalMs` (or right away after `wake`, e.g. on a device disconnect error) and
+// calls the listener, on that thread, only when the list differs from the last one.
+class DeviceWatcher {
+public:
+  using Probe = std::function<std::vector<RtAudio::DeviceInfo>()>;
+  using Listener = std::function<void(const std::vector<RtAudio::DeviceInfo> &devices)>;
+
+  DeviceWatcher();
+  ~DeviceWatcher();
+
+  // JS thread
+  void start(unsigned int intervalMs, const std::vector<RtAudio::DeviceInfo> &devices,
+             Probe probe, Listener listener);
+  void stop();
+  bool isWatching() const;
+  // Any thread, rescans without waiting for the interval.
+  void wake();
+
+  static bool sameDevices(const std::vector<RtAudio::DeviceInfo> &a,
+                          const std::vector<RtAudio::DeviceInfo> &b);
+
+private:
+  void run();
+
+  unsigned int intervalMs;
+  std::vector<RtAudio::DeviceInfo> devices;
+  Probe probe;
+  Listener listener;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable stateChanged;
+  bool stopping;
+  bool wakeRequested;
+};
+
+#endif
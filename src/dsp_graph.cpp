@@ -0,0 +1,540 @@
+#include "dsp_graph.hpp"
+#include "sample_format.hpp"
+#include "sample_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+const double Pi = 3.14159265358979323846;
+
+std::string nodeError(size_t index, const std::string &message) {
+  return "nodes[" + std::to_string(index) + "]" + message;
+}
+
+} // namespace
+
+DspGraph::DspGraph(const DspStreamLayout &layout) : layout{layout} {}
+
+std::unique_ptr<DspGraph> DspGraph::create(const std::vector<DspNodeSettings> &nodes,
+                                           const DspStreamLayout &layout,
+                                           std::string *error) {
+  if (nodes.empty() || nodes.size() > MaxNodes) {
+    *error = "The graph should have between 1 and " + std::to_string(MaxNodes) + " nodes";
+    return nullptr;
+  }
+
+  std::unique_ptr<DspGraph> graph(new DspGraph(layout));
+
+  graph->nodes.resize(nodes.size());
+
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const DspNodeSettings &settings = nodes[i];
+    Node &node = graph->nodes[i];
+    size_t inputCount = settings.type == DspNodeType::Input ? 0 : 1;
+
+    for (unsigned int input : settings.inputs) {
+      if (input >= i) {
+        *error = nodeError(i, " should only take inputs from earlier nodes");
+        return nullptr;
+      }
+    }
+
+    if (settings.type == DspNodeType::Mix ? settings.inputs.empty()
+                                          : settings.inputs.size() != inputCount) {
+      *error = nodeError(i, settings.type == DspNodeType::Input
+                                ? " should have no inputs"
+                                : settings.type == DspNodeType::Mix
+                                      ? " should have at least one input"
+                                      : " should have exactly one input");
+      return nullptr;
+    }
+
+    node.settings = settings;
+    node.channels = inputCount == 0 ? 0 : graph->nodes[settings.inputs[0]].channels;
+
+    switch (settings.type) {
+    case DspNodeType::Input:
+      if (layout.inputChannels == 0) {
+        *error = nodeError(i, " needs a stream with input");
+        return nullptr;
+      }
+
+      node.channels = layout.inputChannels;
+      break;
+
+    case DspNodeType::Gain:
+      node.settings.gains.resize(1, 1);
+      break;
+
+    case DspNodeType::Mix:
+      if (settings.gains.size() > settings.inputs.size()) {
+        *error = nodeError(i, ".gains should have at most one gain per input");
+        return nullptr;
+      }
+
+      node.settings.gains.resize(settings.inputs.size(), 1);
+
+      for (unsigned int input : settings.inputs) {
+        node.channels = std::max(node.channels, graph->nodes[input].channels);
+      }
+
+      // Mono inputs are mixed into every channel.
+      for (unsigned int input : settings.inputs) {
+        if (graph->nodes[input].channels != 1 &&
+            graph->nodes[input].channels != node.channels) {
+          *error = nodeError(i, " should mix inputs of the same channel count, or mono");
+          return nullptr;
+        }
+      }
+      break;
+
+    case DspNodeType::Biquad:
+      if (!(settings.frequency > 0 && settings.frequency < layout.sampleRate / 2.0) ||
+          !(settings.q > 0)) {
+        *error = nodeError(i, " should have a frequency below the Nyquist frequency and "
+                              "a q greater than 0");
+        return nullptr;
+      }
+
+      node.state.assign((size_t)node.channels * 2, 0);
+      graph->updateBiquad(node);
+      break;
+
+    case DspNodeType::Delay:
+      if (node.settings.maxDelay == 0) {
+        node.settings.maxDelay = std::max(settings.delay, layout.sampleRate);
+      }
+
+      if (settings.delay > node.settings.maxDelay) {
+        *error = nodeError(i, ".delay should not exceed maxDelay");
+        return nullptr;
+      }
+
+      node.lineFrames = node.settings.maxDelay + 1;
+      node.line.assign((size_t)node.channels * node.lineFrames, 0);
+      break;
+
+    case DspNodeType::Route:
+      if (settings.channels.empty()) {
+        *error = nodeError(i, ".channels should not be empty");
+        return nullptr;
+      }
+
+      for (int channel : settings.channels) {
+        if (channel < -1 || channel >= (int)node.channels) {
+          *error = nodeError(i, ".channels should be input channels or -1");
+          return nullptr;
+        }
+      }
+
+      node.channels = (unsigned int)settings.channels.size();
+      break;
+
+    case DspNodeType::Passthrough:
+      break;
+    }
+
+    node.applied = node.settings.gains;
+    node.buffer.assign((size_t)node.channels * layout.maxFrames, 0);
+  }
+
+  size_t deviceChannels = std::max(layout.inputChannels, layout.outputChannels);
+
+  graph->deviceFrames.assign(deviceChannels * layout.maxFrames, 0);
+  graph->messages.allocate(MessageCapacity * sizeof(DspMessage));
+
+  return graph;
+}
+
+std::string DspGraph::check(const DspMessage &message) const {
+  if (message.node >= this->nodes.size())
+    return "node should be the index of a graph node";
+
+  const Node &node = this->nodes[message.node];
+  DspNodeType type = node.settings.type;
+
+  switch (message.parameter) {
+  case DspParameter::Gain:
+    if (type != DspNodeType::Gain && type != DspNodeType::Mix)
+      return "gain is a parameter of gain and mix nodes";
+
+    if (message.index >= node.settings.gains.size())
+      return "index should be the index of a mix node input";
+
+    return "";
+
+  case DspParameter::Frequency:
+  case DspParameter::Q:
+  case DspParameter::FilterGain:
+    if (type != DspNodeType::Biquad)
+      return "frequency, q and filterGain are parameters of biquad nodes";
+
+    if (message.parameter == DspParameter::Frequency &&
+        !(message.value > 0 && message.value < this->layout.sampleRate / 2.0))
+      return "frequency should be between 0 and the Nyquist frequency";
+
+    if (message.parameter == DspParameter::Q && !(message.value > 0))
+      return "q should be greater than 0";
+
+    return "";
+
+  case DspParameter::Delay:
+  case DspParameter::Feedback:
+    if (type != DspNodeType::Delay)
+      return "delay and feedback are parameters of delay nodes";
+
+    if (message.parameter == DspParameter::Delay &&
+        !(message.value >= 0 && message.value <= node.settings.maxDelay))
+      return "delay should be between 0 and maxDelay";
+
+    return "";
+  }
+
+  return "Unknown parameter";
+}
+
+bool DspGraph::post(const DspMessage &message) {
+  if (this->messages.writeAvailable() < sizeof(DspMessage))
+    return false;
+
+  return this->messages.write(&message, sizeof(DspMessage)) == sizeof(DspMessage);
+}
+
+void DspGraph::resize(unsigned int maxFrames) {
+  size_t deviceChannels =
+      std::max(this->layout.inputChannels, this->layout.outputChannels);
+
+  this->layout.maxFrames = maxFrames;
+
+  for (Node &node : this->nodes) {
+    node.buffer.assign((size_t)node.channels * maxFrames, 0);
+  }
+
+  this->deviceFrames.assign(deviceChannels * maxFrames, 0);
+}
+
+void DspGraph::process(void *output, const void *input, unsigned int nFrames) {
+  DspMessage message;
+
+  while (this->messages.read(&message, sizeof(DspMessage)) == sizeof(DspMessage)) {
+    apply(message);
+  }
+
+  if (nFrames > this->layout.maxFrames)
+    return;
+
+  for (Node &node : this->nodes) {
+    if (node.settings.type == DspNodeType::Input) {
+      readInput(node, input, nFrames);
+    } else {
+      processNode(node, nFrames);
+    }
+  }
+
+  if (output != nullptr) {
+    writeOutput(this->nodes.back(), output, nFrames);
+  }
+}
+
+void DspGraph::apply(const DspMessage &message) {
+  Node &node = this->nodes[message.node];
+
+  switch (message.parameter) {
+  case DspParameter::Gain:
+    node.settings.gains[message.index] = message.value;
+    break;
+  case DspParameter::Frequency:
+    node.settings.frequency = message.value;
+    updateBiquad(node);
+    break;
+  case DspParameter::Q:
+    node.settings.q = message.value;
+    updateBiquad(node);
+    break;
+  case DspParameter::FilterGain:
+    node.settings.filterGain = message.value;
+    updateBiquad(node);
+    break;
+  case DspParameter::Delay:
+    node.settings.delay = (unsigned int)std::lround(message.value);
+    break;
+  case DspParameter::Feedback:
+    node.settings.feedback = message.value;
+    break;
+  }
+}
+
+void DspGraph::updateBiquad(Node &node) {
+  // Audio EQ cookbook filters.
+  const DspNodeSettings &settings = node.settings;
+  double w0 = 2 * Pi * settings.frequency / this->layout.sampleRate;
+  double cosw = std::cos(w0);
+  double alpha = std::sin(w0) / (2 * settings.q);
+  double A = std::pow(10.0, settings.filterGain / 40);
+  double shelf = 2 * std::sqrt(A) * alpha;
+  double b0, b1, b2, a0, a1, a2;
+
+  a0 = 1 + alpha;
+  a1 = -2 * cosw;
+  a2 = 1 - alpha;
+
+  switch (settings.filter) {
+  case BiquadFilter::Lowpass:
+    b0 = b2 = (1 - cosw) / 2;
+    b1 = 1 - cosw;
+    break;
+  case BiquadFilter::Highpass:
+    b0 = b2 = (1 + cosw) / 2;
+    b1 = -(1 + cosw);
+    break;
+  case BiquadFilter::Bandpass:
+    b0 = alpha;
+    b1 = 0;
+    b2 = -alpha;
+    break;
+  case BiquadFilter::Notch:
+    b0 = b2 = 1;
+    b1 = -2 * cosw;
+    break;
+  case BiquadFilter::Allpass:
+    b0 = 1 - alpha;
+    b1 = -2 * cosw;
+    b2 = 1 + alpha;
+    break;
+  case BiquadFilter::Peaking:
+    b0 = 1 + alpha * A;
+    b1 = -2 * cosw;
+    b2 = 1 - alpha * A;
+    a0 = 1 + alpha / A;
+    a2 = 1 - alpha / A;
+    break;
+  case BiquadFilter::Lowshelf:
+    b0 = A * ((A + 1) - (A - 1) * cosw + shelf);
+    b1 = 2 * A * ((A - 1) - (A + 1) * cosw);
+    b2 = A * ((A + 1) - (A - 1) * cosw - shelf);
+    a0 = (A + 1) + (A - 1) * cosw + shelf;
+    a1 = -2 * ((A - 1) + (A + 1) * cosw);
+    a2 = (A + 1) + (A - 1) * cosw - shelf;
+    break;
+  case BiquadFilter::Highshelf:
+  default:
+    b0 = A * ((A + 1) + (A - 1) * cosw + shelf);
+    b1 = -2 * A * ((A - 1) + (A + 1) * cosw);
+    b2 = A * ((A + 1) + (A - 1) * cosw - shelf);
+    a0 = (A + 1) - (A - 1) * cosw + shelf;
+    a1 = 2 * ((A - 1) - (A + 1) * cosw);
+    a2 = (A + 1) - (A - 1) * cosw - shelf;
+    break;
+  }
+
+  node.b0 = b0 / a0;
+  node.b1 = b1 / a0;
+  node.b2 = b2 / a0;
+  node.a1 = a1 / a0;
+  node.a2 = a2 / a0;
+}
+
+const float *DspGraph::channel(const Node &node, unsigned int channel) const {
+  return node.buffer.data() + (size_t)channel * this->layout.maxFrames;
+}
+
+float *DspGraph::channel(Node &node, unsigned int channel) {
+  return node.buffer.data() + (size_t)channel * this->layout.maxFrames;
+}
+
+void DspGraph::readInput(Node &node, const void *input, unsigned int nFrames) {
+  unsigned int channels = node.channels;
+  float *frames = this->deviceFrames.data();
+
+  if (input == nullptr) {
+    for (unsigned int c = 0; c < channels; c++) {
+      memset(channel(node, c), 0, nFrames * sizeof(float));
+    }
+
+    return;
+  }
+
+  samplesToFloat(input, this->layout.format, frames, (size_t)nFrames * channels);
+
+  for (unsigned int c = 0; c < channels; c++) {
+    float *to = channel(node, c);
+
+    if (!this->layout.interleaved) {
+      memcpy(to, frames + (size_t)c * nFrames, nFrames * sizeof(float));
+      continue;
+    }
+
+    for (unsigned int i = 0; i < nFrames; i++) {
+      to[i] = frames[(size_t)i * channels + c];
+    }
+  }
+}
+
+void DspGraph::processNode(Node &node, unsigned int nFrames) {
+  const DspNodeSettings &settings = node.settings;
+  const SampleKernels &kernels = sampleKernels();
+  const Node &source = this->nodes[settings.inputs[0]];
+
+  switch (settings.type) {
+  case DspNodeType::Gain:
+  case DspNodeType::Mix:
+    for (unsigned int c = 0; c < node.channels; c++) {
+      memset(channel(node, c), 0, nFrames * sizeof(float));
+    }
+
+    for (size_t input = 0; input < settings.inputs.size(); input++) {
+      const Node &from = this->nodes[settings.inputs[input]];
+      float gain = node.applied[input];
+      float step = (settings.gains[input] - gain) / nFrames;
+
+      for (unsigned int c = 0; c < node.channels; c++) {
+        kernels.mixRamp(channel(from, from.channels == 1 ? 0 : c), channel(node, c),
+                        nFrames, gain, step);
+      }
+
+      node.applied[input] = settings.gains[input];
+    }
+    break;
+
+  case DspNodeType::Biquad:
+    for (unsigned int c = 0; c < node.channels; c++) {
+      const float *in = channel(source, c);
+      float *out = channel(node, c);
+      double z1 = node.state[c * 2];
+      double z2 = node.state[c * 2 + 1];
+
+      // Transposed direct form II.
+      for (unsigned int i = 0; i < nFrames; i++) {
+        double x = in[i];
+        double y = node.b0 * x + z1;
+        z1 = node.b1 * x - node.a1 * y + z2;
+        z2 = node.b2 * x - node.a2 * y;
+        out[i] = (float)y;
+      }
+
+      node.state[c * 2] = z1;
+      node.state[c * 2 + 1] = z2;
+    }
+    break;
+
+  case DspNodeType::Delay: {
+    unsigned int length = node.lineFrames;
+    unsigned int delay = settings.delay;
+
+    for (unsigned int c = 0; c < node.channels; c++) {
+      const float *in = channel(source, c);
+      float *out = channel(node, c);
+      float *line = node.line.data() + (size_t)c * length;
+      unsigned int write = node.writeIndex;
+      unsigned int read = (write + length - delay) % length;
+
+      for (unsigned int i = 0; i < nFrames; i++) {
+        float y = delay == 0 ? in[i] : line[read];
+        line[write] = in[i] + settings.feedback * y;
+        out[i] = y;
+
+        if (++write == length)
+          write = 0;
+        if (++read == length)
+          read = 0;
+      }
+    }
+
+    node.writeIndex = (unsigned int)((node.writeIndex + (uint64_t)nFrames) % length);
+    break;
+  }
+
+  case DspNodeType::Passthrough:
+    for (unsigned int c = 0; c < node.channels; c++) {
+      memcpy(channel(node, c), channel(source, c), nFrames * sizeof(float));
+    }
+    break;
+
+  case DspNodeType::Route:
+    for (unsigned int c = 0; c < node.channels; c++) {
+      if (settings.channels[c] < 0) {
+        memset(channel(node, c), 0, nFrames * sizeof(float));
+      } else {
+        memcpy(channel(node, c), channel(source, settings.channels[c]),
+               nFrames * sizeof(float));
+      }
+    }
+    break;
+
+  case DspNodeType::Input:
+    break;
+  }
+}
+
+void DspGraph::writeOutput(const Node &node, void *output, unsigned int nFrames) {
+  unsigned int channels = this->layout.outputChannels;
+  bool convert = this->layout.format != RTAUDIO_FLOAT32;
+  float *samples = convert ? this->deviceFrames.data() : static_cast<float *>(output);
+  size_t sampleCount = (size_t)nFrames * channels;
+
+  // Other formats than float32 get the node's output laid out like the device's and
+  // added in their own format, so what is already there isn't requantized.
+  if (convert) {
+    std::fill(samples, samples + sampleCount, 0.0f);
+  }
+
+  for (unsigned int c = 0; c < channels; c++) {
+    if (node.channels != 1 && c >= node.channels)
+      break;
+
+    const float *from = channel(node, node.channels == 1 ? 0 : c);
+
+    if (!this->layout.interleaved) {
+      sampleKernels().mixRamp(from, samples + (size_t)c * nFrames, nFrames, 1, 0);
+      continue;
+    }
+
+    for (unsigned int i = 0; i < nFrames; i++) {
+      samples[(size_t)i * channels + c] += from[i];
+    }
+  }
+
+  if (convert) {
+    mixFloatIntoSamples(samples, output, this->layout.format, sampleCount);
+  }
+}
+
+ProcessingGraph::ProcessingGraph() : graph{nullptr}, rendering{false} {}
+
+ProcessingGraph::~ProcessingGraph() { replace(nullptr); }
+
+void ProcessingGraph::replace(std::unique_ptr<DspGraph> next) {
+  DspGraph *previous = this->graph.exchange(next.release());
+
+  // Wait for the realtime thread to leave `render` before the old graph goes away.
+  while (this->rendering) {
+    std::this_thread::yield();
+  }
+
+  delete previous;
+}
+
+DspGraph *ProcessingGraph::get() const { return this->graph; }
+
+void ProcessingGraph::resize(unsigned int maxFrames) {
+  DspGraph *graph = this->graph;
+
+  if (graph != nullptr) {
+    graph->resize(maxFrames);
+  }
+}
+
+void ProcessingGraph::render(void *output, const void *input, unsigned int nFrames) {
+  this->rendering = true;
+
+  DspGraph *graph = this->graph;
+
+  if (graph != nullptr) {
+    graph->process(output, input, nFrames);
+  }
+
+  this->rendering = false;
+}
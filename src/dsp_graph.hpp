@@ -0,0 +1,164 @@
+#ifndef __NODE_ADDON_DSP_GRAPH_H__
+#define __NODE_ADDON_DSP_GRAPH_H__
+
+#include "ring_buffer.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class DspNodeType {
+  // The stream input.
+  Input = 0,
+  Gain = 1,
+  // Sums its inputs, each with its own gain.
+  Mix = 2,
+  Biquad = 3,
+  // A delay line with feedback, outputs the delayed signal only.
+  Delay = 4,
+  Passthrough = 5,
+  // Picks an input channel for every output channel.
+  Route = 6,
+};
+
+enum class BiquadFilter {
+  Lowpass = 0,
+  Highpass = 1,
+  Bandpass = 2,
+  Notch = 3,
+  Peaking = 4,
+  Lowshelf = 5,
+  Highshelf = 6,
+  Allpass = 7,
+};
+
+// Parameters that can change while the graph runs, see `DspGraph::post`.
+enum class DspParameter {
+  Gain = 0,
+  Frequency = 1,
+  Q = 2,
+  FilterGain = 3,
+  Delay = 4,
+  Feedback = 5,
+};
+
+struct DspNodeSettings {
+  DspNodeType type = DspNodeType::Passthrough;
+  // Indices of earlier nodes. Input nodes take none, mix nodes any number and the
+  // others exactly one.
+  std::vector<unsigned int> inputs;
+  // Gain nodes use the first, mix nodes one per input. Missing gains are 1.
+  std::vector<float> gains;
+  BiquadFilter filter = BiquadFilter::Lowpass;
+  float frequency = 1000;
+  float q = 0.70710678f;
+  // Peaking and shelving filters, in dB.
+  float filterGain = 0;
+  // In frames, `maxDelay` = 0 means max(delay, one second).
+  unsigned int delay = 0;
+  unsigned int maxDelay = 0;
+  float feedback = 0;
+  // Route nodes: the input channel of every output channel, -1 for silence.
+  std::vector<int> channels;
+};
+
+struct DspStreamLayout {
+  RtAudioFormat format = RTAUDIO_FLOAT32;
+  unsigned int inputChannels = 0;
+  unsigned int outputChannels = 0;
+  bool interleaved = true;
+  unsigned int maxFrames = 0;
+  unsigned int sampleRate = 0;
+};
+
+struct DspMessage {
+  uint32_t node;
+  DspParameter parameter;
+  // The input of a mix node whose gain changes.
+  uint32_t index;
+  float value;
+};
+
+// A processing graph that runs on the realtime thread.
+//
+// Nodes are evaluated in order, each into its own planar float32 buffer, and may only
+// read from earlier nodes. The last node is added to the stream output, a mono last
+// node on every output channel. Gain changes are ramped over a period, other
+// parameters change at the start of the next period.
+//
+// Parameter changes are queued by JS with `post` and picked up by `process`, so the
+// realtime thread never waits for JS. Everything else is fixed when the graph is
+// created, a different graph replaces this one, see `ProcessingGraph`.
+class DspGraph {
+public:
+  static const unsigned int MaxNodes = 256;
+  static const unsigned int MessageCapacity = 256;
+
+  // JS thread
+  static std::unique_ptr<DspGraph> create(const std::vector<DspNodeSettings> &nodes,
+                                          const DspStreamLayout &layout,
+                                          std::string *error);
+  std::string check(const DspMessage &message) const;
+  bool post(const DspMessage &message);
+  // Only while the realtime thread doesn't run the graph, keeps nodes and parameters.
+  void resize(unsigned int maxFrames);
+
+  // Realtime thread
+  void process(void *output, const void *input, unsigned int nFrames);
+
+private:
+  struct Node {
+    DspNodeSettings settings;
+    unsigned int channels = 0;
+    std::vector<float> buffer;
+    // Gains as of the end of the last period.
+    std::vector<float> applied;
+    // Biquad coefficients normalized by a0, and two state variables per channel.
+    double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    std::vector<double> state;
+    // Delay lines of `maxDelay` + 1 frames per channel.
+    std::vector<float> line;
+    unsigned int lineFrames = 0;
+    unsigned int writeIndex = 0;
+  };
+
+  explicit DspGraph(const DspStreamLayout &layout);
+
+  void apply(const DspMessage &message);
+  void updateBiquad(Node &node);
+  const float *channel(const Node &node, unsigned int channel) const;
+  float *channel(Node &node, unsigned int channel);
+  void readInput(Node &node, const void *input, unsigned int nFrames);
+  void processNode(Node &node, unsigned int nFrames);
+  void writeOutput(const Node &node, void *output, unsigned int nFrames);
+
+  DspStreamLayout layout;
+  std::vector<Node> nodes;
+  std::vector<float> deviceFrames;
+  RingBuffer messages;
+};
+
+// Holds the graph the realtime thread runs. `replace` swaps in a new graph (or none)
+// and frees the old one once the realtime thread has left `render`.
+class ProcessingGraph {
+public:
+  ProcessingGraph();
+  ~ProcessingGraph();
+
+  // JS thread
+  void replace(std::unique_ptr<DspGraph> next);
+  DspGraph *get() const;
+  // Only while the stream is stopped.
+  void resize(unsigned int maxFrames);
+
+  // Realtime thread
+  void render(void *output, const void *input, unsigned int nFrames);
+
+private:
+  std::atomic<DspGraph *> graph;
+  std::atomic<bool> rendering;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "encoder_tap.hpp"
+#include "sample_format.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Upper bound of what the encoder thread takes from the ring at once.
+const size_t MaxReadBytes = 256 * 1024;
+
+} // namespace
+
+EncoderTap::EncoderTap()
+    : frameSize{0}, unitSize{0}, nextFrame{0}, active{false}, pushing{false},
+      packetCount{0}, byteCount{0}, framesEncoded{0}, droppedFrames{0}, stopping{false} {}
+
+EncoderTap::~EncoderTap() { stop(); }
+
+bool EncoderTap::start(const EncoderTapSettings &settings, Listener listener,
+                       std::string *error) {
+  this->encoder = createEncoder(settings.codec, error);
+
+  if (!this->encoder) {
+    return false;
+  }
+
+  this->settings = settings;
+  this->listener = listener;
+  this->frameSize = sampleByteSize(settings.format) * settings.channels;
+  this->unitSize = settings.interleaved ? this->frameSize
+                                        : this->frameSize * settings.periodFrames;
+  this->nextFrame = 0;
+  this->pending.clear();
+  this->packetCount = 0;
+  this->byteCount = 0;
+  this->framesEncoded = 0;
+  this->droppedFrames = 0;
+  this->error.clear();
+  this->stopping = false;
+
+  size_t batch = std::max(this->unitSize, MaxReadBytes / this->unitSize * this->unitSize);
+  size_t batchFrames = batch / this->frameSize;
+
+  this->ring.allocate((size_t)settings.ringFrames * this->frameSize);
+  this->readBuffer.assign(batch, 0);
+  this->floatBuffer.assign(batchFrames * settings.channels, 0);
+  this->codecBuffer.assign(batchFrames * settings.codec.channels, 0);
+
+  this->writer = [this](const uint8_t *data, size_t size, unsigned int frames) {
+    EncodedPacket packet;
+
+    packet.data.assign(data, data + size);
+    packet.frame = this->nextFrame;
+    packet.frames = frames;
+    this->nextFrame += frames;
+    this->pending.push_back(std::move(packet));
+    this->packetCount.fetch_add(1, std::memory_order_relaxed);
+    this->byteCount.fetch_add(size, std::memory_order_relaxed);
+  };
+
+  this->thread = std::thread(&EncoderTap::run, this);
+  this->active = true;
+
+  return true;
+}
+
+EncoderStats EncoderTap::stop() {
+  if (!this->thread.joinable()) {
+    return stats();
+  }
+
+  // Make sure the realtime thread is done with the ring before it is drained for the
+  // last time.
+  this->active = false;
+
+  while (this->pushing) {
+    std::this_thread::yield();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+
+  this->stopRequested.notify_one();
+  this->thread.join();
+  this->encoder = nullptr;
+
+  return stats();
+}
+
+bool EncoderTap::isEncoding() const { return this->active; }
+
+bool EncoderTap::acceptsPeriod(unsigned int nFrames) const {
+  return this->settings.interleaved && this->settings.ringFrames >= nFrames * 2;
+}
+
+void EncoderTap::push(const void *input, unsigned int nFrames) {
+  this->pushing = true;
+
+  if (this->active) {
+    size_t byteCount = nFrames * this->frameSize;
+
+    if (this->ring.writeAvailable() >= byteCount) {
+      this->ring.write(input, byteCount);
+    } else {
+      this->droppedFrames.fetch_add(nFrames, std::memory_order_relaxed);
+    }
+  }
+
+  this->pushing = false;
+}
+
+void EncoderTap::run() {
+  using clock = std::chrono::steady_clock;
+
+  // Poll often enough that the ring never gets more than a quarter full.
+  auto pollInterval = std::chrono::milliseconds(std::clamp<unsigned int>(
+      this->settings.ringFrames * 250 / std::max(1u, this->settings.codec.sampleRate), 1,
+      50));
+  auto batchInterval = std::chrono::milliseconds(this->settings.batchIntervalMs);
+  auto lastBatch = clock::now();
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  for (;;) {
+    this->stopRequested.wait_for(lock, pollInterval, [this] { return this->stopping; });
+
+    bool finishing = this->stopping;
+
+    lock.unlock();
+    drain();
+
+    if (finishing && this->error.empty() &&
+        !this->encoder->finish(this->writer, &this->error)) {
+      deliver();
+    }
+
+    auto now = clock::now();
+
+    if (finishing || now - lastBatch >= batchInterval) {
+      if (!this->pending.empty()) {
+        deliver();
+      }
+
+      lastBatch = now;
+    }
+
+    lock.lock();
+
+    if (finishing) {
+      break;
+    }
+  }
+}
+
+void EncoderTap::drain() {
+  for (;;) {
+    size_t byteCount = std::min(this->ring.readAvailable(), this->readBuffer.size());
+
+    byteCount = byteCount / this->unitSize * this->unitSize;
+
+    if (byteCount == 0) {
+      return;
+    }
+
+    if (!this->error.empty()) {
+      // Encoding failed, keep the ring moving so the realtime side doesn't count drops.
+      this->ring.skip(byteCount);
+      continue;
+    }
+
+    this->ring.read(this->readBuffer.data(), byteCount);
+    encodeChunk(byteCount);
+  }
+}
+
+void EncoderTap::encodeChunk(size_t byteCount) {
+  unsigned int channels = this->settings.channels;
+  unsigned int codecChannels = this->settings.codec.channels;
+  size_t nFrames = byteCount / this->frameSize;
+  const float *from = this->floatBuffer.data();
+  float *to = this->codecBuffer.data();
+
+  samplesToFloat(this->readBuffer.data(), this->settings.format, this->floatBuffer.data(),
+                 nFrames * channels);
+
+  if (this->settings.interleaved) {
+    for (size_t i = 0; i < nFrames; i++) {
+      for (unsigned int channel = 0; channel < codecChannels; channel++) {
+        to[i * codecChannels + channel] = from[i * channels + channel];
+      }
+    }
+  } else {
+    // Each period holds one plane per channel.
+    size_t periodFrames = this->settings.periodFrames;
+
+    for (size_t period = 0; period < nFrames / periodFrames; period++) {
+      const float *planes = from + period * periodFrames * channels;
+      float *frames = to + period * periodFrames * codecChannels;
+
+      for (size_t i = 0; i < periodFrames; i++) {
+        for (unsigned int channel = 0; channel < codecChannels; channel++) {
+          frames[i * codecChannels + channel] = planes[channel * periodFrames + i];
+        }
+      }
+    }
+  }
+
+  if (!this->encoder->encode(to, (unsigned int)nFrames, this->writer, &this->error)) {
+    deliver();
+    return;
+  }
+
+  this->framesEncoded.fetch_add(nFrames, std::memory_order_relaxed);
+}
+
+void EncoderTap::deliver() {
+  std::vector<EncodedPacket> packets;
+
+  packets.swap(this->pending);
+
+  if (this->listener) {
+    this->listener(std::move(packets), this->error);
+  }
+}
+
+EncoderStats EncoderTap::stats() {
+  EncoderStats stats;
+
+  stats.packets = this->packetCount.load();
+  stats.bytes = this->byteCount.load();
+  stats.framesEncoded = this->framesEncoded.load();
+  stats.droppedFrames = this->droppedFrames.load();
+  stats.error = this->error;
+
+  return stats;
+}
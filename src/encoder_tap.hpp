@@ -0,0 +1,111 @@
+#ifndef __NODE_ADDON_ENCODER_TAP_H__
+#define __NODE_ADDON_ENCODER_TAP_H__
+
+#include "audio_codec.hpp"
+#include "ring_buffer.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct EncoderTapSettings {
+  // Encoded channels are the first `codec.channels` channels of the input.
+  CodecSettings codec;
+
+  // Stream side.
+  RtAudioFormat format = RTAUDIO_SINT16;
+  unsigned int channels = 0;
+  // Frames per period, non-interleaved input is read back a period at a time.
+  unsigned int periodFrames = 0;
+  bool interleaved = true;
+  unsigned int ringFrames = 0;
+  // How often packets are handed to the listener.
+  unsigned int batchIntervalMs = 100;
+};
+
+struct EncodedPacket {
+  std::vector<uint8_t> data;
+  // Encoded frame the packet starts at, and the frames it holds.
+  uint64_t frame = 0;
+  unsigned int frames = 0;
+};
+
+struct EncoderStats {
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  uint64_t framesEncoded = 0;
+  uint64_t droppedFrames = 0;
+  // Set once encoding failed, nothing is encoded after that.
+  std::string error;
+};
+
+// Encodes stream input to Opus or FLAC without going through JS.
+//
+// The realtime thread only copies each period into a preallocated ring, like
+// `FileRecorder` does. An encoder thread drains it, converts the channels it encodes to
+// float32 and runs the codec. Packets are collected and handed to the listener, on the
+// encoder thread, every `batchIntervalMs` and once more when stopping, so JS gets a few
+// calls a second however small the packets are.
+class EncoderTap {
+public:
+  // Gets the packets since the last call, or the error once encoding failed.
+  using Listener =
+      std::function<void(std::vector<EncodedPacket> packets, const std::string &error)>;
+
+  EncoderTap();
+  ~EncoderTap();
+
+  // JS thread
+  bool start(const EncoderTapSettings &settings, Listener listener, std::string *error);
+  EncoderStats stop();
+  bool isEncoding() const;
+  // Whether encoding can carry on with periods of `nFrames`, see
+  // `FileRecorder::acceptsPeriod`.
+  bool acceptsPeriod(unsigned int nFrames) const;
+
+  // Realtime thread
+  void push(const void *input, unsigned int nFrames);
+
+private:
+  void run();
+  void drain();
+  void encodeChunk(size_t byteCount);
+  void deliver();
+  EncoderStats stats();
+
+  EncoderTapSettings settings;
+  Listener listener;
+  std::unique_ptr<AudioEncoder> encoder;
+  AudioEncoder::Writer writer;
+  RingBuffer ring;
+  size_t frameSize;
+  size_t unitSize;
+  std::vector<uint8_t> readBuffer;
+  std::vector<float> floatBuffer;
+  std::vector<float> codecBuffer;
+
+  // Encoder thread: packets not delivered yet, and the encoded frame the next one
+  // starts at.
+  std::vector<EncodedPacket> pending;
+  uint64_t nextFrame;
+
+  std::atomic<bool> active;
+  std::atomic<bool> pushing;
+  std::atomic<uint64_t> packetCount;
+  std::atomic<uint64_t> byteCount;
+  std::atomic<uint64_t> framesEncoded;
+  std::atomic<uint64_t> droppedFrames;
+  std::string error;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable stopRequested;
+  bool stopping;
+};
+
+#endif
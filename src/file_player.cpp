@@ -0,0 +1,274 @@
+#include "file_player.hpp"
+#include "sample_format.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+uint32_t readLittleEndian(const uint8_t *from, unsigned int byteCount) {
+  uint32_t value = 0;
+
+  for (unsigned int i = 0; i < byteCount; i++) {
+    value |= (uint32_t)from[i] << (8 * i);
+  }
+
+  return value;
+}
+
+unsigned int formatByteSize(RtAudioFormat format) {
+  switch (format) {
+  case RTAUDIO_SINT8:
+    return 1;
+  case RTAUDIO_SINT16:
+    return 2;
+  case RTAUDIO_SINT24:
+    return 3;
+  case RTAUDIO_SINT32:
+  case RTAUDIO_FLOAT32:
+    return 4;
+  case RTAUDIO_FLOAT64:
+    return 8;
+  }
+
+  return 0;
+}
+
+} // namespace
+
+FilePlayer::FilePlayer()
+    : dataOffset{0}, fileFrameSize{0}, unsignedSamples{false}, active{false},
+      rendering{false}, ended{false}, currentFrame{0}, seekTarget{-1} {}
+
+FilePlayer::~FilePlayer() { stop(); }
+
+bool FilePlayer::start(const std::string &path, const PlaybackSettings &settings,
+                       Listener onEnd, PlaybackInfo *playbackInfo,
+                       std::string *error) {
+  stop();
+
+  if (!this->file.open(path, error)) {
+    return false;
+  }
+
+  this->settings = settings;
+  this->unsignedSamples = false;
+
+  if (settings.raw) {
+    this->info.format = settings.rawFormat;
+    this->info.channels = settings.rawChannels;
+    this->info.sampleRate = settings.rawSampleRate;
+    this->dataOffset = 0;
+    this->fileFrameSize = formatByteSize(settings.rawFormat) * settings.rawChannels;
+
+    if (this->fileFrameSize == 0) {
+      *error = "Invalid raw file format";
+      this->file.close();
+      return false;
+    }
+
+    this->info.frames = this->file.size() / this->fileFrameSize;
+  } else if (!parseWav(error)) {
+    this->file.close();
+    return false;
+  }
+
+  if (this->settings.loopEnd == 0 || this->settings.loopEnd > this->info.frames) {
+    this->settings.loopEnd = this->info.frames;
+  }
+
+  if (this->settings.loop && this->settings.loopStart >= this->settings.loopEnd) {
+    *error = "loopStart should be before loopEnd";
+    this->file.close();
+    return false;
+  }
+
+  this->onEnd = onEnd;
+  this->fileBuffer.assign((size_t)settings.maxFrames * this->info.channels, 0);
+  this->mixBuffer.assign((size_t)settings.maxFrames * settings.channels, 0);
+  this->currentFrame = 0;
+  this->seekTarget = -1;
+  this->ended = false;
+  this->active = true;
+
+  *playbackInfo = this->info;
+
+  return true;
+}
+
+void FilePlayer::stop() {
+  // Wait for the realtime thread to leave `render` before the mapping goes away.
+  this->active = false;
+
+  while (this->rendering) {
+    std::this_thread::yield();
+  }
+
+  this->file.close();
+}
+
+bool FilePlayer::isPlaying() const { return this->active && !this->ended; }
+
+void FilePlayer::seek(uint64_t frame) {
+  this->seekTarget = (int64_t)std::min(frame, this->info.frames);
+  this->ended = false;
+}
+
+uint64_t FilePlayer::position() const { return this->currentFrame; }
+
+void FilePlayer::resize(unsigned int maxFrames) {
+  this->settings.maxFrames = maxFrames;
+
+  if (this->active) {
+    this->fileBuffer.assign((size_t)maxFrames * this->info.channels, 0);
+    this->mixBuffer.assign((size_t)maxFrames * this->settings.channels, 0);
+  }
+}
+
+void FilePlayer::render(void *output, unsigned int nFrames) {
+  this->rendering = true;
+
+  if (this->active && !this->ended && nFrames <= this->settings.maxFrames) {
+    renderFrames(output, nFrames);
+  }
+
+  this->rendering = false;
+}
+
+void FilePlayer::renderFrames(void *output, unsigned int nFrames) {
+  int64_t target = this->seekTarget.exchange(-1);
+  uint64_t frame = target >= 0 ? (uint64_t)target : this->currentFrame.load();
+  unsigned int channels = this->settings.channels;
+  unsigned int fileChannels = this->info.channels;
+  float *mixed = this->mixBuffer.data();
+  unsigned int done = 0;
+
+  // The file frames are gathered laid out like the output and added in the stream
+  // format, so what is already in the output isn't requantized.
+  std::fill(mixed, mixed + (size_t)nFrames * channels, 0.0f);
+
+  while (done < nFrames) {
+    uint64_t end = this->settings.loop ? this->settings.loopEnd : this->info.frames;
+
+    if (frame >= end) {
+      if (this->settings.loop) {
+        frame = this->settings.loopStart;
+        continue;
+      }
+
+      this->ended = true;
+      break;
+    }
+
+    unsigned int count = (unsigned int)std::min<uint64_t>(nFrames - done, end - frame);
+    const uint8_t *from =
+        this->file.data() + this->dataOffset + frame * this->fileFrameSize;
+    size_t sampleCount = (size_t)count * fileChannels;
+
+    if (this->unsignedSamples) {
+      for (size_t i = 0; i < sampleCount; i++) {
+        this->fileBuffer[i] = (from[i] - 128) / 128.0f;
+      }
+    } else {
+      samplesToFloat(from, this->info.format, this->fileBuffer.data(), sampleCount);
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+      for (unsigned int channel = 0; channel < channels; channel++) {
+        unsigned int fileChannel = fileChannels == 1 ? 0 : channel;
+
+        if (fileChannel >= fileChannels)
+          break;
+
+        size_t index = this->settings.interleaved ? (done + i) * channels + channel
+                                                  : channel * nFrames + done + i;
+        mixed[index] = this->fileBuffer[i * fileChannels + fileChannel];
+      }
+    }
+
+    frame += count;
+    done += count;
+  }
+
+  mixFloatIntoSamples(mixed, output, this->settings.format, (size_t)nFrames * channels);
+  this->currentFrame = frame;
+
+  if (this->ended && this->onEnd) {
+    this->onEnd();
+  }
+}
+
+bool FilePlayer::parseWav(std::string *error) {
+  const uint8_t *data = this->file.data();
+  size_t size = this->file.size();
+  size_t offset = 12;
+  bool hasFormat = false;
+  unsigned int formatTag = 0;
+  unsigned int bitsPerSample = 0;
+
+  if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+    *error = "Not a WAV file";
+    return false;
+  }
+
+  while (offset + 8 <= size) {
+    const uint8_t *chunk = data + offset;
+    size_t chunkSize = readLittleEndian(chunk + 4, 4);
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && offset + 8 + 16 <= size) {
+      formatTag = readLittleEndian(chunk + 8, 2);
+      this->info.channels = readLittleEndian(chunk + 10, 2);
+      this->info.sampleRate = readLittleEndian(chunk + 12, 4);
+      bitsPerSample = readLittleEndian(chunk + 22, 2);
+
+      // WAVE_FORMAT_EXTENSIBLE, the actual format is at the start of the sub format.
+      if (formatTag == 0xfffe && chunkSize >= 40 && offset + 8 + 40 <= size) {
+        formatTag = readLittleEndian(chunk + 32, 2);
+      }
+
+      hasFormat = true;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (!hasFormat)
+        break;
+
+      // Files that were cut short may still have placeholder sizes, so never trust the
+      // size beyond the end of the file.
+      this->dataOffset = offset + 8;
+      size_t dataSize = std::min(chunkSize, size - this->dataOffset);
+
+      if (formatTag == 1 && bitsPerSample == 8) {
+        this->info.format = RTAUDIO_SINT8;
+        this->unsignedSamples = true;
+      } else if (formatTag == 1 && bitsPerSample == 16) {
+        this->info.format = RTAUDIO_SINT16;
+      } else if (formatTag == 1 && bitsPerSample == 24) {
+        this->info.format = RTAUDIO_SINT24;
+      } else if (formatTag == 1 && bitsPerSample == 32) {
+        this->info.format = RTAUDIO_SINT32;
+      } else if (formatTag == 3 && bitsPerSample == 32) {
+        this->info.format = RTAUDIO_FLOAT32;
+      } else if (formatTag == 3 && bitsPerSample == 64) {
+        this->info.format = RTAUDIO_FLOAT64;
+      } else {
+        *error = "Unsupported WAV sample format";
+        return false;
+      }
+
+      if (this->info.channels == 0) {
+        *error = "Invalid WAV channel count";
+        return false;
+      }
+
+      this->fileFrameSize = formatByteSize(this->info.format) * this->info.channels;
+      this->info.frames = dataSize / this->fileFrameSize;
+
+      return true;
+    }
+
+    // Chunks are padded to an even size.
+    offset += 8 + chunkSize + (chunkSize & 1);
+  }
+
+  *error = "WAV file has no audio data";
+  return false;
+}
@@ -0,0 +1,84 @@
+#ifndef __NODE_ADDON_FILE_PLAYER_H__
+#define __NODE_ADDON_FILE_PLAYER_H__
+
+#include "mapped_file.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct PlaybackSettings {
+  // Stream side.
+  RtAudioFormat format = RTAUDIO_SINT16;
+  unsigned int channels = 0;
+  bool interleaved = true;
+  unsigned int maxFrames = 0;
+
+  // Layout of raw files, WAV files describe themselves.
+  bool raw = false;
+  RtAudioFormat rawFormat = RTAUDIO_SINT16;
+  unsigned int rawChannels = 0;
+  unsigned int rawSampleRate = 0;
+
+  // Loop points in frames, `loopEnd` = 0 means the end of the file.
+  bool loop = false;
+  uint64_t loopStart = 0;
+  uint64_t loopEnd = 0;
+};
+
+struct PlaybackInfo {
+  RtAudioFormat format = RTAUDIO_SINT16;
+  unsigned int channels = 0;
+  unsigned int sampleRate = 0;
+  uint64_t frames = 0;
+};
+
+// Plays a memory-mapped WAV or raw PCM file into the stream output.
+//
+// `render` runs on the realtime thread and mixes the file into whatever is already in
+// the output buffer, converting the sample format and mapping channels (a mono file
+// plays on every channel, other files channel by channel). The sample rate isn't
+// converted. Seeks requested from JS are picked up at the start of the next period.
+class FilePlayer {
+public:
+  using Listener = std::function<void()>;
+
+  FilePlayer();
+  ~FilePlayer();
+
+  // JS thread
+  bool start(const std::string &path, const PlaybackSettings &settings, Listener onEnd,
+             PlaybackInfo *playbackInfo, std::string *error);
+  void stop();
+  bool isPlaying() const;
+  void seek(uint64_t frame);
+  uint64_t position() const;
+  // Only while the stream is stopped, playing carries on with periods of `maxFrames`.
+  void resize(unsigned int maxFrames);
+
+  // Realtime thread
+  void render(void *output, unsigned int nFrames);
+
+private:
+  bool parseWav(std::string *error);
+  void renderFrames(void *output, unsigned int nFrames);
+
+  MappedFile file;
+  PlaybackSettings settings;
+  PlaybackInfo info;
+  Listener onEnd;
+  size_t dataOffset;
+  size_t fileFrameSize;
+  bool unsignedSamples;
+  std::vector<float> fileBuffer;
+  std::vector<float> mixBuffer;
+
+  std::atomic<bool> active;
+  std::atomic<bool> rendering;
+  std::atomic<bool> ended;
+  std::atomic<uint64_t> currentFrame;
+  std::atomic<int64_t> seekTarget;
+};
+
+#endif
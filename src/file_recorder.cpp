@@ -0,0 +1,295 @@
+#include "file_recorder.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// Upper bound of a single write, the writer batches everything available up to this.
+const size_t MaxWriteBytes = 256 * 1024;
+const size_t WavHeaderSize = 44;
+
+void putLittleEndian(uint8_t *to, uint32_t value, unsigned int byteCount) {
+  for (unsigned int i = 0; i < byteCount; i++) {
+    to[i] = (value >> (8 * i)) & 0xff;
+  }
+}
+
+} // namespace
+
+FileRecorder::FileRecorder()
+    : file{nullptr}, frameSize{0}, active{false}, pushing{false}, framesWritten{0},
+      droppedFrames{0}, stopping{false}, drainRequested{false} {}
+
+FileRecorder::~FileRecorder() { stop(); }
+
+bool FileRecorder::start(const std::string &path, const RecordingSettings &settings,
+                         Listener listener, std::string *error) {
+  this->file = std::fopen(path.c_str(), "wb");
+
+  if (this->file == nullptr) {
+    *error = "Couldn't open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  this->settings = settings;
+  this->listener = listener;
+  this->frameSize = settings.channels * settings.sampleSize;
+  this->framesWritten = 0;
+  this->droppedFrames = 0;
+  this->error.clear();
+  this->stopping = false;
+  this->drainRequested = false;
+
+  // Non-interleaved input is read back a period at a time, so batches are whole
+  // periods; interleaved input just needs whole frames.
+  size_t unit = settings.interleaved ? this->frameSize
+                                     : this->frameSize * settings.periodFrames;
+  size_t batch = std::max(unit, MaxWriteBytes / unit * unit);
+
+  this->ring.allocate((size_t)settings.ringFrames * this->frameSize);
+  this->readBuffer.assign(batch, 0);
+  this->writeBuffer.assign(batch, 0);
+
+  if (settings.container == RecordingContainer::Wav) {
+    // Placeholder sizes, fixed up while recording and at the end.
+    writeHeader();
+  }
+
+  this->thread = std::thread(&FileRecorder::run, this);
+  this->active = true;
+
+  return true;
+}
+
+RecordingProgress FileRecorder::stop() {
+  if (!this->thread.joinable()) {
+    return progress();
+  }
+
+  // Make sure the realtime thread is done with the ring before the writer drains it for
+  // the last time.
+  this->active = false;
+
+  while (this->pushing) {
+    std::this_thread::yield();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+
+  this->stopRequested.notify_one();
+  this->thread.join();
+
+  return progress();
+}
+
+bool FileRecorder::isRecording() const { return this->active; }
+
+bool FileRecorder::acceptsPeriod(unsigned int nFrames) const {
+  return this->settings.interleaved && this->settings.ringFrames >= nFrames * 2;
+}
+
+void FileRecorder::push(const void *input, unsigned int nFrames) {
+  this->pushing = true;
+
+  if (this->active) {
+    size_t byteCount = nFrames * this->frameSize;
+
+    while (this->settings.lossless && this->ring.writeAvailable() < byteCount &&
+           byteCount <= this->ring.capacity()) {
+      requestDrain();
+      std::this_thread::yield();
+    }
+
+    if (this->ring.writeAvailable() >= byteCount) {
+      this->ring.write(input, byteCount);
+    } else {
+      this->droppedFrames.fetch_add(nFrames, std::memory_order_relaxed);
+    }
+
+    // Keep the writer ahead of a caller that pushes faster than realtime.
+    if (this->settings.lossless &&
+        this->ring.readAvailable() > this->ring.capacity() / 2) {
+      requestDrain();
+    }
+  }
+
+  this->pushing = false;
+}
+
+void FileRecorder::requestDrain() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->drainRequested = true;
+  }
+
+  this->stopRequested.notify_one();
+}
+
+void FileRecorder::run() {
+  using clock = std::chrono::steady_clock;
+
+  // Poll often enough that the ring never gets more than a quarter full.
+  auto pollInterval = std::chrono::milliseconds(std::clamp<unsigned int>(
+      this->settings.ringFrames * 250 / std::max(1u, this->settings.sampleRate), 1, 50));
+  auto progressInterval = std::chrono::milliseconds(this->settings.progressIntervalMs);
+  auto lastFixup = clock::now();
+  auto lastProgress = clock::now();
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  for (;;) {
+    this->stopRequested.wait_for(lock, pollInterval, [this] {
+      return this->stopping || this->drainRequested;
+    });
+
+    bool finishing = this->stopping;
+
+    this->drainRequested = false;
+    lock.unlock();
+    drain();
+
+    auto now = clock::now();
+
+    if (this->settings.container == RecordingContainer::Wav && this->error.empty() &&
+        now - lastFixup >= std::chrono::seconds(1)) {
+      writeHeader();
+      lastFixup = now;
+    }
+
+    if (this->listener && this->settings.progressIntervalMs > 0 &&
+        now - lastProgress >= progressInterval) {
+      this->listener(progress());
+      lastProgress = now;
+    }
+
+    lock.lock();
+
+    if (finishing) {
+      break;
+    }
+  }
+
+  if (this->settings.container == RecordingContainer::Wav && this->error.empty()) {
+    writeHeader();
+  }
+
+  std::fclose(this->file);
+  this->file = nullptr;
+}
+
+void FileRecorder::drain() {
+  size_t unit = this->frameSize;
+
+  if (!this->settings.interleaved) {
+    unit *= this->settings.periodFrames;
+  }
+
+  for (;;) {
+    size_t byteCount = std::min(this->ring.readAvailable(), this->readBuffer.size());
+
+    byteCount = byteCount / unit * unit;
+
+    if (byteCount == 0) {
+      return;
+    }
+
+    if (!this->error.empty()) {
+      // Writing failed, keep the ring moving so the realtime side doesn't count drops.
+      this->ring.skip(byteCount);
+      continue;
+    }
+
+    this->ring.read(this->readBuffer.data(), byteCount);
+    writeChunk(byteCount);
+  }
+}
+
+void FileRecorder::writeChunk(size_t byteCount) {
+  const uint8_t *data = this->readBuffer.data();
+  unsigned int sampleSize = this->settings.sampleSize;
+  unsigned int channels = this->settings.channels;
+
+  if (!this->settings.interleaved && channels > 1) {
+    // Each period holds one plane per channel, files are interleaved.
+    size_t periodFrames = this->settings.periodFrames;
+    size_t periodSize = periodFrames * this->frameSize;
+
+    for (size_t period = 0; period < byteCount / periodSize; period++) {
+      const uint8_t *from = data + period * periodSize;
+      uint8_t *to = this->writeBuffer.data() + period * periodSize;
+
+      for (size_t frame = 0; frame < periodFrames; frame++) {
+        for (unsigned int channel = 0; channel < channels; channel++) {
+          memcpy(to + (frame * channels + channel) * sampleSize,
+                 from + (channel * periodFrames + frame) * sampleSize, sampleSize);
+        }
+      }
+    }
+
+    data = this->writeBuffer.data();
+  }
+
+  if (this->settings.format == RTAUDIO_SINT8 &&
+      this->settings.container == RecordingContainer::Wav) {
+    // 8-bit WAV samples are unsigned.
+    uint8_t *to = this->writeBuffer.data();
+
+    for (size_t i = 0; i < byteCount; i++) {
+      to[i] = data[i] ^ 0x80;
+    }
+
+    data = to;
+  }
+
+  if (std::fwrite(data, 1, byteCount, this->file) != byteCount) {
+    this->error = std::string("Writing the recording failed: ") + std::strerror(errno);
+
+    if (this->listener) {
+      this->listener(progress());
+    }
+
+    return;
+  }
+
+  this->framesWritten.fetch_add(byteCount / this->frameSize, std::memory_order_relaxed);
+}
+
+void FileRecorder::writeHeader() {
+  uint8_t header[WavHeaderSize];
+  uint64_t dataSize = this->framesWritten.load() * this->frameSize;
+  uint32_t chunkSize = (uint32_t)std::min<uint64_t>(dataSize, 0xffffffff - 36);
+  bool isFloat = this->settings.format == RTAUDIO_FLOAT32 ||
+                 this->settings.format == RTAUDIO_FLOAT64;
+
+  memcpy(header, "RIFF", 4);
+  putLittleEndian(header + 4, chunkSize + 36, 4);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  putLittleEndian(header + 16, 16, 4);
+  putLittleEndian(header + 20, isFloat ? 3 : 1, 2);
+  putLittleEndian(header + 22, this->settings.channels, 2);
+  putLittleEndian(header + 24, this->settings.sampleRate, 4);
+  putLittleEndian(header + 28, this->settings.sampleRate * this->frameSize, 4);
+  putLittleEndian(header + 32, this->frameSize, 2);
+  putLittleEndian(header + 34, this->settings.sampleSize * 8, 2);
+  memcpy(header + 36, "data", 4);
+  putLittleEndian(header + 40, chunkSize, 4);
+
+  std::fseek(this->file, 0, SEEK_SET);
+  std::fwrite(header, 1, WavHeaderSize, this->file);
+  std::fseek(this->file, 0, SEEK_END);
+  std::fflush(this->file);
+}
+
+RecordingProgress FileRecorder::progress() {
+  RecordingProgress progress;
+
+  progress.framesWritten = this->framesWritten.load();
+  progress.droppedFrames = this->droppedFrames.load();
+  progress.error = this->error;
+
+  return progress;
+}
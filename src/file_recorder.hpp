@@ -0,0 +1,95 @@
+#ifndef __NODE_ADDON_FILE_RECORDER_H__
+#define __NODE_ADDON_FILE_RECORDER_H__
+
+#include "ring_buffer.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class RecordingContainer { Wav = 0, Raw = 1 };
+
+struct RecordingSettings {
+  RecordingContainer container = RecordingContainer::Wav;
+  RtAudioFormat format = RTAUDIO_SINT16;
+  unsigned int sampleSize = 2;
+  unsigned int channels = 0;
+  unsigned int sampleRate = 0;
+  // Frames per period, non-interleaved input is interleaved a period at a time.
+  unsigned int periodFrames = 0;
+  bool interleaved = true;
+  unsigned int ringFrames = 0;
+  unsigned int progressIntervalMs = 0;
+  // `push` waits for room instead of dropping, for callers that aren't realtime, like
+  // offline streams.
+  bool lossless = false;
+};
+
+struct RecordingProgress {
+  uint64_t framesWritten = 0;
+  uint64_t droppedFrames = 0;
+  // Set once writing failed, nothing is written after that.
+  std::string error;
+};
+
+// Records stream input to a WAV or raw PCM file without going through JS.
+//
+// The realtime thread only copies each period into a preallocated ring (whole periods,
+// a period that doesn't fit is dropped and counted). A writer thread drains the ring
+// in large batches, converts to the file layout, writes, and rewrites the WAV header
+// about once a second so that a file cut short by a crash is still readable. Progress
+// and errors are reported through the listener, on the writer thread.
+class FileRecorder {
+public:
+  using Listener = std::function<void(const RecordingProgress &progress)>;
+
+  FileRecorder();
+  ~FileRecorder();
+
+  // JS thread
+  bool start(const std::string &path, const RecordingSettings &settings,
+             Listener listener, std::string *error);
+  RecordingProgress stop();
+  bool isRecording() const;
+  // Whether recording can carry on with periods of `nFrames`. Interleaved input doesn't
+  // depend on the period size, as long as the ring holds two periods.
+  bool acceptsPeriod(unsigned int nFrames) const;
+
+  // Realtime thread
+  void push(const void *input, unsigned int nFrames);
+
+private:
+  void run();
+  void requestDrain();
+  void drain();
+  void writeChunk(size_t byteCount);
+  void writeHeader();
+  RecordingProgress progress();
+
+  RecordingSettings settings;
+  Listener listener;
+  std::FILE *file;
+  RingBuffer ring;
+  std::vector<uint8_t> readBuffer;
+  std::vector<uint8_t> writeBuffer;
+  size_t frameSize;
+
+  std::atomic<bool> active;
+  std::atomic<bool> pushing;
+  std::atomic<uint64_t> framesWritten;
+  std::atomic<uint64_t> droppedFrames;
+  std::string error;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable stopRequested;
+  bool stopping;
+  bool drainRequested;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : mapping{nullptr}, length{0}, fileHandle{INVALID_HANDLE_VALUE},
+      mappingHandle{nullptr} {}
+
+bool MappedFile::open(const std::string &path, std::string *error) {
+  close();
+
+  int wideLength = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  std::wstring widePath(wideLength, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], wideLength);
+
+  fileHandle = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+  LARGE_INTEGER fileSize;
+
+  if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize)) {
+    *error = "Couldn't open " + path;
+    close();
+    return false;
+  }
+
+  length = (size_t)fileSize.QuadPart;
+
+  if (length > 0) {
+    mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    mapping = mappingHandle == nullptr
+                  ? nullptr
+                  : (const uint8_t *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+    if (mapping == nullptr) {
+      *error = "Couldn't map " + path;
+      close();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void MappedFile::close() {
+  if (mapping != nullptr) {
+    UnmapViewOfFile(mapping);
+  }
+
+  if (mappingHandle != nullptr) {
+    CloseHandle(mappingHandle);
+  }
+
+  if (fileHandle != INVALID_HANDLE_VALUE) {
+    CloseHandle(fileHandle);
+  }
+
+  mapping = nullptr;
+  length = 0;
+  fileHandle = INVALID_HANDLE_VALUE;
+  mappingHandle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile() : mapping{nullptr}, length{0} {}
+
+bool MappedFile::open(const std::string &path, std::string *error) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat info;
+
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    *error = "Couldn't open " + path + ": " + std::strerror(errno);
+
+    if (fd >= 0) {
+      ::close(fd);
+    }
+
+    return false;
+  }
+
+  length = (size_t)info.st_size;
+
+  if (length > 0) {
+    void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (address == MAP_FAILED) {
+      *error = "Couldn't map " + path + ": " + std::strerror(errno);
+      ::close(fd);
+      length = 0;
+      return false;
+    }
+
+    // Playback reads front to back, ask for aggressive read-ahead so the realtime
+    // thread rarely has to wait for a page fault to be served from disk.
+    madvise(address, length, MADV_SEQUENTIAL);
+    madvise(address, length, MADV_WILLNEED);
+    mapping = (const uint8_t *)address;
+  }
+
+  ::close(fd);
+
+  return true;
+}
+
+void MappedFile::close() {
+  if (mapping != nullptr) {
+    munmap((void *)mapping, length);
+  }
+
+  mapping = nullptr;
+  length = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+const uint8_t *MappedFile::data() const { return mapping; }
+
+size_t MappedFile::size() const { return length; }
@@ -0,0 +1,29 @@
+#ifndef __NODE_ADDON_MAPPED_FILE_H__
+#define __NODE_ADDON_MAPPED_FILE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  bool open(const std::string &path, std::string *error);
+  void close();
+
+  const uint8_t *data() const;
+  size_t size() const;
+
+private:
+  const uint8_t *mapping;
+  size_t length;
+#ifdef _WIN32
+  void *fileHandle;
+  void *mappingHandle;
+#endif
+};
+
+#endif
@@ -0,0 +1,404 @@
+#include "mixer.hpp"
+#include "sample_format.hpp"
+#include "sample_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const float QuarterPi = 0.785398163f;
+
+} // namespace
+
+Mixer::Mixer()
+    : format{RTAUDIO_FLOAT32}, channels{0}, busChannels{0}, interleaved{true},
+      maxFrames{0}, slots{0}, nextGeneration{1}, usedSlots{0}, claimedVoices{0},
+      mixedVoices{0}, currentFrame{0}, underrunCount{0}, lateStartCount{0} {}
+
+void Mixer::configure(RtAudioFormat format, unsigned int channels, bool interleaved,
+                      unsigned int maxFrames, unsigned int maxVoices) {
+  this->format = format;
+  this->channels = channels;
+  this->busChannels = std::min(channels, 2u);
+  this->interleaved = interleaved;
+  this->slots = std::min(maxVoices, MaxVoices);
+  this->voices.reset(this->slots > 0 ? new Voice[this->slots] : nullptr);
+
+  resize(maxFrames);
+
+  this->usedSlots = 0;
+  this->claimedVoices = 0;
+  this->mixedVoices = 0;
+  this->currentFrame = 0;
+  resetStats();
+}
+
+int64_t Mixer::addVoice(const VoiceSettings &settings) {
+  // The realtime thread doesn't look at free slots, so clips of finished voices can be
+  // released and queues (re)allocated here.
+  unsigned int usedSlots = this->usedSlots.load(std::memory_order_relaxed);
+
+  for (unsigned int slot = 0; slot < usedSlots; slot++) {
+    Voice &voice = this->voices[slot];
+
+    if (voice.clip && voice.state.load(std::memory_order_acquire) == Free) {
+      voice.clip.reset();
+      voice.clipSamples = nullptr;
+    }
+  }
+
+  for (unsigned int slot = 0; slot < this->slots; slot++) {
+    Voice &voice = this->voices[slot];
+
+    if (voice.state.load(std::memory_order_acquire) != Free)
+      continue;
+
+    if (settings.clip) {
+      voice.clip = settings.clip;
+      voice.clipSamples = settings.clip->data() + settings.clipOffset * settings.channels;
+      voice.clipFrames = settings.clipFrames;
+      voice.queue.reset();
+    } else {
+      size_t capacity = (size_t)settings.queueFrames * settings.channels * sizeof(float);
+
+      if (voice.queue.capacity() != capacity) {
+        voice.queue.allocate(capacity);
+      } else {
+        voice.queue.reset();
+      }
+
+      voice.clip.reset();
+      voice.clipSamples = nullptr;
+      voice.clipFrames = 0;
+    }
+
+    voice.clipPosition.store(0, std::memory_order_relaxed);
+    voice.channels = settings.channels;
+    voice.startFrame = settings.startFrame;
+    voice.gain.store(settings.gain, std::memory_order_relaxed);
+    voice.pan.store(settings.pan, std::memory_order_relaxed);
+    voice.generation = this->nextGeneration++;
+    voice.fresh = true;
+    voice.starved = true;
+
+    if (slot >= this->usedSlots.load(std::memory_order_relaxed)) {
+      this->usedSlots.store(slot + 1, std::memory_order_release);
+    }
+
+    this->claimedVoices.fetch_add(1, std::memory_order_relaxed);
+    voice.state.store(Playing, std::memory_order_release);
+
+    return (int64_t)(voice.generation * MaxVoices + slot);
+  }
+
+  return -1;
+}
+
+bool Mixer::removeVoice(int64_t id, bool drain) {
+  Voice *voice = find(id);
+
+  if (voice == nullptr)
+    return false;
+
+  uint8_t state = voice->state.load(std::memory_order_acquire);
+
+  // The realtime thread may finish a draining voice at the same time.
+  while ((state == Playing || state == Draining) &&
+         !voice->state.compare_exchange_weak(state, drain ? Draining : Removed,
+                                             std::memory_order_acq_rel)) {
+  }
+
+  return state == Playing || state == Draining;
+}
+
+size_t Mixer::queue(int64_t id, const float *samples, size_t sampleCount) {
+  Voice *voice = find(id);
+
+  if (voice == nullptr || voice->clip ||
+      voice->state.load(std::memory_order_acquire) != Playing)
+    return 0;
+
+  size_t frameSize = voice->channels * sizeof(float);
+  size_t frames = sampleCount / voice->channels;
+
+  return voice->queue.write(samples, frames * frameSize) / frameSize;
+}
+
+bool Mixer::setGain(int64_t id, float gain) {
+  Voice *voice = find(id);
+
+  if (voice == nullptr || voice->state.load(std::memory_order_acquire) == Removed)
+    return false;
+
+  voice->gain.store(gain, std::memory_order_relaxed);
+
+  return true;
+}
+
+bool Mixer::setPan(int64_t id, float pan) {
+  Voice *voice = find(id);
+
+  if (voice == nullptr || voice->state.load(std::memory_order_acquire) == Removed)
+    return false;
+
+  voice->pan.store(std::clamp(pan, -1.0f, 1.0f), std::memory_order_relaxed);
+
+  return true;
+}
+
+int64_t Mixer::queuedFrames(int64_t id) const {
+  Voice *voice = find(id);
+
+  if (voice == nullptr || voice->state.load(std::memory_order_acquire) == Removed)
+    return -1;
+
+  if (voice->clip)
+    return (int64_t)(voice->clipFrames -
+                     voice->clipPosition.load(std::memory_order_relaxed));
+
+  return (int64_t)(voice->queue.readAvailable() / (voice->channels * sizeof(float)));
+}
+
+void Mixer::collect() {
+  for (unsigned int slot = 0; slot < this->slots; slot++) {
+    if (this->voices[slot].state.load(std::memory_order_acquire) == Removed) {
+      finish(this->voices[slot]);
+    }
+  }
+}
+
+unsigned int Mixer::voiceCount() const { return this->claimedVoices; }
+
+unsigned int Mixer::activeVoices() const { return this->mixedVoices; }
+
+unsigned int Mixer::maxVoices() const { return this->slots; }
+
+uint64_t Mixer::frame() const { return this->currentFrame; }
+
+uint64_t Mixer::underruns() const { return this->underrunCount; }
+
+uint64_t Mixer::lateStarts() const { return this->lateStartCount; }
+
+const LatencyHistogram &Mixer::renderTime() const { return this->renderTimes; }
+
+void Mixer::resetStats() {
+  this->underrunCount = 0;
+  this->lateStartCount = 0;
+  this->renderTimes.reset();
+}
+
+Mixer::Voice *Mixer::find(int64_t id) const {
+  if (id < 0)
+    return nullptr;
+
+  uint64_t slot = (uint64_t)id % MaxVoices;
+  uint64_t generation = (uint64_t)id / MaxVoices;
+
+  if (slot >= this->slots || this->voices[slot].generation != generation ||
+      this->voices[slot].state.load(std::memory_order_acquire) == Free)
+    return nullptr;
+
+  return &this->voices[slot];
+}
+
+void Mixer::finish(Voice &voice) {
+  this->claimedVoices.fetch_sub(1, std::memory_order_relaxed);
+  voice.state.store(Free, std::memory_order_release);
+}
+
+void Mixer::render(void *output, unsigned int nFrames, uint64_t frame) {
+  this->currentFrame.store(frame + nFrames, std::memory_order_relaxed);
+
+  if (this->claimedVoices.load(std::memory_order_relaxed) == 0 ||
+      nFrames > this->maxFrames) {
+    this->mixedVoices.store(0, std::memory_order_relaxed);
+    return;
+  }
+
+  int64_t start = StreamStats::now();
+  unsigned int usedSlots = this->usedSlots.load(std::memory_order_acquire);
+  unsigned int mixed = 0;
+
+  for (unsigned int channel = 0; channel < this->busChannels; channel++) {
+    memset(this->bus.data() + (size_t)channel * this->maxFrames, 0,
+           nFrames * sizeof(float));
+  }
+
+  for (unsigned int slot = 0; slot < usedSlots; slot++) {
+    Voice &voice = this->voices[slot];
+    uint8_t state = voice.state.load(std::memory_order_acquire);
+
+    if (state != Free && renderVoice(voice, state, frame, nFrames)) {
+      mixed++;
+    }
+  }
+
+  if (mixed > 0) {
+    mixBus(output, nFrames);
+  }
+
+  this->mixedVoices.store(mixed, std::memory_order_relaxed);
+  this->renderTimes.record(StreamStats::now() - start);
+}
+
+bool Mixer::renderVoice(Voice &voice, uint8_t state, uint64_t frame,
+                        unsigned int nFrames) {
+  if (voice.startFrame >= frame + nFrames) {
+    if (state == Removed) {
+      finish(voice);
+    }
+
+    return false;
+  }
+
+  unsigned int offset =
+      voice.startFrame > frame ? (unsigned int)(voice.startFrame - frame) : 0;
+  unsigned int wanted = nFrames - offset;
+  size_t frameSize = voice.channels * sizeof(float);
+  const float *frames = this->voiceFrames.data();
+  unsigned int count;
+
+  if (voice.clipSamples != nullptr) {
+    size_t position = voice.clipPosition.load(std::memory_order_relaxed);
+
+    // Skip what a late clip missed to stay aligned to the stream.
+    if (voice.fresh && voice.startFrame < frame) {
+      position = (size_t)std::min<uint64_t>(voice.clipFrames, frame - voice.startFrame);
+      this->lateStartCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    count = (unsigned int)std::min<size_t>(wanted, voice.clipFrames - position);
+    frames = voice.clipSamples + position * voice.channels;
+    voice.clipPosition.store(position + count, std::memory_order_relaxed);
+
+    if (count == 0) {
+      finish(voice);
+      return false;
+    }
+  } else {
+    count =
+        (unsigned int)std::min<size_t>(wanted, voice.queue.readAvailable() / frameSize);
+
+    if (count < wanted && state == Playing && !voice.starved) {
+      this->underrunCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    voice.starved = count < wanted;
+
+    if (count == 0) {
+      if (state != Playing) {
+        finish(voice);
+      }
+
+      return false;
+    }
+
+    voice.queue.read(this->voiceFrames.data(), count * frameSize);
+  }
+
+  // Constant power panning for mono voices, balance for stereo ones. A removed voice
+  // fades out.
+  float targets[2][2] = {};
+
+  if (state != Removed) {
+    float gain = voice.gain.load(std::memory_order_relaxed);
+    float pan = voice.pan.load(std::memory_order_relaxed);
+
+    if (this->busChannels == 1) {
+      targets[0][0] = targets[0][1] = voice.channels == 1 ? gain : gain * 0.5f;
+    } else if (voice.channels == 1) {
+      targets[0][0] = gain * std::cos((pan + 1) * QuarterPi);
+      targets[1][0] = gain * std::sin((pan + 1) * QuarterPi);
+    } else {
+      targets[0][0] = gain * std::min(1.0f, 1 - pan);
+      targets[1][1] = gain * std::min(1.0f, 1 + pan);
+    }
+  }
+
+  if (voice.fresh) {
+    memcpy(voice.applied, targets, sizeof(targets));
+    voice.fresh = false;
+  }
+
+  const float *planes[2] = {frames, nullptr};
+
+  if (voice.channels == 2) {
+    float *left = this->voicePlanes.data();
+    float *right = left + this->maxFrames;
+
+    for (unsigned int i = 0; i < count; i++) {
+      left[i] = frames[i * 2];
+      right[i] = frames[i * 2 + 1];
+    }
+
+    planes[0] = left;
+    planes[1] = right;
+  }
+
+  const SampleKernels &kernels = sampleKernels();
+
+  for (unsigned int channel = 0; channel < this->busChannels; channel++) {
+    float *to = this->bus.data() + (size_t)channel * this->maxFrames + offset;
+
+    for (unsigned int voiceChannel = 0; voiceChannel < voice.channels; voiceChannel++) {
+      float from = voice.applied[channel][voiceChannel];
+      float target = targets[channel][voiceChannel];
+
+      if (from != 0 || target != 0) {
+        kernels.mixRamp(planes[voiceChannel], to, count, from, (target - from) / count);
+      }
+
+      voice.applied[channel][voiceChannel] = target;
+    }
+  }
+
+  bool ended =
+      voice.clipSamples != nullptr
+          ? voice.clipPosition.load(std::memory_order_relaxed) == voice.clipFrames
+          : state == Draining && voice.queue.readAvailable() == 0;
+
+  if (state == Removed || ended) {
+    finish(voice);
+  }
+
+  return true;
+}
+
+void Mixer::resize(unsigned int maxFrames) {
+  this->maxFrames = maxFrames;
+  this->bus.assign((size_t)this->busChannels * maxFrames, 0);
+  this->voiceFrames.assign((size_t)2 * maxFrames, 0);
+  this->voicePlanes.assign((size_t)2 * maxFrames, 0);
+  this->outputFrames.assign(
+      this->format == RTAUDIO_FLOAT32 ? 0 : (size_t)this->channels * maxFrames, 0);
+}
+
+void Mixer::mixBus(void *output, unsigned int nFrames) {
+  // Float32 output is mixed into in place. Other formats get the bus laid out like the
+  // output and added in their own format, so what is already there isn't requantized.
+  bool convert = this->format != RTAUDIO_FLOAT32;
+  float *samples = convert ? this->outputFrames.data() : static_cast<float *>(output);
+  size_t sampleCount = (size_t)nFrames * this->channels;
+
+  if (convert) {
+    std::fill(samples, samples + sampleCount, 0.0f);
+  }
+
+  for (unsigned int channel = 0; channel < this->busChannels; channel++) {
+    const float *from = this->bus.data() + (size_t)channel * this->maxFrames;
+
+    if (!this->interleaved) {
+      sampleKernels().mixRamp(from, samples + (size_t)channel * nFrames, nFrames, 1, 0);
+      continue;
+    }
+
+    for (unsigned int i = 0; i < nFrames; i++) {
+      samples[(size_t)i * this->channels + channel] += from[i];
+    }
+  }
+
+  if (convert) {
+    mixFloatIntoSamples(samples, output, this->format, sampleCount);
+  }
+}
@@ -0,0 +1,147 @@
+#ifndef __NODE_ADDON_MIXER_H__
+#define __NODE_ADDON_MIXER_H__
+
+#include "ring_buffer.hpp"
+#include "stream_stats.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Interleaved float32 samples played by clip voices. Clips are immutable, so any number
+// of voices can play the same one.
+using MixerClip = std::shared_ptr<const std::vector<float>>;
+
+struct VoiceSettings {
+  // 1 or 2, samples are interleaved float32.
+  unsigned int channels = 1;
+  unsigned int queueFrames = 0;
+  float gain = 1;
+  // -1 = left, 1 = right.
+  float pan = 0;
+  // Stream frame the voice starts playing at, see `Mixer::frame`.
+  uint64_t startFrame = 0;
+  // Clip voices play `clipFrames` frames of `clip` from `clipOffset` instead of a queue,
+  // then finish.
+  MixerClip clip;
+  size_t clipOffset = 0;
+  size_t clipFrames = 0;
+};
+
+// Mixes voices fed from JS into the stream output.
+//
+// Every voice owns a float32 queue that is allocated when the voice is added, a gain, a
+// pan and the stream frame it starts at. `render` runs on the realtime thread and sums
+// the voices that have started into the first two output channels with the `mixRamp`
+// kernel, ramping gain and pan changes over a period. Voices start at their exact frame
+// within a period.
+//
+// Clip voices play a range of a `MixerClip` instead of a queue, so scheduled sounds need
+// no JS call once they are added. A clip voice whose start frame has already passed when
+// the realtime thread first sees it skips the frames it missed, so it stays aligned to
+// the stream and is counted as a late start.
+//
+// Voices live in a fixed table of slots whose state is a single atomic. JS only claims
+// free slots and marks voices as removed, the realtime thread hands a slot back once
+// it's done with it, so adding or removing a voice never makes the realtime thread
+// wait. Voice ids carry a generation, ids of finished voices stay invalid after their
+// slot is reused.
+class Mixer {
+public:
+  static const unsigned int MaxVoices = 65536;
+
+  Mixer();
+
+  // JS thread. `configure` drops all voices and must only be called while the stream
+  // is closed, `resize` and `collect` only while it's stopped. `resize` keeps the voices.
+  void configure(RtAudioFormat format, unsigned int channels, bool interleaved,
+                 unsigned int maxFrames, unsigned int maxVoices);
+  void resize(unsigned int maxFrames);
+  int64_t addVoice(const VoiceSettings &settings);
+  bool removeVoice(int64_t id, bool drain);
+  size_t queue(int64_t id, const float *samples, size_t sampleCount);
+  bool setGain(int64_t id, float gain);
+  bool setPan(int64_t id, float pan);
+  int64_t queuedFrames(int64_t id) const;
+  void collect();
+
+  unsigned int voiceCount() const;
+  unsigned int activeVoices() const;
+  unsigned int maxVoices() const;
+  uint64_t frame() const;
+  uint64_t underruns() const;
+  uint64_t lateStarts() const;
+  const LatencyHistogram &renderTime() const;
+  void resetStats();
+
+  // Realtime thread, `frame` is the stream frame of the period.
+  void render(void *output, unsigned int nFrames, uint64_t frame);
+
+private:
+  enum State : uint8_t {
+    Free = 0,
+    Playing = 1,
+    // Plays what's queued, then finishes.
+    Draining = 2,
+    // Fades out over the next period, then finishes.
+    Removed = 3,
+  };
+
+  struct Voice {
+    std::atomic<uint8_t> state{Free};
+    std::atomic<float> gain{1};
+    std::atomic<float> pan{0};
+    unsigned int channels = 1;
+    uint64_t startFrame = 0;
+    uint64_t generation = 0;
+    RingBuffer queue;
+
+    // Clip voices: the clip is only touched on the JS thread, the realtime thread reads
+    // `clipSamples`.
+    MixerClip clip;
+    const float *clipSamples = nullptr;
+    size_t clipFrames = 0;
+    std::atomic<size_t> clipPosition{0};
+
+    // Realtime thread, the gains the last period ended at per output and voice
+    // channel. `fresh` voices start at their target without a ramp, `starved` ones
+    // ran out of queued frames and are only counted as an underrun once.
+    float applied[2][2] = {};
+    bool fresh = true;
+    bool starved = true;
+  };
+
+  Voice *find(int64_t id) const;
+  void finish(Voice &voice);
+  bool renderVoice(Voice &voice, uint8_t state, uint64_t frame, unsigned int nFrames);
+  void mixBus(void *output, unsigned int nFrames);
+
+  RtAudioFormat format;
+  unsigned int channels;
+  unsigned int busChannels;
+  bool interleaved;
+  unsigned int maxFrames;
+  unsigned int slots;
+  uint64_t nextGeneration;
+  std::unique_ptr<Voice[]> voices;
+
+  // Realtime thread scratch: the voice mix per output channel, one voice's frames as
+  // queued and split into channels, and the bus laid out like the output for formats
+  // other than float32.
+  std::vector<float> bus;
+  std::vector<float> voiceFrames;
+  std::vector<float> voicePlanes;
+  std::vector<float> outputFrames;
+
+  // One past the highest slot ever claimed, bounds the realtime thread's scan.
+  std::atomic<unsigned int> usedSlots;
+  std::atomic<unsigned int> claimedVoices;
+  std::atomic<unsigned int> mixedVoices;
+  std::atomic<uint64_t> currentFrame;
+  std::atomic<uint64_t> underrunCount;
+  std::atomic<uint64_t> lateStartCount;
+  LatencyHistogram renderTimes;
+};
+
+#endif
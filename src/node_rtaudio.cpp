@@ -1,5 +1,14 @@
 #include "node_rtaudio.hpp"
+#include "node_rtaudio_aggregate.hpp"
+#include "node_rtaudio_worker_port.hpp"
+#include "promise_worker.hpp"
+#include "rtapi_loopback.hpp"
+#include "typed_array.hpp"
+#include "sample_format.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 Napi::Object NodeRtAudio::Init(Napi::Env env, Napi::Object exports) {
@@ -12,16 +21,33 @@ Napi::Object NodeRtAudio::Init(Napi::Env env, Napi::Object exports) {
               "showWarnings", static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::openStream>(
               "openStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::openStreamAsync>(
+              "openStreamAsync", static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::closeStream>(
               "closeStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::closeStreamAsync>(
+              "closeStreamAsync", static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::startStream>(
               "startStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::startStreamAsync>(
+              "startStreamAsync", static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::stopStream>(
               "stopStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::stopStreamAsync>(
+              "stopStreamAsync", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::reconfigureStream>(
+              "reconfigureStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getStartupStats>(
+              "getStartupStats", static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::abortStream>(
               "abortStream", static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::getDevices>(
               "getDevices", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getDevicesAsync>(
+              "getDevicesAsync", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::setDeviceChangeCallback>(
+              "setDeviceChangeCallback",
+              static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::getDefaultInputDevice>(
               "getDefaultInputDevice",
               static_cast<napi_property_attributes>(napi_default)),
@@ -44,6 +70,77 @@ Napi::Object NodeRtAudio::Init(Napi::Env env, Napi::Object exports) {
               "setStreamTime", static_cast<napi_property_attributes>(napi_default)),
           InstanceMethod<&NodeRtAudio::getErrorText>(
               "getErrorText", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::write>(
+              "write", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::read>(
+              "read", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getBufferedFrames>(
+              "getBufferedFrames", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getDeadlineMisses>(
+              "getDeadlineMisses", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getStreamStats>(
+              "getStreamStats", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::resetStreamStats>(
+              "resetStreamStats", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::startRecording>(
+              "startRecording", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::stopRecording>(
+              "stopRecording", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::startPlayback>(
+              "startPlayback", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::stopPlayback>(
+              "stopPlayback", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::seekPlayback>(
+              "seekPlayback", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getPlaybackPosition>(
+              "getPlaybackPosition", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::startEncoder>(
+              "startEncoder", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::stopEncoder>(
+              "stopEncoder", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::startDecoder>(
+              "startDecoder", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::queueEncoded>(
+              "queueEncoded", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::stopDecoder>(
+              "stopDecoder", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::setWorkerBuffers>(
+              "setWorkerBuffers", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::createVoice>(
+              "createVoice", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::queueVoice>(
+              "queueVoice", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::setVoiceGain>(
+              "setVoiceGain", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::setVoicePan>(
+              "setVoicePan", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::removeVoice>(
+              "removeVoice", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::loadClip>(
+              "loadClip", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::unloadClip>(
+              "unloadClip", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::scheduleClip>(
+              "scheduleClip", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getStreamClock>(
+              "getStreamClock", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getVoiceQueuedFrames>(
+              "getVoiceQueuedFrames",
+              static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getMixerStats>(
+              "getMixerStats", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::setProcessingGraph>(
+              "setProcessingGraph", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::setGraphParameter>(
+              "setGraphParameter", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::startAnalysis>(
+              "startAnalysis", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::stopAnalysis>(
+              "stopAnalysis", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getGateStats>(
+              "getGateStats", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudio::getOfflineProgress>(
+              "getOfflineProgress", static_cast<napi_property_attributes>(napi_default)),
           StaticMethod<&NodeRtAudio::getVersion>(
               "getVersion", static_cast<napi_property_attributes>(napi_default)),
           StaticMethod<&NodeRtAudio::getCompiledApi>(
@@ -52,6 +149,14 @@ Napi::Object NodeRtAudio::Init(Napi::Env env, Napi::Object exports) {
               "getApiDisplayName", static_cast<napi_property_attributes>(napi_default)),
           StaticMethod<&NodeRtAudio::getApiName>(
               "getApiName", static_cast<napi_property_attributes>(napi_default)),
+          StaticMethod<&NodeRtAudio::convertSamples>(
+              "convertSamples", static_cast<napi_property_attributes>(napi_default)),
+          StaticMethod<&NodeRtAudio::getSampleConversionIsa>(
+              "getSampleConversionIsa",
+              static_cast<napi_property_attributes>(napi_default)),
+          StaticValue("STREAM_STATS_SNAPSHOT_LENGTH",
+                      Napi::Number::New(env, StreamStats::SnapshotLength),
+                      static_cast<napi_property_attributes>(napi_enumerable)),
       });
 
   Napi::FunctionReference *constructor = new Napi::FunctionReference();
@@ -60,14 +165,37 @@ Napi::Object NodeRtAudio::Init(Napi::Env env, Napi::Object exports) {
 
   exports.Set("NodeRtAudio", func);
 
-  return exports;
+  return NodeRtAudioAggregate::Init(env, NodeRtAudioWorkerPort::Init(env, exports));
 }
 
 NodeRtAudio::NodeRtAudio(const Napi::CallbackInfo &info)
-    : RtAudio(parseApi(info.Env(), info[0])), Napi::ObjectWrap<NodeRtAudio>(info),
-      rtThreadSmph{0}, jsThreadSmph{0} {}
+    : RtAudio(resolveApi(parseApi(info.Env(), info[0]))),
+      Napi::ObjectWrap<NodeRtAudio>(info),
+      rtThreadSmph{0}, jsThreadSmph{0}, warnings{true}, watermarkPending{false},
+      jsCallInFlight{false}, lateOutputReady{false}, deadlineMissPending{false},
+      consecutiveMisses{0}, batchSide{0}, batchPeriod{0}, batchCallInFlight{false},
+      batchStreamTime{0}, batchStatus{0}, clientFrameRemainder{0}, resampling{false},
+      jsInputChannels{0}, jsOutputChannels{0}, dispatchTime{0}, nextClipId{1},
+      analysisGeneration{0},
+      deviceCacheValid{false}, deviceApi{nullptr}, offlineApi{nullptr},
+      offlineGeneration{0}, hasStreamOptions{false}, streamOperationPending{false} {
+  // RtAudio's dummy API has no devices, builds with RTAUDIO_JS_LOOPBACK compile it in
+  // and back it with a virtual loopback device instead.
+  if (RtAudio::getCurrentApi() == RtAudio::RTAUDIO_DUMMY) {
+    delete this->rtapi_;
+    this->rtapi_ = new RtApiLoopback();
+  }
+}
 
 NodeRtAudio::~NodeRtAudio() {
+  // The watcher thread queries `rtapi_`.
+  deviceWatcher.stop();
+
+  if (tsDeviceCb.operator napi_threadsafe_function() != nullptr) {
+    tsDeviceCb.Abort();
+    tsDeviceCb.Release();
+  }
+
   if (tsCb.operator napi_threadsafe_function() != nullptr) {
     tsCb.Abort();
     tsCb.Release();
@@ -79,23 +207,188 @@ NodeRtAudio::~NodeRtAudio() {
     tsErrorCb.Release();
     tsErrorCb.Unref(this->Env());
   }
+
+  recorder.stop();
+
+  if (tsRecordingCb.operator napi_threadsafe_function() != nullptr) {
+    tsRecordingCb.Abort();
+    tsRecordingCb.Release();
+    tsRecordingCb.Unref(this->Env());
+  }
+
+  player.stop();
+
+  if (tsPlaybackCb.operator napi_threadsafe_function() != nullptr) {
+    tsPlaybackCb.Abort();
+    tsPlaybackCb.Release();
+    tsPlaybackCb.Unref(this->Env());
+  }
+
+  encoder.stop();
+
+  if (tsEncoderCb.operator napi_threadsafe_function() != nullptr) {
+    tsEncoderCb.Abort();
+    tsEncoderCb.Release();
+    tsEncoderCb.Unref(this->Env());
+  }
+
+  decoder.stop();
+
+  if (tsDecoderCb.operator napi_threadsafe_function() != nullptr) {
+    tsDecoderCb.Abort();
+    tsDecoderCb.Release();
+    tsDecoderCb.Unref(this->Env());
+  }
+
+  analyzer.stop();
+
+  if (tsAnalysisCb.operator napi_threadsafe_function() != nullptr) {
+    tsAnalysisCb.Abort();
+    tsAnalysisCb.Release();
+    tsAnalysisCb.Unref(this->Env());
+  }
+
+  if (tsGateCb.operator napi_threadsafe_function() != nullptr) {
+    tsGateCb.Abort();
+    tsGateCb.Release();
+    tsGateCb.Unref(this->Env());
+  }
+
+  if (tsOfflineCb.operator napi_threadsafe_function() != nullptr) {
+    tsOfflineCb.Abort();
+    tsOfflineCb.Release();
+    tsOfflineCb.Unref(this->Env());
+  }
+
+  // ~RtAudio deletes `rtapi_`, which has to be the device API again by then.
+  if (this->deviceApi != nullptr) {
+    delete this->offlineApi;
+    this->rtapi_ = this->deviceApi;
+  }
 }
 
 Napi::Value NodeRtAudio::getDevices(const Napi::CallbackInfo &info) {
-  std::vector<RtAudio::DeviceInfo> devicesV;
+  updateDeviceCache(queryDevices());
+
+  return createDeviceArray(info.Env(), this->deviceCache);
+}
+
+Napi::Value NodeRtAudio::getDevicesAsync(const Napi::CallbackInfo &info) {
+  auto devices = std::make_shared<std::vector<RtAudio::DeviceInfo>>();
 
-  const std::vector<unsigned int> deviceIds = this->getDeviceIds();
+  return PromiseWorker::queue(new PromiseWorker(
+      info.Env(), "getDevicesAsync", this->Value(),
+      [this, devices]() {
+        *devices = this->queryDevices();
+        return std::string();
+      },
+      [this, devices](Napi::Env env) {
+        this->updateDeviceCache(*devices);
+        return createDeviceArray(env, *devices);
+      }));
+}
+
+void NodeRtAudio::setDeviceChangeCallback(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  unsigned int intervalMs = 1000;
+
+  this->deviceWatcher.stop();
+
+  if (this->tsDeviceCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsDeviceCb.Release();
+    this->tsDeviceCb = Napi::ThreadSafeFunction();
+  }
+
+  if (info[0].IsNull() || info[0].IsUndefined())
+    return;
+
+  if (!info[0].IsFunction())
+    throw Napi::TypeError::New(env, "callback should be a function or null.");
+
+  if (!info[1].IsUndefined()) {
+    if (!info[1].IsNumber() || info[1].As<Napi::Number>().Int32Value() < 10)
+      throw Napi::TypeError::New(env, "intervalMs should be a number not below 10.");
+
+    intervalMs = info[1].As<Napi::Number>().Uint32Value();
+  }
+
+  // The watcher compares against the list JS saw last.
+  if (!this->deviceCacheValid) {
+    updateDeviceCache(queryDevices());
+  }
+
+  this->tsDeviceCb = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(),
+                                                   "deviceChangeCallback", 0, 1);
+  // Watching alone doesn't keep the process alive.
+  this->tsDeviceCb.Unref(env);
+
+  Napi::ThreadSafeFunction tsfn = this->tsDeviceCb;
 
-  for (const auto &deviceId : deviceIds) {
-    devicesV.push_back(this->getDeviceInfo(deviceId));
+  DeviceWatcher::Listener listener =
+      [tsfn, this](const std::vector<RtAudio::DeviceInfo> &devices) mutable {
+        tsfn.NonBlockingCall([this, devices](Napi::Env env, Napi::Function callback) {
+          std::vector<RtAudio::DeviceInfo> added;
+          std::vector<RtAudio::DeviceInfo> removed;
+
+          for (const RtAudio::DeviceInfo &device : devices) {
+            if (!deviceExists(device.ID, this->deviceCache))
+              added.push_back(device);
+          }
+
+          for (const RtAudio::DeviceInfo &device : this->deviceCache) {
+            if (!deviceExists(device.ID, devices))
+              removed.push_back(device);
+          }
+
+          this->updateDeviceCache(devices);
+
+          try {
+            Napi::Object event = Napi::Object::New(env);
+
+            event.Set("devices", createDeviceArray(env, devices));
+            event.Set("added", createDeviceArray(env, added));
+            event.Set("removed", createDeviceArray(env, removed));
+            callback.Call({event});
+          } catch (const std::exception &err) {
+            std::cerr << err.what() << std::endl;
+          }
+        });
+      };
+
+  this->deviceWatcher.start(
+      intervalMs, this->deviceCache, [this]() { return this->queryDevices(); }, listener);
+}
+
+RtApi *NodeRtAudio::getDeviceApi() const {
+  return this->deviceApi != nullptr ? this->deviceApi : this->rtapi_;
+}
+
+std::vector<RtAudio::DeviceInfo> NodeRtAudio::queryDevices() {
+  std::lock_guard<std::mutex> lock(this->deviceMutex);
+  std::vector<RtAudio::DeviceInfo> devices;
+  RtApi *api = getDeviceApi();
+
+  for (unsigned int deviceId : api->getDeviceIds()) {
+    devices.push_back(api->getDeviceInfo(deviceId));
   }
 
-  Napi::Array devicesArray = Napi::Array::New(info.Env(), devicesV.size());
+  return devices;
+}
+
+void NodeRtAudio::updateDeviceCache(const std::vector<RtAudio::DeviceInfo> &devices) {
+  this->deviceCache = devices;
+  this->deviceCacheValid = true;
+}
+
+Napi::Array
+NodeRtAudio::createDeviceArray(Napi::Env env,
+                               const std::vector<RtAudio::DeviceInfo> &devices) {
+  Napi::Array devicesArray = Napi::Array::New(env, devices.size());
 
-  for (unsigned int i = 0; i < devicesV.size(); i++) {
-    Napi::Object infoObj = Napi::Object::New(info.Env());
+  for (unsigned int i = 0; i < devices.size(); i++) {
+    Napi::Object infoObj = Napi::Object::New(env);
 
-    auto deviceInfo = devicesV[i];
+    auto deviceInfo = devices[i];
 
     infoObj.Set("id", deviceInfo.ID);
     infoObj.Set("name", deviceInfo.name);
@@ -105,7 +398,7 @@ Napi::Value NodeRtAudio::getDevices(const Napi::CallbackInfo &info) {
     infoObj.Set("isDefaultOutput", deviceInfo.isDefaultOutput);
     infoObj.Set("isDefaultInput", deviceInfo.isDefaultInput);
 
-    auto sampleRates = Napi::Array::New(info.Env(), deviceInfo.sampleRates.size());
+    auto sampleRates = Napi::Array::New(env, deviceInfo.sampleRates.size());
     for (unsigned int i = 0; i < deviceInfo.sampleRates.size(); i++) {
       sampleRates[i] = deviceInfo.sampleRates[i];
     }
@@ -121,11 +414,15 @@ Napi::Value NodeRtAudio::getDevices(const Napi::CallbackInfo &info) {
 }
 
 Napi::Value NodeRtAudio::getDefaultInputDevice(const Napi::CallbackInfo &info) {
-  return Napi::Number::New(info.Env(), RtAudio::getDefaultInputDevice());
+  std::lock_guard<std::mutex> lock(this->deviceMutex);
+
+  return Napi::Number::New(info.Env(), getDeviceApi()->getDefaultInputDevice());
 }
 
 Napi::Value NodeRtAudio::getDefaultOutputDevice(const Napi::CallbackInfo &info) {
-  return Napi::Number::New(info.Env(), RtAudio::getDefaultOutputDevice());
+  std::lock_guard<std::mutex> lock(this->deviceMutex);
+
+  return Napi::Number::New(info.Env(), getDeviceApi()->getDefaultOutputDevice());
 }
 
 Napi::Value NodeRtAudio::isStreamOpen(const Napi::CallbackInfo &info) {
@@ -141,18 +438,52 @@ Napi::Value NodeRtAudio::getCurrentApi(const Napi::CallbackInfo &info) {
 }
 
 Napi::Value NodeRtAudio::getStreamLatency(const Napi::CallbackInfo &info) {
-  return Napi::Number::New(info.Env(), RtAudio::getStreamLatency());
+  checkStreamOperation(info.Env());
+
+  long latency = RtAudio::getStreamLatency();
+
+  // Batching plays JS output one block after it was requested, and input waits up to
+  // a block minus one period before JS sees it.
+  if (RtAudio::isStreamOpen() && this->nodeOptions.periodsPerCallback > 1) {
+    long periods = this->nodeOptions.periodsPerCallback;
+
+    if (this->outputParams.nChannels > 0)
+      latency += periods * this->bufferFrames;
+    if (this->inputParams.nChannels > 0)
+      latency += (periods - 1) * this->bufferFrames;
+  }
+
+  // The resampler filters delay both directions, input in client frames.
+  if (RtAudio::isStreamOpen() && this->resampling) {
+    double resamplerLatency = 0;
+
+    if (this->outputParams.nChannels > 0)
+      resamplerLatency += this->outputResampler.latency();
+    if (this->inputParams.nChannels > 0)
+      resamplerLatency += this->inputResampler.latency() * this->sampleRate /
+                          this->nodeOptions.clientSampleRate;
+
+    latency += std::lround(resamplerLatency);
+  }
+
+  return Napi::Number::New(info.Env(), latency);
 }
 
 Napi::Value NodeRtAudio::getStreamSampleRate(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
   return Napi::Number::New(info.Env(), RtAudio::getStreamSampleRate());
 }
 
 Napi::Value NodeRtAudio::getStreamTime(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
   return Napi::Number::New(info.Env(), RtAudio::getStreamTime());
 }
 
 void NodeRtAudio::setStreamTime(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
   if (!info[0].IsNumber()) {
     throw Napi::TypeError::New(info.Env(), "time should be a number.");
   }
@@ -173,8 +504,12 @@ void NodeRtAudio::setErrorCallback(const Napi::CallbackInfo &info) {
   this->tsErrorCb = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(),
                                                   "errorCallback", 0, 1);
 
-  RtAudioErrorCallback errorCallback{[this](RtAudioErrorType type,
-                                            const std::string &errorText) {
+  this->errorCallback = [this](RtAudioErrorType type, const std::string &errorText) {
+    // A device went away, don't wait for the next scan to tell JS.
+    if (type == RTAUDIO_DEVICE_DISCONNECT) {
+      this->deviceWatcher.wake();
+    }
+
     this->tsErrorCb.NonBlockingCall([type, errorText](Napi::Env env,
                                                       Napi::Function callback) {
       try {
@@ -184,9 +519,9 @@ void NodeRtAudio::setErrorCallback(const Napi::CallbackInfo &info) {
         return;
       }
     });
-  }};
+  };
 
-  RtAudio::setErrorCallback(errorCallback);
+  RtAudio::setErrorCallback(this->errorCallback);
 }
 
 void NodeRtAudio::showWarnings(const Napi::CallbackInfo &info) {
@@ -194,37 +529,76 @@ void NodeRtAudio::showWarnings(const Napi::CallbackInfo &info) {
     throw Napi::TypeError::New(info.Env(), "value should be a boolean.");
   }
 
-  RtAudio::showWarnings(info[0].As<Napi::Boolean>());
+  this->warnings = info[0].As<Napi::Boolean>();
+
+  RtAudio::showWarnings(this->warnings);
 }
 
 Napi::Value NodeRtAudio::openStream(const Napi::CallbackInfo &info) {
+  beginOpen(info);
+  openBackend(&this->bufferFrames);
+  finishOpen(info.Env());
+
+  return Napi::Number::New(info.Env(), this->bufferFrames);
+}
+
+Napi::Value NodeRtAudio::openStreamAsync(const Napi::CallbackInfo &info) {
+  beginOpen(info);
+
+  // The backend settles on the period size on the worker, the JS thread only takes it
+  // over once the promise resolves.
+  auto bufferFrames = std::make_shared<unsigned int>(this->bufferFrames);
+
+  this->streamOperationPending = true;
+
+  return PromiseWorker::queue(new PromiseWorker(
+      info.Env(), "openStreamAsync", this->Value(),
+      [this, bufferFrames]() {
+        return openBackend(bufferFrames.get()) == RTAUDIO_NO_ERROR
+                   ? std::string()
+                   : RtAudio::getErrorText();
+      },
+      [this, bufferFrames](Napi::Env env) {
+        this->streamOperationPending = false;
+        this->bufferFrames = *bufferFrames;
+        finishOpen(env);
+
+        return Napi::Number::New(env, this->bufferFrames);
+      },
+      [this](Napi::Env env) {
+        this->streamOperationPending = false;
+        abandonOpen();
+      }));
+}
+
+// Parses the arguments of `openStream` and sets up everything that lives on the JS
+// thread, so that only the backend call is left.
+void NodeRtAudio::beginOpen(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
   jsRef = Napi::ObjectReference::New(this->Value(), 1);
 
   Napi::Env env = info.Env();
   RtAudio::StreamParameters *outputParamsPtr = nullptr;
   RtAudio::StreamParameters *inputParamsPtr = nullptr;
-  RtAudio::StreamOptions *optionsPtr = nullptr;
 
   if (RtAudio::isStreamOpen())
     throw Napi::Error::New(env, "Stream already open");
 
   Napi::Function cb;
 
+  this->outputParams = RtAudio::StreamParameters();
+  this->inputParams = RtAudio::StreamParameters();
+  this->options = RtAudio::StreamOptions();
+  this->nodeOptions = NodeStreamOptions();
+
   if (!info[0].IsNull()) {
     parseOutputParams(env, info[0], &this->outputParams);
-
-    if (!deviceExists(this->outputParams.deviceId, this->getDeviceIds()))
-      throw Napi::TypeError::New(env, "Output device doesn't exist.");
-
     outputParamsPtr = &this->outputParams;
   }
 
   if (!info[1].IsNull()) {
     parseInputParams(env, info[1], &this->inputParams);
-
-    if (!deviceExists(this->inputParams.deviceId, this->getDeviceIds()))
-      throw Napi::TypeError::New(env, "Input device doesn't exist.");
-
     inputParamsPtr = &this->inputParams;
   }
 
@@ -237,263 +611,3658 @@ Napi::Value NodeRtAudio::openStream(const Napi::CallbackInfo &info) {
   if (!info[4].IsNumber())
     throw Napi::Error::New(env, "bufferFrames should be a valid number");
 
-  if (!info[5].IsNull()) {
-    parseStreamOptions(env, info[5], &this->options);
-    optionsPtr = &this->options;
+  this->hasStreamOptions = !info[5].IsNull();
+
+  if (this->hasStreamOptions) {
+    parseStreamOptions(env, info[5], &this->options, &this->nodeOptions);
   }
 
-  if (!info[6].IsFunction())
-    throw Napi::Error::New(env, "callback should be a function");
+  // Offline streams render on the offline device, whatever the parameters say. The
+  // cache is refreshed once if a device isn't in it, it may have appeared since.
+  if (!this->nodeOptions.offline &&
+      ((outputParamsPtr != nullptr &&
+        !deviceExists(this->outputParams.deviceId, this->deviceCache)) ||
+       (inputParamsPtr != nullptr &&
+        !deviceExists(this->inputParams.deviceId, this->deviceCache))))
+    updateDeviceCache(queryDevices());
 
-  this->format = info[2].As<Napi::Number>().Int32Value();
-  this->sampleRate = info[3].As<Napi::Number>().Int32Value();
-  this->bufferFrames = info[4].As<Napi::Number>().Int32Value();
+  if (!this->nodeOptions.offline && outputParamsPtr != nullptr &&
+      !deviceExists(this->outputParams.deviceId, this->deviceCache))
+    throw Napi::TypeError::New(env, "Output device doesn't exist.");
 
-  this->tsCb =
-      Napi::ThreadSafeFunction::New(env, info[6].As<Napi::Function>(), "callback", 1, 1);
+  if (!this->nodeOptions.offline && inputParamsPtr != nullptr &&
+      !deviceExists(this->inputParams.deviceId, this->deviceCache))
+    throw Napi::TypeError::New(env, "Input device doesn't exist.");
 
-  RtAudioCallback callback{[](void *outputBuffer, void *inputBuffer, unsigned int nFrames,
-                              double streamTime, RtAudioStreamStatus status,
-                              void *userData) {
-    NodeRtAudio *that = (NodeRtAudio *)userData;
+  if (this->nodeOptions.offline &&
+      (this->nodeOptions.mode != StreamMode::Callback || this->nodeOptions.deadline > 0))
+    throw Napi::Error::New(
+        env, "options.offline is only supported in callback mode without a deadline");
 
-    that->rtThreadSmph.release();
+  if (this->nodeOptions.offline && this->nodeOptions.offlineSettings.frames == 0 &&
+      (inputParamsPtr == nullptr ||
+       (this->nodeOptions.offlineSettings.inputPath.empty() &&
+        this->nodeOptions.offlineSettings.inputSamples.empty())))
+    throw Napi::Error::New(env, "options.offline needs frames or an input");
 
-    that->tsCb.BlockingCall([nFrames, streamTime, status, that, outputBuffer,
-                             inputBuffer](Napi::Env env, Napi::Function callback) {
-      that->rtThreadSmph.acquire();
-      unsigned int sampleSize = getFormatByteSize(that->format);
-      unsigned int outputByteCount = that->outputParams.nChannels * nFrames * sampleSize;
-      unsigned int inputByteCount = that->inputParams.nChannels * nFrames * sampleSize;
+  if (this->nodeOptions.mode == StreamMode::Buffered &&
+      (this->options.flags & RTAUDIO_NONINTERLEAVED))
+    throw Napi::Error::New(env,
+                           "RTAUDIO_NONINTERLEAVED is not supported in buffered mode");
 
-      Napi::Reference<Napi::Uint8Array> output;
-      Napi::Reference<Napi::Uint8Array> input;
+  if (this->nodeOptions.periodsPerCallback > 1 &&
+      (this->nodeOptions.mode != StreamMode::Callback || this->nodeOptions.deadline > 0))
+    throw Napi::Error::New(
+        env, "periodsPerCallback is only supported in callback mode without a deadline");
 
-      if (outputBuffer != nullptr) {
-        output.Reset(Napi::Uint8Array::New(env, outputByteCount), 1);
-        memset(output.Value().Data(), 0, outputByteCount);
-      }
+  if (this->nodeOptions.clientSampleRate != 0 &&
+      (this->nodeOptions.mode != StreamMode::Callback || this->nodeOptions.deadline > 0 ||
+       this->nodeOptions.periodsPerCallback > 1))
+    throw Napi::Error::New(env, "clientSampleRate is only supported in callback mode "
+                                "without a deadline or periodsPerCallback");
 
-      if (inputBuffer != nullptr) {
-        input.Reset(Napi::Uint8Array::New(env, inputByteCount), 1);
-        memcpy(input.Value().Data(), inputBuffer, inputByteCount);
-      }
+  if (this->nodeOptions.clientSampleRate != 0 &&
+      (!Resampler::supports(info[3].As<Napi::Number>().Uint32Value(),
+                            this->nodeOptions.clientSampleRate) ||
+       !Resampler::supports(this->nodeOptions.clientSampleRate,
+                            info[3].As<Napi::Number>().Uint32Value())))
+    throw Napi::Error::New(
+        env, "The ratio between clientSampleRate and sampleRate is not supported");
 
-      try {
-        auto val = callback.Call({outputBuffer == nullptr ? env.Null() : output.Value(),
-                                  inputBuffer == nullptr ? env.Null() : input.Value(),
-                                  Napi::Number::New(env, nFrames),
-                                  Napi::Number::New(env, streamTime),
-                                  Napi::Number::New(env, status)});
-
-        if (val.IsUndefined()) {
-          that->jsCallbackReturnValue = 0;
-        } else if (val.IsNumber()) {
-          that->jsCallbackReturnValue = val.As<Napi::Number>().Int32Value();
-        } else {
-          throw Napi::TypeError::New(env,
-                                     "return value of the callback should be a number");
-        }
-      } catch (const std::exception &err) {
-        std::cerr << err.what() << std::endl;
+  if ((!this->nodeOptions.inputChannelMap.empty() ||
+       !this->nodeOptions.outputChannelMap.empty()) &&
+      this->nodeOptions.mode != StreamMode::Callback)
+    throw Napi::Error::New(
+        env, "inputChannelMap and outputChannelMap are only supported in callback mode");
 
-        if (outputBuffer != nullptr) {
-          output.Unref();
-        }
+  for (int channel : this->nodeOptions.inputChannelMap) {
+    if (channel >= (int)this->inputParams.nChannels)
+      throw Napi::RangeError::New(
+          env, "options.inputChannelMap should only contain channels of the input.");
+  }
 
-        if (inputBuffer != nullptr) {
-          input.Unref();
-        }
+  std::vector<bool> mappedOutputChannels(this->outputParams.nChannels, false);
 
-        that->jsThreadSmph.release();
-        return;
-      }
+  for (const std::vector<unsigned int> &channels : this->nodeOptions.outputChannelMap) {
+    for (unsigned int channel : channels) {
+      if (channel >= this->outputParams.nChannels)
+        throw Napi::RangeError::New(
+            env, "options.outputChannelMap should only contain channels of the output.");
 
-      if (outputBuffer != nullptr) {
-        memcpy(outputBuffer, output.Value().Data(), outputByteCount);
-      }
+      if (mappedOutputChannels[channel])
+        throw Napi::RangeError::New(env, "options.outputChannelMap should not map two "
+                                         "channels to the same output channel.");
 
-      if (outputBuffer != nullptr) {
-        output.Unref();
-      }
+      mappedOutputChannels[channel] = true;
+    }
+  }
 
-      if (inputBuffer != nullptr) {
-        input.Unref();
-      }
+  if (this->nodeOptions.gate.enabled &&
+      (this->nodeOptions.mode != StreamMode::Callback || info[1].IsNull() ||
+       !info[0].IsNull() || !info[6].IsFunction() || this->nodeOptions.deadline > 0 ||
+       this->nodeOptions.periodsPerCallback > 1 ||
+       this->nodeOptions.clientSampleRate != 0))
+    throw Napi::Error::New(env, "options.gate is only supported on input streams in "
+                                "callback mode with a callback and without a deadline, "
+                                "periodsPerCallback or clientSampleRate");
 
-      that->jsThreadSmph.release();
-    });
+  // The callback is only a notification in buffered mode and runs in the worker in
+  // worker mode. Callback mode streams without one only play native sources, see
+  // `startPlayback`.
+  if (!info[6].IsFunction() && !info[6].IsNull() && !info[6].IsUndefined())
+    throw Napi::Error::New(env, "callback should be a function or null");
 
-    that->jsThreadSmph.acquire();
+  this->format = info[2].As<Napi::Number>().Int32Value();
+  this->jsFormat = this->nodeOptions.jsFormat ? this->nodeOptions.jsFormat : this->format;
+  this->callbackFormat = this->format;
+  this->dither = DitherState();
+  this->sampleRate = info[3].As<Napi::Number>().Int32Value();
+  this->bufferFrames = info[4].As<Napi::Number>().Int32Value();
 
-    return that->jsCallbackReturnValue;
-  }};
+  if (info[6].IsFunction() && this->nodeOptions.mode != StreamMode::Worker) {
+    this->tsCb = Napi::ThreadSafeFunction::New(env, info[6].As<Napi::Function>(),
+                                               "callback", 1, 1);
+  } else {
+    this->tsCb = Napi::ThreadSafeFunction();
+  }
 
-  RtAudio::openStream(outputParamsPtr, inputParamsPtr, this->format, this->sampleRate,
-                      &this->bufferFrames, callback, this, optionsPtr);
+  // Gate events go to `options.gate.callback`, already checked by `parseStreamOptions`.
+  if (this->tsGateCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsGateCb.Release();
+    this->tsGateCb = Napi::ThreadSafeFunction();
+  }
 
-  return Napi::Number::New(env, this->bufferFrames);
-}
+  if (this->nodeOptions.gate.enabled) {
+    Napi::Value gateCallback =
+        info[5].As<Napi::Object>().Get("gate").As<Napi::Object>().Get("callback");
 
-void NodeRtAudio::closeStream(const Napi::CallbackInfo &info) {
-  jsRef.Unref();
-  RtAudio::closeStream();
-}
+    if (gateCallback.IsFunction()) {
+      this->tsGateCb = Napi::ThreadSafeFunction::New(
+          env, gateCallback.As<Napi::Function>(), "gateCallback", 0, 1);
+    }
+  }
 
-void NodeRtAudio::startStream(const Napi::CallbackInfo &info) { RtAudio::startStream(); }
+  if (this->nodeOptions.offline) {
+    Napi::Value offlineCallback =
+        info[5].As<Napi::Object>().Get("offline").As<Napi::Object>().Get("callback");
 
-void NodeRtAudio::stopStream(const Napi::CallbackInfo &info) { RtAudio::stopStream(); }
+    openOfflineApi();
 
-void NodeRtAudio::abortStream(const Napi::CallbackInfo &info) { RtAudio::abortStream(); }
+    if (outputParamsPtr != nullptr)
+      this->outputParams.deviceId = this->offlineApi->getDefaultOutputDevice();
+    if (inputParamsPtr != nullptr)
+      this->inputParams.deviceId = this->offlineApi->getDefaultInputDevice();
 
-Napi::Value NodeRtAudio::getApiDisplayName(const Napi::CallbackInfo &info) {
-  return Napi::String::New(
-      info.Env(), RtAudio::getApiDisplayName(NodeRtAudio::parseApi(info.Env(), info[0])));
-}
+    if (offlineCallback.IsFunction()) {
+      this->tsOfflineCb = Napi::ThreadSafeFunction::New(
+          env, offlineCallback.As<Napi::Function>(), "offlineCallback", 0, 1);
+    }
+  }
 
-Napi::Value NodeRtAudio::getApiName(const Napi::CallbackInfo &info) {
-  return Napi::String::New(
-      info.Env(), RtAudio::getApiName(NodeRtAudio::parseApi(info.Env(), info[0])));
+  this->startup.openRequestTime = StreamStats::now();
+  this->startup.firstCallbackTime = 0;
 }
 
-Napi::Value NodeRtAudio::getVersion(const Napi::CallbackInfo &info) {
-  return Napi::String::New(info.Env(), RtAudio::getVersion());
+RtAudioErrorType NodeRtAudio::openBackend(unsigned int *bufferFrames) {
+  std::lock_guard<std::mutex> lock(this->deviceMutex);
+  int64_t start = StreamStats::now();
+
+  RtAudioErrorType result = RtAudio::openStream(
+      this->outputParams.nChannels > 0 ? &this->outputParams : nullptr,
+      this->inputParams.nChannels > 0 ? &this->inputParams : nullptr, this->format,
+      this->sampleRate, bufferFrames, &NodeRtAudio::streamCallback, this,
+      this->hasStreamOptions ? &this->options : nullptr);
+
+  this->startup.openDuration = StreamStats::now() - start;
+
+  return result;
 }
 
-Napi::Value NodeRtAudio::getCompiledApi(const Napi::CallbackInfo &info) {
-  std::vector<RtAudio::Api> apis;
+// Sets up the state that depends on what the backend settled on, e.g. the period size.
+void NodeRtAudio::finishOpen(Napi::Env env) {
+  if (this->nodeOptions.offline) {
+    std::string error = RtAudio::getErrorText();
+    uint64_t generation = ++this->offlineGeneration;
+    Napi::ThreadSafeFunction tsfn = this->tsOfflineCb;
 
-  RtAudio::getCompiledApi(apis);
+    // The output is only taken on the JS thread, where the stream can't be closed
+    // meanwhile.
+    RtApiOffline::Listener listener = [tsfn, this, generation](
+                                          const OfflineProgress &progress) mutable {
+      if (tsfn.operator napi_threadsafe_function() == nullptr)
+        return;
 
-  auto sampleRates = Napi::Array::New(info.Env(), apis.size());
-  for (unsigned int i = 0; i < apis.size(); i++) {
-    sampleRates[i] = Napi::Number::New(info.Env(), apis[i]);
-  }
+      tsfn.NonBlockingCall([this, generation, progress](Napi::Env env,
+                                                        Napi::Function callback) {
+        if (generation != this->offlineGeneration)
+          return;
 
-  return sampleRates;
-}
+        try {
+          Napi::Object result = createOfflineObject(env, progress);
 
-void NodeRtAudio::NodeRtAudio::parseOutputParams(Napi::Env env, const Napi::Value &val,
-                                                 RtAudio::StreamParameters *params) {
-  if (!val.IsObject()) {
-    throw Napi::TypeError::New(env, "outputParams should be an object or null.");
-  }
+          if (this->nodeOptions.offlineSettings.keepOutput) {
+            std::vector<uint8_t> output = this->offlineApi->takeOutput();
+            Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, output.size());
 
-  Napi::Object obj = val.As<Napi::Object>();
+            memcpy(buffer.Data(), output.data(), output.size());
+            result.Set("output",
+                       createTypedArray(env, this->format, buffer, 0, output.size()));
+          }
 
-  if (!obj.Get("deviceId").IsNumber() ||
-      obj.Get("deviceId").As<Napi::Number>().Int32Value() < 1) {
-    throw Napi::TypeError::New(
-        env, "outputParams.deviceId should be a number greater than 0. If you don't "
-             "intend to use an output stream, set outputParams to null");
-  }
+          callback.Call({result});
+        } catch (const std::exception &err) {
+          std::cerr << err.what() << std::endl;
+        }
+      });
+    };
 
-  params->deviceId = obj.Get("deviceId").As<Napi::Number>().Int32Value();
+    if (!RtAudio::isStreamOpen() ||
+        !this->offlineApi->prepare(this->nodeOptions.offlineSettings, listener, &error)) {
+      if (RtAudio::isStreamOpen())
+        RtAudio::closeStream();
 
-  if (!obj.Get("nChannels").IsNumber() ||
-      obj.Get("nChannels").As<Napi::Number>().Int32Value() < 1) {
-    throw Napi::TypeError::New(
-        env, "outputParams.nChannels should be a number greater than 0. If you don't "
-             "intend to use an output stream, set outputParams to null");
+      abandonOpen();
+
+      throw Napi::Error::New(env, error);
+    }
   }
 
-  params->nChannels = obj.Get("nChannels").As<Napi::Number>().Int32Value();
+  this->stats.reset();
+  this->clock.reset(this->sampleRate);
+  this->startup.restarts = 0;
 
-  if (!obj.Get("firstChannel").IsUndefined()) {
-    if (!obj.Get("firstChannel").IsNumber()) {
-      throw Napi::TypeError::New(env, "outputParams.firstChannel should be a number.");
-    }
+  allocateResamplers();
 
-    params->firstChannel = obj.Get("firstChannel").As<Napi::Number>().Int32Value();
+  this->gate.configure(this->nodeOptions.gate, this->format, this->inputParams.nChannels,
+                       !(this->options.flags & RTAUDIO_NONINTERLEAVED),
+                       this->bufferFrames, this->sampleRate);
+
+  allocateChannelMaps();
+
+  if (this->nodeOptions.mode == StreamMode::Buffered) {
+    allocateRingBuffers();
+  } else {
+    allocateBufferPools(env);
+    allocateDeadlineBuffers();
+    allocateBatchBuffers();
   }
+
+  this->mixer.configure(
+      this->format, this->outputParams.nChannels,
+      !(this->options.flags & RTAUDIO_NONINTERLEAVED), this->bufferFrames,
+      this->outputParams.nChannels > 0 ? this->nodeOptions.maxVoices : 0);
 }
 
-void NodeRtAudio::parseInputParams(Napi::Env env, const Napi::Value &val,
-                                   RtAudio::StreamParameters *params) {
-  if (!val.IsObject()) {
-    throw Napi::TypeError::New(env, "inputParams should be an object or null.");
-  }
+// Undoes `beginOpen` after the backend failed to open the stream.
+void NodeRtAudio::abandonOpen() {
+  jsRef.Unref();
+  closeOfflineApi();
 
-  Napi::Object obj = val.As<Napi::Object>();
+  if (this->tsCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsCb.Release();
+    this->tsCb = Napi::ThreadSafeFunction();
+  }
 
-  if (!obj.Get("deviceId").IsNumber() ||
-      obj.Get("deviceId").As<Napi::Number>().Int32Value() < 1) {
-    throw Napi::TypeError::New(
-        env, "inputParams.deviceId should be a number greater than 0. If you don't "
-             "intend to use an input stream, set outputParams to null");
+  if (this->tsGateCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsGateCb.Release();
+    this->tsGateCb = Napi::ThreadSafeFunction();
   }
+}
 
-  params->deviceId = obj.Get("deviceId").As<Napi::Number>().Int32Value();
+int NodeRtAudio::streamCallback(void *outputBuffer, void *inputBuffer,
+                                unsigned int nFrames, double streamTime,
+                                RtAudioStreamStatus status, void *userData) {
+  NodeRtAudio *that = (NodeRtAudio *)userData;
+  int64_t start = StreamStats::now();
+  uint64_t streamFrame = (uint64_t)std::llround(streamTime * that->sampleRate);
+  int result;
 
-  if (!obj.Get("nChannels").IsNumber() ||
-      obj.Get("nChannels").As<Napi::Number>().Int32Value() < 1) {
-    throw Napi::TypeError::New(
-        env, "inputParams.nChannels should be a number greater than 0. If you don't "
-             "intend to use an input stream, set outputParams to null");
+  that->stats.countCallback(status);
+  that->clock.update(streamFrame, start, nFrames);
+
+  if (that->startup.firstCallbackTime.load(std::memory_order_relaxed) == 0) {
+    that->startup.firstCallbackTime.store(start, std::memory_order_relaxed);
   }
 
-  params->nChannels = obj.Get("nChannels").As<Napi::Number>().Int32Value();
+  if (inputBuffer != nullptr) {
+    that->recorder.push(inputBuffer, nFrames);
+    that->encoder.push(inputBuffer, nFrames);
+  }
 
-  if (!obj.Get("firstChannel").IsUndefined()) {
-    if (!obj.Get("firstChannel").IsNumber()) {
-      throw Napi::TypeError::New(env, "inputParams.firstChannel should be a number.");
+  if (that->nodeOptions.mode == StreamMode::Buffered) {
+    result = that->exchangeRingBuffers(outputBuffer, inputBuffer, nFrames);
+  } else if (that->nodeOptions.mode == StreamMode::Worker) {
+    result = that->exchangeWorkerBuffers(outputBuffer, inputBuffer, nFrames, streamTime,
+                                         status);
+  } else if (that->tsCb.operator napi_threadsafe_function() == nullptr) {
+    result = 0;
+
+    if (outputBuffer != nullptr) {
+      memset(outputBuffer, 0,
+             that->outputParams.nChannels * nFrames * getFormatByteSize(that->format));
     }
-    params->firstChannel = obj.Get("firstChannel").As<Napi::Number>().Int32Value();
+  } else if (that->gate.enabled()) {
+    result = that->invokeJsCallbackGated(outputBuffer, inputBuffer, nFrames, streamTime,
+                                         status);
+  } else if (that->resampling) {
+    result = that->invokeJsCallbackResampled(outputBuffer, inputBuffer, nFrames,
+                                             streamTime, status);
+  } else if (that->nodeOptions.periodsPerCallback > 1) {
+    result = that->invokeJsCallbackBatched(outputBuffer, inputBuffer, nFrames, streamTime,
+                                           status);
+  } else if (that->nodeOptions.deadline > 0) {
+    result = that->invokeJsCallbackWithDeadline(outputBuffer, inputBuffer, nFrames,
+                                                streamTime, status);
+  } else {
+    result =
+        that->invokeJsCallback(outputBuffer, inputBuffer, nFrames, streamTime, status);
   }
-}
 
-void NodeRtAudio::parseStreamOptions(Napi::Env env, const Napi::Value &val,
-                                     RtAudio::StreamOptions *params) {
-  if (!val.IsObject()) {
-    throw Napi::TypeError::New(env, "options should be an object or null.");
+  if (outputBuffer != nullptr) {
+    that->player.render(outputBuffer, nFrames);
+    that->decoder.render(outputBuffer, nFrames);
+    that->mixer.render(outputBuffer, nFrames, streamFrame);
   }
 
-  Napi::Object obj = val.As<Napi::Object>();
+  that->graph.render(outputBuffer, inputBuffer, nFrames);
+  that->analyzer.push(inputBuffer, outputBuffer, nFrames);
 
-  if (!obj.Get("flags").IsUndefined()) {
-    if (!obj.Get("flags").IsNumber()) {
-      throw Napi::TypeError::New(env, "options.flags should be a number.");
-    }
+  that->stats.turnaround.record(StreamStats::now() - start);
 
-    params->flags = obj.Get("flags").As<Napi::Number>().Uint32Value();
+  return result;
+}
+
+int NodeRtAudio::invokeJsCallback(void *outputBuffer, void *inputBuffer,
+                                  unsigned int nFrames, double streamTime,
+                                  RtAudioStreamStatus status) {
+  if (callJs(outputBuffer, inputBuffer, nFrames, streamTime, status, true) != napi_ok) {
+    return 0;
   }
 
-  if (!obj.Get("numberOfBuffers").IsUndefined()) {
-    if (!obj.Get("numberOfBuffers").IsNumber()) {
-      throw Napi::TypeError::New(env, "options.numberOfBuffers should be a number.");
-    }
+  this->jsThreadSmph.acquire();
 
-    params->numberOfBuffers = obj.Get("numberOfBuffers").As<Napi::Number>().Uint32Value();
-  }
+  return this->jsCallbackReturnValue;
+}
 
-  if (!obj.Get("priority").IsUndefined()) {
-    if (!obj.Get("priority").IsNumber()) {
-      throw Napi::TypeError::New(env, "options.priority should be a number.");
+int NodeRtAudio::invokeJsCallbackWithDeadline(void *outputBuffer, void *inputBuffer,
+                                              unsigned int nFrames, double streamTime,
+                                              RtAudioStreamStatus status) {
+  unsigned int sampleSize = getFormatByteSize(this->format);
+  size_t outputByteCount = this->outputParams.nChannels * nFrames * sampleSize;
+  size_t inputByteCount = this->inputParams.nChannels * nFrames * sampleSize;
+  int returnValue = 0;
+
+  // A call that missed an earlier deadline may have finished in the meantime.
+  if (this->jsCallInFlight && this->jsThreadSmph.try_acquire()) {
+    this->jsCallInFlight = false;
+    returnValue = this->jsCallbackReturnValue;
+
+    if (this->nodeOptions.applyLateResults && outputBuffer != nullptr) {
+      memcpy(this->lastOutput.data(), this->stagingOutput.data(),
+             this->lastOutput.size());
+      this->lateOutputReady = true;
     }
+  }
 
-    params->priority = obj.Get("priority").As<Napi::Number>().Int32Value();
+  if (returnValue != 0) {
+    // The late call asked to stop the stream.
+    concealOutput(outputBuffer, nFrames);
+    return returnValue;
   }
 
-  if (!obj.Get("streamName").IsUndefined()) {
-    if (!obj.Get("streamName").IsString()) {
-      throw Napi::TypeError::New(env, "options.streamName should be a number.");
+  // JS works on the staging buffers, so that a call that misses its deadline never
+  // touches device buffers the realtime thread has already given back.
+  if (!this->jsCallInFlight && outputByteCount <= this->stagingOutput.size() &&
+      inputByteCount <= this->stagingInput.size()) {
+    if (inputBuffer != nullptr) {
+      memcpy(this->stagingInput.data(), inputBuffer, inputByteCount);
     }
 
-    params->streamName = obj.Get("streamName").As<Napi::String>().Utf8Value();
-  }
-}
+    if (this->deadlineMissPending) {
+      status |= RTAUDIO_DEADLINE_MISSED;
+    }
 
-RtAudio::Api NodeRtAudio::parseApi(Napi::Env env, const Napi::Value &val) {
-  if (val.IsUndefined()) {
-    return RtAudio::UNSPECIFIED;
-  }
+    if (callJs(outputBuffer == nullptr ? nullptr : this->stagingOutput.data(),
+               inputBuffer == nullptr ? nullptr : this->stagingInput.data(), nFrames,
+               streamTime, status, false) == napi_ok) {
+      this->jsCallInFlight = true;
+      this->deadlineMissPending = false;
 
-  if (!val.IsNumber() || val.As<Napi::Number>().Int32Value() < 0 ||
-      val.As<Napi::Number>().Int32Value() > RtAudio::Api::WINDOWS_DS) {
-    throw Napi::TypeError::New(env, "The api should be a number between 0 and 8.");
-  }
+      std::chrono::duration<double> deadline(this->nodeOptions.deadline * nFrames /
+                                             this->sampleRate);
 
-  return static_cast<RtAudio::Api>(val.As<Napi::Number>().Int32Value());
+      if (this->jsThreadSmph.try_acquire_for(deadline)) {
+        this->jsCallInFlight = false;
+        this->lateOutputReady = false;
+        this->consecutiveMisses = 0;
+
+        if (outputBuffer != nullptr) {
+          memcpy(outputBuffer, this->stagingOutput.data(), outputByteCount);
+          memcpy(this->lastOutput.data(), this->stagingOutput.data(), outputByteCount);
+        }
+
+        return this->jsCallbackReturnValue;
+      }
+    }
+  }
+
+  // Either JS is still busy with an earlier period, or it didn't make it in time.
+  this->stats.deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+  this->deadlineMissPending = true;
+  concealOutput(outputBuffer, nFrames);
+
+  return 0;
+}
+
+int NodeRtAudio::invokeJsCallbackBatched(void *outputBuffer, void *inputBuffer,
+                                         unsigned int nFrames, double streamTime,
+                                         RtAudioStreamStatus status) {
+  unsigned int sampleSize = getFormatByteSize(this->format);
+  unsigned int periods = this->nodeOptions.periodsPerCallback;
+  unsigned int side = this->batchSide;
+  bool interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+
+  if (nFrames != this->bufferFrames) {
+    // Blocks are made of whole periods of the size the stream was opened with.
+    if (outputBuffer != nullptr) {
+      memset(outputBuffer, 0, this->outputParams.nChannels * nFrames * sampleSize);
+    }
+
+    return 0;
+  }
+
+  if (this->batchPeriod == 0) {
+    this->batchStreamTime = streamTime;
+    this->batchStatus = 0;
+  }
+
+  this->batchStatus |= status;
+
+  // Non-interleaved blocks hold one plane of `periods * nFrames` samples per channel,
+  // so each channel of a period goes to its own place in the block.
+  auto copyPeriod = [&](uint8_t *block, uint8_t *period, unsigned int nChannels,
+                        bool toBlock) {
+    unsigned int planes = interleaved ? 1 : nChannels;
+    size_t planeSize = nChannels / planes * nFrames * sampleSize;
+
+    for (unsigned int plane = 0; plane < planes; plane++) {
+      uint8_t *blockPlane = block + (plane * periods + this->batchPeriod) * planeSize;
+      uint8_t *periodPlane = period + plane * planeSize;
+
+      if (toBlock) {
+        memcpy(blockPlane, periodPlane, planeSize);
+      } else {
+        memcpy(periodPlane, blockPlane, planeSize);
+      }
+    }
+  };
+
+  if (inputBuffer != nullptr) {
+    copyPeriod(this->batchInput[side].data(), (uint8_t *)inputBuffer,
+               this->inputParams.nChannels, true);
+  }
+
+  if (outputBuffer != nullptr) {
+    copyPeriod(this->batchOutput[side].data(), (uint8_t *)outputBuffer,
+               this->outputParams.nChannels, false);
+  }
+
+  if (++this->batchPeriod < periods) {
+    return 0;
+  }
+
+  this->batchPeriod = 0;
+
+  // The block JS got at the end of the previous block plays next, JS has had a whole
+  // block worth of time for it, so this normally doesn't wait.
+  if (this->batchCallInFlight) {
+    this->jsThreadSmph.acquire();
+    this->batchCallInFlight = false;
+
+    if (this->jsCallbackReturnValue != 0) {
+      return this->jsCallbackReturnValue;
+    }
+  }
+
+  this->batchSide = side ^ 1;
+
+  if (callJs(outputBuffer == nullptr ? nullptr : this->batchOutput[side].data(),
+             inputBuffer == nullptr ? nullptr : this->batchInput[side].data(),
+             nFrames * periods, this->batchStreamTime, this->batchStatus,
+             true) == napi_ok) {
+    this->batchCallInFlight = true;
+  }
+
+  return 0;
+}
+
+void NodeRtAudio::allocateBatchBuffers() {
+  unsigned int sampleSize = getFormatByteSize(this->format);
+  size_t blockFrames = (size_t)this->bufferFrames * this->nodeOptions.periodsPerCallback;
+
+  this->batchSide = 0;
+  this->batchPeriod = 0;
+  this->batchCallInFlight = false;
+
+  for (int i = 0; i < 2; i++) {
+    if (this->nodeOptions.periodsPerCallback > 1) {
+      this->batchOutput[i].assign(blockFrames * this->outputParams.nChannels * sampleSize,
+                                  0);
+      this->batchInput[i].assign(blockFrames * this->inputParams.nChannels * sampleSize,
+                                 0);
+    } else {
+      this->batchOutput[i].clear();
+      this->batchInput[i].clear();
+    }
+  }
+}
+
+int NodeRtAudio::invokeJsCallbackResampled(void *outputBuffer, void *inputBuffer,
+                                           unsigned int nFrames, double streamTime,
+                                           RtAudioStreamStatus status) {
+  bool interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  unsigned int outputChannels = this->outputParams.nChannels;
+  unsigned int inputChannels = this->inputParams.nChannels;
+
+  if (nFrames > this->bufferFrames) {
+    // The scratch buffers are sized for the period the stream was opened with.
+    if (outputBuffer != nullptr) {
+      memset(outputBuffer, 0, outputChannels * nFrames * getFormatByteSize(this->format));
+    }
+
+    return 0;
+  }
+
+  // Client periods alternate between the two nearest frame counts, so that they add up
+  // to exactly the client rate.
+  unsigned long long clientFrames = (unsigned long long)nFrames *
+                                        this->nodeOptions.clientSampleRate +
+                                    this->clientFrameRemainder;
+  this->clientFrameRemainder = clientFrames % this->sampleRate;
+  clientFrames /= this->sampleRate;
+
+  if (inputBuffer != nullptr) {
+    samplesToFloat(inputBuffer, this->format, this->resampleScratch.data(),
+                   inputChannels * nFrames);
+    this->inputResampler.push(this->resampleScratch.data(), nFrames, interleaved);
+    this->inputResampler.pull(this->clientInput.data(), clientFrames, interleaved);
+  }
+
+  int returnValue = 0;
+
+  if (outputBuffer != nullptr) {
+    std::fill_n(this->clientOutput.begin(), outputChannels * clientFrames, 0.0f);
+  }
+
+  if (callJs(outputBuffer == nullptr ? nullptr : this->clientOutput.data(),
+             inputBuffer == nullptr ? nullptr : this->clientInput.data(), clientFrames,
+             streamTime, status, true) == napi_ok) {
+    this->jsThreadSmph.acquire();
+    returnValue = this->jsCallbackReturnValue;
+  }
+
+  // Silence still goes through the resampler if the call failed, to keep the output
+  // side in step with the input side.
+  if (outputBuffer != nullptr) {
+    this->outputResampler.push(this->clientOutput.data(), clientFrames, interleaved);
+    this->outputResampler.pull(this->resampleScratch.data(), nFrames, interleaved);
+    floatToSamples(this->resampleScratch.data(), outputBuffer, this->format,
+                   outputChannels * nFrames);
+  }
+
+  return returnValue;
+}
+
+int NodeRtAudio::invokeJsCallbackGated(void *outputBuffer, void *inputBuffer,
+                                       unsigned int nFrames, double streamTime,
+                                       RtAudioStreamStatus status) {
+  GateDecision decision = this->gate.process(inputBuffer, nFrames);
+
+  if ((decision == GateDecision::Open || decision == GateDecision::Close) &&
+      this->tsGateCb.operator napi_threadsafe_function() != nullptr) {
+    bool open = decision == GateDecision::Open;
+    double level = this->gate.level();
+
+    this->tsGateCb.NonBlockingCall(
+        [open, streamTime, level](Napi::Env env, Napi::Function callback) {
+          try {
+            callback.Call({Napi::String::New(env, open ? "open" : "close"),
+                           Napi::Number::New(env, streamTime),
+                           Napi::Number::New(env, level)});
+          } catch (const std::exception &err) {
+            std::cerr << err.what() << std::endl;
+          }
+        });
+  }
+
+  switch (decision) {
+  case GateDecision::Suppress:
+  case GateDecision::Close:
+    return 0;
+  case GateDecision::Open: {
+    // The pre-roll comes first, so the call starts that much earlier in stream time.
+    unsigned int frames = this->gate.openingFrames();
+
+    return invokeJsCallback(outputBuffer, this->gate.openingBuffer(), frames,
+                            streamTime - (double)(frames - nFrames) / this->sampleRate,
+                            status);
+  }
+  case GateDecision::Deliver:
+    break;
+  }
+
+  return invokeJsCallback(outputBuffer, inputBuffer, nFrames, streamTime, status);
+}
+
+void NodeRtAudio::allocateResamplers() {
+  unsigned int clientRate = this->nodeOptions.clientSampleRate;
+
+  this->callbackFormat = this->format;
+  this->resampling = false;
+  this->clientFrameRemainder = 0;
+
+  if (clientRate == 0 || clientRate == this->sampleRate) {
+    this->resampleScratch.clear();
+    this->clientOutput.clear();
+    this->clientInput.clear();
+    return;
+  }
+
+  unsigned int clientFrames = getCallbackFrames();
+  unsigned int outputChannels = this->outputParams.nChannels;
+  unsigned int inputChannels = this->inputParams.nChannels;
+  ResamplerQuality quality = this->nodeOptions.resamplerQuality;
+
+  // The client side gets the floor of the exact frame count while the input side
+  // produces the ceiling, so input never runs short. The output side can fall behind by
+  // up to one device frame per client frame, which the prefill covers.
+  unsigned int outputPrefill = (this->sampleRate + clientRate - 1) / clientRate;
+
+  // The ratio was checked before the stream was opened.
+  if (inputChannels > 0) {
+    this->inputResampler.configure(this->sampleRate, clientRate, inputChannels, quality,
+                                   this->bufferFrames, 0);
+  }
+
+  if (outputChannels > 0) {
+    this->outputResampler.configure(clientRate, this->sampleRate, outputChannels, quality,
+                                    clientFrames, outputPrefill);
+  }
+
+  this->resampleScratch.assign(
+      (size_t)this->bufferFrames * std::max(outputChannels, inputChannels), 0);
+  this->clientOutput.assign((size_t)clientFrames * outputChannels, 0);
+  this->clientInput.assign((size_t)clientFrames * inputChannels, 0);
+  this->callbackFormat = RTAUDIO_FLOAT32;
+  this->resampling = true;
+}
+
+void NodeRtAudio::allocateChannelMaps() {
+  size_t sampleSize = sampleByteSize(this->callbackFormat);
+  bool interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  size_t frames = std::max(getCallbackFrames(), this->gate.maxOpeningFrames());
+  const std::vector<std::vector<unsigned int>> &outputChannels =
+      this->nodeOptions.outputChannelMap;
+
+  this->inputMap.clear();
+  this->outputMap.clear();
+  this->jsInputChannels = this->inputParams.nChannels;
+  this->jsOutputChannels = this->outputParams.nChannels;
+
+  if (!this->nodeOptions.inputChannelMap.empty()) {
+    this->inputMap.configure(this->nodeOptions.inputChannelMap,
+                             this->inputParams.nChannels, sampleSize, interleaved);
+    this->jsInputChannels = this->inputMap.channels();
+  }
+
+  if (!outputChannels.empty()) {
+    // JS output channels are gathered into the output channels they are mapped to, the
+    // others are silent.
+    std::vector<int> sources(this->outputParams.nChannels, -1);
+
+    for (size_t i = 0; i < outputChannels.size(); i++) {
+      for (unsigned int channel : outputChannels[i]) {
+        sources[channel] = (int)i;
+      }
+    }
+
+    this->outputMap.configure(sources, (unsigned int)outputChannels.size(), sampleSize,
+                              interleaved);
+    this->jsOutputChannels = (unsigned int)outputChannels.size();
+  }
+
+  bool converting = this->callbackFormat != this->jsFormat;
+
+  this->mappedInput.assign(this->inputMap.isActive() && converting
+                               ? frames * this->jsInputChannels * sampleSize
+                               : 0,
+                           0);
+  this->mappedOutput.assign(this->outputMap.isActive() && converting
+                                ? frames * this->jsOutputChannels * sampleSize
+                                : 0,
+                            0);
+}
+
+void NodeRtAudio::copyInputToJs(const void *inputBuffer, void *to, unsigned int nFrames,
+                                DitherState *dither) {
+  size_t samples = (size_t)this->jsInputChannels * nFrames;
+
+  if (!this->inputMap.isActive()) {
+    ::convertSamples(inputBuffer, this->callbackFormat, to, this->jsFormat, samples,
+                     dither);
+    return;
+  }
+
+  // Only the mapped channels are copied, straight into the JS buffer if the formats
+  // match.
+  if (this->callbackFormat == this->jsFormat) {
+    this->inputMap.apply(inputBuffer, to, nFrames);
+    return;
+  }
+
+  if (samples * sampleByteSize(this->callbackFormat) > this->mappedInput.size()) {
+    memset(to, 0, samples * sampleByteSize(this->jsFormat));
+    return;
+  }
+
+  this->inputMap.apply(inputBuffer, this->mappedInput.data(), nFrames);
+  ::convertSamples(this->mappedInput.data(), this->callbackFormat, to, this->jsFormat,
+                   samples, dither);
+}
+
+void NodeRtAudio::copyOutputFromJs(const void *from, void *outputBuffer,
+                                   unsigned int nFrames, DitherState *dither) {
+  size_t samples = (size_t)this->jsOutputChannels * nFrames;
+  const void *source = from;
+
+  if (!this->outputMap.isActive()) {
+    ::convertSamples(from, this->jsFormat, outputBuffer, this->callbackFormat, samples,
+                     dither);
+    return;
+  }
+
+  if (this->callbackFormat != this->jsFormat) {
+    if (samples * sampleByteSize(this->callbackFormat) > this->mappedOutput.size()) {
+      memset(outputBuffer, 0,
+             (size_t)this->outputParams.nChannels * nFrames *
+                 sampleByteSize(this->callbackFormat));
+      return;
+    }
+
+    ::convertSamples(from, this->jsFormat, this->mappedOutput.data(),
+                     this->callbackFormat, samples, dither);
+    source = this->mappedOutput.data();
+  }
+
+  this->outputMap.apply(source, outputBuffer, nFrames);
+}
+
+unsigned int NodeRtAudio::getCallbackFrames() const {
+  unsigned int clientRate = this->nodeOptions.clientSampleRate;
+
+  if (clientRate != 0 && clientRate != this->sampleRate) {
+    return (unsigned int)(((unsigned long long)this->bufferFrames * clientRate +
+                           this->sampleRate - 1) /
+                          this->sampleRate);
+  }
+
+  return this->bufferFrames * this->nodeOptions.periodsPerCallback;
+}
+
+void NodeRtAudio::concealOutput(void *outputBuffer, unsigned int nFrames) {
+  if (outputBuffer == nullptr) {
+    return;
+  }
+
+  size_t byteCount = std::min<size_t>(this->outputParams.nChannels * nFrames *
+                                          getFormatByteSize(this->format),
+                                      this->lastOutput.size());
+  bool interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+
+  memset(outputBuffer, 0, this->outputParams.nChannels * nFrames *
+                              getFormatByteSize(this->format));
+
+  if (this->lateOutputReady) {
+    // The result of the call that missed the previous deadline, one period late.
+    memcpy(outputBuffer, this->lastOutput.data(), byteCount);
+    this->lateOutputReady = false;
+    return;
+  }
+
+  this->consecutiveMisses++;
+
+  switch (this->nodeOptions.concealment) {
+  case Concealment::Repeat:
+    memcpy(outputBuffer, this->lastOutput.data(), byteCount);
+    break;
+  case Concealment::FadeOut:
+    if (this->consecutiveMisses == 1) {
+      memcpy(outputBuffer, this->lastOutput.data(), byteCount);
+      applyGainRamp(outputBuffer, this->format, nFrames, this->outputParams.nChannels,
+                    interleaved, 1, 0);
+    }
+    break;
+  case Concealment::Silence:
+    break;
+  }
+}
+
+void NodeRtAudio::allocateDeadlineBuffers() {
+  unsigned int sampleSize = getFormatByteSize(this->format);
+
+  this->jsCallInFlight = false;
+  this->lateOutputReady = false;
+  this->deadlineMissPending = false;
+  this->consecutiveMisses = 0;
+
+  if (this->nodeOptions.deadline <= 0) {
+    this->stagingOutput.clear();
+    this->stagingInput.clear();
+    this->lastOutput.clear();
+    return;
+  }
+
+  this->stagingOutput.assign(
+      this->bufferFrames * this->outputParams.nChannels * sampleSize, 0);
+  this->stagingInput.assign(this->bufferFrames * this->inputParams.nChannels * sampleSize,
+                            0);
+  this->lastOutput.assign(this->stagingOutput.size(), 0);
+}
+
+napi_status NodeRtAudio::callJs(void *outputBuffer, void *inputBuffer,
+                                unsigned int nFrames, double streamTime,
+                                RtAudioStreamStatus status, bool blocking) {
+  NodeRtAudio *that = this;
+
+  auto call = [nFrames, streamTime, status, that, outputBuffer,
+               inputBuffer](Napi::Env env, Napi::Function callback) {
+    that->rtThreadSmph.acquire();
+    that->stats.dispatchLatency.record(StreamStats::now() - that->dispatchTime.load());
+    // The buffers handed in are in `callbackFormat`, JS gets `jsFormat`.
+    unsigned int sampleSize = getFormatByteSize(that->jsFormat);
+    unsigned int outputSamples = that->jsOutputChannels * nFrames;
+    unsigned int inputSamples = that->jsInputChannels * nFrames;
+    unsigned int outputByteCount = outputSamples * sampleSize;
+    unsigned int inputByteCount = inputSamples * sampleSize;
+    DitherState *dither = that->nodeOptions.dither ? &that->dither : nullptr;
+
+    Napi::Value output = env.Null();
+    Napi::Value input = env.Null();
+    uint8_t *outputData = nullptr;
+
+    // Pooled buffers are reused round-robin when `bufferPoolSize` is set. Shorter
+    // periods, like the alternating ones of a resampled stream, get views sized to the
+    // period over a pooled buffer. Fresh buffers are only allocated per period without
+    // a pool or for periods longer than its buffers.
+    if (outputBuffer != nullptr) {
+      size_t slotSize = that->outputPool.slotSize();
+
+      if (slotSize == outputByteCount) {
+        const BufferPool::Slot &slot = that->outputPool.next();
+        output = slot.view.Value();
+        outputData = slot.data;
+      } else if (slotSize > outputByteCount) {
+        const BufferPool::Slot &slot = that->outputPool.next();
+        output = that->createBufferView(slot.buffer.Value(), that->jsOutputChannels,
+                                        outputByteCount);
+        outputData = slot.data;
+      } else {
+        Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, outputByteCount);
+        output = that->createBufferView(buffer, that->jsOutputChannels);
+        outputData = (uint8_t *)buffer.Data();
+      }
+
+      memset(outputData, 0, outputByteCount);
+    }
+
+    if (inputBuffer != nullptr) {
+      size_t slotSize = that->inputPool.slotSize();
+
+      if (slotSize == inputByteCount) {
+        const BufferPool::Slot &slot = that->inputPool.next();
+        input = slot.view.Value();
+        that->copyInputToJs(inputBuffer, slot.data, nFrames, dither);
+      } else if (slotSize > inputByteCount) {
+        const BufferPool::Slot &slot = that->inputPool.next();
+        input = that->createBufferView(slot.buffer.Value(), that->jsInputChannels,
+                                       inputByteCount);
+        that->copyInputToJs(inputBuffer, slot.data, nFrames, dither);
+      } else {
+        Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, inputByteCount);
+        input = that->createBufferView(buffer, that->jsInputChannels);
+        that->copyInputToJs(inputBuffer, buffer.Data(), nFrames, dither);
+      }
+    }
+
+    int64_t callStart = StreamStats::now();
+
+    try {
+      auto val = callback.Call({output, input, Napi::Number::New(env, nFrames),
+                                Napi::Number::New(env, streamTime),
+                                Napi::Number::New(env, status)});
+
+      that->stats.jsExecution.record(StreamStats::now() - callStart);
+
+      if (val.IsUndefined()) {
+        that->jsCallbackReturnValue = 0;
+      } else if (val.IsNumber()) {
+        that->jsCallbackReturnValue = val.As<Napi::Number>().Int32Value();
+      } else {
+        throw Napi::TypeError::New(env,
+                                   "return value of the callback should be a number");
+      }
+    } catch (const std::exception &err) {
+      std::cerr << err.what() << std::endl;
+      that->jsThreadSmph.release();
+      return;
+    }
+
+    if (outputBuffer != nullptr) {
+      that->copyOutputFromJs(outputData, outputBuffer, nFrames, dither);
+    }
+
+    that->jsThreadSmph.release();
+  };
+
+  this->dispatchTime.store(StreamStats::now());
+  this->rtThreadSmph.release();
+
+  napi_status result =
+      blocking ? this->tsCb.BlockingCall(call) : this->tsCb.NonBlockingCall(call);
+
+  if (result != napi_ok) {
+    this->rtThreadSmph.try_acquire();
+  }
+
+  return result;
+}
+
+int NodeRtAudio::exchangeRingBuffers(void *outputBuffer, void *inputBuffer,
+                                     unsigned int nFrames) {
+  // Runs on the realtime thread and never waits for JS. The rings take no locks, only
+  // the watermark notification goes through the thread-safe function, which allocates
+  // the call and briefly takes its queue mutex. `watermarkPending` keeps that to one call
+  // until JS ran it.
+  unsigned int sampleSize = getFormatByteSize(this->format);
+  // Output JS should top up, and input JS should read.
+  bool outputLow = false;
+  bool inputReady = false;
+
+  if (outputBuffer != nullptr) {
+    size_t byteCount = this->outputParams.nChannels * nFrames * sampleSize;
+    size_t readCount = this->outputRing.read(outputBuffer, byteCount);
+
+    if (readCount < byteCount) {
+      this->stats.ringUnderruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Play silence for whatever JS didn't provide in time.
+    memset((uint8_t *)outputBuffer + readCount, 0, byteCount - readCount);
+
+    size_t watermarkBytes = this->nodeOptions.watermarkFrames *
+                            this->outputParams.nChannels * sampleSize;
+    outputLow = this->outputRing.readAvailable() <= watermarkBytes;
+  }
+
+  if (inputBuffer != nullptr) {
+    size_t byteCount = this->inputParams.nChannels * nFrames * sampleSize;
+
+    // If JS doesn't keep up, the newest period is dropped as a whole, so JS never reads
+    // part of a period followed by the next one.
+    if (this->inputRing.writeAvailable() >= byteCount) {
+      this->inputRing.write(inputBuffer, byteCount);
+    } else {
+      this->stats.ringOverruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t watermarkBytes =
+        this->nodeOptions.watermarkFrames * this->inputParams.nChannels * sampleSize;
+    inputReady = this->inputRing.readAvailable() >= watermarkBytes;
+  }
+
+  if ((outputLow || inputReady) &&
+      this->tsCb.operator napi_threadsafe_function() != nullptr &&
+      !this->watermarkPending.exchange(true)) {
+    NodeRtAudio *that = this;
+
+    napi_status status =
+        this->tsCb.NonBlockingCall([that](Napi::Env env, Napi::Function callback) {
+          that->watermarkPending.store(false);
+
+          try {
+            callback.Call({});
+          } catch (const std::exception &err) {
+            std::cerr << err.what() << std::endl;
+          }
+        });
+
+    if (status != napi_ok) {
+      this->watermarkPending.store(false);
+    }
+  }
+
+  return 0;
+}
+
+int NodeRtAudio::exchangeWorkerBuffers(void *outputBuffer, void *inputBuffer,
+                                       unsigned int nFrames, double streamTime,
+                                       RtAudioStreamStatus status) {
+  // Loaded by the JS thread before the stream is started, never changed while it runs.
+  WorkerChannel *channel = this->workerChannel.get();
+  size_t outputSamples = this->outputParams.nChannels * nFrames;
+  size_t inputSamples = this->inputParams.nChannels * nFrames;
+  // The shared blocks are in `jsFormat`, the device buffers in the stream format.
+  unsigned int sampleSize = getFormatByteSize(this->jsFormat);
+  size_t outputByteCount = outputSamples * sampleSize;
+  size_t inputByteCount = inputSamples * sampleSize;
+  DitherState *dither = this->nodeOptions.dither ? &this->dither : nullptr;
+
+  if (outputBuffer != nullptr) {
+    memset(outputBuffer, 0, outputSamples * getFormatByteSize(this->format));
+  }
+
+  if (channel == nullptr || outputByteCount > channel->outputSize ||
+      inputByteCount > channel->inputSize) {
+    return 0;
+  }
+
+  if (inputBuffer != nullptr) {
+    ::convertSamples(inputBuffer, this->format, channel->input, this->jsFormat,
+                     inputSamples, dither);
+  }
+
+  if (outputBuffer != nullptr) {
+    memset(channel->output, 0, outputByteCount);
+  }
+
+  channel->control[WorkerChannel::NFrames] = nFrames;
+  channel->control[WorkerChannel::StreamTime] = streamTime;
+  channel->control[WorkerChannel::Status] = status;
+
+  if (!channel->runPeriod()) {
+    return 0;
+  }
+
+  if (outputBuffer != nullptr) {
+    ::convertSamples(channel->output, this->jsFormat, outputBuffer, this->format,
+                     outputSamples, dither);
+  }
+
+  return channel->returnValue;
+}
+
+void NodeRtAudio::closeWorkerChannel() {
+  if (this->workerChannel != nullptr) {
+    this->workerChannel->close();
+    WorkerChannel::remove(this->workerChannel.get());
+  }
+}
+
+void NodeRtAudio::allocateRingBuffers() {
+  unsigned int sampleSize = getFormatByteSize(this->format);
+
+  if (this->nodeOptions.ringBufferFrames == 0) {
+    this->nodeOptions.ringBufferFrames = this->bufferFrames * 4;
+  }
+
+  if (this->nodeOptions.watermarkFrames == 0) {
+    this->nodeOptions.watermarkFrames = this->nodeOptions.ringBufferFrames / 2;
+  }
+
+  this->outputRing.allocate(this->nodeOptions.ringBufferFrames *
+                            this->outputParams.nChannels * sampleSize);
+  this->inputRing.allocate(this->nodeOptions.ringBufferFrames *
+                           this->inputParams.nChannels * sampleSize);
+  this->watermarkPending.store(false);
+}
+
+void NodeRtAudio::allocateBufferPools(Napi::Env env) {
+  unsigned int sampleSize = getFormatByteSize(this->jsFormat);
+  unsigned int poolSize = this->nodeOptions.bufferPoolSize;
+  unsigned int callbackFrames = getCallbackFrames();
+
+  this->outputPool.release();
+  this->inputPool.release();
+
+  // Typed views are only worth it if they are built once, so they always come pooled.
+  if (poolSize == 0 && this->nodeOptions.typedBuffers) {
+    poolSize = 2;
+  }
+
+  if (poolSize == 0) {
+    return;
+  }
+
+  if (this->jsOutputChannels > 0) {
+    this->outputPool.allocate(env, poolSize,
+                              callbackFrames * this->jsOutputChannels * sampleSize,
+                              [this](Napi::ArrayBuffer buffer) {
+                                return createBufferView(buffer, this->jsOutputChannels);
+                              });
+  }
+
+  if (this->jsInputChannels > 0) {
+    this->inputPool.allocate(env, poolSize,
+                             callbackFrames * this->jsInputChannels * sampleSize,
+                             [this](Napi::ArrayBuffer buffer) {
+                               return createBufferView(buffer, this->jsInputChannels);
+                             });
+  }
+}
+
+Napi::Object NodeRtAudio::createBufferView(Napi::ArrayBuffer buffer,
+                                           unsigned int nChannels, size_t byteCount) {
+  Napi::Env env = buffer.Env();
+
+  // 0 views the whole buffer.
+  if (byteCount == 0) {
+    byteCount = buffer.ByteLength();
+  }
+
+  if (!this->nodeOptions.typedBuffers) {
+    return Napi::Uint8Array::New(env, byteCount, buffer, 0);
+  }
+
+  if (!(this->options.flags & RTAUDIO_NONINTERLEAVED)) {
+    return createTypedArray(env, this->jsFormat, buffer, 0, byteCount);
+  }
+
+  // Non-interleaved buffers hold each channel's samples back-to-back, so they are
+  // delivered as one view per channel.
+  size_t channelByteCount = byteCount / nChannels;
+  Napi::Array channels = Napi::Array::New(env, nChannels);
+
+  for (unsigned int i = 0; i < nChannels; i++) {
+    channels[i] = createTypedArray(env, this->jsFormat, buffer, i * channelByteCount,
+                                   channelByteCount);
+  }
+
+  return channels;
+}
+
+Napi::TypedArray NodeRtAudio::createTypedArray(Napi::Env env, RtAudioFormat format,
+                                               Napi::ArrayBuffer buffer,
+                                               size_t byteOffset, size_t byteCount) {
+  size_t length = byteCount / getFormatByteSize(format);
+
+  switch (format) {
+  case RTAUDIO_SINT8:
+    return Napi::Int8Array::New(env, length, buffer, byteOffset);
+  case RTAUDIO_SINT16:
+    return Napi::Int16Array::New(env, length, buffer, byteOffset);
+  case RTAUDIO_SINT32:
+    return Napi::Int32Array::New(env, length, buffer, byteOffset);
+  case RTAUDIO_FLOAT32:
+    return Napi::Float32Array::New(env, length, buffer, byteOffset);
+  case RTAUDIO_FLOAT64:
+    return Napi::Float64Array::New(env, length, buffer, byteOffset);
+  default:
+    // There is no 24-bit typed array, packed samples are delivered as bytes.
+    return Napi::Uint8Array::New(env, byteCount, buffer, byteOffset);
+  }
+}
+
+void NodeRtAudio::setWorkerBuffers(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  checkStreamOperation(env);
+
+  if (this->nodeOptions.mode != StreamMode::Worker || !RtAudio::isStreamOpen())
+    throw Napi::Error::New(env,
+                           "setWorkerBuffers is only available on an open worker stream");
+
+  if (RtAudio::isStreamRunning())
+    throw Napi::Error::New(env, "setWorkerBuffers can't be called on a running stream");
+
+  if (!info[0].IsTypedArray())
+    throw Napi::TypeError::New(env, "control should be a Float64Array.");
+
+  if (!info[1].IsNull() && !info[1].IsTypedArray())
+    throw Napi::TypeError::New(env, "output should be a TypedArray or null.");
+
+  if (!info[2].IsNull() && !info[2].IsTypedArray())
+    throw Napi::TypeError::New(env, "input should be a TypedArray or null.");
+
+  size_t controlSize = 0;
+  size_t outputSize = 0;
+  size_t inputSize = 0;
+  double *control = (double *)getTypedArrayData(env, info[0], &controlSize);
+  uint8_t *output =
+      info[1].IsNull() ? nullptr : getTypedArrayData(env, info[1], &outputSize);
+  uint8_t *input =
+      info[2].IsNull() ? nullptr : getTypedArrayData(env, info[2], &inputSize);
+
+  if (controlSize < WorkerChannel::ControlSlotCount * sizeof(double))
+    throw Napi::RangeError::New(env, "control is too small.");
+
+  closeWorkerChannel();
+
+  this->workerChannel =
+      std::make_shared<WorkerChannel>(control, output, outputSize, input, inputSize);
+  WorkerChannel::add(this->workerChannel);
+
+  // Keep the shared memory alive for as long as the realtime thread may touch it.
+  Napi::Array buffers = Napi::Array::New(env, 3);
+  buffers[0u] = info[0];
+  buffers[1u] = info[1];
+  buffers[2u] = info[2];
+  this->workerBuffersRef = Napi::Persistent(buffers.As<Napi::Object>());
+}
+
+Napi::Value NodeRtAudio::write(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (this->nodeOptions.mode != StreamMode::Buffered || !RtAudio::isStreamOpen())
+    throw Napi::Error::New(env, "write is only available on an open buffered stream");
+
+  if (this->outputParams.nChannels == 0)
+    throw Napi::Error::New(env, "Stream has no output");
+
+  if (!info[0].IsTypedArray())
+    throw Napi::TypeError::New(env, "data should be a TypedArray");
+
+  size_t byteCount = 0;
+  uint8_t *bytes = getTypedArrayData(env, info[0], &byteCount);
+  size_t frameSize = this->outputParams.nChannels * getFormatByteSize(this->format);
+  size_t jsFrameSize = this->outputParams.nChannels * getFormatByteSize(this->jsFormat);
+
+  if (this->jsFormat == this->format) {
+    byteCount = byteCount / frameSize * frameSize;
+    return Napi::Number::New(env, this->outputRing.write(bytes, byteCount) / frameSize);
+  }
+
+  // Only convert what fits, this is the only writer so the space can only grow.
+  size_t frames =
+      std::min(byteCount / jsFrameSize, this->outputRing.writeAvailable() / frameSize);
+  DitherState *dither = this->nodeOptions.dither ? &this->dither : nullptr;
+
+  this->conversionBuffer.resize(frames * frameSize);
+  ::convertSamples(bytes, this->jsFormat, this->conversionBuffer.data(), this->format,
+                   frames * this->outputParams.nChannels, dither);
+
+  return Napi::Number::New(
+      env, this->outputRing.write(this->conversionBuffer.data(), frames * frameSize) /
+               frameSize);
+}
+
+Napi::Value NodeRtAudio::read(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (this->nodeOptions.mode != StreamMode::Buffered || !RtAudio::isStreamOpen())
+    throw Napi::Error::New(env, "read is only available on an open buffered stream");
+
+  if (this->inputParams.nChannels == 0)
+    throw Napi::Error::New(env, "Stream has no input");
+
+  if (!info[0].IsTypedArray())
+    throw Napi::TypeError::New(env, "data should be a TypedArray");
+
+  size_t byteCount = 0;
+  uint8_t *bytes = getTypedArrayData(env, info[0], &byteCount);
+  size_t frameSize = this->inputParams.nChannels * getFormatByteSize(this->format);
+  size_t jsFrameSize = this->inputParams.nChannels * getFormatByteSize(this->jsFormat);
+
+  if (this->jsFormat == this->format) {
+    byteCount = byteCount / frameSize * frameSize;
+    return Napi::Number::New(env, this->inputRing.read(bytes, byteCount) / frameSize);
+  }
+
+  size_t frames =
+      std::min(byteCount / jsFrameSize, this->inputRing.readAvailable() / frameSize);
+
+  this->conversionBuffer.resize(frames * frameSize);
+  frames = this->inputRing.read(this->conversionBuffer.data(), frames * frameSize) /
+           frameSize;
+  ::convertSamples(this->conversionBuffer.data(), this->format, bytes, this->jsFormat,
+                   frames * this->inputParams.nChannels,
+                   this->nodeOptions.dither ? &this->dither : nullptr);
+
+  return Napi::Number::New(env, frames);
+}
+
+Napi::Value NodeRtAudio::getDeadlineMisses(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), this->stats.deadlineMisses.load());
+}
+
+Napi::Value NodeRtAudio::getStreamStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!info[0].IsUndefined()) {
+    // Compact form, fills a preallocated Float64Array so that polling doesn't allocate.
+    if (!info[0].IsTypedArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float64_array)
+      throw Napi::TypeError::New(env, "snapshot should be a Float64Array.");
+
+    if (info[0].As<Napi::TypedArray>().ElementLength() < StreamStats::SnapshotLength)
+      throw Napi::RangeError::New(env, "snapshot should have at least " +
+                                           std::to_string(StreamStats::SnapshotLength) +
+                                           " elements.");
+
+    size_t byteLength = 0;
+    this->stats.snapshot((double *)getTypedArrayData(env, info[0], &byteLength));
+
+    return info[0];
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+
+  result.Set("callbacks", (double)this->stats.callbacks.load());
+  result.Set("inputOverflows", (double)this->stats.inputOverflows.load());
+  result.Set("outputUnderflows", (double)this->stats.outputUnderflows.load());
+  result.Set("deadlineMisses", (double)this->stats.deadlineMisses.load());
+  result.Set("ringUnderruns", (double)this->stats.ringUnderruns.load());
+  result.Set("ringOverruns", (double)this->stats.ringOverruns.load());
+  result.Set("dispatchLatency", createHistogramObject(env, this->stats.dispatchLatency));
+  result.Set("jsExecution", createHistogramObject(env, this->stats.jsExecution));
+  result.Set("turnaround", createHistogramObject(env, this->stats.turnaround));
+
+  return result;
+}
+
+void NodeRtAudio::resetStreamStats(const Napi::CallbackInfo &info) {
+  this->stats.reset();
+  this->mixer.resetStats();
+  this->gate.resetStats();
+}
+
+Napi::Value NodeRtAudio::getGateStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::Object result = Napi::Object::New(env);
+
+  result.Set("open", this->gate.isOpen());
+  result.Set("opens", (double)this->gate.opens());
+  result.Set("closes", (double)this->gate.closes());
+  result.Set("suppressedPeriods", (double)this->gate.suppressedPeriods());
+  result.Set("suppressedFrames", (double)this->gate.suppressedFrames());
+  result.Set("deliveredPeriods", (double)this->gate.deliveredPeriods());
+  result.Set("level", this->gate.level());
+  result.Set("noiseFloor", this->gate.noiseFloor());
+
+  return result;
+}
+
+void NodeRtAudio::startRecording(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  RecordingSettings settings;
+  std::string error;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen() || this->inputParams.nChannels == 0)
+    throw Napi::Error::New(env, "startRecording needs an open stream with input");
+
+  if (this->recorder.isRecording())
+    throw Napi::Error::New(env, "Already recording");
+
+  if (!info[0].IsString())
+    throw Napi::TypeError::New(env, "path should be a string.");
+
+  settings.format = this->format;
+  settings.sampleSize = getFormatByteSize(this->format);
+  settings.channels = this->inputParams.nChannels;
+  settings.sampleRate = this->sampleRate;
+  settings.periodFrames = this->bufferFrames;
+  settings.interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  settings.ringFrames = this->sampleRate * 2;
+  settings.progressIntervalMs = 1000;
+
+  if (!info[1].IsUndefined() && !info[1].IsNull()) {
+    if (!info[1].IsObject())
+      throw Napi::TypeError::New(env, "options should be an object.");
+
+    Napi::Object obj = info[1].As<Napi::Object>();
+
+    if (!obj.Get("container").IsUndefined()) {
+      std::string container = obj.Get("container").IsString()
+                                  ? obj.Get("container").As<Napi::String>().Utf8Value()
+                                  : "";
+
+      if (container != "wav" && container != "raw")
+        throw Napi::TypeError::New(env, "options.container should be 'wav' or 'raw'.");
+
+      settings.container =
+          container == "wav" ? RecordingContainer::Wav : RecordingContainer::Raw;
+    }
+
+    if (!obj.Get("bufferFrames").IsUndefined()) {
+      if (!obj.Get("bufferFrames").IsNumber())
+        throw Napi::TypeError::New(env, "options.bufferFrames should be a number.");
+
+      settings.ringFrames = obj.Get("bufferFrames").As<Napi::Number>().Uint32Value();
+    }
+
+    if (!obj.Get("progressInterval").IsUndefined()) {
+      if (!obj.Get("progressInterval").IsNumber())
+        throw Napi::TypeError::New(env, "options.progressInterval should be a number.");
+
+      settings.progressIntervalMs =
+          obj.Get("progressInterval").As<Napi::Number>().Uint32Value();
+    }
+  }
+
+  if (!info[2].IsUndefined() && !info[2].IsNull() && !info[2].IsFunction())
+    throw Napi::TypeError::New(env, "callback should be a function.");
+
+  // Whole periods go into the ring, so it has to hold at least two of them.
+  settings.ringFrames = std::max(settings.ringFrames, this->bufferFrames * 2);
+
+  FileRecorder::Listener listener;
+
+  if (info[2].IsFunction()) {
+    this->tsRecordingCb = Napi::ThreadSafeFunction::New(
+        env, info[2].As<Napi::Function>(), "recordingCallback", 0, 1);
+
+    Napi::ThreadSafeFunction tsfn = this->tsRecordingCb;
+
+    listener = [tsfn](const RecordingProgress &progress) mutable {
+      tsfn.NonBlockingCall([progress](Napi::Env env, Napi::Function callback) {
+        try {
+          if (progress.error.empty()) {
+            callback.Call({Napi::String::New(env, "progress"),
+                           createRecordingObject(env, progress)});
+          } else {
+            callback.Call({Napi::String::New(env, "error"),
+                           Napi::Error::New(env, progress.error).Value()});
+          }
+        } catch (const std::exception &err) {
+          std::cerr << err.what() << std::endl;
+        }
+      });
+    };
+  }
+
+  if (!this->recorder.start(info[0].As<Napi::String>().Utf8Value(), settings, listener,
+                            &error)) {
+    finishRecording();
+    throw Napi::Error::New(env, error);
+  }
+}
+
+Napi::Value NodeRtAudio::stopRecording(const Napi::CallbackInfo &info) {
+  if (!this->recorder.isRecording())
+    throw Napi::Error::New(info.Env(), "Not recording");
+
+  return createRecordingObject(info.Env(), finishRecording());
+}
+
+RecordingProgress NodeRtAudio::finishRecording() {
+  RecordingProgress progress = this->recorder.stop();
+
+  if (this->tsRecordingCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsRecordingCb.Release();
+    this->tsRecordingCb = Napi::ThreadSafeFunction();
+  }
+
+  return progress;
+}
+
+Napi::Value NodeRtAudio::startPlayback(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  PlaybackSettings settings;
+  PlaybackInfo playbackInfo;
+  std::string error;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen() || this->outputParams.nChannels == 0)
+    throw Napi::Error::New(env, "startPlayback needs an open stream with output");
+
+  if (!info[0].IsString())
+    throw Napi::TypeError::New(env, "path should be a string.");
+
+  settings.format = this->format;
+  settings.channels = this->outputParams.nChannels;
+  settings.interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  settings.maxFrames = this->bufferFrames;
+  settings.rawFormat = this->format;
+  settings.rawChannels = this->outputParams.nChannels;
+  settings.rawSampleRate = this->sampleRate;
+
+  if (!info[1].IsUndefined() && !info[1].IsNull()) {
+    if (!info[1].IsObject())
+      throw Napi::TypeError::New(env, "options should be an object.");
+
+    Napi::Object obj = info[1].As<Napi::Object>();
+
+    if (!obj.Get("container").IsUndefined()) {
+      std::string container = obj.Get("container").IsString()
+                                  ? obj.Get("container").As<Napi::String>().Utf8Value()
+                                  : "";
+
+      if (container != "wav" && container != "raw")
+        throw Napi::TypeError::New(env, "options.container should be 'wav' or 'raw'.");
+
+      settings.raw = container == "raw";
+    }
+
+    if (!obj.Get("format").IsUndefined()) {
+      if (!obj.Get("format").IsNumber())
+        throw Napi::TypeError::New(env, "options.format should be a number.");
+
+      settings.rawFormat = obj.Get("format").As<Napi::Number>().Uint32Value();
+    }
+
+    if (!obj.Get("channels").IsUndefined()) {
+      if (!obj.Get("channels").IsNumber() ||
+          obj.Get("channels").As<Napi::Number>().Uint32Value() < 1)
+        throw Napi::TypeError::New(env,
+                                   "options.channels should be a number greater than 0.");
+
+      settings.rawChannels = obj.Get("channels").As<Napi::Number>().Uint32Value();
+    }
+
+    if (!obj.Get("loop").IsUndefined()) {
+      if (!obj.Get("loop").IsBoolean())
+        throw Napi::TypeError::New(env, "options.loop should be a boolean.");
+
+      settings.loop = obj.Get("loop").As<Napi::Boolean>();
+    }
+
+    if (!obj.Get("loopStart").IsUndefined()) {
+      if (!obj.Get("loopStart").IsNumber())
+        throw Napi::TypeError::New(env, "options.loopStart should be a number.");
+
+      settings.loopStart = (uint64_t)obj.Get("loopStart").As<Napi::Number>().Int64Value();
+    }
+
+    if (!obj.Get("loopEnd").IsUndefined()) {
+      if (!obj.Get("loopEnd").IsNumber())
+        throw Napi::TypeError::New(env, "options.loopEnd should be a number.");
+
+      settings.loopEnd = (uint64_t)obj.Get("loopEnd").As<Napi::Number>().Int64Value();
+    }
+  }
+
+  if (!info[2].IsUndefined() && !info[2].IsNull() && !info[2].IsFunction())
+    throw Napi::TypeError::New(env, "callback should be a function.");
+
+  finishPlayback();
+
+  FilePlayer::Listener onEnd;
+
+  if (info[2].IsFunction()) {
+    this->tsPlaybackCb = Napi::ThreadSafeFunction::New(
+        env, info[2].As<Napi::Function>(), "playbackCallback", 0, 1);
+
+    Napi::ThreadSafeFunction tsfn = this->tsPlaybackCb;
+
+    onEnd = [tsfn]() mutable {
+      tsfn.NonBlockingCall([](Napi::Env env, Napi::Function callback) {
+        try {
+          callback.Call({Napi::String::New(env, "end")});
+        } catch (const std::exception &err) {
+          std::cerr << err.what() << std::endl;
+        }
+      });
+    };
+  }
+
+  if (!this->player.start(info[0].As<Napi::String>().Utf8Value(), settings, onEnd,
+                          &playbackInfo, &error)) {
+    finishPlayback();
+    throw Napi::Error::New(env, error);
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+
+  result.Set("frames", (double)playbackInfo.frames);
+  result.Set("channels", playbackInfo.channels);
+  result.Set("sampleRate", playbackInfo.sampleRate);
+  result.Set("format", (double)playbackInfo.format);
+
+  return result;
+}
+
+void NodeRtAudio::stopPlayback(const Napi::CallbackInfo &info) { finishPlayback(); }
+
+void NodeRtAudio::seekPlayback(const Napi::CallbackInfo &info) {
+  if (!info[0].IsNumber() || info[0].As<Napi::Number>().Int64Value() < 0)
+    throw Napi::TypeError::New(info.Env(), "frame should be a non-negative number.");
+
+  this->player.seek((uint64_t)info[0].As<Napi::Number>().Int64Value());
+}
+
+Napi::Value NodeRtAudio::getPlaybackPosition(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), (double)this->player.position());
+}
+
+void NodeRtAudio::finishPlayback() {
+  this->player.stop();
+
+  if (this->tsPlaybackCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsPlaybackCb.Release();
+    this->tsPlaybackCb = Napi::ThreadSafeFunction();
+  }
+}
+
+void NodeRtAudio::parseCodecOptions(Napi::Env env, const Napi::Object &obj,
+                                    unsigned int streamChannels,
+                                    CodecSettings *settings) {
+  std::string codec =
+      obj.Get("codec").IsString() ? obj.Get("codec").As<Napi::String>().Utf8Value() : "";
+
+  if (codec != "opus" && codec != "flac")
+    throw Napi::TypeError::New(env, "options.codec should be 'opus' or 'flac'.");
+
+  settings->type = codec == "opus" ? CodecType::Opus : CodecType::Flac;
+  settings->channels = std::min(streamChannels, codec == "opus" ? 2u : 8u);
+
+  if (!obj.Get("channels").IsUndefined()) {
+    if (!obj.Get("channels").IsNumber() ||
+        obj.Get("channels").As<Napi::Number>().Uint32Value() < 1 ||
+        obj.Get("channels").As<Napi::Number>().Uint32Value() > streamChannels)
+      throw Napi::TypeError::New(
+          env, "options.channels should be a number between 1 and the stream channels.");
+
+    settings->channels = obj.Get("channels").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("bitrate").IsUndefined()) {
+    if (!obj.Get("bitrate").IsNumber())
+      throw Napi::TypeError::New(env, "options.bitrate should be a number.");
+
+    settings->bitrate = obj.Get("bitrate").As<Napi::Number>().Uint32Value();
+  }
+
+  // The codec checks the duration, this only has to give whole frames.
+  double frameDuration = 20;
+
+  if (!obj.Get("frameDuration").IsUndefined()) {
+    if (!obj.Get("frameDuration").IsNumber())
+      throw Napi::TypeError::New(env, "options.frameDuration should be a number.");
+
+    frameDuration = obj.Get("frameDuration").As<Napi::Number>().DoubleValue();
+  }
+
+  settings->packetFrames = (unsigned int)std::max(
+      0.0, std::round(frameDuration * settings->sampleRate / 1000));
+
+  if (!obj.Get("application").IsUndefined()) {
+    std::string application = obj.Get("application").IsString()
+                                  ? obj.Get("application").As<Napi::String>().Utf8Value()
+                                  : "";
+
+    if (application == "voip") {
+      settings->application = OpusApplication::Voip;
+    } else if (application == "audio") {
+      settings->application = OpusApplication::Audio;
+    } else if (application == "lowdelay") {
+      settings->application = OpusApplication::LowDelay;
+    } else {
+      throw Napi::TypeError::New(
+          env, "options.application should be 'voip', 'audio' or 'lowdelay'.");
+    }
+  }
+
+  if (!obj.Get("bitsPerSample").IsUndefined()) {
+    if (!obj.Get("bitsPerSample").IsNumber())
+      throw Napi::TypeError::New(env, "options.bitsPerSample should be a number.");
+
+    settings->bitsPerSample = obj.Get("bitsPerSample").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("compressionLevel").IsUndefined()) {
+    if (!obj.Get("compressionLevel").IsNumber())
+      throw Napi::TypeError::New(env, "options.compressionLevel should be a number.");
+
+    settings->compressionLevel =
+        obj.Get("compressionLevel").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("library").IsUndefined()) {
+    if (!obj.Get("library").IsString())
+      throw Napi::TypeError::New(env, "options.library should be a string.");
+
+    settings->library = obj.Get("library").As<Napi::String>().Utf8Value();
+  }
+}
+
+void NodeRtAudio::startEncoder(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  EncoderTapSettings settings;
+  std::string error;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen() || this->inputParams.nChannels == 0)
+    throw Napi::Error::New(env, "startEncoder needs an open stream with input");
+
+  if (this->encoder.isEncoding())
+    throw Napi::Error::New(env, "Already encoding");
+
+  if (!info[0].IsObject())
+    throw Napi::TypeError::New(env, "options should be an object.");
+
+  if (!info[1].IsFunction())
+    throw Napi::TypeError::New(env, "callback should be a function.");
+
+  Napi::Object obj = info[0].As<Napi::Object>();
+
+  settings.codec.sampleRate = this->sampleRate;
+  settings.format = this->format;
+  settings.channels = this->inputParams.nChannels;
+  settings.periodFrames = this->bufferFrames;
+  settings.interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  settings.ringFrames = this->sampleRate;
+
+  parseCodecOptions(env, obj, this->inputParams.nChannels, &settings.codec);
+
+  if (!obj.Get("batchInterval").IsUndefined()) {
+    if (!obj.Get("batchInterval").IsNumber())
+      throw Napi::TypeError::New(env, "options.batchInterval should be a number.");
+
+    settings.batchIntervalMs = obj.Get("batchInterval").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("bufferFrames").IsUndefined()) {
+    if (!obj.Get("bufferFrames").IsNumber())
+      throw Napi::TypeError::New(env, "options.bufferFrames should be a number.");
+
+    settings.ringFrames = obj.Get("bufferFrames").As<Napi::Number>().Uint32Value();
+  }
+
+  // Whole periods go into the ring, so it has to hold at least two of them.
+  settings.ringFrames = std::max(settings.ringFrames, this->bufferFrames * 2);
+
+  this->tsEncoderCb = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(),
+                                                    "encoderCallback", 0, 1);
+
+  Napi::ThreadSafeFunction tsfn = this->tsEncoderCb;
+
+  EncoderTap::Listener listener = [tsfn](std::vector<EncodedPacket> packets,
+                                         const std::string &error) mutable {
+    tsfn.NonBlockingCall([packets = std::move(packets), error](Napi::Env env,
+                                                               Napi::Function callback) {
+      try {
+        if (!packets.empty()) {
+          Napi::Array array = Napi::Array::New(env, packets.size());
+
+          for (size_t i = 0; i < packets.size(); i++) {
+            const EncodedPacket &packet = packets[i];
+            Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, packet.data.size());
+            Napi::Object object = Napi::Object::New(env);
+
+            memcpy(buffer.Data(), packet.data.data(), packet.data.size());
+            object.Set("data", Napi::Uint8Array::New(env, packet.data.size(), buffer, 0));
+            object.Set("frame", (double)packet.frame);
+            object.Set("frames", packet.frames);
+            array.Set((uint32_t)i, object);
+          }
+
+          callback.Call({Napi::String::New(env, "packets"), array});
+        }
+
+        if (!error.empty()) {
+          callback.Call(
+              {Napi::String::New(env, "error"), Napi::Error::New(env, error).Value()});
+        }
+      } catch (const std::exception &err) {
+        std::cerr << err.what() << std::endl;
+      }
+    });
+  };
+
+  if (!this->encoder.start(settings, listener, &error)) {
+    finishEncoder();
+    throw Napi::Error::New(env, error);
+  }
+}
+
+Napi::Value NodeRtAudio::stopEncoder(const Napi::CallbackInfo &info) {
+  if (!this->encoder.isEncoding())
+    throw Napi::Error::New(info.Env(), "Not encoding");
+
+  return createEncoderObject(info.Env(), finishEncoder());
+}
+
+EncoderStats NodeRtAudio::finishEncoder() {
+  EncoderStats stats = this->encoder.stop();
+
+  if (this->tsEncoderCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsEncoderCb.Release();
+    this->tsEncoderCb = Napi::ThreadSafeFunction();
+  }
+
+  return stats;
+}
+
+void NodeRtAudio::startDecoder(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  DecoderSourceSettings settings;
+  std::string error;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen() || this->outputParams.nChannels == 0)
+    throw Napi::Error::New(env, "startDecoder needs an open stream with output");
+
+  if (!info[0].IsObject())
+    throw Napi::TypeError::New(env, "options should be an object.");
+
+  if (!info[1].IsUndefined() && !info[1].IsNull() && !info[1].IsFunction())
+    throw Napi::TypeError::New(env, "callback should be a function.");
+
+  Napi::Object obj = info[0].As<Napi::Object>();
+
+  settings.codec.sampleRate = this->sampleRate;
+  settings.format = this->format;
+  settings.channels = this->outputParams.nChannels;
+  settings.interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  settings.maxFrames = this->bufferFrames;
+  settings.ringFrames = this->sampleRate / 5;
+
+  parseCodecOptions(env, obj, this->outputParams.nChannels, &settings.codec);
+
+  if (!obj.Get("bufferFrames").IsUndefined()) {
+    if (!obj.Get("bufferFrames").IsNumber())
+      throw Napi::TypeError::New(env, "options.bufferFrames should be a number.");
+
+    settings.ringFrames = obj.Get("bufferFrames").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("prebufferFrames").IsUndefined()) {
+    if (!obj.Get("prebufferFrames").IsNumber())
+      throw Napi::TypeError::New(env, "options.prebufferFrames should be a number.");
+
+    settings.prebufferFrames =
+        obj.Get("prebufferFrames").As<Napi::Number>().Uint32Value();
+  }
+
+  settings.ringFrames = std::max(settings.ringFrames, this->bufferFrames * 2);
+  settings.prebufferFrames = std::min(settings.prebufferFrames, settings.ringFrames);
+
+  finishDecoder();
+
+  DecoderSource::Listener listener;
+
+  if (info[1].IsFunction()) {
+    this->tsDecoderCb = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(),
+                                                      "decoderCallback", 0, 1);
+
+    Napi::ThreadSafeFunction tsfn = this->tsDecoderCb;
+
+    listener = [tsfn](const std::string &error) mutable {
+      tsfn.NonBlockingCall([error](Napi::Env env, Napi::Function callback) {
+        try {
+          if (error.empty()) {
+            callback.Call({Napi::String::New(env, "end")});
+          } else {
+            callback.Call({Napi::String::New(env, "error"),
+                           Napi::Error::New(env, error).Value()});
+          }
+        } catch (const std::exception &err) {
+          std::cerr << err.what() << std::endl;
+        }
+      });
+    };
+  }
+
+  if (!this->decoder.start(settings, listener, &error)) {
+    finishDecoder();
+    throw Napi::Error::New(env, error);
+  }
+}
+
+Napi::Value NodeRtAudio::queueEncoded(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!this->decoder.isDecoding())
+    throw Napi::Error::New(env, "Not decoding");
+
+  if (info[0].IsNull()) {
+    this->decoder.end();
+    return Napi::Number::New(env, 0);
+  }
+
+  if (!info[0].IsTypedArray() ||
+      info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array)
+    throw Napi::TypeError::New(env, "packet should be a Uint8Array or null.");
+
+  size_t byteLength = 0;
+  const uint8_t *data = getTypedArrayData(env, info[0], &byteLength);
+
+  return Napi::Number::New(
+      env, (double)this->decoder.queue(std::vector<uint8_t>(data, data + byteLength)));
+}
+
+Napi::Value NodeRtAudio::stopDecoder(const Napi::CallbackInfo &info) {
+  return createDecoderObject(info.Env(), finishDecoder());
+}
+
+DecoderStats NodeRtAudio::finishDecoder() {
+  DecoderStats stats = this->decoder.stop();
+
+  if (this->tsDecoderCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsDecoderCb.Release();
+    this->tsDecoderCb = Napi::ThreadSafeFunction();
+  }
+
+  return stats;
+}
+
+Napi::Value NodeRtAudio::createVoice(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  VoiceSettings settings;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen() || this->mixer.maxVoices() == 0)
+    throw Napi::Error::New(env,
+                           "createVoice needs an open stream with output and voices");
+
+  settings.queueFrames = this->sampleRate;
+  settings.startFrame = this->mixer.frame();
+
+  if (!info[0].IsUndefined() && !info[0].IsNull()) {
+    if (!info[0].IsObject())
+      throw Napi::TypeError::New(env, "options should be an object.");
+
+    Napi::Object obj = info[0].As<Napi::Object>();
+
+    if (!obj.Get("channels").IsUndefined()) {
+      if (!obj.Get("channels").IsNumber() ||
+          (obj.Get("channels").As<Napi::Number>().Int32Value() != 1 &&
+           obj.Get("channels").As<Napi::Number>().Int32Value() != 2))
+        throw Napi::TypeError::New(env, "options.channels should be 1 or 2.");
+
+      settings.channels = obj.Get("channels").As<Napi::Number>().Uint32Value();
+    }
+
+    if (!obj.Get("queueFrames").IsUndefined()) {
+      if (!obj.Get("queueFrames").IsNumber() ||
+          obj.Get("queueFrames").As<Napi::Number>().Int32Value() < 1)
+        throw Napi::TypeError::New(
+            env, "options.queueFrames should be a number greater than 0.");
+
+      settings.queueFrames = obj.Get("queueFrames").As<Napi::Number>().Uint32Value();
+    }
+
+    parseVoiceOptions(env, obj, &settings);
+  }
+
+  // Voices removed while the stream isn't running are never picked up by the realtime
+  // thread, hand their slots back here.
+  if (!RtAudio::isStreamRunning()) {
+    this->mixer.collect();
+  }
+
+  int64_t id = this->mixer.addVoice(settings);
+
+  if (id < 0)
+    throw Napi::Error::New(env, "All " + std::to_string(this->mixer.maxVoices()) +
+                                    " mixer voices are in use");
+
+  return Napi::Number::New(env, (double)id);
+}
+
+Napi::Value NodeRtAudio::queueVoice(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int64_t id = parseVoiceId(env, info[0]);
+
+  if (!info[1].IsTypedArray() ||
+      info[1].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array)
+    throw Napi::TypeError::New(env, "samples should be a Float32Array.");
+
+  size_t byteLength = 0;
+  const float *samples = (const float *)getTypedArrayData(env, info[1], &byteLength);
+
+  return Napi::Number::New(
+      env, (double)this->mixer.queue(id, samples, byteLength / sizeof(float)));
+}
+
+Napi::Value NodeRtAudio::setVoiceGain(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int64_t id = parseVoiceId(env, info[0]);
+
+  if (!info[1].IsNumber())
+    throw Napi::TypeError::New(env, "gain should be a number.");
+
+  return Napi::Boolean::New(
+      env, this->mixer.setGain(id, info[1].As<Napi::Number>().FloatValue()));
+}
+
+Napi::Value NodeRtAudio::setVoicePan(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int64_t id = parseVoiceId(env, info[0]);
+
+  if (!info[1].IsNumber())
+    throw Napi::TypeError::New(env, "pan should be a number.");
+
+  return Napi::Boolean::New(
+      env, this->mixer.setPan(id, info[1].As<Napi::Number>().FloatValue()));
+}
+
+Napi::Value NodeRtAudio::removeVoice(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int64_t id = parseVoiceId(env, info[0]);
+
+  if (!info[1].IsUndefined() && !info[1].IsBoolean())
+    throw Napi::TypeError::New(env, "drain should be a boolean.");
+
+  bool removed = this->mixer.removeVoice(id, info[1].IsBoolean() &&
+                                                 info[1].As<Napi::Boolean>().Value());
+
+  if (!RtAudio::isStreamRunning()) {
+    this->mixer.collect();
+  }
+
+  return Napi::Boolean::New(env, removed);
+}
+
+Napi::Value NodeRtAudio::getVoiceQueuedFrames(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  return Napi::Number::New(env,
+                           (double)this->mixer.queuedFrames(parseVoiceId(env, info[0])));
+}
+
+Napi::Value NodeRtAudio::getMixerStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::Object result = Napi::Object::New(env);
+  const LatencyHistogram &renderTime = this->mixer.renderTime();
+  double periodMicroseconds =
+      this->sampleRate == 0 ? 0 : this->bufferFrames * 1e6 / this->sampleRate;
+
+  result.Set("voices", this->mixer.voiceCount());
+  result.Set("activeVoices", this->mixer.activeVoices());
+  result.Set("maxVoices", this->mixer.maxVoices());
+  result.Set("frame", (double)this->mixer.frame());
+  result.Set("underruns", (double)this->mixer.underruns());
+  result.Set("lateStarts", (double)this->mixer.lateStarts());
+  result.Set("renderTime", createHistogramObject(env, renderTime));
+  result.Set("load", periodMicroseconds == 0
+                         ? 0
+                         : renderTime.meanMicroseconds() / periodMicroseconds);
+
+  return result;
+}
+
+Napi::Value NodeRtAudio::loadClip(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  unsigned int channels = 1;
+
+  if (!info[1].IsUndefined()) {
+    if (!info[1].IsNumber() || (info[1].As<Napi::Number>().Int32Value() != 1 &&
+                                info[1].As<Napi::Number>().Int32Value() != 2))
+      throw Napi::TypeError::New(env, "channels should be 1 or 2.");
+
+    channels = info[1].As<Napi::Number>().Uint32Value();
+  }
+
+  uint32_t id = this->nextClipId++;
+
+  this->clips[id] = {parseClipSamples(env, info[0], channels), channels};
+
+  return Napi::Number::New(env, id);
+}
+
+Napi::Value NodeRtAudio::unloadClip(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!info[0].IsNumber())
+    throw Napi::TypeError::New(env, "clip should be a number.");
+
+  // Voices that still play the clip keep their own reference.
+  return Napi::Boolean::New(env,
+                            this->clips.erase(info[0].As<Napi::Number>().Uint32Value()));
+}
+
+Napi::Value NodeRtAudio::scheduleClip(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  VoiceSettings settings;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen() || this->mixer.maxVoices() == 0)
+    throw Napi::Error::New(env,
+                           "scheduleClip needs an open stream with output and voices");
+
+  if (!info[1].IsUndefined() && !info[1].IsNull() && !info[1].IsObject())
+    throw Napi::TypeError::New(env, "options should be an object.");
+
+  Napi::Object obj =
+      info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+
+  if (info[0].IsNumber()) {
+    auto clip = this->clips.find(info[0].As<Napi::Number>().Uint32Value());
+
+    if (clip == this->clips.end())
+      throw Napi::Error::New(env, "The clip isn't loaded");
+
+    settings.clip = clip->second.first;
+    settings.channels = clip->second.second;
+  } else {
+    if (!obj.Get("channels").IsUndefined()) {
+      if (!obj.Get("channels").IsNumber() ||
+          (obj.Get("channels").As<Napi::Number>().Int32Value() != 1 &&
+           obj.Get("channels").As<Napi::Number>().Int32Value() != 2))
+        throw Napi::TypeError::New(env, "options.channels should be 1 or 2.");
+
+      settings.channels = obj.Get("channels").As<Napi::Number>().Uint32Value();
+    }
+
+    settings.clip = parseClipSamples(env, info[0], settings.channels);
+  }
+
+  size_t clipFrames = settings.clip->size() / settings.channels;
+
+  settings.startFrame = this->mixer.frame();
+  parseVoiceOptions(env, obj, &settings);
+
+  if (!obj.Get("offset").IsUndefined()) {
+    if (!obj.Get("offset").IsNumber() ||
+        obj.Get("offset").As<Napi::Number>().Int64Value() < 0 ||
+        obj.Get("offset").As<Napi::Number>().Int64Value() > (int64_t)clipFrames)
+      throw Napi::TypeError::New(
+          env, "options.offset should be a number between 0 and the clip length.");
+
+    settings.clipOffset = (size_t)obj.Get("offset").As<Napi::Number>().Int64Value();
+  }
+
+  settings.clipFrames = clipFrames - settings.clipOffset;
+
+  if (!obj.Get("frames").IsUndefined()) {
+    if (!obj.Get("frames").IsNumber() ||
+        obj.Get("frames").As<Napi::Number>().Int64Value() < 1 ||
+        obj.Get("frames").As<Napi::Number>().Int64Value() > (int64_t)settings.clipFrames)
+      throw Napi::TypeError::New(env, "options.frames should be a number between 1 and "
+                                      "the frames after options.offset.");
+
+    settings.clipFrames = (size_t)obj.Get("frames").As<Napi::Number>().Int64Value();
+  }
+
+  if (settings.clipFrames == 0)
+    throw Napi::Error::New(env, "The clip has no frames to play");
+
+  if (!RtAudio::isStreamRunning()) {
+    this->mixer.collect();
+  }
+
+  int64_t id = this->mixer.addVoice(settings);
+
+  if (id < 0)
+    throw Napi::Error::New(env, "All " + std::to_string(this->mixer.maxVoices()) +
+                                    " mixer voices are in use");
+
+  return Napi::Number::New(env, (double)id);
+}
+
+Napi::Value NodeRtAudio::getStreamClock(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  StreamClock::Anchor anchor;
+
+  // The backend stream may be half reopened while a stream operation is pending.
+  if (this->streamOperationPending || !RtAudio::isStreamOpen() ||
+      !this->clock.read(&anchor))
+    return env.Null();
+
+  Napi::Object result = Napi::Object::New(env);
+
+  result.Set("frame", (double)anchor.frame);
+  result.Set("time", (double)anchor.time);
+  result.Set("nanosecondsPerFrame", anchor.nanosecondsPerFrame);
+  result.Set("sampleRate", 1e9 / anchor.nanosecondsPerFrame);
+
+  return result;
+}
+
+void NodeRtAudio::setProcessingGraph(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen())
+    throw Napi::Error::New(env, "setProcessingGraph needs an open stream");
+
+  if (info[0].IsNull() || info[0].IsUndefined()) {
+    this->graph.replace(nullptr);
+    return;
+  }
+
+  if (!info[0].IsArray())
+    throw Napi::TypeError::New(env, "nodes should be an array.");
+
+  Napi::Array array = info[0].As<Napi::Array>();
+  std::vector<DspNodeSettings> nodes(array.Length());
+
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    parseGraphNode(env, array.Get(i), i, &nodes[i]);
+  }
+
+  DspStreamLayout layout;
+  std::string error;
+
+  layout.format = this->format;
+  layout.inputChannels = this->inputParams.nChannels;
+  layout.outputChannels = this->outputParams.nChannels;
+  layout.interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  layout.maxFrames = this->bufferFrames;
+  layout.sampleRate = this->sampleRate;
+
+  std::unique_ptr<DspGraph> graph = DspGraph::create(nodes, layout, &error);
+
+  if (graph == nullptr)
+    throw Napi::Error::New(env, error);
+
+  this->graph.replace(std::move(graph));
+}
+
+Napi::Value NodeRtAudio::setGraphParameter(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  DspGraph *graph = this->graph.get();
+  DspMessage message = {0, DspParameter::Gain, 0, 0};
+
+  if (graph == nullptr)
+    throw Napi::Error::New(env, "setGraphParameter needs a processing graph");
+
+  if (!info[0].IsNumber() || info[0].As<Napi::Number>().Int64Value() < 0)
+    throw Napi::TypeError::New(env, "node should be a non-negative number.");
+
+  if (!info[1].IsString())
+    throw Napi::TypeError::New(env, "parameter should be a string.");
+
+  if (!info[2].IsNumber())
+    throw Napi::TypeError::New(env, "value should be a number.");
+
+  if (!info[3].IsUndefined() &&
+      (!info[3].IsNumber() || info[3].As<Napi::Number>().Int64Value() < 0))
+    throw Napi::TypeError::New(env, "index should be a non-negative number.");
+
+  static const std::vector<std::pair<std::string, DspParameter>> parameters = {
+      {"gain", DspParameter::Gain},         {"frequency", DspParameter::Frequency},
+      {"q", DspParameter::Q},               {"filterGain", DspParameter::FilterGain},
+      {"delay", DspParameter::Delay},       {"feedback", DspParameter::Feedback},
+  };
+  std::string name = info[1].As<Napi::String>().Utf8Value();
+  auto parameter =
+      std::find_if(parameters.begin(), parameters.end(),
+                   [&name](const auto &entry) { return entry.first == name; });
+
+  if (parameter == parameters.end())
+    throw Napi::TypeError::New(env, "Unknown parameter " + name);
+
+  message.node = info[0].As<Napi::Number>().Uint32Value();
+  message.parameter = parameter->second;
+  message.index = info[3].IsNumber() ? info[3].As<Napi::Number>().Uint32Value() : 0;
+  message.value = info[2].As<Napi::Number>().FloatValue();
+
+  std::string error = graph->check(message);
+
+  if (!error.empty())
+    throw Napi::Error::New(env, error);
+
+  return Napi::Boolean::New(env, graph->post(message));
+}
+
+Napi::Value NodeRtAudio::startAnalysis(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  AnalysisSettings settings;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen())
+    throw Napi::Error::New(env, "startAnalysis needs an open stream");
+
+  if (!info[0].IsUndefined() && !info[0].IsNull()) {
+    if (!info[0].IsObject())
+      throw Napi::TypeError::New(env, "options should be an object.");
+
+    Napi::Object obj = info[0].As<Napi::Object>();
+
+    if (!obj.Get("source").IsUndefined()) {
+      std::string source = obj.Get("source").IsString()
+                               ? obj.Get("source").As<Napi::String>().Utf8Value()
+                               : "";
+
+      if (source != "input" && source != "output")
+        throw Napi::TypeError::New(env, "options.source should be 'input' or 'output'.");
+
+      settings.output = source == "output";
+    }
+
+    if (!obj.Get("rate").IsUndefined()) {
+      if (!obj.Get("rate").IsNumber() ||
+          !(obj.Get("rate").As<Napi::Number>().DoubleValue() > 0 &&
+            obj.Get("rate").As<Napi::Number>().DoubleValue() <= 1000))
+        throw Napi::TypeError::New(env,
+                                   "options.rate should be a number between 0 and 1000.");
+
+      settings.rate = obj.Get("rate").As<Napi::Number>().DoubleValue();
+    }
+
+    if (!obj.Get("fftSize").IsUndefined()) {
+      unsigned int fftSize = obj.Get("fftSize").IsNumber()
+                                 ? obj.Get("fftSize").As<Napi::Number>().Uint32Value()
+                                 : 1;
+
+      if (fftSize != 0 && (fftSize < Analyzer::MinFftSize ||
+                           fftSize > Analyzer::MaxFftSize || (fftSize & (fftSize - 1))))
+        throw Napi::TypeError::New(
+            env, "options.fftSize should be 0 or a power of two between " +
+                     std::to_string(Analyzer::MinFftSize) + " and " +
+                     std::to_string(Analyzer::MaxFftSize) + ".");
+
+      settings.fftSize = fftSize;
+    }
+  }
+
+  if (!info[1].IsFunction())
+    throw Napi::TypeError::New(env, "callback should be a function.");
+
+  settings.format = this->format;
+  settings.channels =
+      settings.output ? this->outputParams.nChannels : this->inputParams.nChannels;
+  settings.periodFrames = this->bufferFrames;
+  settings.interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  settings.sampleRate = this->sampleRate;
+
+  if (settings.channels == 0)
+    throw Napi::Error::New(env, settings.output ? "The stream has no output"
+                                                : "The stream has no input");
+
+  finishAnalysis();
+
+  size_t length = (size_t)settings.channels * 2 + settings.fftSize / 2;
+  Napi::Float32Array results = Napi::Float32Array::New(env, length);
+  uint64_t generation = ++this->analysisGeneration;
+
+  this->analysisResultsRef = Napi::Persistent(results.As<Napi::Object>());
+  this->tsAnalysisCb = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(),
+                                                     "analysisCallback", 0, 1);
+
+  Napi::ThreadSafeFunction tsfn = this->tsAnalysisCb;
+
+  // Results are copied into the same Float32Array every time, on the JS thread.
+  Analyzer::Listener listener = [tsfn, this, generation]() mutable {
+    tsfn.NonBlockingCall([this, generation](Napi::Env env, Napi::Function callback) {
+      if (generation != this->analysisGeneration || this->analysisResultsRef.IsEmpty())
+        return;
+
+      try {
+        Napi::Value results = this->analysisResultsRef.Value();
+        size_t byteLength = 0;
+
+        this->analyzer.copyResults((float *)getTypedArrayData(env, results, &byteLength));
+        callback.Call({results});
+      } catch (const std::exception &err) {
+        std::cerr << err.what() << std::endl;
+      }
+    });
+  };
+
+  this->analyzer.start(settings, listener);
+
+  return results;
+}
+
+void NodeRtAudio::stopAnalysis(const Napi::CallbackInfo &info) { finishAnalysis(); }
+
+void NodeRtAudio::finishAnalysis() {
+  this->analyzer.stop();
+  this->analysisGeneration++;
+  this->analysisResultsRef.Reset();
+
+  if (this->tsAnalysisCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsAnalysisCb.Release();
+    this->tsAnalysisCb = Napi::ThreadSafeFunction();
+  }
+}
+
+Napi::Value NodeRtAudio::getOfflineProgress(const Napi::CallbackInfo &info) {
+  if (this->offlineApi == nullptr)
+    return info.Env().Null();
+
+  return createOfflineObject(info.Env(), this->offlineApi->progress());
+}
+
+void NodeRtAudio::openOfflineApi() {
+  std::lock_guard<std::mutex> lock(this->deviceMutex);
+
+  this->offlineApi = new RtApiOffline();
+  this->deviceApi = this->rtapi_;
+  this->rtapi_ = this->offlineApi;
+
+  RtAudio::showWarnings(this->warnings);
+
+  if (this->errorCallback) {
+    RtAudio::setErrorCallback(this->errorCallback);
+  }
+}
+
+void NodeRtAudio::closeOfflineApi() {
+  if (this->deviceApi == nullptr)
+    return;
+
+  std::lock_guard<std::mutex> lock(this->deviceMutex);
+
+  this->offlineGeneration++;
+  this->rtapi_ = this->deviceApi;
+  this->deviceApi = nullptr;
+  delete this->offlineApi;
+  this->offlineApi = nullptr;
+
+  if (this->tsOfflineCb.operator napi_threadsafe_function() != nullptr) {
+    this->tsOfflineCb.Release();
+    this->tsOfflineCb = Napi::ThreadSafeFunction();
+  }
+}
+
+Napi::Object NodeRtAudio::createOfflineObject(Napi::Env env,
+                                              const OfflineProgress &progress) const {
+  Napi::Object result = Napi::Object::New(env);
+  double duration = (double)progress.frames / this->sampleRate;
+
+  result.Set("frames", (double)progress.frames);
+  result.Set("duration", duration);
+  result.Set("elapsed", progress.elapsed);
+  // How many times faster than realtime the stream rendered.
+  result.Set("speedup", progress.elapsed > 0 ? duration / progress.elapsed : 0);
+  result.Set("finished", progress.finished);
+
+  if (!progress.error.empty()) {
+    result.Set("error", progress.error);
+  }
+
+  return result;
+}
+
+void NodeRtAudio::parseGraphNode(Napi::Env env, const Napi::Value &val,
+                                 unsigned int index, DspNodeSettings *settings) {
+  static const std::vector<std::pair<std::string, DspNodeType>> types = {
+      {"input", DspNodeType::Input},   {"gain", DspNodeType::Gain},
+      {"mix", DspNodeType::Mix},       {"biquad", DspNodeType::Biquad},
+      {"delay", DspNodeType::Delay},   {"passthrough", DspNodeType::Passthrough},
+      {"route", DspNodeType::Route},
+  };
+  static const std::vector<std::pair<std::string, BiquadFilter>> filters = {
+      {"lowpass", BiquadFilter::Lowpass},     {"highpass", BiquadFilter::Highpass},
+      {"bandpass", BiquadFilter::Bandpass},   {"notch", BiquadFilter::Notch},
+      {"peaking", BiquadFilter::Peaking},     {"lowshelf", BiquadFilter::Lowshelf},
+      {"highshelf", BiquadFilter::Highshelf}, {"allpass", BiquadFilter::Allpass},
+  };
+  std::string prefix = "nodes[" + std::to_string(index) + "]";
+
+  if (!val.IsObject())
+    throw Napi::TypeError::New(env, prefix + " should be an object.");
+
+  Napi::Object obj = val.As<Napi::Object>();
+  std::string type = obj.Get("type").IsString()
+                         ? obj.Get("type").As<Napi::String>().Utf8Value()
+                         : "";
+  auto nodeType =
+      std::find_if(types.begin(), types.end(),
+                   [&type](const auto &entry) { return entry.first == type; });
+
+  if (nodeType == types.end())
+    throw Napi::TypeError::New(env, prefix + ".type should be one of input, gain, mix, "
+                                             "biquad, delay, passthrough or route.");
+
+  settings->type = nodeType->second;
+
+  auto parseNumber = [&](const char *name, float *value) {
+    if (obj.Get(name).IsUndefined())
+      return;
+
+    if (!obj.Get(name).IsNumber())
+      throw Napi::TypeError::New(env, prefix + "." + name + " should be a number.");
+
+    *value = obj.Get(name).As<Napi::Number>().FloatValue();
+  };
+
+  auto parseFrames = [&](const char *name, unsigned int *value) {
+    if (obj.Get(name).IsUndefined())
+      return;
+
+    if (!obj.Get(name).IsNumber() || obj.Get(name).As<Napi::Number>().Int64Value() < 0)
+      throw Napi::TypeError::New(env, prefix + "." + name +
+                                          " should be a non-negative number.");
+
+    *value = obj.Get(name).As<Napi::Number>().Uint32Value();
+  };
+
+  auto parseNumbers = [&](const char *name, auto push) {
+    if (obj.Get(name).IsUndefined())
+      return;
+
+    if (!obj.Get(name).IsArray())
+      throw Napi::TypeError::New(env, prefix + "." + name + " should be an array.");
+
+    Napi::Array array = obj.Get(name).As<Napi::Array>();
+
+    for (uint32_t i = 0; i < array.Length(); i++) {
+      if (!array.Get(i).IsNumber())
+        throw Napi::TypeError::New(env,
+                                   prefix + "." + name + " should only contain numbers.");
+
+      push(array.Get(i).As<Napi::Number>());
+    }
+  };
+
+  if (!obj.Get("input").IsUndefined()) {
+    unsigned int input = 0;
+
+    parseFrames("input", &input);
+    settings->inputs.push_back(input);
+  }
+
+  parseNumbers("inputs", [&](Napi::Number value) {
+    if (value.Int64Value() < 0)
+      throw Napi::TypeError::New(env, prefix + ".inputs should be node indices.");
+
+    settings->inputs.push_back(value.Uint32Value());
+  });
+
+  if (!obj.Get("gain").IsUndefined()) {
+    float gain = 1;
+
+    parseNumber("gain", &gain);
+    settings->gains.push_back(gain);
+  }
+
+  parseNumbers("gains", [&](Napi::Number value) {
+    settings->gains.push_back(value.FloatValue());
+  });
+
+  if (!obj.Get("filter").IsUndefined()) {
+    std::string filter = obj.Get("filter").IsString()
+                             ? obj.Get("filter").As<Napi::String>().Utf8Value()
+                             : "";
+    auto filterType =
+        std::find_if(filters.begin(), filters.end(),
+                     [&filter](const auto &entry) { return entry.first == filter; });
+
+    if (filterType == filters.end())
+      throw Napi::TypeError::New(env, prefix + ".filter should be one of lowpass, "
+                                               "highpass, bandpass, notch, peaking, "
+                                               "lowshelf, highshelf or allpass.");
+
+    settings->filter = filterType->second;
+  }
+
+  parseNumber("frequency", &settings->frequency);
+  parseNumber("q", &settings->q);
+  parseNumber("filterGain", &settings->filterGain);
+  parseFrames("delay", &settings->delay);
+  parseFrames("maxDelay", &settings->maxDelay);
+  parseNumber("feedback", &settings->feedback);
+  parseNumbers("channels", [&](Napi::Number value) {
+    settings->channels.push_back(value.Int32Value());
+  });
+}
+
+int64_t NodeRtAudio::parseVoiceId(Napi::Env env, const Napi::Value &val) {
+  if (!val.IsNumber())
+    throw Napi::TypeError::New(env, "voice should be a number.");
+
+  return val.As<Napi::Number>().Int64Value();
+}
+
+void NodeRtAudio::parseVoiceOptions(Napi::Env env, const Napi::Object &obj,
+                                    VoiceSettings *settings) {
+  if (!obj.Get("gain").IsUndefined()) {
+    if (!obj.Get("gain").IsNumber())
+      throw Napi::TypeError::New(env, "options.gain should be a number.");
+
+    settings->gain = obj.Get("gain").As<Napi::Number>().FloatValue();
+  }
+
+  if (!obj.Get("pan").IsUndefined()) {
+    if (!obj.Get("pan").IsNumber())
+      throw Napi::TypeError::New(env, "options.pan should be a number.");
+
+    settings->pan =
+        std::clamp(obj.Get("pan").As<Napi::Number>().FloatValue(), -1.0f, 1.0f);
+  }
+
+  if (!obj.Get("startFrame").IsUndefined()) {
+    if (!obj.Get("startFrame").IsNumber() ||
+        obj.Get("startFrame").As<Napi::Number>().Int64Value() < 0)
+      throw Napi::TypeError::New(env,
+                                 "options.startFrame should be a non-negative number.");
+
+    settings->startFrame =
+        (uint64_t)obj.Get("startFrame").As<Napi::Number>().Int64Value();
+  }
+}
+
+MixerClip NodeRtAudio::parseClipSamples(Napi::Env env, const Napi::Value &val,
+                                        unsigned int channels) {
+  if (!val.IsTypedArray() ||
+      val.As<Napi::TypedArray>().TypedArrayType() != napi_float32_array)
+    throw Napi::TypeError::New(env, "samples should be a Float32Array.");
+
+  size_t byteLength = 0;
+  const float *samples = (const float *)getTypedArrayData(env, val, &byteLength);
+  size_t sampleCount = byteLength / sizeof(float);
+
+  if (sampleCount % channels != 0)
+    throw Napi::TypeError::New(env, "samples should hold whole frames.");
+
+  return std::make_shared<const std::vector<float>>(samples, samples + sampleCount);
+}
+
+Napi::Object NodeRtAudio::createRecordingObject(Napi::Env env,
+                                                const RecordingProgress &progress) {
+  Napi::Object result = Napi::Object::New(env);
+
+  result.Set("framesWritten", (double)progress.framesWritten);
+  result.Set("droppedFrames", (double)progress.droppedFrames);
+
+  if (!progress.error.empty()) {
+    result.Set("error", progress.error);
+  }
+
+  return result;
+}
+
+Napi::Object NodeRtAudio::createEncoderObject(Napi::Env env, const EncoderStats &stats) {
+  Napi::Object result = Napi::Object::New(env);
+
+  result.Set("packets", (double)stats.packets);
+  result.Set("bytes", (double)stats.bytes);
+  result.Set("framesEncoded", (double)stats.framesEncoded);
+  result.Set("droppedFrames", (double)stats.droppedFrames);
+
+  if (!stats.error.empty()) {
+    result.Set("error", stats.error);
+  }
+
+  return result;
+}
+
+Napi::Object NodeRtAudio::createDecoderObject(Napi::Env env, const DecoderStats &stats) {
+  Napi::Object result = Napi::Object::New(env);
+
+  result.Set("packets", (double)stats.packets);
+  result.Set("framesDecoded", (double)stats.framesDecoded);
+  result.Set("underruns", (double)stats.underruns);
+
+  if (!stats.error.empty()) {
+    result.Set("error", stats.error);
+  }
+
+  return result;
+}
+
+Napi::Object NodeRtAudio::createHistogramObject(Napi::Env env,
+                                                const LatencyHistogram &histogram) {
+  Napi::Object result = Napi::Object::New(env);
+  Napi::Array buckets = Napi::Array::New(env, LatencyHistogram::BucketCount);
+
+  for (unsigned int i = 0; i < LatencyHistogram::BucketCount; i++) {
+    buckets.Set(i, (double)histogram.bucket(i));
+  }
+
+  result.Set("count", (double)histogram.count());
+  result.Set("mean", histogram.meanMicroseconds());
+  result.Set("p50", histogram.percentileMicroseconds(0.5));
+  result.Set("p99", histogram.percentileMicroseconds(0.99));
+  result.Set("max", histogram.maxMicroseconds());
+  result.Set("buckets", buckets);
+
+  return result;
+}
+
+Napi::Value NodeRtAudio::getBufferedFrames(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::Object fill = Napi::Object::New(env);
+  unsigned int sampleSize = getFormatByteSize(this->format);
+  size_t outputFrameSize = this->outputParams.nChannels * sampleSize;
+  size_t inputFrameSize = this->inputParams.nChannels * sampleSize;
+
+  fill.Set("output", outputFrameSize == 0
+                         ? 0
+                         : this->outputRing.readAvailable() / outputFrameSize);
+  fill.Set("input",
+           inputFrameSize == 0 ? 0 : this->inputRing.readAvailable() / inputFrameSize);
+  fill.Set("capacity", this->nodeOptions.ringBufferFrames);
+
+  return fill;
+}
+
+void NodeRtAudio::closeStream(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+  closeWorkerChannel();
+
+  if (this->offlineApi != nullptr) {
+    closeOfflineStream();
+  } else {
+    RtAudio::closeStream();
+  }
+
+  finishClose();
+}
+
+// Closing joins the render thread, which may be waiting for a JS call that can't run
+// while this thread is blocked. The call is dropped instead: the callback is aborted
+// and the render thread woken up, it sees the stream stopped and leaves.
+void NodeRtAudio::closeOfflineStream() {
+  if (this->tsCb.operator napi_threadsafe_function() == nullptr) {
+    RtAudio::closeStream();
+    return;
+  }
+
+  if (RtAudio::isStreamRunning()) {
+    RtAudio::stopStream();
+  }
+
+  this->tsCb.Abort();
+
+  // Exactly one permit, whether or not the render thread is waiting for it.
+  this->jsThreadSmph.try_acquire();
+  this->jsThreadSmph.release();
+
+  RtAudio::closeStream();
+
+  // Permits of calls that never ran.
+  this->jsThreadSmph.try_acquire();
+  this->rtThreadSmph.try_acquire();
+  this->tsCb = Napi::ThreadSafeFunction();
+}
+
+Napi::Value NodeRtAudio::closeStreamAsync(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+  closeWorkerChannel();
+
+  this->streamOperationPending = true;
+
+  return PromiseWorker::queue(new PromiseWorker(
+      info.Env(), "closeStreamAsync", this->Value(),
+      [this]() {
+        RtAudio::closeStream();
+        return std::string();
+      },
+      [this](Napi::Env env) {
+        this->streamOperationPending = false;
+        finishClose();
+
+        return env.Undefined();
+      }));
+}
+
+void NodeRtAudio::finishClose() {
+  jsRef.Unref();
+  closeOfflineApi();
+  finishRecording();
+  finishPlayback();
+  finishEncoder();
+  finishDecoder();
+  graph.replace(nullptr);
+  finishAnalysis();
+
+  if (tsGateCb.operator napi_threadsafe_function() != nullptr) {
+    tsGateCb.Release();
+    tsGateCb = Napi::ThreadSafeFunction();
+  }
+
+  outputPool.release();
+  inputPool.release();
+  workerChannel = nullptr;
+  workerBuffersRef.Reset();
+}
+
+void NodeRtAudio::startStream(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
+  if (workerChannel != nullptr) {
+    workerChannel->resume();
+  }
+
+  startBackend();
+}
+
+Napi::Value NodeRtAudio::startStreamAsync(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
+  if (workerChannel != nullptr) {
+    workerChannel->resume();
+  }
+
+  this->streamOperationPending = true;
+
+  return PromiseWorker::queue(new PromiseWorker(
+      info.Env(), "startStreamAsync", this->Value(),
+      [this]() {
+        return startBackend() == RTAUDIO_NO_ERROR ? std::string()
+                                                  : RtAudio::getErrorText();
+      },
+      [this](Napi::Env env) {
+        this->streamOperationPending = false;
+        return env.Undefined();
+      },
+      [this](Napi::Env env) { this->streamOperationPending = false; }));
+}
+
+RtAudioErrorType NodeRtAudio::startBackend() {
+  int64_t start = StreamStats::now();
+
+  this->startup.startRequestTime = start;
+  this->startup.firstCallbackTime = 0;
+
+  RtAudioErrorType result = RtAudio::startStream();
+
+  this->startup.startDuration = StreamStats::now() - start;
+
+  return result;
+}
+
+void NodeRtAudio::stopStream(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
+  // Make sure the realtime thread isn't left waiting on the worker while RtAudio joins
+  // it.
+  if (workerChannel != nullptr) {
+    workerChannel->cancel();
+  }
+
+  RtAudio::stopStream();
+}
+
+Napi::Value NodeRtAudio::stopStreamAsync(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
+  if (workerChannel != nullptr) {
+    workerChannel->cancel();
+  }
+
+  this->streamOperationPending = true;
+
+  // The JS thread stays free, so a callback the realtime thread is waiting for still
+  // runs while RtAudio drains the stream.
+  return PromiseWorker::queue(new PromiseWorker(
+      info.Env(), "stopStreamAsync", this->Value(),
+      [this]() {
+        return RtAudio::stopStream() == RTAUDIO_NO_ERROR ? std::string()
+                                                         : RtAudio::getErrorText();
+      },
+      [this](Napi::Env env) {
+        this->streamOperationPending = false;
+        return env.Undefined();
+      },
+      [this](Napi::Env env) { this->streamOperationPending = false; }));
+}
+
+void NodeRtAudio::abortStream(const Napi::CallbackInfo &info) {
+  checkStreamOperation(info.Env());
+
+  if (workerChannel != nullptr) {
+    workerChannel->cancel();
+  }
+
+  RtAudio::abortStream();
+}
+
+Napi::Value NodeRtAudio::reconfigureStream(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  RtAudio::StreamParameters outputParams = this->outputParams;
+  RtAudio::StreamParameters inputParams = this->inputParams;
+  unsigned int bufferFrames = this->bufferFrames;
+
+  checkStreamOperation(env);
+
+  if (!RtAudio::isStreamOpen())
+    throw Napi::Error::New(env, "reconfigureStream needs an open stream");
+
+  if (this->nodeOptions.offline)
+    throw Napi::Error::New(env, "Offline streams can't be reconfigured");
+
+  if (!info[0].IsUndefined()) {
+    if (info[0].IsNull() != (this->outputParams.nChannels == 0))
+      throw Napi::Error::New(env, "reconfigureStream can't add or remove the output");
+
+    if (!info[0].IsNull())
+      parseOutputParams(env, info[0], &outputParams);
+  }
+
+  if (!info[1].IsUndefined()) {
+    if (info[1].IsNull() != (this->inputParams.nChannels == 0))
+      throw Napi::Error::New(env, "reconfigureStream can't add or remove the input");
+
+    if (!info[1].IsNull())
+      parseInputParams(env, info[1], &inputParams);
+  }
+
+  if (outputParams.nChannels != this->outputParams.nChannels ||
+      inputParams.nChannels != this->inputParams.nChannels)
+    throw Napi::Error::New(env, "reconfigureStream can't change the number of channels");
+
+  if (!info[2].IsUndefined()) {
+    if (!info[2].IsNumber())
+      throw Napi::TypeError::New(env, "bufferFrames should be a valid number");
+
+    bufferFrames = info[2].As<Napi::Number>().Uint32Value();
+  }
+
+  // The worker's SharedArrayBuffer blocks were sized for the current period.
+  if (this->nodeOptions.mode == StreamMode::Worker && bufferFrames != this->bufferFrames)
+    throw Napi::Error::New(env, "bufferFrames can't be changed in worker mode");
+
+  const std::vector<RtAudio::DeviceInfo> &devices = this->deviceCache;
+
+  if ((outputParams.nChannels > 0 && !deviceExists(outputParams.deviceId, devices)) ||
+      (inputParams.nChannels > 0 && !deviceExists(inputParams.deviceId, devices))) {
+    updateDeviceCache(queryDevices());
+  }
+
+  if (outputParams.nChannels > 0 && !deviceExists(outputParams.deviceId, devices))
+    throw Napi::TypeError::New(env, "Output device doesn't exist.");
+
+  if (inputParams.nChannels > 0 && !deviceExists(inputParams.deviceId, devices))
+    throw Napi::TypeError::New(env, "Input device doesn't exist.");
+
+  unsigned int previousFrames = this->bufferFrames;
+  bool running = RtAudio::isStreamRunning();
+  // What the backend settles on. `this->bufferFrames` only changes on the JS thread once
+  // the promise resolves, methods that use it are blocked by `checkStreamOperation`
+  // until then.
+  auto settledFrames = std::make_shared<unsigned int>(bufferFrames);
+
+  if (workerChannel != nullptr) {
+    workerChannel->cancel();
+  }
+
+  this->outputParams = outputParams;
+  this->inputParams = inputParams;
+  this->streamOperationPending = true;
+  this->startup.openRequestTime = StreamStats::now();
+  this->startup.firstCallbackTime = 0;
+
+  // Everything but the backend stream is kept: the callbacks, the pools, the worker,
+  // native sources and voices. The stream is restarted on the worker unless the period
+  // size changed, then the buffers sized by it are resized first.
+  return PromiseWorker::queue(new PromiseWorker(
+      env, "reconfigureStream", this->Value(),
+      [this, running, previousFrames, settledFrames]() {
+        if (RtAudio::isStreamRunning())
+          RtAudio::stopStream();
+
+        double streamTime = RtAudio::getStreamTime();
+        int64_t stopTime = StreamStats::now();
+
+        RtAudio::closeStream();
+
+        if (openBackend(settledFrames.get()) != RTAUDIO_NO_ERROR)
+          return RtAudio::getErrorText();
+
+        // Mixer start frames and the stream clock follow stream time, which reopening
+        // reset. A running stream's timeline also covers the restart.
+        if (running)
+          streamTime += (StreamStats::now() - stopTime) * 1e-9;
+
+        RtAudio::setStreamTime(streamTime);
+
+        if (running && *settledFrames == previousFrames) {
+          if (this->workerChannel != nullptr)
+            this->workerChannel->resume();
+
+          if (startBackend() != RTAUDIO_NO_ERROR)
+            return RtAudio::getErrorText();
+        }
+
+        return std::string();
+      },
+      [this, running, previousFrames, settledFrames](Napi::Env env) {
+        this->streamOperationPending = false;
+        this->startup.restarts++;
+        this->bufferFrames = *settledFrames;
+
+        if (this->bufferFrames != previousFrames) {
+          resizeStreamBuffers(env);
+
+          if (running) {
+            if (this->workerChannel != nullptr)
+              this->workerChannel->resume();
+
+            startBackend();
+          }
+        }
+
+        return Napi::Number::New(env, this->bufferFrames);
+      },
+      [this](Napi::Env env) {
+        this->streamOperationPending = false;
+
+        // The stream may have been closed, don't keep the object alive for it.
+        if (!RtAudio::isStreamOpen()) {
+          closeWorkerChannel();
+          finishClose();
+        }
+      }));
+}
+
+// After `reconfigureStream` settled on another period size, while the stream is stopped.
+// Playback, the decoder, the graph and mixer voices carry on with resized scratch
+// buffers, analysis starts over. Recording and encoding only carry on if their input
+// doesn't depend on the period size, otherwise they are stopped with an error event.
+void NodeRtAudio::resizeStreamBuffers(Napi::Env env) {
+  bool interleaved = !(this->options.flags & RTAUDIO_NONINTERLEAVED);
+  unsigned int frames = this->bufferFrames;
+
+  if (this->recorder.isRecording() && !this->recorder.acceptsPeriod(frames)) {
+    this->recorder.stop();
+    notifyResized(this->tsRecordingCb);
+    finishRecording();
+  }
+
+  if (this->encoder.isEncoding() && !this->encoder.acceptsPeriod(frames)) {
+    this->encoder.stop();
+    notifyResized(this->tsEncoderCb);
+    finishEncoder();
+  }
+
+  if (this->decoder.isDecoding() && !this->decoder.resize(frames)) {
+    this->decoder.stop();
+    notifyResized(this->tsDecoderCb);
+    finishDecoder();
+  }
+
+  this->player.resize(frames);
+  this->graph.resize(frames);
+
+  if (this->analyzer.isRunning()) {
+    this->analyzer.restart(frames);
+  }
+
+  allocateResamplers();
+  this->gate.configure(this->nodeOptions.gate, this->format, this->inputParams.nChannels,
+                       interleaved, this->bufferFrames, this->sampleRate);
+  allocateChannelMaps();
+
+  if (this->nodeOptions.mode != StreamMode::Buffered) {
+    allocateBufferPools(env);
+    allocateDeadlineBuffers();
+    allocateBatchBuffers();
+  }
+
+  this->mixer.resize(frames);
+}
+
+// Tells a native source's callback that it was stopped because the period size changed.
+void NodeRtAudio::notifyResized(const Napi::ThreadSafeFunction &tsfn) {
+  if (tsfn.operator napi_threadsafe_function() == nullptr)
+    return;
+
+  Napi::ThreadSafeFunction call = tsfn;
+
+  call.NonBlockingCall([](Napi::Env env, Napi::Function callback) {
+    try {
+      callback.Call({Napi::String::New(env, "error"),
+                     Napi::Error::New(env, "Stopped, the stream's buffer size changed")
+                         .Value()});
+    } catch (const std::exception &err) {
+      std::cerr << err.what() << std::endl;
+    }
+  });
+}
+
+Napi::Value NodeRtAudio::getStartupStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::Object result = Napi::Object::New(env);
+  int64_t firstCallback = this->startup.firstCallbackTime.load();
+
+  result.Set("open", this->startup.openDuration * 1e-6);
+  result.Set("start", this->startup.startDuration * 1e-6);
+
+  if (firstCallback != 0) {
+    result.Set("startToFirstCallback",
+               (firstCallback - this->startup.startRequestTime) * 1e-6);
+    result.Set("openToFirstCallback",
+               (firstCallback - this->startup.openRequestTime) * 1e-6);
+  } else {
+    result.Set("startToFirstCallback", env.Null());
+    result.Set("openToFirstCallback", env.Null());
+  }
+
+  result.Set("restarts", (double)this->startup.restarts);
+
+  return result;
+}
+
+void NodeRtAudio::checkStreamOperation(Napi::Env env) const {
+  if (this->streamOperationPending)
+    throw Napi::Error::New(env, "Another stream operation is in progress");
+}
+
+Napi::Value NodeRtAudio::getApiDisplayName(const Napi::CallbackInfo &info) {
+  return Napi::String::New(
+      info.Env(), RtAudio::getApiDisplayName(NodeRtAudio::parseApi(info.Env(), info[0])));
+}
+
+Napi::Value NodeRtAudio::getApiName(const Napi::CallbackInfo &info) {
+  return Napi::String::New(
+      info.Env(), RtAudio::getApiName(NodeRtAudio::parseApi(info.Env(), info[0])));
+}
+
+Napi::Value NodeRtAudio::getVersion(const Napi::CallbackInfo &info) {
+  return Napi::String::New(info.Env(), RtAudio::getVersion());
+}
+
+Napi::Value NodeRtAudio::getCompiledApi(const Napi::CallbackInfo &info) {
+  std::vector<RtAudio::Api> apis;
+
+  RtAudio::getCompiledApi(apis);
+
+  auto sampleRates = Napi::Array::New(info.Env(), apis.size());
+  for (unsigned int i = 0; i < apis.size(); i++) {
+    sampleRates[i] = Napi::Number::New(info.Env(), apis[i]);
+  }
+
+  return sampleRates;
+}
+
+void NodeRtAudio::convertSamples(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!info[0].IsTypedArray() || !info[2].IsTypedArray())
+    throw Napi::TypeError::New(env, "from and to should be TypedArrays");
+
+  if (!info[1].IsNumber() ||
+      sampleByteSize(info[1].As<Napi::Number>().Uint32Value()) == 0)
+    throw Napi::TypeError::New(env, "fromFormat should be a valid RtAudioFormat.");
+
+  if (!info[3].IsNumber() ||
+      sampleByteSize(info[3].As<Napi::Number>().Uint32Value()) == 0)
+    throw Napi::TypeError::New(env, "toFormat should be a valid RtAudioFormat.");
+
+  RtAudioFormat fromFormat = info[1].As<Napi::Number>().Uint32Value();
+  RtAudioFormat toFormat = info[3].As<Napi::Number>().Uint32Value();
+  bool dither = false;
+  bool reference = false;
+
+  if (info[4].IsObject()) {
+    Napi::Object obj = info[4].As<Napi::Object>();
+
+    if (!obj.Get("dither").IsUndefined()) {
+      if (!obj.Get("dither").IsBoolean())
+        throw Napi::TypeError::New(env, "options.dither should be a boolean.");
+
+      dither = obj.Get("dither").As<Napi::Boolean>();
+    }
+
+    if (!obj.Get("reference").IsUndefined()) {
+      if (!obj.Get("reference").IsBoolean())
+        throw Napi::TypeError::New(env, "options.reference should be a boolean.");
+
+      reference = obj.Get("reference").As<Napi::Boolean>();
+    }
+  }
+
+  size_t fromSize = 0;
+  size_t toSize = 0;
+  uint8_t *from = getTypedArrayData(env, info[0], &fromSize);
+  uint8_t *to = getTypedArrayData(env, info[2], &toSize);
+  size_t count =
+      std::min(fromSize / sampleByteSize(fromFormat), toSize / sampleByteSize(toFormat));
+  thread_local DitherState ditherState;
+
+  ::convertSamples(from, fromFormat, to, toFormat, count,
+                   dither ? &ditherState : nullptr, reference);
+}
+
+Napi::Value NodeRtAudio::getSampleConversionIsa(const Napi::CallbackInfo &info) {
+  return Napi::String::New(info.Env(), ::getSampleConversionIsa());
+}
+
+void NodeRtAudio::NodeRtAudio::parseOutputParams(Napi::Env env, const Napi::Value &val,
+                                                 RtAudio::StreamParameters *params) {
+  if (!val.IsObject()) {
+    throw Napi::TypeError::New(env, "outputParams should be an object or null.");
+  }
+
+  Napi::Object obj = val.As<Napi::Object>();
+
+  if (!obj.Get("deviceId").IsNumber() ||
+      obj.Get("deviceId").As<Napi::Number>().Int32Value() < 1) {
+    throw Napi::TypeError::New(
+        env, "outputParams.deviceId should be a number greater than 0. If you don't "
+             "intend to use an output stream, set outputParams to null");
+  }
+
+  params->deviceId = obj.Get("deviceId").As<Napi::Number>().Int32Value();
+
+  if (!obj.Get("nChannels").IsNumber() ||
+      obj.Get("nChannels").As<Napi::Number>().Int32Value() < 1) {
+    throw Napi::TypeError::New(
+        env, "outputParams.nChannels should be a number greater than 0. If you don't "
+             "intend to use an output stream, set outputParams to null");
+  }
+
+  params->nChannels = obj.Get("nChannels").As<Napi::Number>().Int32Value();
+
+  if (!obj.Get("firstChannel").IsUndefined()) {
+    if (!obj.Get("firstChannel").IsNumber()) {
+      throw Napi::TypeError::New(env, "outputParams.firstChannel should be a number.");
+    }
+
+    params->firstChannel = obj.Get("firstChannel").As<Napi::Number>().Int32Value();
+  }
+}
+
+void NodeRtAudio::parseInputParams(Napi::Env env, const Napi::Value &val,
+                                   RtAudio::StreamParameters *params) {
+  if (!val.IsObject()) {
+    throw Napi::TypeError::New(env, "inputParams should be an object or null.");
+  }
+
+  Napi::Object obj = val.As<Napi::Object>();
+
+  if (!obj.Get("deviceId").IsNumber() ||
+      obj.Get("deviceId").As<Napi::Number>().Int32Value() < 1) {
+    throw Napi::TypeError::New(
+        env, "inputParams.deviceId should be a number greater than 0. If you don't "
+             "intend to use an input stream, set outputParams to null");
+  }
+
+  params->deviceId = obj.Get("deviceId").As<Napi::Number>().Int32Value();
+
+  if (!obj.Get("nChannels").IsNumber() ||
+      obj.Get("nChannels").As<Napi::Number>().Int32Value() < 1) {
+    throw Napi::TypeError::New(
+        env, "inputParams.nChannels should be a number greater than 0. If you don't "
+             "intend to use an input stream, set outputParams to null");
+  }
+
+  params->nChannels = obj.Get("nChannels").As<Napi::Number>().Int32Value();
+
+  if (!obj.Get("firstChannel").IsUndefined()) {
+    if (!obj.Get("firstChannel").IsNumber()) {
+      throw Napi::TypeError::New(env, "inputParams.firstChannel should be a number.");
+    }
+    params->firstChannel = obj.Get("firstChannel").As<Napi::Number>().Int32Value();
+  }
+}
+
+void NodeRtAudio::parseStreamOptions(Napi::Env env, const Napi::Value &val,
+                                     RtAudio::StreamOptions *params,
+                                     NodeStreamOptions *nodeParams) {
+  if (!val.IsObject()) {
+    throw Napi::TypeError::New(env, "options should be an object or null.");
+  }
+
+  Napi::Object obj = val.As<Napi::Object>();
+
+  if (!obj.Get("flags").IsUndefined()) {
+    if (!obj.Get("flags").IsNumber()) {
+      throw Napi::TypeError::New(env, "options.flags should be a number.");
+    }
+
+    params->flags = obj.Get("flags").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("numberOfBuffers").IsUndefined()) {
+    if (!obj.Get("numberOfBuffers").IsNumber()) {
+      throw Napi::TypeError::New(env, "options.numberOfBuffers should be a number.");
+    }
+
+    params->numberOfBuffers = obj.Get("numberOfBuffers").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("priority").IsUndefined()) {
+    if (!obj.Get("priority").IsNumber()) {
+      throw Napi::TypeError::New(env, "options.priority should be a number.");
+    }
+
+    params->priority = obj.Get("priority").As<Napi::Number>().Int32Value();
+  }
+
+  if (!obj.Get("streamName").IsUndefined()) {
+    if (!obj.Get("streamName").IsString()) {
+      throw Napi::TypeError::New(env, "options.streamName should be a number.");
+    }
+
+    params->streamName = obj.Get("streamName").As<Napi::String>().Utf8Value();
+  }
+
+  if (!obj.Get("mode").IsUndefined()) {
+    if (!obj.Get("mode").IsNumber() ||
+        obj.Get("mode").As<Napi::Number>().Int32Value() < 0 ||
+        obj.Get("mode").As<Napi::Number>().Int32Value() >
+            static_cast<int>(StreamMode::Worker)) {
+      throw Napi::TypeError::New(env,
+                                 "options.mode should be a valid RtAudioStreamMode.");
+    }
+
+    nodeParams->mode =
+        static_cast<StreamMode>(obj.Get("mode").As<Napi::Number>().Int32Value());
+  }
+
+  if (!obj.Get("ringBufferFrames").IsUndefined()) {
+    if (!obj.Get("ringBufferFrames").IsNumber()) {
+      throw Napi::TypeError::New(env, "options.ringBufferFrames should be a number.");
+    }
+
+    nodeParams->ringBufferFrames =
+        obj.Get("ringBufferFrames").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("watermarkFrames").IsUndefined()) {
+    if (!obj.Get("watermarkFrames").IsNumber()) {
+      throw Napi::TypeError::New(env, "options.watermarkFrames should be a number.");
+    }
+
+    nodeParams->watermarkFrames =
+        obj.Get("watermarkFrames").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("bufferPoolSize").IsUndefined()) {
+    if (!obj.Get("bufferPoolSize").IsNumber()) {
+      throw Napi::TypeError::New(env, "options.bufferPoolSize should be a number.");
+    }
+
+    nodeParams->bufferPoolSize =
+        obj.Get("bufferPoolSize").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("periodsPerCallback").IsUndefined()) {
+    if (!obj.Get("periodsPerCallback").IsNumber() ||
+        obj.Get("periodsPerCallback").As<Napi::Number>().Int32Value() < 1) {
+      throw Napi::TypeError::New(
+          env, "options.periodsPerCallback should be a number greater than 0.");
+    }
+
+    nodeParams->periodsPerCallback =
+        obj.Get("periodsPerCallback").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("deadline").IsUndefined()) {
+    if (!obj.Get("deadline").IsNumber() ||
+        obj.Get("deadline").As<Napi::Number>().DoubleValue() < 0) {
+      throw Napi::TypeError::New(env, "options.deadline should be a positive number.");
+    }
+
+    nodeParams->deadline = obj.Get("deadline").As<Napi::Number>().DoubleValue();
+  }
+
+  if (!obj.Get("concealment").IsUndefined()) {
+    if (!obj.Get("concealment").IsNumber() ||
+        obj.Get("concealment").As<Napi::Number>().Int32Value() < 0 ||
+        obj.Get("concealment").As<Napi::Number>().Int32Value() >
+            static_cast<int>(Concealment::FadeOut)) {
+      throw Napi::TypeError::New(
+          env, "options.concealment should be a valid RtAudioConcealment.");
+    }
+
+    nodeParams->concealment =
+        static_cast<Concealment>(obj.Get("concealment").As<Napi::Number>().Int32Value());
+  }
+
+  if (!obj.Get("applyLateResults").IsUndefined()) {
+    if (!obj.Get("applyLateResults").IsBoolean()) {
+      throw Napi::TypeError::New(env, "options.applyLateResults should be a boolean.");
+    }
+
+    nodeParams->applyLateResults = obj.Get("applyLateResults").As<Napi::Boolean>();
+  }
+
+  if (!obj.Get("typedBuffers").IsUndefined()) {
+    if (!obj.Get("typedBuffers").IsBoolean()) {
+      throw Napi::TypeError::New(env, "options.typedBuffers should be a boolean.");
+    }
+
+    nodeParams->typedBuffers = obj.Get("typedBuffers").As<Napi::Boolean>();
+  }
+
+  if (!obj.Get("jsFormat").IsUndefined()) {
+    if (!obj.Get("jsFormat").IsNumber() ||
+        (obj.Get("jsFormat").As<Napi::Number>().Uint32Value() != 0 &&
+         sampleByteSize(obj.Get("jsFormat").As<Napi::Number>().Uint32Value()) == 0)) {
+      throw Napi::TypeError::New(env,
+                                 "options.jsFormat should be a valid RtAudioFormat.");
+    }
+
+    nodeParams->jsFormat = obj.Get("jsFormat").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("dither").IsUndefined()) {
+    if (!obj.Get("dither").IsBoolean()) {
+      throw Napi::TypeError::New(env, "options.dither should be a boolean.");
+    }
+
+    nodeParams->dither = obj.Get("dither").As<Napi::Boolean>();
+  }
+
+  if (!obj.Get("clientSampleRate").IsUndefined()) {
+    if (!obj.Get("clientSampleRate").IsNumber() ||
+        obj.Get("clientSampleRate").As<Napi::Number>().Int32Value() < 0) {
+      throw Napi::TypeError::New(env, "options.clientSampleRate should be a number.");
+    }
+
+    nodeParams->clientSampleRate =
+        obj.Get("clientSampleRate").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("maxVoices").IsUndefined()) {
+    if (!obj.Get("maxVoices").IsNumber() ||
+        obj.Get("maxVoices").As<Napi::Number>().Int64Value() < 0 ||
+        obj.Get("maxVoices").As<Napi::Number>().Int64Value() > Mixer::MaxVoices) {
+      throw Napi::TypeError::New(env, "options.maxVoices should be a number between 0 "
+                                      "and " +
+                                          std::to_string(Mixer::MaxVoices) + ".");
+    }
+
+    nodeParams->maxVoices = obj.Get("maxVoices").As<Napi::Number>().Uint32Value();
+  }
+
+  if (!obj.Get("inputChannelMap").IsUndefined()) {
+    if (!obj.Get("inputChannelMap").IsArray() ||
+        obj.Get("inputChannelMap").As<Napi::Array>().Length() == 0) {
+      throw Napi::TypeError::New(env,
+                                 "options.inputChannelMap should be a non-empty array.");
+    }
+
+    Napi::Array channels = obj.Get("inputChannelMap").As<Napi::Array>();
+
+    for (uint32_t i = 0; i < channels.Length(); i++) {
+      if (!channels.Get(i).IsNumber() ||
+          channels.Get(i).As<Napi::Number>().Int32Value() < 0) {
+        throw Napi::TypeError::New(
+            env, "options.inputChannelMap should only contain channel numbers.");
+      }
+
+      nodeParams->inputChannelMap.push_back(
+          channels.Get(i).As<Napi::Number>().Int32Value());
+    }
+  }
+
+  if (!obj.Get("outputChannelMap").IsUndefined()) {
+    if (!obj.Get("outputChannelMap").IsArray() ||
+        obj.Get("outputChannelMap").As<Napi::Array>().Length() == 0) {
+      throw Napi::TypeError::New(env,
+                                 "options.outputChannelMap should be a non-empty array.");
+    }
+
+    Napi::Array channels = obj.Get("outputChannelMap").As<Napi::Array>();
+
+    // Every entry is an output channel, or an array of them to duplicate the channel.
+    for (uint32_t i = 0; i < channels.Length(); i++) {
+      Napi::Value entry = channels.Get(i);
+      std::vector<unsigned int> targets;
+
+      if (entry.IsArray()) {
+        for (uint32_t j = 0; j < entry.As<Napi::Array>().Length(); j++) {
+          Napi::Value target = entry.As<Napi::Array>().Get(j);
+
+          if (!target.IsNumber() || target.As<Napi::Number>().Int32Value() < 0) {
+            throw Napi::TypeError::New(env, "options.outputChannelMap should only "
+                                            "contain channel numbers or arrays of them.");
+          }
+
+          targets.push_back(target.As<Napi::Number>().Uint32Value());
+        }
+      } else if (entry.IsNumber() && entry.As<Napi::Number>().Int32Value() >= 0) {
+        targets.push_back(entry.As<Napi::Number>().Uint32Value());
+      } else {
+        throw Napi::TypeError::New(env, "options.outputChannelMap should only contain "
+                                        "channel numbers or arrays of them.");
+      }
+
+      nodeParams->outputChannelMap.push_back(targets);
+    }
+  }
+
+  if (!obj.Get("gate").IsUndefined() && !obj.Get("gate").IsNull()) {
+    if (!obj.Get("gate").IsObject()) {
+      throw Napi::TypeError::New(env, "options.gate should be an object or null.");
+    }
+
+    Napi::Object gate = obj.Get("gate").As<Napi::Object>();
+    GateSettings *settings = &nodeParams->gate;
+
+    settings->enabled = true;
+
+    if (!gate.Get("threshold").IsUndefined()) {
+      if (!gate.Get("threshold").IsNumber()) {
+        throw Napi::TypeError::New(env, "options.gate.threshold should be a number.");
+      }
+
+      settings->threshold = gate.Get("threshold").As<Napi::Number>().DoubleValue();
+    }
+
+    settings->closeThreshold = settings->threshold - 6;
+
+    if (!gate.Get("closeThreshold").IsUndefined()) {
+      if (!gate.Get("closeThreshold").IsNumber() ||
+          gate.Get("closeThreshold").As<Napi::Number>().DoubleValue() >
+              settings->threshold) {
+        throw Napi::TypeError::New(
+            env, "options.gate.closeThreshold should be a number not above threshold.");
+      }
+
+      settings->closeThreshold =
+          gate.Get("closeThreshold").As<Napi::Number>().DoubleValue();
+    }
+
+    if (!gate.Get("hold").IsUndefined()) {
+      if (!gate.Get("hold").IsNumber() ||
+          gate.Get("hold").As<Napi::Number>().DoubleValue() < 0) {
+        throw Napi::TypeError::New(env, "options.gate.hold should be a positive number.");
+      }
+
+      settings->hold = gate.Get("hold").As<Napi::Number>().DoubleValue();
+    }
+
+    if (!gate.Get("preRoll").IsUndefined()) {
+      if (!gate.Get("preRoll").IsNumber() ||
+          gate.Get("preRoll").As<Napi::Number>().DoubleValue() < 0 ||
+          gate.Get("preRoll").As<Napi::Number>().DoubleValue() > 10) {
+        throw Napi::TypeError::New(env,
+                                   "options.gate.preRoll should be a number between 0 "
+                                   "and 10.");
+      }
+
+      settings->preRoll = gate.Get("preRoll").As<Napi::Number>().DoubleValue();
+    }
+
+    if (!gate.Get("vad").IsUndefined()) {
+      if (!gate.Get("vad").IsBoolean()) {
+        throw Napi::TypeError::New(env, "options.gate.vad should be a boolean.");
+      }
+
+      settings->vad = gate.Get("vad").As<Napi::Boolean>();
+    }
+
+    if (!gate.Get("callback").IsUndefined() && !gate.Get("callback").IsFunction()) {
+      throw Napi::TypeError::New(env, "options.gate.callback should be a function.");
+    }
+  }
+
+  if (!obj.Get("offline").IsUndefined() && !obj.Get("offline").IsNull()) {
+    if (!obj.Get("offline").IsObject()) {
+      throw Napi::TypeError::New(env, "options.offline should be an object or null.");
+    }
+
+    Napi::Object offline = obj.Get("offline").As<Napi::Object>();
+    OfflineSettings *settings = &nodeParams->offlineSettings;
+
+    nodeParams->offline = true;
+
+    if (!offline.Get("frames").IsUndefined()) {
+      if (!offline.Get("frames").IsNumber() ||
+          offline.Get("frames").As<Napi::Number>().DoubleValue() < 0) {
+        throw Napi::TypeError::New(env,
+                                   "options.offline.frames should be a positive number.");
+      }
+
+      settings->frames = offline.Get("frames").As<Napi::Number>().Int64Value();
+    }
+
+    // A file path, or interleaved samples in the stream format that are copied.
+    if (offline.Get("input").IsString()) {
+      settings->inputPath = offline.Get("input").As<Napi::String>().Utf8Value();
+    } else if (offline.Get("input").IsTypedArray()) {
+      size_t byteLength = 0;
+      uint8_t *data = getTypedArrayData(env, offline.Get("input"), &byteLength);
+
+      settings->inputSamples.assign(data, data + byteLength);
+    } else if (!offline.Get("input").IsUndefined()) {
+      throw Napi::TypeError::New(
+          env, "options.offline.input should be a string or a typed array.");
+    }
+
+    if (!offline.Get("inputContainer").IsUndefined()) {
+      std::string container =
+          offline.Get("inputContainer").IsString()
+              ? offline.Get("inputContainer").As<Napi::String>().Utf8Value()
+              : "";
+
+      if (container != "wav" && container != "raw")
+        throw Napi::TypeError::New(env,
+                                   "options.offline.inputContainer should be 'wav' or "
+                                   "'raw'.");
+
+      settings->inputRaw = container == "raw";
+    }
+
+    if (!offline.Get("output").IsUndefined()) {
+      if (!offline.Get("output").IsString()) {
+        throw Napi::TypeError::New(env, "options.offline.output should be a string.");
+      }
+
+      settings->outputPath = offline.Get("output").As<Napi::String>().Utf8Value();
+    }
+
+    if (!offline.Get("outputContainer").IsUndefined()) {
+      std::string container =
+          offline.Get("outputContainer").IsString()
+              ? offline.Get("outputContainer").As<Napi::String>().Utf8Value()
+              : "";
+
+      if (container != "wav" && container != "raw")
+        throw Napi::TypeError::New(env,
+                                   "options.offline.outputContainer should be 'wav' or "
+                                   "'raw'.");
+
+      settings->outputContainer =
+          container == "wav" ? RecordingContainer::Wav : RecordingContainer::Raw;
+    }
+
+    if (!offline.Get("keepOutput").IsUndefined()) {
+      if (!offline.Get("keepOutput").IsBoolean()) {
+        throw Napi::TypeError::New(env,
+                                   "options.offline.keepOutput should be a boolean.");
+      }
+
+      settings->keepOutput = offline.Get("keepOutput").As<Napi::Boolean>();
+    }
+
+    if (!offline.Get("callback").IsUndefined() && !offline.Get("callback").IsFunction()) {
+      throw Napi::TypeError::New(env, "options.offline.callback should be a function.");
+    }
+
+    // The kept output is handed to the callback.
+    if (settings->keepOutput && !offline.Get("callback").IsFunction()) {
+      throw Napi::TypeError::New(env, "options.offline.keepOutput needs a callback.");
+    }
+  }
+
+  if (!obj.Get("resamplerQuality").IsUndefined()) {
+    if (!obj.Get("resamplerQuality").IsNumber() ||
+        obj.Get("resamplerQuality").As<Napi::Number>().Int32Value() < 0 ||
+        obj.Get("resamplerQuality").As<Napi::Number>().Int32Value() >
+            static_cast<int>(ResamplerQuality::Best)) {
+      throw Napi::TypeError::New(
+          env, "options.resamplerQuality should be a valid RtAudioResamplerQuality.");
+    }
+
+    nodeParams->resamplerQuality = static_cast<ResamplerQuality>(
+        obj.Get("resamplerQuality").As<Napi::Number>().Int32Value());
+  }
+}
+
+RtAudio::Api NodeRtAudio::parseApi(Napi::Env env, const Napi::Value &val) {
+  if (val.IsUndefined()) {
+    return RtAudio::UNSPECIFIED;
+  }
+
+  if (!val.IsNumber() || val.As<Napi::Number>().Int32Value() < 0 ||
+      val.As<Napi::Number>().Int32Value() > RtAudio::Api::RTAUDIO_DUMMY) {
+    throw Napi::TypeError::New(env, "The api should be a number between 0 and 9.");
+  }
+
+  return static_cast<RtAudio::Api>(val.As<Napi::Number>().Int32Value());
+}
+
+RtAudio::Api NodeRtAudio::resolveApi(RtAudio::Api api) {
+  if (api != RtAudio::UNSPECIFIED) {
+    return api;
+  }
+
+  // RtAudio searches JACK before PulseAudio, keep PulseAudio the default on Linux as
+  // long as it has devices. With a JACK server running (or PipeWire's libjack) the
+  // search would pick JACK otherwise.
+  std::vector<RtAudio::Api> apis;
+  RtAudio::getCompiledApi(apis);
+
+  if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_PULSE) != apis.end()) {
+    RtAudio pulse(RtAudio::LINUX_PULSE);
+    pulse.showWarnings(false);
+
+    if (pulse.getDeviceCount() > 0) {
+      return RtAudio::LINUX_PULSE;
+    }
+  }
+
+  return api;
 }
 
 unsigned int NodeRtAudio::getFormatByteSize(RtAudioFormat format) {
@@ -522,11 +4291,14 @@ unsigned int NodeRtAudio::getFormatByteSize(RtAudioFormat format) {
 }
 
 bool NodeRtAudio::deviceExists(unsigned int id,
-                               const std::vector<unsigned int> &devices) {
-  return std::find(devices.begin(), devices.end(), id) != devices.end();
+                               const std::vector<RtAudio::DeviceInfo> &devices) {
+  return std::find_if(devices.begin(), devices.end(),
+                      [id](const RtAudio::DeviceInfo &device) {
+                        return device.ID == id;
+                      }) != devices.end();
 }
 
 // A little hack here to avoid using `NodeRtAudio::` in the macro call below.
 auto &NodeRtAudioAddonInit = NodeRtAudio::Init;
 
-NODE_API_MODULE(NodeRtAudio, NodeRtAudioAddonInit)
\ No newline at end of file
+NODE_API_MODULE(NodeRtAudio, NodeRtAudioAddonInit)
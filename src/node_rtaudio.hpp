@@ -1,12 +1,93 @@
 #ifndef __NODE_ADDON_NODE_RTAUDIO_H__
 #define __NODE_ADDON_NODE_RTAUDIO_H__
 
+#include "analyzer.hpp"
+#include "buffer_pool.hpp"
+#include "channel_map.hpp"
+#include "decoder_source.hpp"
+#include "device_watcher.hpp"
+#include "dsp_graph.hpp"
+#include "encoder_tap.hpp"
+#include "file_player.hpp"
+#include "file_recorder.hpp"
+#include "mixer.hpp"
+#include "resampler.hpp"
+#include "ring_buffer.hpp"
+#include "rtapi_offline.hpp"
+#include "sample_format.hpp"
+#include "silence_gate.hpp"
+#include "stream_clock.hpp"
+#include "stream_stats.hpp"
+#include "worker_channel.hpp"
 #include <RtAudio.h>
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <napi.h>
 #include <queue>
 #include <semaphore>
 #include <shared_mutex>
 
+// Stream status flag set by the binding: an earlier period missed its deadline and was
+// concealed natively.
+static const RtAudioStreamStatus RTAUDIO_DEADLINE_MISSED = 0x10;
+
+// How the realtime thread exchanges audio with JS.
+enum class StreamMode {
+  // Every period is handed to the JS callback and the realtime thread waits for it.
+  Callback = 0,
+  // The realtime thread only moves data through the ring buffers, JS pushes and pulls
+  // frames through `write`/`read` at its own pace.
+  Buffered = 1,
+  // The callback runs in a worker_threads Worker, audio is exchanged through
+  // SharedArrayBuffer blocks, see `WorkerChannel`.
+  Worker = 2,
+};
+
+// What is played instead when the JS callback misses its deadline.
+enum class Concealment {
+  Silence = 0,
+  // Repeat the last output buffer.
+  Repeat = 1,
+  // Fade the last output buffer out, then play silence.
+  FadeOut = 2,
+};
+
+// Stream options that are handled by the binding rather than by RtAudio.
+struct NodeStreamOptions {
+  StreamMode mode = StreamMode::Callback;
+  unsigned int ringBufferFrames = 0;
+  unsigned int watermarkFrames = 0;
+  unsigned int bufferPoolSize = 0;
+  bool typedBuffers = false;
+  // Fraction of a period the realtime thread waits for JS, 0 = forever.
+  double deadline = 0;
+  Concealment concealment = Concealment::Silence;
+  bool applyLateResults = false;
+  // Device periods handed to JS per callback, see `invokeJsCallbackBatched`.
+  unsigned int periodsPerCallback = 1;
+  // Sample format of the buffers JS works with, 0 = the stream format. Samples are
+  // converted on the way in and out, see `convertSamples`.
+  RtAudioFormat jsFormat = 0;
+  bool dither = false;
+  // Sample rate of the buffers JS works with, 0 = the stream rate. See
+  // `invokeJsCallbackResampled`.
+  unsigned int clientSampleRate = 0;
+  ResamplerQuality resamplerQuality = ResamplerQuality::Medium;
+  // Voice slots of the output mixer, see `createVoice`.
+  unsigned int maxVoices = 32;
+  // Skips JS calls for silent input periods, see `invokeJsCallbackGated`.
+  GateSettings gate;
+  // The input channel of every JS input channel, empty = all of them in order.
+  std::vector<int> inputChannelMap;
+  // The output channels every JS output channel is played on, empty = all of them in
+  // order.
+  std::vector<std::vector<unsigned int>> outputChannelMap;
+  // Renders through `RtApiOffline` instead of the devices, see `offline`.
+  bool offline = false;
+  OfflineSettings offlineSettings;
+};
+
 class NodeRtAudio : public RtAudio, public Napi::ObjectWrap<NodeRtAudio> {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
@@ -19,11 +100,19 @@ public:
   void setErrorCallback(const Napi::CallbackInfo &info);
   void showWarnings(const Napi::CallbackInfo &info);
   Napi::Value openStream(const Napi::CallbackInfo &info);
+  Napi::Value openStreamAsync(const Napi::CallbackInfo &info);
   void closeStream(const Napi::CallbackInfo &info);
+  Napi::Value closeStreamAsync(const Napi::CallbackInfo &info);
   void startStream(const Napi::CallbackInfo &info);
+  Napi::Value startStreamAsync(const Napi::CallbackInfo &info);
   void stopStream(const Napi::CallbackInfo &info);
+  Napi::Value stopStreamAsync(const Napi::CallbackInfo &info);
   void abortStream(const Napi::CallbackInfo &info);
+  Napi::Value reconfigureStream(const Napi::CallbackInfo &info);
+  Napi::Value getStartupStats(const Napi::CallbackInfo &info);
   Napi::Value getDevices(const Napi::CallbackInfo &info);
+  Napi::Value getDevicesAsync(const Napi::CallbackInfo &info);
+  void setDeviceChangeCallback(const Napi::CallbackInfo &info);
   Napi::Value getDefaultInputDevice(const Napi::CallbackInfo &info);
   Napi::Value getDefaultOutputDevice(const Napi::CallbackInfo &info);
   Napi::Value isStreamOpen(const Napi::CallbackInfo &info);
@@ -34,40 +123,300 @@ public:
   Napi::Value getStreamTime(const Napi::CallbackInfo &info);
   void setStreamTime(const Napi::CallbackInfo &info);
   Napi::Value getErrorText(const Napi::CallbackInfo &info);
+  Napi::Value write(const Napi::CallbackInfo &info);
+  Napi::Value read(const Napi::CallbackInfo &info);
+  Napi::Value getBufferedFrames(const Napi::CallbackInfo &info);
+  Napi::Value getDeadlineMisses(const Napi::CallbackInfo &info);
+  Napi::Value getStreamStats(const Napi::CallbackInfo &info);
+  void resetStreamStats(const Napi::CallbackInfo &info);
+  void startRecording(const Napi::CallbackInfo &info);
+  Napi::Value stopRecording(const Napi::CallbackInfo &info);
+  Napi::Value startPlayback(const Napi::CallbackInfo &info);
+  void stopPlayback(const Napi::CallbackInfo &info);
+  void seekPlayback(const Napi::CallbackInfo &info);
+  Napi::Value getPlaybackPosition(const Napi::CallbackInfo &info);
+  void startEncoder(const Napi::CallbackInfo &info);
+  Napi::Value stopEncoder(const Napi::CallbackInfo &info);
+  void startDecoder(const Napi::CallbackInfo &info);
+  Napi::Value queueEncoded(const Napi::CallbackInfo &info);
+  Napi::Value stopDecoder(const Napi::CallbackInfo &info);
+  void setWorkerBuffers(const Napi::CallbackInfo &info);
+  Napi::Value createVoice(const Napi::CallbackInfo &info);
+  Napi::Value queueVoice(const Napi::CallbackInfo &info);
+  Napi::Value setVoiceGain(const Napi::CallbackInfo &info);
+  Napi::Value setVoicePan(const Napi::CallbackInfo &info);
+  Napi::Value removeVoice(const Napi::CallbackInfo &info);
+  Napi::Value getVoiceQueuedFrames(const Napi::CallbackInfo &info);
+  Napi::Value getMixerStats(const Napi::CallbackInfo &info);
+  Napi::Value loadClip(const Napi::CallbackInfo &info);
+  Napi::Value unloadClip(const Napi::CallbackInfo &info);
+  Napi::Value scheduleClip(const Napi::CallbackInfo &info);
+  Napi::Value getStreamClock(const Napi::CallbackInfo &info);
+  void setProcessingGraph(const Napi::CallbackInfo &info);
+  Napi::Value setGraphParameter(const Napi::CallbackInfo &info);
+  Napi::Value startAnalysis(const Napi::CallbackInfo &info);
+  void stopAnalysis(const Napi::CallbackInfo &info);
+  Napi::Value getGateStats(const Napi::CallbackInfo &info);
+  Napi::Value getOfflineProgress(const Napi::CallbackInfo &info);
 
 public:
   static Napi::Value getVersion(const Napi::CallbackInfo &info);
   static Napi::Value getApiDisplayName(const Napi::CallbackInfo &info);
   static Napi::Value getApiName(const Napi::CallbackInfo &info);
   static Napi::Value getCompiledApi(const Napi::CallbackInfo &info);
+  static void convertSamples(const Napi::CallbackInfo &info);
+  static Napi::Value getSampleConversionIsa(const Napi::CallbackInfo &info);
+  static RtAudio::Api parseApi(Napi::Env env, const Napi::Value &val);
+  static RtAudio::Api resolveApi(RtAudio::Api api);
 
 private:
+  static int64_t parseVoiceId(Napi::Env env, const Napi::Value &val);
+  static void parseVoiceOptions(Napi::Env env, const Napi::Object &obj,
+                                VoiceSettings *settings);
+  static void parseCodecOptions(Napi::Env env, const Napi::Object &obj,
+                                unsigned int streamChannels, CodecSettings *settings);
+  static MixerClip parseClipSamples(Napi::Env env, const Napi::Value &val,
+                                    unsigned int channels);
+  static void parseGraphNode(Napi::Env env, const Napi::Value &val, unsigned int index,
+                             DspNodeSettings *settings);
   static void parseOutputParams(Napi::Env env, const Napi::Value &val,
                                 RtAudio::StreamParameters *params);
   static void parseInputParams(Napi::Env env, const Napi::Value &val,
                                RtAudio::StreamParameters *params);
   static void parseStreamOptions(Napi::Env env, const Napi::Value &val,
-                                 RtAudio::StreamOptions *params);
-  static RtAudio::Api parseApi(Napi::Env env, const Napi::Value &val);
+                                 RtAudio::StreamOptions *params,
+                                 NodeStreamOptions *nodeParams);
   static unsigned int getFormatByteSize(RtAudioFormat format);
-  static bool deviceExists(unsigned int id, const std::vector<unsigned int> &devices);
+  static bool deviceExists(unsigned int id,
+                           const std::vector<RtAudio::DeviceInfo> &devices);
+  RtApi *getDeviceApi() const;
+  std::vector<RtAudio::DeviceInfo> queryDevices();
+  void updateDeviceCache(const std::vector<RtAudio::DeviceInfo> &devices);
+  static Napi::Array createDeviceArray(Napi::Env env,
+                                       const std::vector<RtAudio::DeviceInfo> &devices);
+  void beginOpen(const Napi::CallbackInfo &info);
+  RtAudioErrorType openBackend(unsigned int *bufferFrames);
+  void finishOpen(Napi::Env env);
+  void abandonOpen();
+  RtAudioErrorType startBackend();
+  void finishClose();
+  void resizeStreamBuffers(Napi::Env env);
+  static void notifyResized(const Napi::ThreadSafeFunction &tsfn);
+  void checkStreamOperation(Napi::Env env) const;
+  static int streamCallback(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                            double streamTime, RtAudioStreamStatus status,
+                            void *userData);
+  int invokeJsCallback(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                       double streamTime, RtAudioStreamStatus status);
+  int invokeJsCallbackWithDeadline(void *outputBuffer, void *inputBuffer,
+                                   unsigned int nFrames, double streamTime,
+                                   RtAudioStreamStatus status);
+  int invokeJsCallbackBatched(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                              double streamTime, RtAudioStreamStatus status);
+  int invokeJsCallbackResampled(void *outputBuffer, void *inputBuffer,
+                                unsigned int nFrames, double streamTime,
+                                RtAudioStreamStatus status);
+  int invokeJsCallbackGated(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                            double streamTime, RtAudioStreamStatus status);
+  void allocateResamplers();
+  void allocateChannelMaps();
+  void copyInputToJs(const void *inputBuffer, void *to, unsigned int nFrames,
+                     DitherState *dither);
+  void copyOutputFromJs(const void *from, void *outputBuffer, unsigned int nFrames,
+                        DitherState *dither);
+  unsigned int getCallbackFrames() const;
+  void allocateBatchBuffers();
+  napi_status callJs(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                     double streamTime, RtAudioStreamStatus status, bool blocking);
+  void concealOutput(void *outputBuffer, unsigned int nFrames);
+  void allocateDeadlineBuffers();
+  int exchangeRingBuffers(void *outputBuffer, void *inputBuffer, unsigned int nFrames);
+  int exchangeWorkerBuffers(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                            double streamTime, RtAudioStreamStatus status);
+  void closeWorkerChannel();
+  RecordingProgress finishRecording();
+  void finishPlayback();
+  EncoderStats finishEncoder();
+  DecoderStats finishDecoder();
+  void finishAnalysis();
+  void openOfflineApi();
+  void closeOfflineApi();
+  void closeOfflineStream();
+  Napi::Object createOfflineObject(Napi::Env env, const OfflineProgress &progress) const;
+  static Napi::Object createRecordingObject(Napi::Env env,
+                                            const RecordingProgress &progress);
+  static Napi::Object createEncoderObject(Napi::Env env, const EncoderStats &stats);
+  static Napi::Object createDecoderObject(Napi::Env env, const DecoderStats &stats);
+  void allocateRingBuffers();
+  void allocateBufferPools(Napi::Env env);
+  Napi::Object createBufferView(Napi::ArrayBuffer buffer, unsigned int nChannels,
+                                size_t byteCount = 0);
+  static Napi::Object createHistogramObject(Napi::Env env,
+                                            const LatencyHistogram &histogram);
+  static Napi::TypedArray createTypedArray(Napi::Env env, RtAudioFormat format,
+                                           Napi::ArrayBuffer buffer, size_t byteOffset,
+                                           size_t byteCount);
   std::binary_semaphore rtThreadSmph;
   std::binary_semaphore jsThreadSmph;
 
 private:
   Napi::ThreadSafeFunction tsCb;
   Napi::ThreadSafeFunction tsErrorCb;
+  // Kept to hand it to the offline API, which is created per stream.
+  RtAudioErrorCallback errorCallback;
+  bool warnings;
   RtAudioFormat format;
+  // The format of the buffers JS sees, `format` unless `jsFormat` is set.
+  RtAudioFormat jsFormat;
+  // The format of the buffers handed to `callJs`, float32 while resampling.
+  RtAudioFormat callbackFormat;
+  DitherState dither;
   RtAudio::StreamOptions options;
+  NodeStreamOptions nodeOptions;
   RtAudio::StreamParameters inputParams;
   RtAudio::StreamParameters outputParams;
   unsigned int sampleRate;
   unsigned int bufferFrames;
   int jsCallbackReturnValue;
 
+  // Buffered mode state. `outputRing` is fed by JS and drained by the realtime thread,
+  // `inputRing` the other way around.
+  RingBuffer outputRing;
+  RingBuffer inputRing;
+  std::atomic<bool> watermarkPending;
+  // Device format staging for `write`/`read` when `jsFormat` differs.
+  std::vector<uint8_t> conversionBuffer;
+
+  // Callback mode buffers that are reused across periods, see `bufferPoolSize`.
+  BufferPool outputPool;
+  BufferPool inputPool;
+
+  // Deadline state, see `deadline`. The JS thread only touches the staging buffers, and
+  // only while a call is in flight.
+  std::vector<uint8_t> stagingOutput;
+  std::vector<uint8_t> stagingInput;
+  std::vector<uint8_t> lastOutput;
+  bool jsCallInFlight;
+  bool lateOutputReady;
+  bool deadlineMissPending;
+  unsigned int consecutiveMisses;
+
+  // Batching state, see `periodsPerCallback`. The realtime thread plays and captures
+  // through one pair of blocks while JS works on the other.
+  std::vector<uint8_t> batchOutput[2];
+  std::vector<uint8_t> batchInput[2];
+  unsigned int batchSide;
+  unsigned int batchPeriod;
+  bool batchCallInFlight;
+  double batchStreamTime;
+  RtAudioStreamStatus batchStatus;
+
+  // Resampling state, see `clientSampleRate`. The client buffers hold float32 samples
+  // at the client rate, `clientFrameRemainder` carries the rounding between periods.
+  Resampler inputResampler;
+  Resampler outputResampler;
+  std::vector<float> resampleScratch;
+  std::vector<float> clientOutput;
+  std::vector<float> clientInput;
+  unsigned long long clientFrameRemainder;
+  bool resampling;
+
+  // Channel maps of callback mode, see `inputChannelMap`. JS buffers have
+  // `jsInputChannels`/`jsOutputChannels` channels, the mapped buffers hold them in
+  // `callbackFormat` when it differs from `jsFormat`.
+  ChannelMap inputMap;
+  ChannelMap outputMap;
+  std::vector<uint8_t> mappedInput;
+  std::vector<uint8_t> mappedOutput;
+  unsigned int jsInputChannels;
+  unsigned int jsOutputChannels;
+
+  // See `getStreamStats`. `dispatchTime` is when the realtime thread last handed a
+  // period to JS.
+  StreamStats stats;
+  std::atomic<int64_t> dispatchTime;
+
+  // Worker mode hand-off, and the SharedArrayBuffer views it points into.
+  std::shared_ptr<WorkerChannel> workerChannel;
+  Napi::ObjectReference workerBuffersRef;
+
+  // Native recording of the stream input, see `startRecording`.
+  FileRecorder recorder;
+  Napi::ThreadSafeFunction tsRecordingCb;
+
+  // Native playback into the stream output, see `startPlayback`.
+  FilePlayer player;
+  Napi::ThreadSafeFunction tsPlaybackCb;
+
+  // Native Opus/FLAC encoding of the stream input and decoding into the output, see
+  // `startEncoder` and `startDecoder`.
+  EncoderTap encoder;
+  Napi::ThreadSafeFunction tsEncoderCb;
+  DecoderSource decoder;
+  Napi::ThreadSafeFunction tsDecoderCb;
+
+  // Voices mixed into the stream output, see `createVoice`. Clips loaded with `loadClip`
+  // outlive streams.
+  Mixer mixer;
+  std::map<uint32_t, std::pair<MixerClip, unsigned int>> clips;
+  uint32_t nextClipId;
+
+  // Stream frames to `process.hrtime`, see `getStreamClock`.
+  StreamClock clock;
+
+  // Native processing of the stream, see `setProcessingGraph`.
+  ProcessingGraph graph;
+
+  // Native metering, see `startAnalysis`. `analysisGeneration` tells results of an
+  // earlier analysis that are still queued for JS apart.
+  Analyzer analyzer;
+  Napi::ThreadSafeFunction tsAnalysisCb;
+  Napi::ObjectReference analysisResultsRef;
+  uint64_t analysisGeneration;
+
+  // Silence gate of callback mode input streams, see `gate`. `tsGateCb` gets the open
+  // and close events.
+  SilenceGate gate;
+  Napi::ThreadSafeFunction tsGateCb;
+
+  // Device enumeration, see `getDevicesAsync`. `deviceMutex` serializes RtAudio's
+  // device queries, which also run on libuv workers and the watcher thread. The cache
+  // is only touched on the JS thread.
+  std::mutex deviceMutex;
+  std::vector<RtAudio::DeviceInfo> deviceCache;
+  bool deviceCacheValid;
+  DeviceWatcher deviceWatcher;
+  Napi::ThreadSafeFunction tsDeviceCb;
+
+  // Offline rendering, see `offline`. While an offline stream is open `rtapi_` is
+  // `offlineApi` and `deviceApi` holds the API of the devices. `offlineGeneration`
+  // tells end events of an earlier offline stream apart.
+  RtApi *deviceApi;
+  RtApiOffline *offlineApi;
+  Napi::ThreadSafeFunction tsOfflineCb;
+  uint64_t offlineGeneration;
+
+  // `options` is passed to RtAudio, `openStream` got stream options.
+  bool hasStreamOptions;
+
+  // Set while an `*Async` method or `reconfigureStream` runs the backend on a worker,
+  // the other stream methods throw meanwhile.
+  bool streamOperationPending;
+
+  // See `getStartupStats`, times from `StreamStats::now`. `firstCallbackTime` is set by
+  // the realtime thread on the first callback after a start.
+  struct {
+    int64_t openRequestTime = 0;
+    int64_t openDuration = 0;
+    int64_t startRequestTime = 0;
+    int64_t startDuration = 0;
+    std::atomic<int64_t> firstCallbackTime{0};
+    uint64_t restarts = 0;
+  } startup;
+
   // To keep the object alive (even if gets eligible for gc) when open is called, but
   // close hasn't called yet.
   Napi::ObjectReference jsRef;
 };
 
-#endif
\ No newline at end of file
+#endif
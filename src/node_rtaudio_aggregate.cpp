@@ -0,0 +1,392 @@
+#include "node_rtaudio_aggregate.hpp"
+#include "node_rtaudio.hpp"
+#include "rtapi_loopback.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// An RtAudio that backs the dummy API with the loopback device, like `NodeRtAudio`.
+class AggregateStream : public RtAudio {
+public:
+  AggregateStream(RtAudio::Api api) : RtAudio(api) {
+    if (RtAudio::getCurrentApi() == RtAudio::RTAUDIO_DUMMY) {
+      delete this->rtapi_;
+      this->rtapi_ = new RtApiLoopback();
+    }
+  }
+};
+
+} // namespace
+
+Napi::Object NodeRtAudioAggregate::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func = DefineClass(
+      env, "NodeRtAudioAggregate",
+      {
+          InstanceMethod<&NodeRtAudioAggregate::openStream>(
+              "openStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioAggregate::closeStream>(
+              "closeStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioAggregate::startStream>(
+              "startStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioAggregate::stopStream>(
+              "stopStream", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioAggregate::isStreamOpen>(
+              "isStreamOpen", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioAggregate::isStreamRunning>(
+              "isStreamRunning", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioAggregate::getStreamLatency>(
+              "getStreamLatency", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioAggregate::getDriftStats>(
+              "getDriftStats", static_cast<napi_property_attributes>(napi_default)),
+      });
+
+  exports.Set("NodeRtAudioAggregate", func);
+
+  return exports;
+}
+
+NodeRtAudioAggregate::NodeRtAudioAggregate(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<NodeRtAudioAggregate>(info),
+      api(NodeRtAudio::resolveApi(NodeRtAudio::parseApi(info.Env(), info[0]))),
+      bufferFrames(0), nChannels(0),
+      rtThreadSmph{0}, jsThreadSmph{0}, jsCallbackReturnValue(0) {}
+
+NodeRtAudioAggregate::~NodeRtAudioAggregate() {
+  if (tsCb.operator napi_threadsafe_function() != nullptr) {
+    tsCb.Abort();
+    tsCb.Release();
+    tsCb.Unref(this->Env());
+  }
+
+  closeStreams();
+}
+
+Napi::Value NodeRtAudioAggregate::openStream(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!this->streams.empty())
+    throw Napi::Error::New(env, "Stream already open");
+
+  if (!info[0].IsArray() || info[0].As<Napi::Array>().Length() == 0)
+    throw Napi::TypeError::New(env, "devices should be a non-empty array.");
+
+  if (!info[1].IsNumber())
+    throw Napi::Error::New(env, "sampleRate should be a valid number");
+
+  if (!info[2].IsNumber())
+    throw Napi::Error::New(env, "bufferFrames should be a valid number");
+
+  if (!info[4].IsFunction() && !info[4].IsNull() && !info[4].IsUndefined())
+    throw Napi::Error::New(env, "callback should be a function or null");
+
+  Napi::Array devicesArray = info[0].As<Napi::Array>();
+  std::vector<RtAudio::StreamParameters> params;
+
+  for (uint32_t i = 0; i < devicesArray.Length(); i++) {
+    if (!devicesArray.Get(i).IsObject())
+      throw Napi::TypeError::New(env, "devices should be an array of objects.");
+
+    Napi::Object obj = devicesArray.Get(i).As<Napi::Object>();
+    RtAudio::StreamParameters param;
+
+    if (!obj.Get("deviceId").IsNumber() ||
+        obj.Get("deviceId").As<Napi::Number>().Int32Value() < 1)
+      throw Napi::TypeError::New(env, "devices[].deviceId should be a number greater "
+                                      "than 0.");
+
+    if (!obj.Get("nChannels").IsNumber() ||
+        obj.Get("nChannels").As<Napi::Number>().Int32Value() < 1)
+      throw Napi::TypeError::New(env, "devices[].nChannels should be a number greater "
+                                      "than 0.");
+
+    if (!obj.Get("firstChannel").IsUndefined() && !obj.Get("firstChannel").IsNumber())
+      throw Napi::TypeError::New(env, "devices[].firstChannel should be a number.");
+
+    param.deviceId = obj.Get("deviceId").As<Napi::Number>().Uint32Value();
+    param.nChannels = obj.Get("nChannels").As<Napi::Number>().Uint32Value();
+    param.firstChannel = obj.Get("firstChannel").IsNumber()
+                             ? obj.Get("firstChannel").As<Napi::Number>().Uint32Value()
+                             : 0;
+    params.push_back(param);
+  }
+
+  RtAudio::StreamOptions options;
+  bool driftCorrection = true;
+
+  if (info[3].IsObject()) {
+    Napi::Object obj = info[3].As<Napi::Object>();
+
+    if (!obj.Get("flags").IsUndefined()) {
+      if (!obj.Get("flags").IsNumber())
+        throw Napi::TypeError::New(env, "options.flags should be a number.");
+
+      options.flags = obj.Get("flags").As<Napi::Number>().Uint32Value();
+    }
+
+    if (!obj.Get("numberOfBuffers").IsUndefined()) {
+      if (!obj.Get("numberOfBuffers").IsNumber())
+        throw Napi::TypeError::New(env, "options.numberOfBuffers should be a number.");
+
+      options.numberOfBuffers =
+          obj.Get("numberOfBuffers").As<Napi::Number>().Uint32Value();
+    }
+
+    if (!obj.Get("streamName").IsUndefined()) {
+      if (!obj.Get("streamName").IsString())
+        throw Napi::TypeError::New(env, "options.streamName should be a string.");
+
+      options.streamName = obj.Get("streamName").As<Napi::String>().Utf8Value();
+    }
+
+    if (!obj.Get("driftCorrection").IsUndefined()) {
+      if (!obj.Get("driftCorrection").IsBoolean())
+        throw Napi::TypeError::New(env, "options.driftCorrection should be a boolean.");
+
+      driftCorrection = obj.Get("driftCorrection").As<Napi::Boolean>();
+    }
+  }
+
+  // The aggregate frame is interleaved, and so are the rings.
+  options.flags &= ~RTAUDIO_NONINTERLEAVED;
+
+  unsigned int sampleRate = info[1].As<Napi::Number>().Uint32Value();
+  unsigned int requestedFrames = info[2].As<Napi::Number>().Uint32Value();
+
+  this->params = params;
+  this->nChannels = 0;
+
+  for (size_t i = 0; i < params.size(); i++) {
+    std::unique_ptr<RtAudio> stream = std::make_unique<AggregateStream>(this->api);
+    unsigned int frames = requestedFrames;
+    RtAudioErrorType result;
+
+    if (i == 0) {
+      result = stream->openStream(nullptr, &this->params[i], RTAUDIO_FLOAT32, sampleRate,
+                                  &frames, &NodeRtAudioAggregate::masterCallback, this,
+                                  &options);
+      this->bufferFrames = frames;
+    } else {
+      auto device = std::make_unique<AggregateDevice>();
+      result = stream->openStream(nullptr, &this->params[i], RTAUDIO_FLOAT32, sampleRate,
+                                  &frames, &NodeRtAudioAggregate::deviceCallback,
+                                  device.get(), &options);
+      device->configure(params[i].nChannels, frames, this->bufferFrames, driftCorrection);
+      this->devices.push_back(std::move(device));
+    }
+
+    if (result != RTAUDIO_NO_ERROR) {
+      std::string error = stream->getErrorText();
+      closeStreams();
+      throw Napi::Error::New(env, "Device " + std::to_string(params[i].deviceId) + ": " +
+                                      error);
+    }
+
+    this->streams.push_back(std::move(stream));
+    this->nChannels += params[i].nChannels;
+  }
+
+  this->frame.assign((size_t)this->bufferFrames * this->nChannels, 0);
+  this->pool.allocate(env, 2, this->frame.size() * sizeof(float),
+                      [](Napi::ArrayBuffer buffer) -> Napi::Object {
+                        size_t length = buffer.ByteLength() / sizeof(float);
+                        return Napi::Float32Array::New(buffer.Env(), length, buffer, 0);
+                      });
+
+  if (info[4].IsFunction()) {
+    this->tsCb = Napi::ThreadSafeFunction::New(env, info[4].As<Napi::Function>(),
+                                               "aggregateCallback", 1, 1);
+  } else {
+    this->tsCb = Napi::ThreadSafeFunction();
+  }
+
+  jsRef = Napi::ObjectReference::New(this->Value(), 1);
+
+  return Napi::Number::New(env, this->bufferFrames);
+}
+
+void NodeRtAudioAggregate::closeStream(const Napi::CallbackInfo &info) {
+  jsRef.Unref();
+  closeStreams();
+  pool.release();
+}
+
+void NodeRtAudioAggregate::closeStreams() {
+  for (auto &stream : this->streams) {
+    if (stream->isStreamOpen()) {
+      stream->closeStream();
+    }
+  }
+
+  this->streams.clear();
+  this->devices.clear();
+}
+
+void NodeRtAudioAggregate::startStream(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (this->streams.empty())
+    throw Napi::Error::New(env, "No stream is open");
+
+  for (auto &device : this->devices) {
+    device->reset();
+  }
+
+  // The secondary devices start first, so that their rings are filling up by the time
+  // the master asks for them.
+  for (size_t i = this->streams.size(); i-- > 0;) {
+    if (this->streams[i]->startStream() != RTAUDIO_NO_ERROR) {
+      std::string error = this->streams[i]->getErrorText();
+
+      for (size_t j = i + 1; j < this->streams.size(); j++) {
+        this->streams[j]->stopStream();
+      }
+
+      throw Napi::Error::New(env, "Device " + std::to_string(this->params[i].deviceId) +
+                                      ": " + error);
+    }
+  }
+}
+
+void NodeRtAudioAggregate::stopStream(const Napi::CallbackInfo &info) {
+  for (auto &stream : this->streams) {
+    if (stream->isStreamRunning()) {
+      stream->stopStream();
+    }
+  }
+}
+
+Napi::Value NodeRtAudioAggregate::isStreamOpen(const Napi::CallbackInfo &info) {
+  return Napi::Boolean::New(info.Env(), !this->streams.empty());
+}
+
+Napi::Value NodeRtAudioAggregate::isStreamRunning(const Napi::CallbackInfo &info) {
+  return Napi::Boolean::New(info.Env(), !this->streams.empty() &&
+                                            this->streams[0]->isStreamRunning());
+}
+
+Napi::Value NodeRtAudioAggregate::getStreamLatency(const Napi::CallbackInfo &info) {
+  double latency = 0;
+
+  // The worst case over the devices, each adding its own input latency to the ring and
+  // resampler delay of the secondary ones.
+  for (size_t i = 0; i < this->streams.size(); i++) {
+    double deviceLatency = this->streams[i]->getStreamLatency();
+
+    if (i > 0) {
+      deviceLatency += this->devices[i - 1]->latency();
+    }
+
+    latency = std::max(latency, deviceLatency);
+  }
+
+  return Napi::Number::New(info.Env(), std::round(latency));
+}
+
+Napi::Value NodeRtAudioAggregate::getDriftStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::Array result = Napi::Array::New(env, this->devices.size());
+
+  for (size_t i = 0; i < this->devices.size(); i++) {
+    const AggregateDevice &device = *this->devices[i];
+    Napi::Object stats = Napi::Object::New(env);
+
+    stats.Set("deviceId", this->params[i + 1].deviceId);
+    stats.Set("driftPpm", device.driftPpm());
+    stats.Set("bufferedFrames", device.bufferedFrames());
+    stats.Set("targetFrames", device.targetFrames());
+    stats.Set("underruns", (double)device.underruns());
+    stats.Set("overruns", (double)device.overruns());
+    result[i] = stats;
+  }
+
+  return result;
+}
+
+int NodeRtAudioAggregate::deviceCallback(void *outputBuffer, void *inputBuffer,
+                                         unsigned int nFrames, double streamTime,
+                                         RtAudioStreamStatus status, void *userData) {
+  ((AggregateDevice *)userData)->push((const float *)inputBuffer, nFrames, status);
+  return 0;
+}
+
+int NodeRtAudioAggregate::masterCallback(void *outputBuffer, void *inputBuffer,
+                                         unsigned int nFrames, double streamTime,
+                                         RtAudioStreamStatus status, void *userData) {
+  NodeRtAudioAggregate *that = (NodeRtAudioAggregate *)userData;
+  unsigned int masterChannels = that->params[0].nChannels;
+  unsigned int channelOffset = masterChannels;
+
+  if (nFrames > that->bufferFrames || inputBuffer == nullptr) {
+    return 0;
+  }
+
+  const float *input = (const float *)inputBuffer;
+
+  for (unsigned int i = 0; i < nFrames; i++) {
+    memcpy(that->frame.data() + (size_t)i * that->nChannels, input + i * masterChannels,
+           masterChannels * sizeof(float));
+  }
+
+  for (size_t i = 0; i < that->devices.size(); i++) {
+    status |= that->devices[i]->align(that->frame.data(), that->nChannels, channelOffset,
+                                      nFrames);
+    channelOffset += that->params[i + 1].nChannels;
+  }
+
+  if (that->tsCb.operator napi_threadsafe_function() == nullptr) {
+    return 0;
+  }
+
+  auto call = [nFrames, streamTime, status, that](Napi::Env env,
+                                                  Napi::Function callback) {
+    that->rtThreadSmph.acquire();
+
+    size_t byteCount = (size_t)nFrames * that->nChannels * sizeof(float);
+    Napi::Value input;
+
+    // Pooled buffers only fit full periods.
+    if (byteCount == that->pool.slotSize()) {
+      const BufferPool::Slot &slot = that->pool.next();
+      memcpy(slot.data, that->frame.data(), byteCount);
+      input = slot.view.Value();
+    } else {
+      Napi::Float32Array array = Napi::Float32Array::New(env, byteCount / sizeof(float));
+      memcpy(array.Data(), that->frame.data(), byteCount);
+      input = array;
+    }
+
+    try {
+      auto val = callback.Call({input, Napi::Number::New(env, nFrames),
+                                Napi::Number::New(env, streamTime),
+                                Napi::Number::New(env, status)});
+
+      if (val.IsUndefined()) {
+        that->jsCallbackReturnValue = 0;
+      } else if (val.IsNumber()) {
+        that->jsCallbackReturnValue = val.As<Napi::Number>().Int32Value();
+      } else {
+        throw Napi::TypeError::New(env,
+                                   "return value of the callback should be a number");
+      }
+    } catch (const std::exception &err) {
+      std::cerr << err.what() << std::endl;
+      that->jsCallbackReturnValue = 0;
+    }
+
+    that->jsThreadSmph.release();
+  };
+
+  that->rtThreadSmph.release();
+
+  if (that->tsCb.BlockingCall(call) != napi_ok) {
+    that->rtThreadSmph.try_acquire();
+    return 0;
+  }
+
+  that->jsThreadSmph.acquire();
+
+  return that->jsCallbackReturnValue;
+}
@@ -0,0 +1,67 @@
+#ifndef __NODE_ADDON_NODE_RTAUDIO_AGGREGATE_H__
+#define __NODE_ADDON_NODE_RTAUDIO_AGGREGATE_H__
+
+#include "aggregate_device.hpp"
+#include "buffer_pool.hpp"
+#include <RtAudio.h>
+#include <memory>
+#include <napi.h>
+#include <semaphore>
+#include <vector>
+
+// An input stream over several devices, delivered to one callback as a single
+// interleaved float32 buffer holding every device's channels side by side.
+//
+// Each device runs its own RtAudio stream. The first one is the clock master: its
+// callback assembles the aggregate frame and calls JS, the others only feed their
+// `AggregateDevice` rings and are resampled to the master's clock.
+class NodeRtAudioAggregate : public Napi::ObjectWrap<NodeRtAudioAggregate> {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+public:
+  NodeRtAudioAggregate(const Napi::CallbackInfo &info);
+  ~NodeRtAudioAggregate();
+
+public:
+  Napi::Value openStream(const Napi::CallbackInfo &info);
+  void closeStream(const Napi::CallbackInfo &info);
+  void startStream(const Napi::CallbackInfo &info);
+  void stopStream(const Napi::CallbackInfo &info);
+  Napi::Value isStreamOpen(const Napi::CallbackInfo &info);
+  Napi::Value isStreamRunning(const Napi::CallbackInfo &info);
+  Napi::Value getStreamLatency(const Napi::CallbackInfo &info);
+  Napi::Value getDriftStats(const Napi::CallbackInfo &info);
+
+private:
+  static int masterCallback(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                            double streamTime, RtAudioStreamStatus status,
+                            void *userData);
+  static int deviceCallback(void *outputBuffer, void *inputBuffer, unsigned int nFrames,
+                            double streamTime, RtAudioStreamStatus status,
+                            void *userData);
+  void closeStreams();
+
+private:
+  RtAudio::Api api;
+  std::vector<std::unique_ptr<RtAudio>> streams;
+  std::vector<RtAudio::StreamParameters> params;
+  // Secondary devices, `devices[i]` belongs to `streams[i + 1]`.
+  std::vector<std::unique_ptr<AggregateDevice>> devices;
+  unsigned int bufferFrames;
+  unsigned int nChannels;
+
+  // The aggregate frame, assembled on the master's thread.
+  std::vector<float> frame;
+  BufferPool pool;
+
+  Napi::ThreadSafeFunction tsCb;
+  std::binary_semaphore rtThreadSmph;
+  std::binary_semaphore jsThreadSmph;
+  int jsCallbackReturnValue;
+
+  // Keeps the object alive while a stream is open, like `NodeRtAudio`.
+  Napi::ObjectReference jsRef;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "node_rtaudio_worker_port.hpp"
+#include "typed_array.hpp"
+
+Napi::Object NodeRtAudioWorkerPort::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func = DefineClass(
+      env, "NodeRtAudioWorkerPort",
+      {
+          InstanceMethod<&NodeRtAudioWorkerPort::wait>(
+              "wait", static_cast<napi_property_attributes>(napi_default)),
+          InstanceMethod<&NodeRtAudioWorkerPort::done>(
+              "done", static_cast<napi_property_attributes>(napi_default)),
+      });
+
+  exports.Set("NodeRtAudioWorkerPort", func);
+
+  return exports;
+}
+
+NodeRtAudioWorkerPort::NodeRtAudioWorkerPort(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<NodeRtAudioWorkerPort>(info) {
+  Napi::Env env = info.Env();
+
+  if (!info[0].IsTypedArray())
+    throw Napi::TypeError::New(env, "control should be a Float64Array.");
+
+  size_t byteLength;
+  uint8_t *control = getTypedArrayData(env, info[0], &byteLength);
+
+  this->channel = WorkerChannel::find(control);
+
+  if (this->channel == nullptr)
+    throw Napi::Error::New(env, "No open stream is using this control block.");
+}
+
+Napi::Value NodeRtAudioWorkerPort::wait(const Napi::CallbackInfo &info) {
+  if (!info[0].IsNumber()) {
+    throw Napi::TypeError::New(info.Env(), "timeout should be a number.");
+  }
+
+  return Napi::Number::New(info.Env(),
+                           this->channel->wait(info[0].As<Napi::Number>().Uint32Value()));
+}
+
+void NodeRtAudioWorkerPort::done(const Napi::CallbackInfo &info) {
+  if (!info[0].IsUndefined() && !info[0].IsNumber()) {
+    throw Napi::TypeError::New(info.Env(),
+                               "return value of the callback should be a number");
+  }
+
+  this->channel->complete(info[0].IsNumber() ? info[0].As<Napi::Number>().Int32Value()
+                                             : 0);
+}
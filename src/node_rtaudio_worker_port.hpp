@@ -0,0 +1,24 @@
+#ifndef __NODE_ADDON_NODE_RTAUDIO_WORKER_PORT_H__
+#define __NODE_ADDON_NODE_RTAUDIO_WORKER_PORT_H__
+
+#include "worker_channel.hpp"
+#include <napi.h>
+
+// The worker side of a stream opened with a `worker` script. It is constructed inside
+// the Worker from the stream's shared control block.
+class NodeRtAudioWorkerPort : public Napi::ObjectWrap<NodeRtAudioWorkerPort> {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+public:
+  NodeRtAudioWorkerPort(const Napi::CallbackInfo &info);
+
+public:
+  Napi::Value wait(const Napi::CallbackInfo &info);
+  void done(const Napi::CallbackInfo &info);
+
+private:
+  std::shared_ptr<WorkerChannel> channel;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef __NODE_ADDON_PROMISE_WORKER_H__
+#define __NODE_ADDON_PROMISE_WORKER_H__
+
+#include <functional>
+#include <napi.h>
+#include <string>
+
+// Runs native work on a libuv worker thread and settles a promise with the result on
+// the JS thread, for the `*Async` methods. Keeps the object it was started for alive
+// until then.
+//
+// `task` runs on the worker and returns an error text, empty on success. `resolve`
+// builds the resolution value on the JS thread and may throw to reject instead, `cleanup`
+// cleans up on the JS thread before the promise is rejected with the error text.
+class PromiseWorker : public Napi::AsyncWorker {
+public:
+  using Task = std::function<std::string()>;
+  using Resolve = std::function<Napi::Value(Napi::Env env)>;
+  using Cleanup = std::function<void(Napi::Env env)>;
+
+  PromiseWorker(Napi::Env env, const char *name, Napi::Object owner, Task task,
+                Resolve resolve, Cleanup cleanup = nullptr)
+      : Napi::AsyncWorker(env, name), deferred{Napi::Promise::Deferred::New(env)},
+        owner{Napi::Persistent(owner)}, task{task}, resolve{resolve},
+        cleanup{cleanup} {}
+
+  // Queues the worker, which deletes itself once the promise is settled.
+  static Napi::Promise queue(PromiseWorker *worker) {
+    Napi::Promise promise = worker->deferred.Promise();
+
+    worker->Queue();
+
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error = this->task();
+
+    if (!error.empty()) {
+      SetError(error);
+    }
+  }
+
+  void OnOK() override {
+    try {
+      this->deferred.Resolve(this->resolve(Env()));
+    } catch (const Napi::Error &error) {
+      this->deferred.Reject(error.Value());
+    }
+  }
+
+  void OnError(const Napi::Error &error) override {
+    if (this->cleanup) {
+      this->cleanup(Env());
+    }
+
+    this->deferred.Reject(error.Value());
+  }
+
+private:
+  Napi::Promise::Deferred deferred;
+  Napi::ObjectReference owner;
+  Task task;
+  Resolve resolve;
+  Cleanup cleanup;
+};
+
+#endif
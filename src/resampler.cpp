@@ -0,0 +1,272 @@
+#include "resampler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+const double Pi = 3.14159265358979323846;
+const unsigned int MaxPhases = 4096;
+const unsigned int MaxTaps = 256;
+
+// `VariableResampler` filter, phases are linearly interpolated in between.
+const unsigned int VariableTaps = 32;
+const unsigned int VariablePhases = 256;
+const double VariableBeta = 8.5;
+const double VariableCutoff = 0.45;
+
+struct QualitySettings {
+  unsigned int taps;
+  double beta;
+  // Passband edge relative to the lower Nyquist frequency.
+  double rolloff;
+};
+
+QualitySettings getQualitySettings(ResamplerQuality quality) {
+  switch (quality) {
+  case ResamplerQuality::Fast:
+    return {16, 6.0, 0.85};
+  case ResamplerQuality::Best:
+    return {64, 11.0, 0.94};
+  default:
+    return {32, 8.5, 0.9};
+  }
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+double besselI0(double x) {
+  double sum = 1;
+  double term = 1;
+
+  for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+
+  return sum;
+}
+
+} // namespace
+
+Resampler::Resampler()
+    : kernels(&sampleKernels()), up(1), down(1), taps(0), nChannels(0),
+      prefillFrames(0), phase(0), historyPosition(0), fifoFrames(0) {}
+
+bool Resampler::supports(unsigned int fromRate, unsigned int toRate) {
+  unsigned int divisor = std::gcd(fromRate, toRate);
+  return divisor != 0 && toRate / divisor <= MaxPhases;
+}
+
+bool Resampler::configure(unsigned int fromRate, unsigned int toRate,
+                          unsigned int nChannels, ResamplerQuality quality,
+                          size_t maxInputFrames, size_t prefillFrames) {
+  if (!supports(fromRate, toRate)) {
+    return false;
+  }
+
+  unsigned int divisor = std::gcd(fromRate, toRate);
+
+  QualitySettings settings = getQualitySettings(quality);
+
+  this->up = toRate / divisor;
+  this->down = fromRate / divisor;
+  this->nChannels = nChannels;
+  this->prefillFrames = prefillFrames;
+
+  // When decimating the cutoff drops below the input Nyquist frequency, so the filter
+  // gets longer to keep the same transition band in output terms.
+  unsigned int taps = settings.taps * ((this->down + this->up - 1) / this->up);
+  this->taps = std::min(MaxTaps, (taps + 7) / 8 * 8);
+
+  // The prototype runs at `up` times the input rate.
+  size_t length = (size_t)this->taps * this->up;
+  double cutoff = settings.rolloff * 0.5 / std::max(this->up, this->down);
+  double center = (length - 1) / 2.0;
+  double window = besselI0(settings.beta);
+
+  this->coefficients.assign(length, 0);
+
+  for (size_t j = 0; j < length; j++) {
+    double x = j - center;
+    double sinc = x == 0 ? 1 : std::sin(2 * Pi * cutoff * x) / (2 * Pi * cutoff * x);
+    double r = length > 1 ? 2.0 * j / (length - 1) - 1 : 0;
+    double kaiser =
+        besselI0(settings.beta * std::sqrt(std::max(0.0, 1 - r * r))) / window;
+
+    // Gain `up` makes up for the zeros stuffed between input samples.
+    size_t p = j % this->up;
+    size_t k = j / this->up;
+    this->coefficients[p * this->taps + (this->taps - 1 - k)] =
+        (float)(2 * cutoff * sinc * kaiser * this->up);
+  }
+
+  this->history.assign((size_t)nChannels * 2 * this->taps, 0);
+
+  size_t maxOutputFrames = (maxInputFrames * this->up + this->down - 1) / this->down;
+  this->fifo.assign((maxOutputFrames + prefillFrames + 4) * nChannels, 0);
+
+  reset();
+
+  return true;
+}
+
+void Resampler::reset() {
+  std::fill(this->history.begin(), this->history.end(), 0.0f);
+  std::fill(this->fifo.begin(), this->fifo.end(), 0.0f);
+  this->phase = 0;
+  this->historyPosition = 0;
+  this->fifoFrames = this->prefillFrames;
+}
+
+void Resampler::push(const float *input, size_t nFrames, bool interleaved) {
+  size_t capacity = this->fifo.size() / std::max(1u, this->nChannels);
+
+  for (size_t frame = 0; frame < nFrames; frame++) {
+    for (unsigned int channel = 0; channel < this->nChannels; channel++) {
+      float sample = interleaved ? input[frame * this->nChannels + channel]
+                                 : input[channel * nFrames + frame];
+      float *channelHistory = this->history.data() + channel * 2 * this->taps;
+      channelHistory[this->historyPosition] = sample;
+      channelHistory[this->historyPosition + this->taps] = sample;
+    }
+
+    // The window runs from the oldest to the newest input.
+    unsigned int start = this->historyPosition + 1;
+    this->historyPosition = start % this->taps;
+
+    for (; this->phase < this->up; this->phase += this->down) {
+      if (this->fifoFrames == capacity) {
+        continue;
+      }
+
+      const float *phaseCoefficients =
+          this->coefficients.data() + this->phase * this->taps;
+      float *out = this->fifo.data() + this->fifoFrames * this->nChannels;
+
+      for (unsigned int channel = 0; channel < this->nChannels; channel++) {
+        const float *window = this->history.data() + channel * 2 * this->taps + start;
+        out[channel] = this->kernels->dotProduct(phaseCoefficients, window, this->taps);
+      }
+
+      this->fifoFrames++;
+    }
+
+    this->phase -= this->up;
+  }
+}
+
+size_t Resampler::pull(float *output, size_t nFrames, bool interleaved) {
+  size_t available = std::min(nFrames, this->fifoFrames);
+
+  for (size_t frame = 0; frame < nFrames; frame++) {
+    for (unsigned int channel = 0; channel < this->nChannels; channel++) {
+      float sample =
+          frame < available ? this->fifo[frame * this->nChannels + channel] : 0.0f;
+
+      if (interleaved) {
+        output[frame * this->nChannels + channel] = sample;
+      } else {
+        output[channel * nFrames + frame] = sample;
+      }
+    }
+  }
+
+  // Only a few frames are left over per period, so moving them to the front is cheap.
+  this->fifoFrames -= available;
+  memmove(this->fifo.data(), this->fifo.data() + available * this->nChannels,
+          this->fifoFrames * this->nChannels * sizeof(float));
+
+  return available;
+}
+
+double Resampler::latency() const {
+  double filterDelay = ((double)this->taps * this->up - 1) / 2 / this->down;
+  return filterDelay + this->prefillFrames;
+}
+
+VariableResampler::VariableResampler()
+    : kernels(&sampleKernels()), nChannels(0), maxInputFrames(0), position(0) {}
+
+void VariableResampler::configure(unsigned int nChannels, size_t maxInputFrames) {
+  this->nChannels = nChannels;
+  this->maxInputFrames = maxInputFrames;
+
+  // One extra phase so that interpolating next to phase 1.0 stays in the table.
+  this->table.assign((VariablePhases + 1) * VariableTaps, 0);
+  double window = besselI0(VariableBeta);
+  double halfLength = VariableTaps / 2.0;
+
+  for (unsigned int p = 0; p <= VariablePhases; p++) {
+    double fraction = (double)p / VariablePhases;
+
+    for (unsigned int j = 0; j < VariableTaps; j++) {
+      // Tap `j` sits `x` frames from the interpolated position.
+      double x = j + 1 - halfLength - fraction;
+      double arg = 2 * Pi * VariableCutoff * x;
+      double sinc = x == 0 ? 1 : std::sin(arg) / arg;
+      double r = std::min(1.0, std::abs(x) / halfLength);
+      double kaiser = besselI0(VariableBeta * std::sqrt(1 - r * r)) / window;
+
+      this->table[p * VariableTaps + j] = (float)(2 * VariableCutoff * sinc * kaiser);
+    }
+  }
+
+  this->coefficients.assign(VariableTaps, 0);
+  this->work.assign(nChannels * (VariableTaps + maxInputFrames), 0);
+
+  reset();
+}
+
+void VariableResampler::reset() {
+  std::fill(this->work.begin(), this->work.end(), 0.0f);
+  this->position = 0;
+}
+
+size_t VariableResampler::inputFramesFor(size_t nFrames, double ratio) const {
+  return (size_t)std::floor(this->position + nFrames * ratio);
+}
+
+void VariableResampler::process(const float *input, float *output, size_t nFrames,
+                                double ratio) {
+  size_t inputFrames = std::min(inputFramesFor(nFrames, ratio), this->maxInputFrames);
+  size_t stride = VariableTaps + this->maxInputFrames;
+
+  for (unsigned int channel = 0; channel < this->nChannels; channel++) {
+    float *channelWork = this->work.data() + channel * stride + VariableTaps;
+
+    for (size_t frame = 0; frame < inputFrames; frame++) {
+      channelWork[frame] = input[frame * this->nChannels + channel];
+    }
+  }
+
+  for (size_t frame = 0; frame < nFrames; frame++) {
+    double x = this->position + frame * ratio;
+    size_t index = std::min((size_t)x, inputFrames > 0 ? inputFrames - 1 : 0);
+    double phase = (x - index) * VariablePhases;
+    unsigned int p = std::min((unsigned int)phase, VariablePhases - 1);
+    float weight = (float)(phase - p);
+    const float *low = this->table.data() + p * VariableTaps;
+    const float *high = low + VariableTaps;
+
+    for (unsigned int j = 0; j < VariableTaps; j++) {
+      this->coefficients[j] = low[j] + (high[j] - low[j]) * weight;
+    }
+
+    for (unsigned int channel = 0; channel < this->nChannels; channel++) {
+      const float *window = this->work.data() + channel * stride + index + 1;
+      output[frame * this->nChannels + channel] =
+          this->kernels->dotProduct(this->coefficients.data(), window, VariableTaps);
+    }
+  }
+
+  this->position += nFrames * ratio - inputFrames;
+
+  // Keep the last inputs as the history of the next call.
+  for (unsigned int channel = 0; channel < this->nChannels; channel++) {
+    float *channelWork = this->work.data() + channel * stride;
+    memmove(channelWork, channelWork + inputFrames, VariableTaps * sizeof(float));
+  }
+}
+
+double VariableResampler::latency() const { return VariableTaps / 2.0; }
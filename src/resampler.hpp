@@ -0,0 +1,109 @@
+#ifndef __NODE_ADDON_RESAMPLER_H__
+#define __NODE_ADDON_RESAMPLER_H__
+
+#include "sample_kernels.hpp"
+#include <cstddef>
+#include <vector>
+
+// Filter length and stopband trade-off of `Resampler`, longer filters add latency.
+enum class ResamplerQuality {
+  // 16 taps per phase, about 60 dB stopband.
+  Fast = 0,
+  // 32 taps per phase, about 85 dB stopband.
+  Medium = 1,
+  // 64 taps per phase, about 110 dB stopband.
+  Best = 2,
+};
+
+// A rational polyphase resampler for float frames, with a Kaiser windowed sinc filter.
+//
+// Frames are pushed at one rate and pulled at the other through an internal FIFO, so the
+// two sides don't have to move the same number of frames per call. Everything is
+// allocated by `configure`, `push`/`pull` never allocate and are meant to be called on
+// the realtime thread.
+class Resampler {
+public:
+  Resampler();
+
+  // Whether converting between the two rates is supported, i.e. the ratio doesn't need
+  // more than 4096 filter phases.
+  static bool supports(unsigned int fromRate, unsigned int toRate);
+
+  // Sets up the conversion for up to `maxInputFrames` frames per `push`. The FIFO starts
+  // with `prefillFrames` frames of silence, which absorbs the rounding between the
+  // frames pushed and pulled per call. Returns false if the rates aren't supported.
+  bool configure(unsigned int fromRate, unsigned int toRate, unsigned int nChannels,
+                 ResamplerQuality quality, size_t maxInputFrames, size_t prefillFrames);
+  void reset();
+
+  // Resamples `nFrames` frames into the FIFO. Planar buffers hold `nFrames` samples per
+  // channel back-to-back.
+  void push(const float *input, size_t nFrames, bool interleaved);
+
+  // Takes `nFrames` frames out of the FIFO, padding with silence if it runs short.
+  // Returns the number of frames that were available.
+  size_t pull(float *output, size_t nFrames, bool interleaved);
+
+  // Delay added by the filter and the prefill, in output frames.
+  double latency() const;
+
+private:
+  const SampleKernels *kernels;
+  unsigned int up;
+  unsigned int down;
+  unsigned int taps;
+  unsigned int nChannels;
+  size_t prefillFrames;
+
+  // `up` phases of `taps` coefficients each, reversed so that the last one multiplies
+  // the newest input frame.
+  std::vector<float> coefficients;
+  unsigned int phase;
+
+  // Per channel history of the last `taps` inputs, stored twice so that the filter
+  // window is always contiguous.
+  std::vector<float> history;
+  unsigned int historyPosition;
+
+  // Interleaved output frames that haven't been pulled yet.
+  std::vector<float> fifo;
+  size_t fifoFrames;
+};
+
+// A resampler whose ratio may change on every call, for following the clock drift
+// between devices. The ratio is expected to stay close to 1: the filter is a 32 tap
+// windowed sinc at a fixed cutoff, with its phase interpolated from a table.
+//
+// `configure` allocates, `process` doesn't and is meant for the realtime thread.
+class VariableResampler {
+public:
+  VariableResampler();
+
+  void configure(unsigned int nChannels, size_t maxInputFrames);
+  void reset();
+
+  // Input frames `process` consumes to produce `nFrames` frames, `ratio` being input
+  // frames per output frame.
+  size_t inputFramesFor(size_t nFrames, double ratio) const;
+
+  // Resamples exactly `inputFramesFor(nFrames, ratio)` interleaved input frames into
+  // `nFrames` interleaved output frames.
+  void process(const float *input, float *output, size_t nFrames, double ratio);
+
+  // Delay added by the filter, in frames.
+  double latency() const;
+
+private:
+  const SampleKernels *kernels;
+  unsigned int nChannels;
+  size_t maxInputFrames;
+  // Fractional input position of the next output frame.
+  double position;
+
+  std::vector<float> table;
+  std::vector<float> coefficients;
+  // Per channel, the history the filter needs followed by the new input.
+  std::vector<float> work;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "ring_buffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+RingBuffer::RingBuffer() : readIndex{0}, writeIndex{0} {}
+
+void RingBuffer::allocate(size_t capacity) {
+  buffer.assign(capacity, 0);
+  reset();
+}
+
+void RingBuffer::reset() {
+  readIndex.store(0, std::memory_order_relaxed);
+  writeIndex.store(0, std::memory_order_relaxed);
+}
+
+size_t RingBuffer::capacity() const { return buffer.size(); }
+
+size_t RingBuffer::readAvailable() const {
+  return writeIndex.load(std::memory_order_acquire) -
+         readIndex.load(std::memory_order_acquire);
+}
+
+size_t RingBuffer::writeAvailable() const { return buffer.size() - readAvailable(); }
+
+size_t RingBuffer::write(const void *data, size_t size) {
+  const size_t w = writeIndex.load(std::memory_order_relaxed);
+  const size_t r = readIndex.load(std::memory_order_acquire);
+  const size_t count = std::min(size, buffer.size() - (w - r));
+
+  if (count == 0)
+    return 0;
+
+  const size_t offset = w % buffer.size();
+  const size_t first = std::min(count, buffer.size() - offset);
+
+  memcpy(buffer.data() + offset, data, first);
+  memcpy(buffer.data(), static_cast<const uint8_t *>(data) + first, count - first);
+
+  writeIndex.store(w + count, std::memory_order_release);
+
+  return count;
+}
+
+size_t RingBuffer::read(void *data, size_t size) {
+  const size_t r = readIndex.load(std::memory_order_relaxed);
+  const size_t w = writeIndex.load(std::memory_order_acquire);
+  const size_t count = std::min(size, w - r);
+
+  if (count == 0)
+    return 0;
+
+  const size_t offset = r % buffer.size();
+  const size_t first = std::min(count, buffer.size() - offset);
+
+  memcpy(data, buffer.data() + offset, first);
+  memcpy(static_cast<uint8_t *>(data) + first, buffer.data(), count - first);
+
+  readIndex.store(r + count, std::memory_order_release);
+
+  return count;
+}
+
+size_t RingBuffer::skip(size_t size) {
+  const size_t r = readIndex.load(std::memory_order_relaxed);
+  const size_t w = writeIndex.load(std::memory_order_acquire);
+  const size_t count = std::min(size, w - r);
+
+  readIndex.store(r + count, std::memory_order_release);
+
+  return count;
+}
@@ -0,0 +1,39 @@
+#ifndef __NODE_ADDON_RING_BUFFER_H__
+#define __NODE_ADDON_RING_BUFFER_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A lock-free single-producer/single-consumer byte ring.
+//
+// Exactly one thread may call `write` and exactly one (possibly different) thread may
+// call `read`/`skip`. `allocate` and `reset` must only be called while neither side is
+// active, e.g. while the stream is closed or stopped. Callers that move whole frames
+// should keep the capacity and every transfer a multiple of the frame size, so the
+// available counts always stay frame aligned.
+class RingBuffer {
+public:
+  RingBuffer();
+
+  void allocate(size_t capacity);
+  void reset();
+
+  size_t capacity() const;
+  size_t readAvailable() const;
+  size_t writeAvailable() const;
+
+  size_t write(const void *data, size_t size);
+  size_t read(void *data, size_t size);
+  size_t skip(size_t size);
+
+private:
+  std::vector<uint8_t> buffer;
+
+  // Monotonic byte counters, the slot is the counter modulo the capacity.
+  alignas(64) std::atomic<size_t> readIndex;
+  alignas(64) std::atomic<size_t> writeIndex;
+};
+
+#endif
@@ -0,0 +1,296 @@
+#include "rtapi_loopback.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+RtApiLoopback::RtApiLoopback() : running{false}, closing{false} {}
+
+RtApiLoopback::~RtApiLoopback() {
+  if (stream_.state != STREAM_CLOSED) {
+    closeStream();
+  }
+}
+
+void RtApiLoopback::probeDevices(void) {
+  if (!deviceList_.empty()) {
+    return;
+  }
+
+  RtAudio::DeviceInfo info;
+
+  info.ID = currentDeviceId_++;
+  info.name = "Loopback";
+  info.outputChannels = MaxChannels;
+  info.inputChannels = MaxChannels;
+  info.duplexChannels = MaxChannels;
+  info.isDefaultOutput = true;
+  info.isDefaultInput = true;
+  info.sampleRates.assign(SAMPLE_RATES, SAMPLE_RATES + MAX_SAMPLE_RATES);
+  info.preferredSampleRate = 48000;
+  info.nativeFormats = RTAUDIO_SINT8 | RTAUDIO_SINT16 | RTAUDIO_SINT24 | RTAUDIO_SINT32 |
+                       RTAUDIO_FLOAT32 | RTAUDIO_FLOAT64;
+
+  deviceList_.push_back(info);
+}
+
+bool RtApiLoopback::probeDeviceOpen(unsigned int deviceId, StreamMode mode,
+                                    unsigned int channels, unsigned int firstChannel,
+                                    unsigned int sampleRate, RtAudioFormat format,
+                                    unsigned int *bufferSize,
+                                    RtAudio::StreamOptions *options) {
+  if (deviceList_.empty() || deviceId != deviceList_[0].ID) {
+    errorText_ = "RtApiLoopback::probeDeviceOpen: device ID is invalid!";
+    return FAILURE;
+  }
+
+  if (channels + firstChannel > MaxChannels) {
+    errorText_ = "RtApiLoopback::probeDeviceOpen: the device supports up to 8 channels.";
+    return FAILURE;
+  }
+
+  if (sampleRate == 0) {
+    errorText_ = "RtApiLoopback::probeDeviceOpen: invalid sample rate.";
+    return FAILURE;
+  }
+
+  if (*bufferSize == 0) {
+    *bufferSize = 256;
+  }
+
+  // Both directions have to share the period size.
+  if (mode == INPUT && stream_.mode == OUTPUT) {
+    *bufferSize = stream_.bufferSize;
+  }
+
+  stream_.deviceId[mode] = deviceId;
+  stream_.sampleRate = sampleRate;
+  stream_.bufferSize = *bufferSize;
+  stream_.nBuffers = 1;
+  stream_.userFormat = format;
+  stream_.deviceFormat[mode] = format;
+  stream_.doByteSwap[mode] = false;
+  stream_.nUserChannels[mode] = channels;
+  stream_.nDeviceChannels[mode] = channels + firstChannel;
+  stream_.channelOffset[mode] = 0;
+  stream_.latency[mode] = *bufferSize;
+  stream_.userInterleaved = !(options && (options->flags & RTAUDIO_NONINTERLEAVED));
+  stream_.deviceInterleaved[mode] = true;
+  stream_.doConvertBuffer[mode] =
+      firstChannel > 0 || (!stream_.userInterleaved && channels > 1);
+
+  size_t userBytes = channels * *bufferSize * formatBytes(format);
+  size_t deviceBytes = stream_.nDeviceChannels[mode] * *bufferSize * formatBytes(format);
+
+  stream_.userBuffer[mode] = (char *)calloc(userBytes, 1);
+
+  if (stream_.userBuffer[mode] == nullptr) {
+    errorText_ = "RtApiLoopback::probeDeviceOpen: error allocating user buffer memory.";
+    return FAILURE;
+  }
+
+  if (stream_.doConvertBuffer[mode]) {
+    bool makeBuffer = true;
+
+    if (mode == INPUT && stream_.mode == OUTPUT && stream_.deviceBuffer) {
+      makeBuffer = deviceBytes > (size_t)stream_.nDeviceChannels[OUTPUT] * *bufferSize *
+                                     formatBytes(format);
+    }
+
+    if (makeBuffer) {
+      free(stream_.deviceBuffer);
+      stream_.deviceBuffer = (char *)calloc(deviceBytes, 1);
+
+      if (stream_.deviceBuffer == nullptr) {
+        errorText_ =
+            "RtApiLoopback::probeDeviceOpen: error allocating device buffer memory.";
+        return FAILURE;
+      }
+    }
+
+    setConvertInfo(mode, firstChannel);
+  }
+
+  if (mode == OUTPUT) {
+    loopbackBuffer.assign(deviceBytes, 0);
+  }
+
+  stream_.mode = (mode == INPUT && stream_.mode == OUTPUT) ? DUPLEX : mode;
+
+  if (!thread.joinable()) {
+    closing = false;
+    thread = std::thread(&RtApiLoopback::run, this);
+  }
+
+  return SUCCESS;
+}
+
+void RtApiLoopback::closeStream(void) {
+  if (stream_.state == STREAM_CLOSED) {
+    errorText_ = "RtApiLoopback::closeStream(): no open stream to close!";
+    error(RTAUDIO_WARNING);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+    running = false;
+  }
+
+  stateChanged.notify_one();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+
+  for (int i = 0; i < 2; i++) {
+    free(stream_.userBuffer[i]);
+    stream_.userBuffer[i] = nullptr;
+  }
+
+  free(stream_.deviceBuffer);
+  stream_.deviceBuffer = nullptr;
+  loopbackBuffer.clear();
+
+  clearStreamInfo();
+}
+
+RtAudioErrorType RtApiLoopback::startStream(void) {
+  if (stream_.state != STREAM_STOPPED) {
+    if (stream_.state == STREAM_RUNNING)
+      errorText_ = "RtApiLoopback::startStream(): the stream is already running!";
+    else
+      errorText_ = "RtApiLoopback::startStream(): the stream is stopping or closed!";
+    return error(RTAUDIO_WARNING);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stream_.state = STREAM_RUNNING;
+    running = true;
+  }
+
+  stateChanged.notify_one();
+
+  return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiLoopback::stopStream(void) {
+  if (stream_.state != STREAM_RUNNING && stream_.state != STREAM_STOPPING) {
+    if (stream_.state == STREAM_STOPPED)
+      errorText_ = "RtApiLoopback::stopStream(): the stream is already stopped!";
+    else
+      errorText_ = "RtApiLoopback::stopStream(): the stream is closed!";
+    return error(RTAUDIO_WARNING);
+  }
+
+  // Like the other APIs this doesn't wait for the timer thread, which may be blocked in
+  // the callback; it just won't start another period.
+  std::lock_guard<std::mutex> lock(mutex);
+  stream_.state = STREAM_STOPPED;
+  running = false;
+
+  return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiLoopback::abortStream(void) { return stopStream(); }
+
+void RtApiLoopback::run() {
+  using clock = std::chrono::steady_clock;
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  for (;;) {
+    stateChanged.wait(lock, [this] { return closing || running.load(); });
+
+    if (closing) {
+      return;
+    }
+
+    lock.unlock();
+
+    const auto period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>((double)stream_.bufferSize / stream_.sampleRate));
+    auto next = clock::now();
+    RtAudioStreamStatus status = 0;
+
+    while (running) {
+      next += period;
+      std::this_thread::sleep_until(next);
+
+      if (!running) {
+        break;
+      }
+
+      callbackEvent(status);
+      status = 0;
+
+      // A callback that took longer than a whole period makes the device drop periods,
+      // the same way a sound card would report an xrun.
+      if (clock::now() > next + period) {
+        next = clock::now();
+
+        if (stream_.mode != INPUT)
+          status |= RTAUDIO_OUTPUT_UNDERFLOW;
+        if (stream_.mode != OUTPUT)
+          status |= RTAUDIO_INPUT_OVERFLOW;
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+void RtApiLoopback::callbackEvent(RtAudioStreamStatus status) {
+  RtAudioCallback callback = (RtAudioCallback)stream_.callbackInfo.callback;
+  unsigned int sampleSize = formatBytes(stream_.userFormat);
+  size_t frames = stream_.bufferSize;
+
+  if (stream_.mode == INPUT || stream_.mode == DUPLEX) {
+    // Input channel i hears output channel i, channels the output doesn't have are
+    // silent.
+    char *deviceInput =
+        stream_.doConvertBuffer[INPUT] ? stream_.deviceBuffer : stream_.userBuffer[INPUT];
+    unsigned int inputChannels = stream_.nDeviceChannels[INPUT];
+    unsigned int outputChannels =
+        stream_.mode == DUPLEX ? stream_.nDeviceChannels[OUTPUT] : 0;
+    unsigned int sharedChannels = std::min(inputChannels, outputChannels);
+
+    for (size_t frame = 0; frame < frames; frame++) {
+      char *to = deviceInput + frame * inputChannels * sampleSize;
+
+      memcpy(to, loopbackBuffer.data() + frame * outputChannels * sampleSize,
+             sharedChannels * sampleSize);
+      memset(to + sharedChannels * sampleSize, 0,
+             (inputChannels - sharedChannels) * sampleSize);
+    }
+
+    if (stream_.doConvertBuffer[INPUT]) {
+      convertBuffer(stream_.userBuffer[INPUT], stream_.deviceBuffer,
+                    stream_.convertInfo[INPUT]);
+    }
+  }
+
+  int result = callback(stream_.userBuffer[OUTPUT], stream_.userBuffer[INPUT],
+                        stream_.bufferSize, getStreamTime(), status,
+                        stream_.callbackInfo.userData);
+
+  if (stream_.mode == OUTPUT || stream_.mode == DUPLEX) {
+    char *deviceOutput = stream_.userBuffer[OUTPUT];
+
+    if (stream_.doConvertBuffer[OUTPUT]) {
+      convertBuffer(stream_.deviceBuffer, stream_.userBuffer[OUTPUT],
+                    stream_.convertInfo[OUTPUT]);
+      deviceOutput = stream_.deviceBuffer;
+    }
+
+    memcpy(loopbackBuffer.data(), deviceOutput, loopbackBuffer.size());
+  }
+
+  tickStreamTime();
+
+  if (result == 1 || result == 2) {
+    stopStream();
+  }
+}
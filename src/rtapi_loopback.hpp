@@ -0,0 +1,51 @@
+#ifndef __NODE_ADDON_RTAPI_LOOPBACK_H__
+#define __NODE_ADDON_RTAPI_LOOPBACK_H__
+
+#include <RtAudio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A virtual duplex device that needs no sound server or hardware: a timer thread runs
+// the stream callback once per period and whatever was written to the output is
+// captured as the input of the next period.
+//
+// It stands in for RtAudio's dummy API (which has no devices) when the addon is built
+// with RTAUDIO_JS_LOOPBACK, so that streams and benchmarks can run on headless
+// machines. Like the other RtApi implementations it fills in `stream_` and lets RtApi
+// convert between the user and the device layout.
+class RtApiLoopback : public RtApi {
+public:
+  static const unsigned int MaxChannels = 8;
+
+  RtApiLoopback();
+  ~RtApiLoopback();
+
+  RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+  void closeStream(void) override;
+  RtAudioErrorType startStream(void) override;
+  RtAudioErrorType stopStream(void) override;
+  RtAudioErrorType abortStream(void) override;
+
+private:
+  void probeDevices(void) override;
+  bool probeDeviceOpen(unsigned int deviceId, StreamMode mode, unsigned int channels,
+                       unsigned int firstChannel, unsigned int sampleRate,
+                       RtAudioFormat format, unsigned int *bufferSize,
+                       RtAudio::StreamOptions *options) override;
+  void run();
+  void callbackEvent(RtAudioStreamStatus status);
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable stateChanged;
+  std::atomic<bool> running;
+  bool closing;
+
+  // The last output period in the device layout, played back as the next input.
+  std::vector<char> loopbackBuffer;
+};
+
+#endif
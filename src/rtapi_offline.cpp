@@ -0,0 +1,405 @@
+#include "rtapi_offline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+RtApiOffline::RtApiOffline()
+    : inputOffset{0}, renderedFrames{0}, elapsedNanoseconds{0}, finished{false},
+      running{false}, rendering{false}, closing{false} {}
+
+RtApiOffline::~RtApiOffline() {
+  if (stream_.state != STREAM_CLOSED) {
+    closeStream();
+  }
+}
+
+void RtApiOffline::probeDevices(void) {
+  if (!deviceList_.empty()) {
+    return;
+  }
+
+  RtAudio::DeviceInfo info;
+
+  info.ID = currentDeviceId_++;
+  info.name = "Offline";
+  info.outputChannels = MaxChannels;
+  info.inputChannels = MaxChannels;
+  info.duplexChannels = MaxChannels;
+  info.isDefaultOutput = true;
+  info.isDefaultInput = true;
+  info.sampleRates.assign(SAMPLE_RATES, SAMPLE_RATES + MAX_SAMPLE_RATES);
+  info.preferredSampleRate = 48000;
+  info.nativeFormats = RTAUDIO_SINT8 | RTAUDIO_SINT16 | RTAUDIO_SINT24 | RTAUDIO_SINT32 |
+                       RTAUDIO_FLOAT32 | RTAUDIO_FLOAT64;
+
+  deviceList_.push_back(info);
+}
+
+bool RtApiOffline::probeDeviceOpen(unsigned int deviceId, StreamMode mode,
+                                   unsigned int channels, unsigned int firstChannel,
+                                   unsigned int sampleRate, RtAudioFormat format,
+                                   unsigned int *bufferSize,
+                                   RtAudio::StreamOptions *options) {
+  if (deviceList_.empty() || deviceId != deviceList_[0].ID) {
+    errorText_ = "RtApiOffline::probeDeviceOpen: device ID is invalid!";
+    return FAILURE;
+  }
+
+  if (channels > MaxChannels) {
+    errorText_ = "RtApiOffline::probeDeviceOpen: the device supports up to 256 channels.";
+    return FAILURE;
+  }
+
+  if (sampleRate == 0) {
+    errorText_ = "RtApiOffline::probeDeviceOpen: invalid sample rate.";
+    return FAILURE;
+  }
+
+  if (*bufferSize == 0) {
+    *bufferSize = 256;
+  }
+
+  // Both directions have to share the period size.
+  if (mode == INPUT && stream_.mode == OUTPUT) {
+    *bufferSize = stream_.bufferSize;
+  }
+
+  stream_.deviceId[mode] = deviceId;
+  stream_.sampleRate = sampleRate;
+  stream_.bufferSize = *bufferSize;
+  stream_.nBuffers = 1;
+  stream_.userFormat = format;
+  stream_.deviceFormat[mode] = format;
+  stream_.doByteSwap[mode] = false;
+  stream_.nUserChannels[mode] = channels;
+  stream_.nDeviceChannels[mode] = channels;
+  stream_.channelOffset[mode] = 0;
+  stream_.latency[mode] = 0;
+  stream_.userInterleaved = !(options && (options->flags & RTAUDIO_NONINTERLEAVED));
+  stream_.deviceInterleaved[mode] = stream_.userInterleaved;
+  stream_.doConvertBuffer[mode] = false;
+  stream_.userBuffer[mode] =
+      (char *)calloc((size_t)channels * *bufferSize * formatBytes(format), 1);
+
+  if (stream_.userBuffer[mode] == nullptr) {
+    errorText_ = "RtApiOffline::probeDeviceOpen: error allocating user buffer memory.";
+    return FAILURE;
+  }
+
+  stream_.mode = (mode == INPUT && stream_.mode == OUTPUT) ? DUPLEX : mode;
+
+  if (!thread.joinable()) {
+    closing = false;
+    thread = std::thread(&RtApiOffline::run, this);
+  }
+
+  return SUCCESS;
+}
+
+bool RtApiOffline::prepare(const OfflineSettings &settings, Listener onEnd,
+                           std::string *error) {
+  bool hasInput = stream_.mode == INPUT || stream_.mode == DUPLEX;
+  bool hasOutput = stream_.mode == OUTPUT || stream_.mode == DUPLEX;
+  unsigned int sampleSize = formatBytes(stream_.userFormat);
+
+  if (stream_.state != STREAM_STOPPED) {
+    *error = "The offline stream should be open and stopped.";
+    return false;
+  }
+
+  if (!settings.inputSamples.empty() && !stream_.userInterleaved) {
+    *error = "Offline input buffers need an interleaved stream.";
+    return false;
+  }
+
+  if (settings.keepOutput && !stream_.userInterleaved) {
+    *error = "Keeping the offline output needs an interleaved stream.";
+    return false;
+  }
+
+  this->settings = settings;
+  this->onEnd = onEnd;
+  this->inputOffset = 0;
+  this->output.clear();
+  this->renderedFrames = 0;
+  this->elapsedNanoseconds = 0;
+  this->finished = false;
+
+  if (hasInput && !settings.inputPath.empty()) {
+    PlaybackSettings playback;
+    PlaybackInfo info;
+
+    playback.format = stream_.userFormat;
+    playback.channels = stream_.nUserChannels[INPUT];
+    playback.interleaved = stream_.userInterleaved;
+    playback.maxFrames = stream_.bufferSize;
+    playback.raw = settings.inputRaw;
+    playback.rawFormat = stream_.userFormat;
+    playback.rawChannels = stream_.nUserChannels[INPUT];
+    playback.rawSampleRate = stream_.sampleRate;
+
+    if (!this->reader.start(settings.inputPath, playback, nullptr, &info, error)) {
+      return false;
+    }
+  }
+
+  if (hasOutput && !settings.outputPath.empty()) {
+    RecordingSettings recording;
+
+    recording.container = settings.outputContainer;
+    recording.format = stream_.userFormat;
+    recording.sampleSize = sampleSize;
+    recording.channels = stream_.nUserChannels[OUTPUT];
+    recording.sampleRate = stream_.sampleRate;
+    recording.periodFrames = stream_.bufferSize;
+    recording.interleaved = stream_.userInterleaved;
+    recording.ringFrames = std::max(stream_.bufferSize * 8, stream_.sampleRate) /
+                           stream_.bufferSize * stream_.bufferSize;
+    recording.lossless = true;
+
+    if (!this->writer.start(settings.outputPath, recording, nullptr, error)) {
+      this->reader.stop();
+      return false;
+    }
+  }
+
+  if (hasOutput && settings.keepOutput && settings.frames > 0) {
+    this->output.reserve(settings.frames * stream_.nUserChannels[OUTPUT] * sampleSize);
+  }
+
+  return true;
+}
+
+OfflineProgress RtApiOffline::progress() const {
+  OfflineProgress progress;
+
+  progress.frames = this->renderedFrames;
+  progress.elapsed = this->elapsedNanoseconds * 1e-9;
+  progress.finished = this->finished;
+
+  return progress;
+}
+
+std::vector<uint8_t> RtApiOffline::takeOutput() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return std::move(this->output);
+}
+
+void RtApiOffline::closeStream(void) {
+  if (stream_.state == STREAM_CLOSED) {
+    errorText_ = "RtApiOffline::closeStream(): no open stream to close!";
+    error(RTAUDIO_WARNING);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+    running = false;
+  }
+
+  stateChanged.notify_one();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+
+  reader.stop();
+  writer.stop();
+
+  for (int i = 0; i < 2; i++) {
+    free(stream_.userBuffer[i]);
+    stream_.userBuffer[i] = nullptr;
+  }
+
+  output.clear();
+
+  clearStreamInfo();
+}
+
+RtAudioErrorType RtApiOffline::startStream(void) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (stream_.state != STREAM_STOPPED) {
+      if (stream_.state == STREAM_RUNNING)
+        errorText_ = "RtApiOffline::startStream(): the stream is already running!";
+      else
+        errorText_ = "RtApiOffline::startStream(): the stream is stopping or closed!";
+      return error(RTAUDIO_WARNING);
+    }
+
+    stream_.state = STREAM_RUNNING;
+    running = true;
+  }
+
+  stateChanged.notify_one();
+
+  return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiOffline::stopStream(void) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (stream_.state != STREAM_RUNNING && stream_.state != STREAM_STOPPING) {
+    if (stream_.state == STREAM_STOPPED)
+      errorText_ = "RtApiOffline::stopStream(): the stream is already stopped!";
+    else
+      errorText_ = "RtApiOffline::stopStream(): the stream is closed!";
+    return error(RTAUDIO_WARNING);
+  }
+
+  // The render thread finishes the period it is in, which may be waiting for JS, so it
+  // is left to mark the stream stopped and call the listener. A run it hasn't picked up
+  // yet just doesn't happen.
+  stream_.state = rendering ? STREAM_STOPPING : STREAM_STOPPED;
+  running = false;
+
+  return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiOffline::abortStream(void) { return stopStream(); }
+
+void RtApiOffline::run() {
+  using clock = std::chrono::steady_clock;
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  for (;;) {
+    stateChanged.wait(lock, [this] { return closing || running.load(); });
+
+    if (closing) {
+      return;
+    }
+
+    rendering = true;
+    lock.unlock();
+
+    auto start = clock::now();
+    int64_t elapsedBefore = this->elapsedNanoseconds;
+    bool done = false;
+
+    while (running && !done) {
+      uint64_t frames = this->renderedFrames;
+
+      if (this->settings.frames > 0 && frames >= this->settings.frames) {
+        done = true;
+        break;
+      }
+
+      bool inputEnded = false;
+      int result = callbackEvent(&inputEnded);
+
+      this->elapsedNanoseconds =
+          elapsedBefore +
+          std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start)
+              .count();
+
+      if (result == 1 || result == 2) {
+        break;
+      }
+
+      // Without a frame count the input decides when rendering ends.
+      done = this->settings.frames == 0 && inputEnded;
+    }
+
+    OfflineProgress progress = finish(done);
+
+    // Only stopped once nothing touches the stream anymore, so that a start can't
+    // race with the end of this run.
+    lock.lock();
+    stream_.state = STREAM_STOPPED;
+    running = false;
+    rendering = false;
+    lock.unlock();
+
+    if (this->onEnd) {
+      this->onEnd(progress);
+    }
+
+    lock.lock();
+  }
+}
+
+bool RtApiOffline::readInput(void *input, unsigned int nFrames) {
+  size_t byteCount =
+      (size_t)nFrames * stream_.nUserChannels[INPUT] * formatBytes(stream_.userFormat);
+  const std::vector<uint8_t> &samples = this->settings.inputSamples;
+
+  if (!samples.empty()) {
+    size_t count = std::min(byteCount, samples.size() - this->inputOffset);
+
+    memcpy(input, samples.data() + this->inputOffset, count);
+    memset((uint8_t *)input + count, 0, byteCount - count);
+    this->inputOffset += count;
+
+    return this->inputOffset >= samples.size();
+  }
+
+  memset(input, 0, byteCount);
+
+  if (!this->settings.inputPath.empty()) {
+    this->reader.render(input, nFrames);
+    return !this->reader.isPlaying();
+  }
+
+  return true;
+}
+
+int RtApiOffline::callbackEvent(bool *inputEnded) {
+  RtAudioCallback callback = (RtAudioCallback)stream_.callbackInfo.callback;
+  unsigned int nFrames = stream_.bufferSize;
+  uint64_t frames = this->renderedFrames;
+
+  if (stream_.mode == INPUT || stream_.mode == DUPLEX) {
+    *inputEnded = readInput(stream_.userBuffer[INPUT], nFrames);
+  } else {
+    *inputEnded = true;
+  }
+
+  // The virtual clock, exact however long the callback takes.
+  stream_.streamTime = (double)frames / stream_.sampleRate;
+
+  int result = callback(stream_.userBuffer[OUTPUT], stream_.userBuffer[INPUT], nFrames,
+                        stream_.streamTime, 0, stream_.callbackInfo.userData);
+
+  if (stream_.mode == OUTPUT || stream_.mode == DUPLEX) {
+    const char *output = stream_.userBuffer[OUTPUT];
+    size_t byteCount = (size_t)nFrames * stream_.nUserChannels[OUTPUT] *
+                       formatBytes(stream_.userFormat);
+
+    if (this->writer.isRecording()) {
+      this->writer.push(output, nFrames);
+    }
+
+    if (this->settings.keepOutput) {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->output.insert(this->output.end(), output, output + byteCount);
+    }
+  }
+
+  this->renderedFrames = frames + nFrames;
+  stream_.streamTime = (double)this->renderedFrames / stream_.sampleRate;
+
+  return result;
+}
+
+OfflineProgress RtApiOffline::finish(bool finished) {
+  std::string error;
+
+  this->finished = finished;
+
+  // The output file is complete once rendering is, a stopped stream may still resume.
+  if (finished) {
+    error = this->writer.stop().error;
+    this->reader.stop();
+  }
+
+  OfflineProgress progress = this->progress();
+
+  progress.error = error;
+
+  return progress;
+}
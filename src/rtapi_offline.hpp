@@ -0,0 +1,107 @@
+#ifndef __NODE_ADDON_RTAPI_OFFLINE_H__
+#define __NODE_ADDON_RTAPI_OFFLINE_H__
+
+#include "file_player.hpp"
+#include "file_recorder.hpp"
+#include <RtAudio.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct OfflineSettings {
+  // Frames to render, rounded up to whole periods. 0 = until the input ends.
+  uint64_t frames = 0;
+
+  // The input: a WAV or raw file in the stream layout, or interleaved samples in the
+  // stream format. Silence without either.
+  std::string inputPath;
+  bool inputRaw = false;
+  std::vector<uint8_t> inputSamples;
+
+  // The output: a WAV or raw file, and/or kept in memory, see `takeOutput`.
+  std::string outputPath;
+  RecordingContainer outputContainer = RecordingContainer::Wav;
+  bool keepOutput = false;
+};
+
+struct OfflineProgress {
+  uint64_t frames = 0;
+  // Wall clock seconds spent rendering.
+  double elapsed = 0;
+  // Rendering reached `frames` or the end of the input, rather than being stopped.
+  bool finished = false;
+  // Set if writing the output file failed.
+  std::string error;
+};
+
+// A virtual device that renders as fast as the callback allows instead of at the
+// sample rate, for batch jobs, tests and throughput measurements.
+//
+// A render thread runs the stream callback back to back while the stream is running.
+// Stream time is a virtual clock, the frames rendered so far over the sample rate, so
+// it advances exactly one period per callback however long the callback takes. Input
+// comes from a file (through `FilePlayer`) or a buffer, output goes to a file (through
+// a lossless `FileRecorder`) and/or memory. Whenever rendering ends, because it
+// finished, the callback returned 1 or 2 or the stream was stopped, the stream stops by
+// itself and the listener is called on the render thread. `stopStream` doesn't wait for
+// the period in flight, the stream is stopping until the render thread is done with it.
+//
+// The device and user layouts are the same, `firstChannel` is ignored.
+class RtApiOffline : public RtApi {
+public:
+  static const unsigned int MaxChannels = 256;
+
+  using Listener = std::function<void(const OfflineProgress &progress)>;
+
+  RtApiOffline();
+  ~RtApiOffline();
+
+  // JS thread, between opening and starting the stream.
+  bool prepare(const OfflineSettings &settings, Listener onEnd, std::string *error);
+  OfflineProgress progress() const;
+  // The output kept in memory, interleaved in the stream format.
+  std::vector<uint8_t> takeOutput();
+
+  RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+  void closeStream(void) override;
+  RtAudioErrorType startStream(void) override;
+  RtAudioErrorType stopStream(void) override;
+  RtAudioErrorType abortStream(void) override;
+
+private:
+  void probeDevices(void) override;
+  bool probeDeviceOpen(unsigned int deviceId, StreamMode mode, unsigned int channels,
+                       unsigned int firstChannel, unsigned int sampleRate,
+                       RtAudioFormat format, unsigned int *bufferSize,
+                       RtAudio::StreamOptions *options) override;
+  void run();
+  bool readInput(void *input, unsigned int nFrames);
+  int callbackEvent(bool *inputEnded);
+  OfflineProgress finish(bool finished);
+
+  OfflineSettings settings;
+  Listener onEnd;
+  FilePlayer reader;
+  FileRecorder writer;
+  size_t inputOffset;
+  std::vector<uint8_t> output;
+
+  std::atomic<uint64_t> renderedFrames;
+  std::atomic<int64_t> elapsedNanoseconds;
+  std::atomic<bool> finished;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable stateChanged;
+  std::atomic<bool> running;
+  // Set by the render thread while it renders a run, guarded by `mutex`.
+  bool rendering;
+  bool closing;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include "sample_format.hpp"
+#include "sample_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+template <typename T>
+void rampSamples(T *samples, unsigned int nFrames, unsigned int nChannels,
+                 bool interleaved, float startGain, float endGain) {
+  float step = nFrames > 1 ? (endGain - startGain) / (nFrames - 1) : 0;
+
+  for (unsigned int frame = 0; frame < nFrames; frame++) {
+    float gain = startGain + step * frame;
+
+    for (unsigned int channel = 0; channel < nChannels; channel++) {
+      T &sample = interleaved ? samples[frame * nChannels + channel]
+                              : samples[channel * nFrames + frame];
+      sample = static_cast<T>(sample * static_cast<double>(gain));
+    }
+  }
+}
+
+void rampSint24(uint8_t *bytes, unsigned int nFrames, unsigned int nChannels,
+                bool interleaved, float startGain, float endGain) {
+  float step = nFrames > 1 ? (endGain - startGain) / (nFrames - 1) : 0;
+
+  for (unsigned int frame = 0; frame < nFrames; frame++) {
+    float gain = startGain + step * frame;
+
+    for (unsigned int channel = 0; channel < nChannels; channel++) {
+      uint8_t *sample = bytes + 3 * (interleaved ? frame * nChannels + channel
+                                                 : channel * nFrames + frame);
+      writeSint24(sample, static_cast<int32_t>(readSint24(sample) * gain));
+    }
+  }
+}
+
+template <typename T>
+void mixInto(const float *from, T *to, size_t count, double scale) {
+  const double low = std::numeric_limits<T>::min();
+  const double high = std::numeric_limits<T>::max();
+
+  for (size_t i = 0; i < count; i++) {
+    if (from[i] != 0) {
+      to[i] = (T)std::llrint(std::clamp(to[i] + from[i] * scale, low, high));
+    }
+  }
+}
+
+void mixIntoSint24(const float *from, uint8_t *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (from[i] != 0) {
+      double sum = std::clamp(readSint24(to + 3 * i) + from[i] * 8388608.0, -8388608.0,
+                              8388607.0);
+      writeSint24(to + 3 * i, (int32_t)std::llrint(sum));
+    }
+  }
+}
+
+// Samples converted per step when going through floats.
+const size_t ChunkSize = 256;
+
+void int8ToFloat(const int8_t *from, float *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    to[i] = from[i] * (1.0f / 128);
+  }
+}
+
+void floatToInt8(const float *from, int8_t *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    float value = std::clamp(from[i], -1.0f, 1.0f) * 128;
+    to[i] = (int8_t)std::min(std::lrint(value), 127L);
+  }
+}
+
+void samplesToFloatWith(const SampleKernels &kernels, const void *from,
+                        RtAudioFormat format, float *to, size_t count) {
+  switch (format) {
+  case RTAUDIO_SINT8:
+    int8ToFloat((const int8_t *)from, to, count);
+    break;
+  case RTAUDIO_SINT16:
+    kernels.int16ToFloat((const int16_t *)from, to, count);
+    break;
+  case RTAUDIO_SINT24:
+    kernels.int24ToFloat((const uint8_t *)from, to, count);
+    break;
+  case RTAUDIO_SINT32:
+    kernels.int32ToFloat((const int32_t *)from, to, count);
+    break;
+  case RTAUDIO_FLOAT32:
+    std::copy((const float *)from, (const float *)from + count, to);
+    break;
+  case RTAUDIO_FLOAT64:
+    kernels.doubleToFloat((const double *)from, to, count);
+    break;
+  }
+}
+
+void floatToSamplesWith(const SampleKernels &kernels, const float *from, void *to,
+                        RtAudioFormat format, size_t count) {
+  switch (format) {
+  case RTAUDIO_SINT8:
+    floatToInt8(from, (int8_t *)to, count);
+    break;
+  case RTAUDIO_SINT16:
+    kernels.floatToInt16(from, (int16_t *)to, count);
+    break;
+  case RTAUDIO_SINT24:
+    kernels.floatToInt24(from, (uint8_t *)to, count);
+    break;
+  case RTAUDIO_SINT32:
+    kernels.floatToInt32(from, (int32_t *)to, count);
+    break;
+  case RTAUDIO_FLOAT32:
+    for (size_t i = 0; i < count; i++) {
+      ((float *)to)[i] = std::clamp(from[i], -1.0f, 1.0f);
+    }
+    break;
+  case RTAUDIO_FLOAT64:
+    kernels.floatToDouble(from, (double *)to, count);
+    break;
+  }
+}
+
+// One least significant bit of the formats that are dithered, 0 for the others.
+float ditherStep(RtAudioFormat format) {
+  switch (format) {
+  case RTAUDIO_SINT8:
+    return 1.0f / 128;
+  case RTAUDIO_SINT16:
+    return 1.0f / 32768;
+  case RTAUDIO_SINT24:
+    return 1.0f / 8388608;
+  default:
+    return 0;
+  }
+}
+
+// Adds triangular noise of +-1 LSB, the difference of two uniform draws per sample.
+void addDither(const float *from, float *to, size_t count, float step,
+               DitherState *dither) {
+  const float scale = step / 4294967296.0f;
+  uint32_t state = dither->state;
+
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    uint32_t first = state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    to[i] = from[i] + ((float)first - (float)state) * scale;
+  }
+
+  dither->state = state;
+}
+
+} // namespace
+
+void applyGainRamp(void *buffer, RtAudioFormat format, unsigned int nFrames,
+                   unsigned int nChannels, bool interleaved, float startGain,
+                   float endGain) {
+  switch (format) {
+  case RTAUDIO_SINT8:
+    rampSamples((int8_t *)buffer, nFrames, nChannels, interleaved, startGain, endGain);
+    break;
+  case RTAUDIO_SINT16:
+    rampSamples((int16_t *)buffer, nFrames, nChannels, interleaved, startGain, endGain);
+    break;
+  case RTAUDIO_SINT24:
+    rampSint24((uint8_t *)buffer, nFrames, nChannels, interleaved, startGain, endGain);
+    break;
+  case RTAUDIO_SINT32:
+    rampSamples((int32_t *)buffer, nFrames, nChannels, interleaved, startGain, endGain);
+    break;
+  case RTAUDIO_FLOAT32:
+    rampSamples((float *)buffer, nFrames, nChannels, interleaved, startGain, endGain);
+    break;
+  case RTAUDIO_FLOAT64:
+    rampSamples((double *)buffer, nFrames, nChannels, interleaved, startGain, endGain);
+    break;
+  }
+}
+
+void samplesToFloat(const void *from, RtAudioFormat format, float *to, size_t count) {
+  samplesToFloatWith(sampleKernels(), from, format, to, count);
+}
+
+void floatToSamples(const float *from, void *to, RtAudioFormat format, size_t count) {
+  floatToSamplesWith(sampleKernels(), from, to, format, count);
+}
+
+void mixFloatIntoSamples(const float *from, void *to, RtAudioFormat format,
+                         size_t count) {
+  switch (format) {
+  case RTAUDIO_SINT8:
+    mixInto(from, (int8_t *)to, count, 128.0);
+    break;
+  case RTAUDIO_SINT16:
+    mixInto(from, (int16_t *)to, count, 32768.0);
+    break;
+  case RTAUDIO_SINT24:
+    mixIntoSint24(from, (uint8_t *)to, count);
+    break;
+  case RTAUDIO_SINT32:
+    mixInto(from, (int32_t *)to, count, 2147483648.0);
+    break;
+  case RTAUDIO_FLOAT32:
+    for (size_t i = 0; i < count; i++) {
+      ((float *)to)[i] += from[i];
+    }
+    break;
+  case RTAUDIO_FLOAT64:
+    for (size_t i = 0; i < count; i++) {
+      ((double *)to)[i] += from[i];
+    }
+    break;
+  }
+}
+
+void convertSamples(const void *from, RtAudioFormat fromFormat, void *to,
+                    RtAudioFormat toFormat, size_t count, DitherState *dither,
+                    bool reference) {
+  const SampleKernels &kernels = reference ? referenceSampleKernels() : sampleKernels();
+  const float step = dither ? ditherStep(toFormat) : 0;
+
+  if (fromFormat == toFormat) {
+    memcpy(to, from, count * sampleByteSize(fromFormat));
+    return;
+  }
+
+  if (fromFormat == RTAUDIO_FLOAT32 && step == 0) {
+    floatToSamplesWith(kernels, (const float *)from, to, toFormat, count);
+    return;
+  }
+
+  if (toFormat == RTAUDIO_FLOAT32) {
+    samplesToFloatWith(kernels, from, fromFormat, (float *)to, count);
+    return;
+  }
+
+  const size_t fromSize = sampleByteSize(fromFormat);
+  const size_t toSize = sampleByteSize(toFormat);
+  float chunk[ChunkSize];
+
+  for (size_t offset = 0; offset < count; offset += ChunkSize) {
+    size_t n = std::min(ChunkSize, count - offset);
+    const uint8_t *source = (const uint8_t *)from + offset * fromSize;
+
+    if (fromFormat == RTAUDIO_FLOAT32) {
+      addDither((const float *)source, chunk, n, step, dither);
+    } else {
+      samplesToFloatWith(kernels, source, fromFormat, chunk, n);
+      if (step != 0)
+        addDither(chunk, chunk, n, step, dither);
+    }
+
+    floatToSamplesWith(kernels, chunk, (uint8_t *)to + offset * toSize, toFormat, n);
+  }
+}
+
+size_t sampleByteSize(RtAudioFormat format) {
+  switch (format) {
+  case RTAUDIO_SINT8:
+    return 1;
+  case RTAUDIO_SINT16:
+    return 2;
+  case RTAUDIO_SINT24:
+    return 3;
+  case RTAUDIO_SINT32:
+  case RTAUDIO_FLOAT32:
+    return 4;
+  case RTAUDIO_FLOAT64:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+const char *getSampleConversionIsa() { return sampleKernels().isa; }
@@ -0,0 +1,47 @@
+#ifndef __NODE_ADDON_SAMPLE_FORMAT_H__
+#define __NODE_ADDON_SAMPLE_FORMAT_H__
+
+#include <RtAudio.h>
+#include <cstddef>
+#include <cstdint>
+
+// Sample level helpers that work on buffers of any RtAudioFormat. They are meant to be
+// called on the realtime thread, so they never allocate.
+
+// Multiplies the buffer with a gain that goes linearly from `startGain` on the first
+// frame to `endGain` on the last one.
+void applyGainRamp(void *buffer, RtAudioFormat format, unsigned int nFrames,
+                   unsigned int nChannels, bool interleaved, float startGain,
+                   float endGain);
+
+// Per stream state of the dither noise generator, see `convertSamples`.
+struct DitherState {
+  uint32_t state = 0x9e3779b9;
+};
+
+// Converts `count` samples in host byte order to floats in [-1, 1].
+void samplesToFloat(const void *from, RtAudioFormat format, float *to, size_t count);
+
+// Converts `count` floats to samples in host byte order, clipping to [-1, 1].
+void floatToSamples(const float *from, void *to, RtAudioFormat format, size_t count);
+
+// Adds `count` floats in [-1, 1] to samples in host byte order. The sums are computed in
+// the samples' own format, clipping integer ones, so samples `from` adds 0 to keep
+// their exact value.
+void mixFloatIntoSamples(const float *from, void *to, RtAudioFormat format, size_t count);
+
+// Converts `count` samples between two formats, going through floats unless one side
+// already is float32, and copying if the formats match. Conversions use the SIMD kernels
+// the CPU supports, or the scalar reference ones if `reference` is set. If `dither` is
+// given, TPDF noise of one LSB is added before quantizing to 8, 16 or 24 bits.
+void convertSamples(const void *from, RtAudioFormat fromFormat, void *to,
+                    RtAudioFormat toFormat, size_t count, DitherState *dither = nullptr,
+                    bool reference = false);
+
+// Bytes per sample of the format, 0 if it is unknown.
+size_t sampleByteSize(RtAudioFormat format);
+
+// The instruction set of the conversion kernels, "avx2", "sse2", "neon" or "scalar".
+const char *getSampleConversionIsa();
+
+#endif
@@ -0,0 +1,649 @@
+#include "sample_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SAMPLE_KERNELS_SSE2
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+// Compiled for AVX2 regardless of the build flags, only called if the CPU has it.
+#define SAMPLE_KERNELS_AVX2 __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define SAMPLE_KERNELS_AVX2
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SAMPLE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// The largest float below 2^31, 2^31 itself overflows the int32 conversions.
+const float MaxInt32Float = 2147483520.0f;
+
+void int16ToFloatScalar(const int16_t *from, float *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    to[i] = from[i] * (1.0f / 32768);
+  }
+}
+
+void floatToInt16Scalar(const float *from, int16_t *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    float value = std::clamp(from[i], -1.0f, 1.0f) * 32768;
+    to[i] = (int16_t)std::min(std::lrint(value), 32767L);
+  }
+}
+
+void int24ToFloatScalar(const uint8_t *from, float *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    to[i] = readSint24(from + 3 * i) * (1.0f / 8388608);
+  }
+}
+
+void floatToInt24Scalar(const float *from, uint8_t *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    float value = std::clamp(from[i], -1.0f, 1.0f) * 8388608;
+    writeSint24(to + 3 * i, (int32_t)std::min(std::lrint(value), 8388607L));
+  }
+}
+
+void int32ToFloatScalar(const int32_t *from, float *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    to[i] = from[i] * (1.0f / 2147483648.0f);
+  }
+}
+
+void floatToInt32Scalar(const float *from, int32_t *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    float value = std::clamp(from[i], -1.0f, 1.0f) * 2147483648.0f;
+    to[i] = (int32_t)std::lrint(std::min(value, MaxInt32Float));
+  }
+}
+
+void doubleToFloatScalar(const double *from, float *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    to[i] = (float)from[i];
+  }
+}
+
+void floatToDoubleScalar(const float *from, double *to, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    to[i] = std::clamp(from[i], -1.0f, 1.0f);
+  }
+}
+
+float dotProductScalar(const float *a, const float *b, size_t count) {
+  float sum = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+void mixRampScalar(const float *from, float *to, size_t count, float gain, float step) {
+  for (size_t i = 0; i < count; i++) {
+    to[i] += from[i] * (gain + step * i);
+  }
+}
+
+float peakScalar(const float *from, size_t count) {
+  float peak = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    peak = std::max(peak, std::fabs(from[i]));
+  }
+
+  return peak;
+}
+
+void gather32Scalar(const uint32_t *from, uint32_t *to, size_t count,
+                    const int32_t *pattern, size_t patternLength, size_t patternStride) {
+  for (size_t k = 0, j = 0; k < count; k++) {
+    int32_t index = pattern[j];
+
+    to[k] = index < 0 ? 0 : from[index];
+
+    if (++j == patternLength) {
+      j = 0;
+      from += patternStride;
+    }
+  }
+}
+
+#ifdef SAMPLE_KERNELS_SSE2
+
+void int16ToFloatSse2(const int16_t *from, float *to, size_t count) {
+  const __m128 scale = _mm_set1_ps(1.0f / 32768);
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    __m128i samples = _mm_loadu_si128((const __m128i *)(from + i));
+    __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+    _mm_storeu_ps(to + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+    _mm_storeu_ps(to + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+  }
+
+  int16ToFloatScalar(from + i, to + i, count - i);
+}
+
+void floatToInt16Sse2(const float *from, int16_t *to, size_t count) {
+  const __m128 scale = _mm_set1_ps(32768);
+  const __m128 min = _mm_set1_ps(-1);
+  const __m128 max = _mm_set1_ps(1);
+  size_t i = 0;
+
+  // 1.0 scales to 32768, the saturating pack clips it to 32767.
+  for (; i + 8 <= count; i += 8) {
+    __m128 low = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(from + i), min), max);
+    __m128 high = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(from + i + 4), min), max);
+    __m128i samples = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(low, scale)),
+                                      _mm_cvtps_epi32(_mm_mul_ps(high, scale)));
+    _mm_storeu_si128((__m128i *)(to + i), samples);
+  }
+
+  floatToInt16Scalar(from + i, to + i, count - i);
+}
+
+void int32ToFloatSse2(const int32_t *from, float *to, size_t count) {
+  const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i samples = _mm_loadu_si128((const __m128i *)(from + i));
+    _mm_storeu_ps(to + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+  }
+
+  int32ToFloatScalar(from + i, to + i, count - i);
+}
+
+void floatToInt32Sse2(const float *from, int32_t *to, size_t count) {
+  const __m128 scale = _mm_set1_ps(2147483648.0f);
+  const __m128 min = _mm_set1_ps(-1);
+  const __m128 max = _mm_set1_ps(1);
+  const __m128 maxScaled = _mm_set1_ps(MaxInt32Float);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 samples = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(from + i), min), max);
+    samples = _mm_min_ps(_mm_mul_ps(samples, scale), maxScaled);
+    _mm_storeu_si128((__m128i *)(to + i), _mm_cvtps_epi32(samples));
+  }
+
+  floatToInt32Scalar(from + i, to + i, count - i);
+}
+
+void doubleToFloatSse2(const double *from, float *to, size_t count) {
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 low = _mm_cvtpd_ps(_mm_loadu_pd(from + i));
+    __m128 high = _mm_cvtpd_ps(_mm_loadu_pd(from + i + 2));
+    _mm_storeu_ps(to + i, _mm_movelh_ps(low, high));
+  }
+
+  doubleToFloatScalar(from + i, to + i, count - i);
+}
+
+void floatToDoubleSse2(const float *from, double *to, size_t count) {
+  const __m128 min = _mm_set1_ps(-1);
+  const __m128 max = _mm_set1_ps(1);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 samples = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(from + i), min), max);
+    _mm_storeu_pd(to + i, _mm_cvtps_pd(samples));
+    _mm_storeu_pd(to + i + 2, _mm_cvtps_pd(_mm_movehl_ps(samples, samples)));
+  }
+
+  floatToDoubleScalar(from + i, to + i, count - i);
+}
+
+float dotProductSse2(const float *a, const float *b, size_t count) {
+  __m128 sum = _mm_setzero_ps();
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+  return _mm_cvtss_f32(sum) + dotProductScalar(a + i, b + i, count - i);
+}
+
+void mixRampSse2(const float *from, float *to, size_t count, float gain, float step) {
+  const __m128 lanes = _mm_set_ps(3 * step, 2 * step, step, 0);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 gains = _mm_add_ps(_mm_set1_ps(gain + step * i), lanes);
+    __m128 product = _mm_mul_ps(_mm_loadu_ps(from + i), gains);
+    _mm_storeu_ps(to + i, _mm_add_ps(_mm_loadu_ps(to + i), product));
+  }
+
+  mixRampScalar(from + i, to + i, count - i, gain + step * i, step);
+}
+
+float peakSse2(const float *from, size_t count) {
+  const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 peak = _mm_setzero_ps();
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(from + i), magnitude));
+  }
+
+  peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+  peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, 1));
+
+  return std::max(_mm_cvtss_f32(peak), peakScalar(from + i, count - i));
+}
+
+#endif
+
+#ifdef SAMPLE_KERNELS_AVX2
+
+SAMPLE_KERNELS_AVX2 void int16ToFloatAvx2(const int16_t *from, float *to, size_t count) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 32768);
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(from + i)));
+    _mm256_storeu_ps(to + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+  }
+
+  int16ToFloatScalar(from + i, to + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void floatToInt16Avx2(const float *from, int16_t *to, size_t count) {
+  const __m256 scale = _mm256_set1_ps(32768);
+  const __m256 min = _mm256_set1_ps(-1);
+  const __m256 max = _mm256_set1_ps(1);
+  size_t i = 0;
+
+  for (; i + 16 <= count; i += 16) {
+    __m256 low = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(from + i), min), max);
+    __m256 high = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(from + i + 8), min), max);
+    __m256i samples = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(low, scale)),
+                                         _mm256_cvtps_epi32(_mm256_mul_ps(high, scale)));
+    // The pack works per 128-bit lane, put the quarters back in order.
+    samples = _mm256_permute4x64_epi64(samples, 0xd8);
+    _mm256_storeu_si256((__m256i *)(to + i), samples);
+  }
+
+  floatToInt16Scalar(from + i, to + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void int24ToFloatAvx2(const uint8_t *from, float *to, size_t count) {
+  // Moves the 3 bytes of each sample to the top of a 32-bit lane, the arithmetic shift
+  // then sign extends it.
+  const __m256i shuffle =
+      _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2,
+                       -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+  const __m256 scale = _mm256_set1_ps(1.0f / 8388608);
+  size_t i = 0;
+
+  // Each step reads 28 bytes for 8 samples, so stop while that stays in bounds.
+  for (; i + 10 <= count; i += 8) {
+    __m128i low = _mm_loadu_si128((const __m128i *)(from + 3 * i));
+    __m128i high = _mm_loadu_si128((const __m128i *)(from + 3 * i + 12));
+    __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+    __m256i samples = _mm256_srai_epi32(_mm256_shuffle_epi8(bytes, shuffle), 8);
+    _mm256_storeu_ps(to + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+  }
+
+  int24ToFloatScalar(from + 3 * i, to + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void floatToInt24Avx2(const float *from, uint8_t *to, size_t count) {
+  const __m256i shuffle =
+      _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4,
+                       5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const __m256 scale = _mm256_set1_ps(8388608);
+  const __m256 min = _mm256_set1_ps(-1);
+  const __m256 max = _mm256_set1_ps(1);
+  const __m256 maxScaled = _mm256_set1_ps(8388607);
+  size_t i = 0;
+
+  // Each lane is stored as 16 bytes of which 12 are samples, the next store overwrites
+  // the rest, so stop while the last 4 spare bytes stay in bounds.
+  for (; i + 10 <= count; i += 8) {
+    __m256 samples = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(from + i), min), max);
+    samples = _mm256_min_ps(_mm256_mul_ps(samples, scale), maxScaled);
+    __m256i bytes = _mm256_shuffle_epi8(_mm256_cvtps_epi32(samples), shuffle);
+    _mm_storeu_si128((__m128i *)(to + 3 * i), _mm256_castsi256_si128(bytes));
+    _mm_storeu_si128((__m128i *)(to + 3 * i + 12), _mm256_extracti128_si256(bytes, 1));
+  }
+
+  floatToInt24Scalar(from + i, to + 3 * i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void int32ToFloatAvx2(const int32_t *from, float *to, size_t count) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    __m256i samples = _mm256_loadu_si256((const __m256i *)(from + i));
+    _mm256_storeu_ps(to + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+  }
+
+  int32ToFloatScalar(from + i, to + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void floatToInt32Avx2(const float *from, int32_t *to, size_t count) {
+  const __m256 scale = _mm256_set1_ps(2147483648.0f);
+  const __m256 min = _mm256_set1_ps(-1);
+  const __m256 max = _mm256_set1_ps(1);
+  const __m256 maxScaled = _mm256_set1_ps(MaxInt32Float);
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    __m256 samples = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(from + i), min), max);
+    samples = _mm256_min_ps(_mm256_mul_ps(samples, scale), maxScaled);
+    _mm256_storeu_si256((__m256i *)(to + i), _mm256_cvtps_epi32(samples));
+  }
+
+  floatToInt32Scalar(from + i, to + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void doubleToFloatAvx2(const double *from, float *to, size_t count) {
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(to + i, _mm256_cvtpd_ps(_mm256_loadu_pd(from + i)));
+  }
+
+  doubleToFloatScalar(from + i, to + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void floatToDoubleAvx2(const float *from, double *to, size_t count) {
+  const __m128 min = _mm_set1_ps(-1);
+  const __m128 max = _mm_set1_ps(1);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 samples = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(from + i), min), max);
+    _mm256_storeu_pd(to + i, _mm256_cvtps_pd(samples));
+  }
+
+  floatToDoubleScalar(from + i, to + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 float dotProductAvx2(const float *a, const float *b, size_t count) {
+  __m256 sum = _mm256_setzero_ps();
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    __m256 product = _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    sum = _mm256_add_ps(sum, product);
+  }
+
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+
+  return _mm_cvtss_f32(half) + dotProductScalar(a + i, b + i, count - i);
+}
+
+SAMPLE_KERNELS_AVX2 void mixRampAvx2(const float *from, float *to, size_t count,
+                                     float gain, float step) {
+  const __m256 lanes = _mm256_mul_ps(_mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0),
+                                     _mm256_set1_ps(step));
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    __m256 gains = _mm256_add_ps(_mm256_set1_ps(gain + step * i), lanes);
+    __m256 product = _mm256_mul_ps(_mm256_loadu_ps(from + i), gains);
+    _mm256_storeu_ps(to + i, _mm256_add_ps(_mm256_loadu_ps(to + i), product));
+  }
+
+  mixRampScalar(from + i, to + i, count - i, gain + step * i, step);
+}
+
+SAMPLE_KERNELS_AVX2 float peakAvx2(const float *from, size_t count) {
+  const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 peak = _mm256_setzero_ps();
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(from + i), magnitude));
+  }
+
+  __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+  half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+
+  return std::max(_mm_cvtss_f32(half), peakScalar(from + i, count - i));
+}
+
+// Whole patterns go through masked gathers, so they have to be a multiple of 8 long.
+SAMPLE_KERNELS_AVX2 void gather32Avx2(const uint32_t *from, uint32_t *to, size_t count,
+                                      const int32_t *pattern, size_t patternLength,
+                                      size_t patternStride) {
+  if (patternLength % 8 != 0) {
+    gather32Scalar(from, to, count, pattern, patternLength, patternStride);
+    return;
+  }
+
+  const __m256i none = _mm256_set1_epi32(-1);
+  size_t k = 0;
+
+  for (; k + patternLength <= count; k += patternLength) {
+    for (size_t j = 0; j < patternLength; j += 8) {
+      __m256i indices = _mm256_loadu_si256((const __m256i *)(pattern + j));
+      __m256i mask = _mm256_cmpgt_epi32(indices, none);
+      __m256i samples = _mm256_mask_i32gather_epi32(
+          _mm256_setzero_si256(), (const int *)from, indices, mask, 4);
+      _mm256_storeu_si256((__m256i *)(to + k + j), samples);
+    }
+
+    from += patternStride;
+  }
+
+  gather32Scalar(from, to + k, count - k, pattern, patternLength, patternStride);
+}
+
+#endif
+
+#ifdef SAMPLE_KERNELS_NEON
+
+void int16ToFloatNeon(const int16_t *from, float *to, size_t count) {
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t samples = vld1q_s16(from + i);
+    vst1q_f32(to + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))),
+                                  1.0f / 32768));
+    vst1q_f32(to + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))),
+                                      1.0f / 32768));
+  }
+
+  int16ToFloatScalar(from + i, to + i, count - i);
+}
+
+void floatToInt16Neon(const float *from, int16_t *to, size_t count) {
+  const float32x4_t min = vdupq_n_f32(-1);
+  const float32x4_t max = vdupq_n_f32(1);
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    float32x4_t low = vminq_f32(vmaxq_f32(vld1q_f32(from + i), min), max);
+    float32x4_t high = vminq_f32(vmaxq_f32(vld1q_f32(from + i + 4), min), max);
+    int32x4_t lowSamples = vcvtnq_s32_f32(vmulq_n_f32(low, 32768));
+    int32x4_t highSamples = vcvtnq_s32_f32(vmulq_n_f32(high, 32768));
+    vst1q_s16(to + i, vcombine_s16(vqmovn_s32(lowSamples), vqmovn_s32(highSamples)));
+  }
+
+  floatToInt16Scalar(from + i, to + i, count - i);
+}
+
+void int32ToFloatNeon(const int32_t *from, float *to, size_t count) {
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t samples = vcvtq_f32_s32(vld1q_s32(from + i));
+    vst1q_f32(to + i, vmulq_n_f32(samples, 1.0f / 2147483648.0f));
+  }
+
+  int32ToFloatScalar(from + i, to + i, count - i);
+}
+
+void floatToInt32Neon(const float *from, int32_t *to, size_t count) {
+  const float32x4_t min = vdupq_n_f32(-1);
+  const float32x4_t max = vdupq_n_f32(1);
+  size_t i = 0;
+
+  // The conversion saturates, so 1.0 ends up as INT32_MAX.
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t samples = vminq_f32(vmaxq_f32(vld1q_f32(from + i), min), max);
+    vst1q_s32(to + i, vcvtnq_s32_f32(vmulq_n_f32(samples, 2147483648.0f)));
+  }
+
+  floatToInt32Scalar(from + i, to + i, count - i);
+}
+
+void doubleToFloatNeon(const double *from, float *to, size_t count) {
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(to + i, vcombine_f32(vcvt_f32_f64(vld1q_f64(from + i)),
+                                   vcvt_f32_f64(vld1q_f64(from + i + 2))));
+  }
+
+  doubleToFloatScalar(from + i, to + i, count - i);
+}
+
+void floatToDoubleNeon(const float *from, double *to, size_t count) {
+  const float32x4_t min = vdupq_n_f32(-1);
+  const float32x4_t max = vdupq_n_f32(1);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t samples = vminq_f32(vmaxq_f32(vld1q_f32(from + i), min), max);
+    vst1q_f64(to + i, vcvt_f64_f32(vget_low_f32(samples)));
+    vst1q_f64(to + i + 2, vcvt_high_f64_f32(samples));
+  }
+
+  floatToDoubleScalar(from + i, to + i, count - i);
+}
+
+float dotProductNeon(const float *a, const float *b, size_t count) {
+  float32x4_t sum = vdupq_n_f32(0);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+
+  return vaddvq_f32(sum) + dotProductScalar(a + i, b + i, count - i);
+}
+
+void mixRampNeon(const float *from, float *to, size_t count, float gain, float step) {
+  const float steps[4] = {0, step, 2 * step, 3 * step};
+  const float32x4_t lanes = vld1q_f32(steps);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t gains = vaddq_f32(vdupq_n_f32(gain + step * i), lanes);
+    vst1q_f32(to + i, vmlaq_f32(vld1q_f32(to + i), vld1q_f32(from + i), gains));
+  }
+
+  mixRampScalar(from + i, to + i, count - i, gain + step * i, step);
+}
+
+float peakNeon(const float *from, size_t count) {
+  float32x4_t peak = vdupq_n_f32(0);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(from + i)));
+  }
+
+  return std::max(vmaxvq_f32(peak), peakScalar(from + i, count - i));
+}
+
+#endif
+
+const SampleKernels ScalarKernels = {
+    "scalar",
+    int16ToFloatScalar,
+    floatToInt16Scalar,
+    int24ToFloatScalar,
+    floatToInt24Scalar,
+    int32ToFloatScalar,
+    floatToInt32Scalar,
+    doubleToFloatScalar,
+    floatToDoubleScalar,
+    dotProductScalar,
+    mixRampScalar,
+    peakScalar,
+    gather32Scalar,
+};
+
+SampleKernels selectKernels() {
+#if defined(SAMPLE_KERNELS_AVX2)
+#if defined(__GNUC__) || defined(__clang__)
+  if (__builtin_cpu_supports("avx2"))
+#endif
+    return {"avx2",
+            int16ToFloatAvx2,
+            floatToInt16Avx2,
+            int24ToFloatAvx2,
+            floatToInt24Avx2,
+            int32ToFloatAvx2,
+            floatToInt32Avx2,
+            doubleToFloatAvx2,
+            floatToDoubleAvx2,
+            dotProductAvx2,
+            mixRampAvx2,
+            peakAvx2,
+            gather32Avx2};
+#endif
+
+#if defined(SAMPLE_KERNELS_SSE2)
+  // There is no SSE2 byte shuffle, 24-bit samples stay scalar, and no gather before
+  // AVX2.
+  return {"sse2",
+          int16ToFloatSse2,
+          floatToInt16Sse2,
+          int24ToFloatScalar,
+          floatToInt24Scalar,
+          int32ToFloatSse2,
+          floatToInt32Sse2,
+          doubleToFloatSse2,
+          floatToDoubleSse2,
+          dotProductSse2,
+          mixRampSse2,
+          peakSse2,
+          gather32Scalar};
+#elif defined(SAMPLE_KERNELS_NEON)
+  return {"neon",
+          int16ToFloatNeon,
+          floatToInt16Neon,
+          int24ToFloatScalar,
+          floatToInt24Scalar,
+          int32ToFloatNeon,
+          floatToInt32Neon,
+          doubleToFloatNeon,
+          floatToDoubleNeon,
+          dotProductNeon,
+          mixRampNeon,
+          peakNeon,
+          gather32Scalar};
+#else
+  return ScalarKernels;
+#endif
+}
+
+} // namespace
+
+const SampleKernels &sampleKernels() {
+  static const SampleKernels kernels = selectKernels();
+  return kernels;
+}
+
+const SampleKernels &referenceSampleKernels() { return ScalarKernels; }
@@ -0,0 +1,69 @@
+#ifndef __NODE_ADDON_SAMPLE_KERNELS_H__
+#define __NODE_ADDON_SAMPLE_KERNELS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// Packed 24-bit samples in host byte order.
+inline int32_t readSint24(const uint8_t *sample) {
+#if defined(__BIG_ENDIAN__) ||                                                           \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  return (int32_t)((uint32_t)sample[0] << 24 | (uint32_t)sample[1] << 16 |
+                   (uint32_t)sample[2] << 8) >>
+         8;
+#else
+  return (int32_t)((uint32_t)sample[2] << 24 | (uint32_t)sample[1] << 16 |
+                   (uint32_t)sample[0] << 8) >>
+         8;
+#endif
+}
+
+inline void writeSint24(uint8_t *sample, int32_t value) {
+#if defined(__BIG_ENDIAN__) ||                                                           \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  sample[0] = (uint8_t)(value >> 16);
+  sample[1] = (uint8_t)(value >> 8);
+  sample[2] = (uint8_t)value;
+#else
+  sample[0] = (uint8_t)value;
+  sample[1] = (uint8_t)(value >> 8);
+  sample[2] = (uint8_t)(value >> 16);
+#endif
+}
+
+// Conversion and filter kernels. Conversions go between float32 and the other sample
+// formats, in host byte order. Floats are in [-1, 1]; conversions to integers clip and
+// round to nearest, 24-bit samples are packed.
+//
+// `sampleKernels` picks the widest instruction set the CPU supports (AVX2 or SSE2 on
+// x86, NEON on ARM64) once, `referenceSampleKernels` are the plain scalar loops the
+// vectorized ones fall back to for their tails and are checked against.
+struct SampleKernels {
+  const char *isa;
+  void (*int16ToFloat)(const int16_t *from, float *to, size_t count);
+  void (*floatToInt16)(const float *from, int16_t *to, size_t count);
+  void (*int24ToFloat)(const uint8_t *from, float *to, size_t count);
+  void (*floatToInt24)(const float *from, uint8_t *to, size_t count);
+  void (*int32ToFloat)(const int32_t *from, float *to, size_t count);
+  void (*floatToInt32)(const float *from, int32_t *to, size_t count);
+  void (*doubleToFloat)(const double *from, float *to, size_t count);
+  void (*floatToDouble)(const float *from, double *to, size_t count);
+  // Sum of the element-wise products, used by the resampler filters.
+  float (*dotProduct)(const float *a, const float *b, size_t count);
+  // Adds `from` into `to`, scaled by a gain that starts at `gain` and changes by `step`
+  // per sample, used by the mixer.
+  void (*mixRamp)(const float *from, float *to, size_t count, float gain, float step);
+  // Largest absolute value, used for metering.
+  float (*peak)(const float *from, size_t count);
+  // Copies 32-bit samples through an index pattern that repeats every `patternLength`
+  // samples of `to` and `patternStride` samples of `from`:
+  // to[k] = from[k / patternLength * patternStride + pattern[k % patternLength]], 0 for
+  // negative indices. Used by the channel maps.
+  void (*gather32)(const uint32_t *from, uint32_t *to, size_t count,
+                   const int32_t *pattern, size_t patternLength, size_t patternStride);
+};
+
+const SampleKernels &sampleKernels();
+const SampleKernels &referenceSampleKernels();
+
+#endif
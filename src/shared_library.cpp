@@ -0,0 +1,53 @@
+#include "shared_library.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+SharedLibrary::SharedLibrary() : handle{nullptr} {}
+
+SharedLibrary::~SharedLibrary() {
+  if (this->handle == nullptr) {
+    return;
+  }
+
+#ifdef _WIN32
+  FreeLibrary((HMODULE)this->handle);
+#else
+  dlclose(this->handle);
+#endif
+}
+
+bool SharedLibrary::open(const std::vector<std::string> &names, std::string *error) {
+  for (const std::string &name : names) {
+#ifdef _WIN32
+    this->handle = (void *)LoadLibraryA(name.c_str());
+#else
+    this->handle = dlopen(name.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+
+    if (this->handle != nullptr) {
+      return true;
+    }
+  }
+
+  *error = "Couldn't load " + (names.empty() ? std::string("the library") : names[0]);
+
+  return false;
+}
+
+bool SharedLibrary::isOpen() const { return this->handle != nullptr; }
+
+void *SharedLibrary::symbol(const char *name) const {
+  if (this->handle == nullptr) {
+    return nullptr;
+  }
+
+#ifdef _WIN32
+  return (void *)GetProcAddress((HMODULE)this->handle, name);
+#else
+  return dlsym(this->handle, name);
+#endif
+}
@@ -0,0 +1,27 @@
+#ifndef __NODE_ADDON_SHARED_LIBRARY_H__
+#define __NODE_ADDON_SHARED_LIBRARY_H__
+
+#include <string>
+#include <vector>
+
+// A shared library opened at runtime, for optional dependencies the binding isn't linked
+// against. The library stays loaded until the object is destroyed.
+class SharedLibrary {
+public:
+  SharedLibrary();
+  ~SharedLibrary();
+
+  SharedLibrary(const SharedLibrary &) = delete;
+  SharedLibrary &operator=(const SharedLibrary &) = delete;
+
+  // Opens the first of `names` that loads, names are passed to the system loader as they
+  // are.
+  bool open(const std::vector<std::string> &names, std::string *error);
+  bool isOpen() const;
+  void *symbol(const char *name) const;
+
+private:
+  void *handle;
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "silence_gate.hpp"
+#include "sample_format.hpp"
+#include "sample_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const double Pi = 3.14159265358979323846;
+
+// Speech band of the VAD, in Hz.
+const double BandLow = 300;
+const double BandHigh = 3400;
+
+// dB per second the noise floor creeps up while the band is above it, and the share of
+// the distance it falls per period while the band is below it.
+const double FloorRise = 1;
+const double FloorFall = 0.3;
+
+double toDecibels(double power) {
+  return power > 0 ? std::max(10 * std::log10(power), SilenceGate::MinLevel)
+                   : SilenceGate::MinLevel;
+}
+
+} // namespace
+
+float SilenceGate::Biquad::process(float x) {
+  float y = this->b0 * x + this->z1;
+
+  this->z1 = this->b1 * x - this->a1 * y + this->z2;
+  this->z2 = this->b2 * x - this->a2 * y;
+
+  return y;
+}
+
+SilenceGate::SilenceGate()
+    : format{RTAUDIO_SINT16}, channels{0}, interleaved{true}, periodFrames{0},
+      sampleRate{0}, sampleSize{0}, open{false}, holdFrames{0}, holdLeft{0},
+      bandFloor{0}, bandMargin{0}, preRollSlots{0}, preRollNext{0}, preRollCount{0},
+      openingCount{0}, openState{false}, openCount{0}, closeCount{0}, suppressed{0},
+      suppressedFrameCount{0}, delivered{0}, lastLevel{MinLevel}, lastFloor{MinLevel} {}
+
+void SilenceGate::configure(const GateSettings &settings, RtAudioFormat format,
+                            unsigned int channels, bool interleaved,
+                            unsigned int periodFrames, unsigned int sampleRate) {
+  this->settings = settings;
+  this->format = format;
+  this->channels = channels;
+  this->interleaved = interleaved;
+  this->periodFrames = periodFrames;
+  this->sampleRate = sampleRate;
+  this->sampleSize = sampleByteSize(format);
+
+  this->open = false;
+  this->holdFrames = (uint64_t)(settings.hold * sampleRate);
+  this->holdLeft = 0;
+  this->bandFloor = 0;
+  this->bandMargin = 0;
+  this->highpass = Biquad();
+  this->lowpass = Biquad();
+
+  size_t periodBytes = (size_t)periodFrames * channels * this->sampleSize;
+
+  this->preRollSlots =
+      settings.enabled && periodFrames > 0
+          ? (unsigned int)std::ceil(settings.preRoll * sampleRate / periodFrames)
+          : 0;
+  this->preRollNext = 0;
+  this->preRollCount = 0;
+  this->openingCount = 0;
+
+  if (!settings.enabled) {
+    this->samples.clear();
+    this->mono.clear();
+    this->preRoll.clear();
+    this->preRollFrames.clear();
+    this->opening.clear();
+    resetStats();
+    return;
+  }
+
+  this->samples.assign((size_t)periodFrames * channels, 0);
+  this->mono.assign(settings.vad ? periodFrames : 0, 0);
+  this->preRoll.assign(periodBytes * this->preRollSlots, 0);
+  this->preRollFrames.assign(this->preRollSlots, 0);
+  this->opening.assign(periodBytes * (this->preRollSlots + 1), 0);
+
+  // Butterworth high and low pass around the speech band, audio EQ cookbook.
+  double q = 0.70710678;
+  double w0 = 2 * Pi * BandLow / sampleRate;
+  double alpha = std::sin(w0) / (2 * q);
+  double a0 = 1 + alpha;
+
+  this->highpass.b0 = (float)((1 + std::cos(w0)) / 2 / a0);
+  this->highpass.b1 = (float)(-(1 + std::cos(w0)) / a0);
+  this->highpass.b2 = this->highpass.b0;
+  this->highpass.a1 = (float)(-2 * std::cos(w0) / a0);
+  this->highpass.a2 = (float)((1 - alpha) / a0);
+
+  w0 = 2 * Pi * std::min(BandHigh, sampleRate * 0.45) / sampleRate;
+  alpha = std::sin(w0) / (2 * q);
+  a0 = 1 + alpha;
+
+  this->lowpass.b0 = (float)((1 - std::cos(w0)) / 2 / a0);
+  this->lowpass.b1 = (float)((1 - std::cos(w0)) / a0);
+  this->lowpass.b2 = this->lowpass.b0;
+  this->lowpass.a1 = (float)(-2 * std::cos(w0) / a0);
+  this->lowpass.a2 = (float)((1 - alpha) / a0);
+
+  resetStats();
+}
+
+bool SilenceGate::enabled() const { return this->settings.enabled; }
+
+bool SilenceGate::isOpen() const { return this->openState; }
+
+uint64_t SilenceGate::opens() const { return this->openCount; }
+
+uint64_t SilenceGate::closes() const { return this->closeCount; }
+
+uint64_t SilenceGate::suppressedPeriods() const { return this->suppressed; }
+
+uint64_t SilenceGate::suppressedFrames() const { return this->suppressedFrameCount; }
+
+uint64_t SilenceGate::deliveredPeriods() const { return this->delivered; }
+
+double SilenceGate::level() const { return this->lastLevel; }
+
+double SilenceGate::noiseFloor() const { return this->lastFloor; }
+
+void SilenceGate::resetStats() {
+  this->openCount = 0;
+  this->closeCount = 0;
+  this->suppressed = 0;
+  this->suppressedFrameCount = 0;
+  this->delivered = 0;
+}
+
+GateDecision SilenceGate::process(const void *input, unsigned int nFrames) {
+  // Periods the buffers weren't sized for are passed through untouched.
+  if (input == nullptr || nFrames > this->periodFrames) {
+    if (this->open) {
+      this->delivered.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return this->open ? GateDecision::Deliver : GateDecision::Suppress;
+  }
+
+  measure(input, nFrames);
+
+  double level = this->lastLevel.load(std::memory_order_relaxed);
+  bool vad = this->settings.vad;
+
+  if (!this->open) {
+    if (level >= this->settings.threshold && (!vad || this->bandMargin >= VadMargin)) {
+      this->open = true;
+      this->openState = true;
+      this->holdLeft = this->holdFrames;
+      this->openCount.fetch_add(1, std::memory_order_relaxed);
+      this->delivered.fetch_add(1, std::memory_order_relaxed);
+      assembleOpening(input, nFrames);
+      return GateDecision::Open;
+    }
+
+    store(input, nFrames);
+    this->suppressed.fetch_add(1, std::memory_order_relaxed);
+    this->suppressedFrameCount.fetch_add(nFrames, std::memory_order_relaxed);
+    return GateDecision::Suppress;
+  }
+
+  if (level >= this->settings.closeThreshold &&
+      (!vad || this->bandMargin >= VadMargin / 2)) {
+    this->holdLeft = this->holdFrames;
+  } else if (this->holdLeft > nFrames) {
+    this->holdLeft -= nFrames;
+  } else {
+    this->open = false;
+    this->openState = false;
+    this->holdLeft = 0;
+    this->closeCount.fetch_add(1, std::memory_order_relaxed);
+    store(input, nFrames);
+    this->suppressed.fetch_add(1, std::memory_order_relaxed);
+    this->suppressedFrameCount.fetch_add(nFrames, std::memory_order_relaxed);
+    return GateDecision::Close;
+  }
+
+  this->delivered.fetch_add(1, std::memory_order_relaxed);
+
+  return GateDecision::Deliver;
+}
+
+void *SilenceGate::openingBuffer() { return this->opening.data(); }
+
+unsigned int SilenceGate::openingFrames() const { return this->openingCount; }
+
+unsigned int SilenceGate::maxOpeningFrames() const {
+  return this->settings.enabled ? (this->preRollSlots + 1) * this->periodFrames : 0;
+}
+
+void SilenceGate::measure(const void *input, unsigned int nFrames) {
+  const SampleKernels &kernels = sampleKernels();
+  size_t count = (size_t)nFrames * this->channels;
+  float *from = this->samples.data();
+
+  samplesToFloat(input, this->format, from, count);
+
+  // The mean power doesn't depend on the layout.
+  this->lastLevel.store(toDecibels(kernels.dotProduct(from, from, count) / count),
+                        std::memory_order_relaxed);
+
+  if (!this->settings.vad) {
+    return;
+  }
+
+  float *mono = this->mono.data();
+  size_t frameStride = this->interleaved ? this->channels : 1;
+  size_t channelStride = this->interleaved ? 1 : nFrames;
+  float scale = 1.0f / this->channels;
+
+  for (unsigned int i = 0; i < nFrames; i++) {
+    float sum = 0;
+
+    for (unsigned int c = 0; c < this->channels; c++) {
+      sum += from[i * frameStride + c * channelStride];
+    }
+
+    mono[i] = this->lowpass.process(this->highpass.process(sum * scale));
+  }
+
+  double band = toDecibels(kernels.dotProduct(mono, mono, nFrames) / nFrames);
+  double floor = this->bandFloor;
+
+  // Falls quickly to quieter periods, creeps up during louder ones.
+  if (band < floor) {
+    floor += (band - floor) * FloorFall;
+  } else {
+    floor = std::min(band, floor + FloorRise * nFrames / this->sampleRate);
+  }
+
+  this->lastFloor.store(floor, std::memory_order_relaxed);
+  this->bandFloor = floor;
+  this->bandMargin = band - floor;
+}
+
+void SilenceGate::store(const void *input, unsigned int nFrames) {
+  if (this->preRollSlots == 0) {
+    return;
+  }
+
+  size_t periodBytes = (size_t)this->periodFrames * this->channels * this->sampleSize;
+
+  memcpy(this->preRoll.data() + this->preRollNext * periodBytes, input,
+         (size_t)nFrames * this->channels * this->sampleSize);
+  this->preRollFrames[this->preRollNext] = nFrames;
+  this->preRollNext = (this->preRollNext + 1) % this->preRollSlots;
+  this->preRollCount = std::min(this->preRollCount + 1, this->preRollSlots);
+}
+
+void SilenceGate::assembleOpening(const void *input, unsigned int nFrames) {
+  size_t frameBytes = this->channels * this->sampleSize;
+  size_t periodBytes = this->periodFrames * frameBytes;
+  unsigned int first =
+      (this->preRollNext + this->preRollSlots - this->preRollCount) %
+      std::max(this->preRollSlots, 1u);
+  unsigned int frames = nFrames;
+
+  for (unsigned int i = 0; i < this->preRollCount; i++) {
+    frames += this->preRollFrames[(first + i) % this->preRollSlots];
+  }
+
+  // Interleaved periods are appended as they are, planar ones channel by channel.
+  unsigned int planes = this->interleaved ? 1 : this->channels;
+  size_t unitBytes = this->interleaved ? frameBytes : this->sampleSize;
+  uint8_t *to = this->opening.data();
+
+  for (unsigned int plane = 0; plane < planes; plane++) {
+    for (unsigned int i = 0; i <= this->preRollCount; i++) {
+      bool current = i == this->preRollCount;
+      unsigned int slot = current ? 0 : (first + i) % this->preRollSlots;
+      unsigned int slotFrames = current ? nFrames : this->preRollFrames[slot];
+      const uint8_t *from = current ? (const uint8_t *)input
+                                    : this->preRoll.data() + slot * periodBytes;
+      size_t byteCount = slotFrames * unitBytes;
+
+      memcpy(to, from + plane * byteCount, byteCount);
+      to += byteCount;
+    }
+  }
+
+  this->openingCount = frames;
+  this->preRollCount = 0;
+}
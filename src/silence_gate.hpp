@@ -0,0 +1,125 @@
+#ifndef __NODE_ADDON_SILENCE_GATE_H__
+#define __NODE_ADDON_SILENCE_GATE_H__
+
+#include <RtAudio.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+struct GateSettings {
+  bool enabled = false;
+  // Levels in dBFS, the mean power of all channels over a period.
+  double threshold = -40;
+  double closeThreshold = -46;
+  // Seconds the gate stays open after the level drops below `closeThreshold`.
+  double hold = 0.5;
+  // Seconds of audio before the gate opened that are delivered with the first period.
+  double preRoll = 0.2;
+  // Also require speech band energy well above the tracked noise floor.
+  bool vad = false;
+};
+
+enum class GateDecision {
+  // Closed, the period isn't delivered.
+  Suppress = 0,
+  // Open, the period is delivered.
+  Deliver = 1,
+  // The gate just opened, `openingBuffer` is delivered instead of the period.
+  Open = 2,
+  // The gate just closed, the period isn't delivered.
+  Close = 3,
+};
+
+// Decides on the realtime thread which input periods are worth waking JS for.
+//
+// The gate opens on a period whose level reaches `threshold` and closes once the level
+// has stayed below `closeThreshold` for `hold` seconds. While closed, periods go into a
+// pre-roll ring, and the period that opens the gate is delivered together with the
+// pre-roll so the onset isn't lost.
+//
+// With `vad` set the gate also tracks the noise floor of the 300-3400 Hz band, and
+// only opens while that band is `VadMargin` dB above it. Steady noise that is loud
+// enough to pass `threshold`, like fans or hum, then keeps the gate closed.
+class SilenceGate {
+public:
+  static constexpr double VadMargin = 9;
+  static constexpr double MinLevel = -120;
+
+  SilenceGate();
+
+  // JS thread, `configure` only while the stream is closed.
+  void configure(const GateSettings &settings, RtAudioFormat format,
+                 unsigned int channels, bool interleaved, unsigned int periodFrames,
+                 unsigned int sampleRate);
+  bool enabled() const;
+  bool isOpen() const;
+  uint64_t opens() const;
+  uint64_t closes() const;
+  uint64_t suppressedPeriods() const;
+  uint64_t suppressedFrames() const;
+  uint64_t deliveredPeriods() const;
+  double level() const;
+  double noiseFloor() const;
+  void resetStats();
+
+  // Realtime thread
+  GateDecision process(const void *input, unsigned int nFrames);
+  // After `Open`, the pre-roll followed by the period that opened the gate. Valid until
+  // the next call to `process`.
+  void *openingBuffer();
+  unsigned int openingFrames() const;
+  unsigned int maxOpeningFrames() const;
+
+private:
+  struct Biquad {
+    float b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    float z1 = 0, z2 = 0;
+
+    float process(float x);
+  };
+
+  void measure(const void *input, unsigned int nFrames);
+  void store(const void *input, unsigned int nFrames);
+  void assembleOpening(const void *input, unsigned int nFrames);
+
+  GateSettings settings;
+  RtAudioFormat format;
+  unsigned int channels;
+  bool interleaved;
+  unsigned int periodFrames;
+  unsigned int sampleRate;
+  size_t sampleSize;
+
+  // Realtime thread state.
+  bool open;
+  uint64_t holdFrames;
+  uint64_t holdLeft;
+  std::vector<float> samples;
+  std::vector<float> mono;
+  Biquad highpass;
+  Biquad lowpass;
+  // Speech band noise floor in dB, and how far the last period was above it.
+  double bandFloor;
+  double bandMargin;
+
+  // Pre-roll ring of whole periods in the device format.
+  std::vector<uint8_t> preRoll;
+  std::vector<unsigned int> preRollFrames;
+  unsigned int preRollSlots;
+  unsigned int preRollNext;
+  unsigned int preRollCount;
+  std::vector<uint8_t> opening;
+  unsigned int openingCount;
+
+  // Read by JS.
+  std::atomic<bool> openState;
+  std::atomic<uint64_t> openCount;
+  std::atomic<uint64_t> closeCount;
+  std::atomic<uint64_t> suppressed;
+  std::atomic<uint64_t> suppressedFrameCount;
+  std::atomic<uint64_t> delivered;
+  std::atomic<double> lastLevel;
+  std::atomic<double> lastFloor;
+};
+
+#endif
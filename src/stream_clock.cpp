@@ -0,0 +1,79 @@
+#include "stream_clock.hpp"
+#include <cmath>
+
+namespace {
+
+const double TwoPi = 6.283185307179586;
+
+// Periods the loop may be off by before it starts over.
+const double MaxError = 4;
+
+} // namespace
+
+StreamClock::StreamClock()
+    : nominalNanosecondsPerFrame{0}, locked{false}, nextFrame{0}, time0{0}, time1{0},
+      period{0}, sequence{0}, anchorFrame{0}, anchorTime{0},
+      anchorNanosecondsPerFrame{0} {}
+
+void StreamClock::reset(unsigned int sampleRate) {
+  this->nominalNanosecondsPerFrame = sampleRate == 0 ? 0 : 1e9 / sampleRate;
+  this->locked = false;
+  this->nextFrame = 0;
+  publish(0, 0, 0);
+}
+
+bool StreamClock::read(Anchor *anchor) const {
+  uint32_t before, after;
+
+  do {
+    before = this->sequence.load(std::memory_order_acquire);
+    anchor->frame = this->anchorFrame.load(std::memory_order_relaxed);
+    anchor->time = this->anchorTime.load(std::memory_order_relaxed);
+    anchor->nanosecondsPerFrame =
+        this->anchorNanosecondsPerFrame.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = this->sequence.load(std::memory_order_relaxed);
+  } while (before != after || (before & 1) != 0);
+
+  return anchor->nanosecondsPerFrame > 0;
+}
+
+void StreamClock::update(uint64_t frame, int64_t now, unsigned int nFrames) {
+  double nominal = nFrames * this->nominalNanosecondsPerFrame;
+
+  if (nFrames == 0 || nominal == 0) {
+    return;
+  }
+
+  // A second order loop as in Fons Adriaensen's "Using a DLL to filter time", with its
+  // coefficients recomputed for the current period length.
+  double error = now - this->time1;
+  bool skipped = frame != this->nextFrame;
+
+  if (!this->locked || skipped || std::fabs(error) > MaxError * nominal) {
+    this->locked = true;
+    this->time0 = (double)now;
+    this->time1 = now + nominal;
+    this->period = nominal;
+  } else {
+    double omega = TwoPi * Bandwidth * nominal * 1e-9;
+
+    this->time0 = this->time1;
+    this->time1 += std::sqrt(2.0) * omega * error + this->period;
+    this->period += omega * omega * error;
+  }
+
+  this->nextFrame = frame + nFrames;
+  publish(frame, (int64_t)std::llround(this->time0), this->period / nFrames);
+}
+
+void StreamClock::publish(uint64_t frame, int64_t time, double nanosecondsPerFrame) {
+  uint32_t sequence = this->sequence.load(std::memory_order_relaxed);
+
+  this->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  this->anchorFrame.store(frame, std::memory_order_relaxed);
+  this->anchorTime.store(time, std::memory_order_relaxed);
+  this->anchorNanosecondsPerFrame.store(nanosecondsPerFrame, std::memory_order_relaxed);
+  this->sequence.store(sequence + 2, std::memory_order_release);
+}
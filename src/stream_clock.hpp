@@ -0,0 +1,58 @@
+#ifndef __NODE_ADDON_STREAM_CLOCK_H__
+#define __NODE_ADDON_STREAM_CLOCK_H__
+
+#include <atomic>
+#include <cstdint>
+
+// Maps stream frames to `StreamStats::now()` time, the clock of `process.hrtime`.
+//
+// The realtime thread reports the stream frame and the time at the start of every
+// period. Callback times jitter with scheduling, so they go through a delay-locked loop
+// that follows the device clock, both its offset and its actual rate, and smooths the
+// jitter out. A gap of more than a few periods, e.g. after the stream was stopped, starts
+// the loop over.
+//
+// Readers on other threads get a consistent anchor through a sequence lock.
+class StreamClock {
+public:
+  // Loop bandwidth in Hz.
+  static constexpr double Bandwidth = 0.1;
+
+  struct Anchor {
+    // Stream frame of the last period and the smoothed time it started at.
+    uint64_t frame;
+    int64_t time;
+    // Measured period of a frame, the inverse of the actual sample rate.
+    double nanosecondsPerFrame;
+  };
+
+  StreamClock();
+
+  // JS thread, while the stream is closed.
+  void reset(unsigned int sampleRate);
+  // False until the first period.
+  bool read(Anchor *anchor) const;
+
+  // Realtime thread, at the start of every period.
+  void update(uint64_t frame, int64_t now, unsigned int nFrames);
+
+private:
+  void publish(uint64_t frame, int64_t time, double nanosecondsPerFrame);
+
+  double nominalNanosecondsPerFrame;
+
+  // Realtime thread loop state: the filtered start times of this and the next period,
+  // and the filtered period length.
+  bool locked;
+  uint64_t nextFrame;
+  double time0;
+  double time1;
+  double period;
+
+  std::atomic<uint32_t> sequence;
+  std::atomic<uint64_t> anchorFrame;
+  std::atomic<int64_t> anchorTime;
+  std::atomic<double> anchorNanosecondsPerFrame;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "stream_stats.hpp"
+#include <bit>
+#include <chrono>
+
+LatencyHistogram::LatencyHistogram() { reset(); }
+
+void LatencyHistogram::record(int64_t nanoseconds) {
+  uint64_t ns = nanoseconds < 0 ? 0 : static_cast<uint64_t>(nanoseconds);
+  unsigned int i = std::bit_width(ns / 1000);
+
+  buckets[i < BucketCount ? i : BucketCount - 1].fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(1, std::memory_order_relaxed);
+  sumNanoseconds.fetch_add(ns, std::memory_order_relaxed);
+
+  uint64_t max = maxNanoseconds.load(std::memory_order_relaxed);
+  while (ns > max &&
+         !maxNanoseconds.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::reset() {
+  for (auto &bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+
+  total.store(0, std::memory_order_relaxed);
+  sumNanoseconds.store(0, std::memory_order_relaxed);
+  maxNanoseconds.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const { return total.load(std::memory_order_relaxed); }
+
+double LatencyHistogram::meanMicroseconds() const {
+  uint64_t n = count();
+  return n == 0 ? 0 : sumNanoseconds.load(std::memory_order_relaxed) / 1000.0 / n;
+}
+
+double LatencyHistogram::maxMicroseconds() const {
+  return maxNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double LatencyHistogram::percentileMicroseconds(double p) const {
+  uint64_t n = count();
+  uint64_t seen = 0;
+
+  if (n == 0)
+    return 0;
+
+  // Report the upper bound of the bucket the percentile falls into, capped by the max.
+  for (unsigned int i = 0; i < BucketCount; i++) {
+    seen += bucket(i);
+
+    if (seen >= p * n) {
+      double upperBound = static_cast<double>(uint64_t{1} << i);
+      return i + 1 < BucketCount && upperBound < maxMicroseconds() ? upperBound
+                                                                   : maxMicroseconds();
+    }
+  }
+
+  return maxMicroseconds();
+}
+
+uint64_t LatencyHistogram::bucket(unsigned int i) const {
+  return buckets[i].load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(double *out) const {
+  out[0] = static_cast<double>(count());
+  out[1] = sumNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+  out[2] = maxMicroseconds();
+
+  for (unsigned int i = 0; i < BucketCount; i++) {
+    out[3 + i] = static_cast<double>(bucket(i));
+  }
+}
+
+StreamStats::StreamStats() { reset(); }
+
+int64_t StreamStats::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void StreamStats::countCallback(RtAudioStreamStatus status) {
+  callbacks.fetch_add(1, std::memory_order_relaxed);
+
+  if (status & RTAUDIO_INPUT_OVERFLOW) {
+    inputOverflows.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (status & RTAUDIO_OUTPUT_UNDERFLOW) {
+    outputUnderflows.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void StreamStats::reset() {
+  callbacks.store(0, std::memory_order_relaxed);
+  inputOverflows.store(0, std::memory_order_relaxed);
+  outputUnderflows.store(0, std::memory_order_relaxed);
+  deadlineMisses.store(0, std::memory_order_relaxed);
+  ringUnderruns.store(0, std::memory_order_relaxed);
+  ringOverruns.store(0, std::memory_order_relaxed);
+  dispatchLatency.reset();
+  jsExecution.reset();
+  turnaround.reset();
+}
+
+void StreamStats::snapshot(double *out) const {
+  out[0] = static_cast<double>(callbacks.load(std::memory_order_relaxed));
+  out[1] = static_cast<double>(inputOverflows.load(std::memory_order_relaxed));
+  out[2] = static_cast<double>(outputUnderflows.load(std::memory_order_relaxed));
+  out[3] = static_cast<double>(deadlineMisses.load(std::memory_order_relaxed));
+  out[4] = static_cast<double>(ringUnderruns.load(std::memory_order_relaxed));
+  out[5] = static_cast<double>(ringOverruns.load(std::memory_order_relaxed));
+
+  dispatchLatency.snapshot(out + CounterCount);
+  jsExecution.snapshot(out + CounterCount + LatencyHistogram::SnapshotLength);
+  turnaround.snapshot(out + CounterCount + 2 * LatencyHistogram::SnapshotLength);
+}
@@ -0,0 +1,76 @@
+#ifndef __NODE_ADDON_STREAM_STATS_H__
+#define __NODE_ADDON_STREAM_STATS_H__
+
+#include <RtAudio.h>
+#include <atomic>
+#include <cstdint>
+
+// A lock-free histogram of durations with power-of-two microsecond buckets: bucket 0
+// counts durations below 1us, bucket i (i > 0) those in [2^(i-1), 2^i) us and the last
+// bucket everything above.
+//
+// `record` is called on the realtime thread and only does relaxed atomic increments.
+// Readers on other threads may see a histogram that is mid-update, which is fine for
+// monitoring.
+class LatencyHistogram {
+public:
+  static const unsigned int BucketCount = 24;
+
+  // count, sum (us), max (us), then the buckets
+  static const unsigned int SnapshotLength = 3 + BucketCount;
+
+  LatencyHistogram();
+
+  void record(int64_t nanoseconds);
+  void reset();
+
+  uint64_t count() const;
+  double meanMicroseconds() const;
+  double maxMicroseconds() const;
+  double percentileMicroseconds(double p) const;
+  uint64_t bucket(unsigned int i) const;
+
+  void snapshot(double *out) const;
+
+private:
+  std::atomic<uint64_t> buckets[BucketCount];
+  std::atomic<uint64_t> total;
+  std::atomic<uint64_t> sumNanoseconds;
+  std::atomic<uint64_t> maxNanoseconds;
+};
+
+// Counters and timings of a stream, collected on the realtime thread.
+class StreamStats {
+public:
+  // The counters in snapshot order, followed by the histograms in declaration order.
+  static const unsigned int CounterCount = 6;
+  static const unsigned int SnapshotLength =
+      CounterCount + 3 * LatencyHistogram::SnapshotLength;
+
+  StreamStats();
+
+  static int64_t now();
+
+  void countCallback(RtAudioStreamStatus status);
+  void reset();
+  void snapshot(double *out) const;
+
+  std::atomic<uint64_t> callbacks;
+  std::atomic<uint64_t> inputOverflows;
+  std::atomic<uint64_t> outputUnderflows;
+  std::atomic<uint64_t> deadlineMisses;
+  // Buffered mode: periods the output ring couldn't fill, and periods whose input
+  // didn't fit into the input ring.
+  std::atomic<uint64_t> ringUnderruns;
+  std::atomic<uint64_t> ringOverruns;
+
+  // From the realtime thread handing a period to JS until the callback starts running.
+  LatencyHistogram dispatchLatency;
+  // Time spent in the JS callback itself.
+  LatencyHistogram jsExecution;
+  // The whole realtime callback, from the driver handing over a period until it's
+  // handed back.
+  LatencyHistogram turnaround;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef __NODE_ADDON_TYPED_ARRAY_H__
+#define __NODE_ADDON_TYPED_ARRAY_H__
+
+#include <napi.h>
+
+// Returns the data pointer and byte length of a typed array. Unlike
+// `TypedArray::ArrayBuffer().Data()` this also works for views over a
+// SharedArrayBuffer, which napi_get_arraybuffer_info rejects.
+inline uint8_t *getTypedArrayData(Napi::Env env, const Napi::Value &value,
+                                  size_t *byteLength) {
+  napi_typedarray_type type;
+  size_t length;
+  void *data;
+  napi_value arrayBuffer;
+  size_t byteOffset;
+
+  napi_status status = napi_get_typedarray_info(env, value, &type, &length, &data,
+                                                &arrayBuffer, &byteOffset);
+
+  if (status != napi_ok)
+    throw Napi::Error::New(env);
+
+  *byteLength = value.As<Napi::TypedArray>().ByteLength();
+
+  return static_cast<uint8_t *>(data);
+}
+
+#endif
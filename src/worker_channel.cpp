@@ -0,0 +1,79 @@
+#include "worker_channel.hpp"
+#include <chrono>
+
+std::mutex WorkerChannel::registryMutex;
+std::map<const void *, std::shared_ptr<WorkerChannel>> WorkerChannel::registry;
+
+WorkerChannel::WorkerChannel(double *control, uint8_t *output, size_t outputSize,
+                             uint8_t *input, size_t inputSize)
+    : control{control}, output{output}, outputSize{outputSize}, input{input},
+      inputSize{inputSize}, returnValue{0}, ready{0}, done{0}, period{0},
+      completedPeriod{0}, workerPeriod{0}, cancelled{false}, closed{false} {}
+
+void WorkerChannel::add(const std::shared_ptr<WorkerChannel> &channel) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry[channel->control] = channel;
+}
+
+void WorkerChannel::remove(const WorkerChannel *channel) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry.erase(channel->control);
+}
+
+std::shared_ptr<WorkerChannel> WorkerChannel::find(const void *control) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto it = registry.find(control);
+  return it == registry.end() ? nullptr : it->second;
+}
+
+bool WorkerChannel::runPeriod() {
+  const uint64_t current = period.fetch_add(1) + 1;
+
+  ready.release();
+
+  // Wait in slices so that stopping or closing the stream never hangs on a worker that
+  // died or got stuck. Completions of periods that were given up on are skipped.
+  while (true) {
+    if (done.try_acquire_for(std::chrono::milliseconds(10))) {
+      if (completedPeriod.load() == current)
+        return true;
+    } else if (cancelled.load()) {
+      return false;
+    }
+  }
+}
+
+int WorkerChannel::wait(unsigned int timeoutMs) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  while (!closed.load()) {
+    if (!ready.try_acquire_until(deadline))
+      return closed.load() ? 0 : -1;
+
+    // Stale wake-ups of periods the realtime thread has already given up on are skipped.
+    uint64_t current = period.load();
+
+    if (current != workerPeriod && !cancelled.load()) {
+      workerPeriod = current;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+void WorkerChannel::complete(int value) {
+  returnValue = value;
+  completedPeriod.store(workerPeriod);
+  done.release();
+}
+
+void WorkerChannel::resume() { cancelled.store(false); }
+
+void WorkerChannel::cancel() { cancelled.store(true); }
+
+void WorkerChannel::close() {
+  closed.store(true);
+  cancelled.store(true);
+  ready.release();
+}
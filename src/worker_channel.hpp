@@ -0,0 +1,66 @@
+#ifndef __NODE_ADDON_WORKER_CHANNEL_H__
+#define __NODE_ADDON_WORKER_CHANNEL_H__
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+
+// The hand-off between the realtime thread and a worker_threads Worker that runs the
+// stream callback.
+//
+// Audio and period info are exchanged through SharedArrayBuffer blocks owned by JS,
+// the channel only holds their addresses and does the signalling. V8 implements
+// `Atomics.wait` with its own wait lists, so a native write to shared memory can't wake
+// a waiting worker; the worker blocks in `wait` on a native semaphore instead.
+//
+// Channels are registered under the address of their control block, which is the same
+// in the main thread and in the worker, so the worker can find the channel of the
+// stream it was spawned for.
+class WorkerChannel {
+public:
+  // Layout of the Float64Array control block.
+  enum ControlSlot { NFrames = 0, StreamTime = 1, Status = 2, ControlSlotCount = 3 };
+
+  WorkerChannel(double *control, uint8_t *output, size_t outputSize, uint8_t *input,
+                size_t inputSize);
+
+  static void add(const std::shared_ptr<WorkerChannel> &channel);
+  static void remove(const WorkerChannel *channel);
+  static std::shared_ptr<WorkerChannel> find(const void *control);
+
+  // Realtime thread
+  bool runPeriod();
+
+  // Worker thread
+  int wait(unsigned int timeoutMs);
+  void complete(int returnValue);
+
+  // JS thread
+  void resume();
+  void cancel();
+  void close();
+
+  double *const control;
+  uint8_t *const output;
+  const size_t outputSize;
+  uint8_t *const input;
+  const size_t inputSize;
+  int returnValue;
+
+private:
+  std::counting_semaphore<> ready;
+  std::counting_semaphore<> done;
+  std::atomic<uint64_t> period;
+  std::atomic<uint64_t> completedPeriod;
+  uint64_t workerPeriod;
+  std::atomic<bool> cancelled;
+  std::atomic<bool> closed;
+
+  static std::mutex registryMutex;
+  static std::map<const void *, std::shared_ptr<WorkerChannel>> registry;
+};
+
+#endif
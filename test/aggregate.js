@@ -0,0 +1,62 @@
+'use strict'
+
+// Aggregate capture example. It opens one aggregate stream over several input devices
+// and prints the level of every device's channels together with the clock drift the
+// stream is correcting for.
+
+// Usage: node test/aggregate.js [deviceId...]
+// Without ids, every device with input channels is used.
+
+// Note: every device has to support float32 48000 Hz capture.
+
+const { RtAudio, RtAudioAggregate } = require('..')
+
+const sampleRate = 48000
+const bufferFrames = 480
+
+const rtAudio = new RtAudio()
+const ids = process.argv.slice(2).map(Number)
+const devices = rtAudio.getDevices()
+  .filter((device) => device.inputChannels > 0 && (ids.length === 0 || ids.includes(device.id)))
+  .map((device) => ({ deviceId: device.id, nChannels: Math.min(device.inputChannels, 2), name: device.name }))
+
+if (devices.length === 0) {
+  console.error('No input devices found.')
+  process.exit(1)
+}
+
+const channels = devices.reduce((sum, device) => sum + device.nChannels, 0)
+const peaks = new Float32Array(channels)
+
+const aggregate = new RtAudioAggregate()
+
+aggregate.openStream(devices, sampleRate, bufferFrames, null, (input, nFrames) => {
+  for (let i = 0; i < nFrames * channels; i++) {
+    const channel = i % channels
+    peaks[channel] = Math.max(peaks[channel], Math.abs(input[i]))
+  }
+})
+
+aggregate.startStream()
+
+console.log(`Capturing ${channels} channels from ${devices.length} devices, latency ${aggregate.getStreamLatency()} frames\n`)
+
+setInterval(() => {
+  const drift = aggregate.getDriftStats()
+  let channel = 0
+
+  console.table(devices.map((device, i) => {
+    const levels = Array.from(peaks.subarray(channel, channel + device.nChannels))
+    channel += device.nChannels
+
+    return {
+      device: device.name,
+      'peak dBFS': levels.map((peak) => (20 * Math.log10(peak || 1e-10)).toFixed(1)).join(' '),
+      'drift ppm': i === 0 ? 'master' : drift[i - 1].driftPpm.toFixed(1),
+      'buffered': i === 0 ? '' : `${drift[i - 1].bufferedFrames.toFixed(0)}/${drift[i - 1].targetFrames}`,
+      'xruns': i === 0 ? '' : drift[i - 1].underruns + drift[i - 1].overruns,
+    }
+  }))
+
+  peaks.fill(0)
+}, 1000)
@@ -0,0 +1,214 @@
+'use strict'
+
+// Benchmark suite. It sweeps audio APIs, buffer sizes, channel counts, sample formats and
+// callback delivery modes, runs a duplex stream for each combination and reports
+// sustained callbacks/s, period jitter, stream latency, GC activity and the binding's own
+// timing stats.
+
+// Usage: node test/bench-suite.js [--seconds=1] [--frames=64,256,1024] [--channels=2,8]
+//          [--formats=sint16,float32] [--modes=callback,pooled,batched,buffered,worker]
+//          [--sample-rate=48000] [--apis=dummy,default,pulse,alsa,jack] [--json]
+
+// Note: by default it runs on the headless loopback device, so the binding has to be
+// built with `npm run build:loopback`. Pass --apis=default to use the default devices
+// instead, or e.g. --apis=pulse,alsa,jack to compare the Linux APIs on their default
+// devices at the same buffer sizes. APIs the binding wasn't built with are skipped.
+
+const path = require('path')
+const { PerformanceObserver } = require('perf_hooks')
+const v8 = require('v8')
+const { RtAudio, RtAudioApi, RtAudioFormat, RtAudioStreamMode } = require('..')
+
+const args = Object.fromEntries(process.argv.slice(2).map((arg) => {
+  const [key, value] = arg.replace(/^--/, '').split('=')
+  return [key, value === undefined ? true : value]
+}))
+
+if (args.help) {
+  console.log(require('fs').readFileSync(__filename, 'utf8').split('\n').slice(7, 10).join('\n'))
+  process.exit(0)
+}
+
+const list = (value, fallback) => String(value || fallback).split(',')
+
+const formats = {
+  sint16: RtAudioFormat.RTAUDIO_SINT16,
+  sint32: RtAudioFormat.RTAUDIO_SINT32,
+  float32: RtAudioFormat.RTAUDIO_FLOAT32,
+  float64: RtAudioFormat.RTAUDIO_FLOAT64,
+}
+
+const sampleBytes = { sint16: 2, sint32: 4, float32: 4, float64: 8 }
+
+const apis = {
+  default: RtAudioApi.UNSPECIFIED,
+  dummy: RtAudioApi.RTAUDIO_DUMMY,
+  pulse: RtAudioApi.LINUX_PULSE,
+  alsa: RtAudioApi.LINUX_ALSA,
+  jack: RtAudioApi.UNIX_JACK,
+  wasapi: RtAudioApi.WINDOWS_WASAPI,
+  ds: RtAudioApi.WINDOWS_DS,
+}
+
+// Stream options of each callback delivery mode.
+const modes = {
+  callback: () => ({}),
+  pooled: () => ({ bufferPoolSize: 4, typedBuffers: true }),
+  batched: () => ({ bufferPoolSize: 4, typedBuffers: true, periodsPerCallback: 4 }),
+  buffered: (frames) => ({ mode: RtAudioStreamMode.BUFFERED, ringBufferFrames: frames * 8, watermarkFrames: frames * 2 }),
+  worker: () => ({ worker: path.join(__dirname, 'bench-worker.js') }),
+}
+
+const seconds = Number(args.seconds || 1)
+const sampleRate = Number(args['sample-rate'] || 48000)
+const apiNames = list(args.apis || args.api, 'dummy')
+const frameSizes = list(args.frames, '64,256,1024').map(Number)
+const channelCounts = list(args.channels, '2,8').map(Number)
+const formatNames = list(args.formats, 'sint16,float32')
+const modeNames = list(args.modes, 'callback,pooled,batched,buffered,worker')
+
+const percentile = (values, p) => {
+  if (values.length === 0) return 0
+  const sorted = Float64Array.from(values).sort()
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))]
+}
+
+const run = ({ apiName, frames, channels, formatName, modeName }) => new Promise((resolve, reject) => {
+  const rtAudio = new RtAudio(apis[apiName])
+  const outputDevice = rtAudio.getDefaultOutputDevice()
+  const inputDevice = rtAudio.getDefaultInputDevice()
+
+  if (!outputDevice || !inputDevice) {
+    reject(new Error(`No default ${!outputDevice ? 'output' : 'input'} device found.`))
+    return
+  }
+
+  const options = modes[modeName](frames)
+  const period = frames * (options.periodsPerCallback || 1) / sampleRate * 1e6
+  const jitter = []
+  let lastCall = 0n
+  let gcCount = 0
+  let gcTime = 0
+  let heapAllocated = 0
+  let lastHeapUsed = v8.getHeapStatistics().used_heap_size
+
+  const gcObserver = new PerformanceObserver((list) => {
+    for (const entry of list.getEntries()) {
+      gcCount++
+      gcTime += entry.duration
+    }
+  })
+  gcObserver.observe({ entryTypes: ['gc'] })
+
+  const heapSampler = setInterval(() => {
+    const used = v8.getHeapStatistics().used_heap_size
+    if (used > lastHeapUsed) heapAllocated += used - lastHeapUsed
+    lastHeapUsed = used
+  }, 5)
+
+  // Callback, pooled and batched modes get one call per period (or block), so they also
+  // measure how far the calls drift from the nominal interval.
+  const onPeriod = (output, input) => {
+    const now = process.hrtime.bigint()
+
+    if (lastCall !== 0n) jitter.push(Math.abs(Number(now - lastCall) / 1e3 - period))
+    lastCall = now
+
+    output.set(input, 0)
+  }
+
+  // Buffered mode moves the captured input back to the output ring on every watermark.
+  const frameBytes = channels * sampleBytes[formatName]
+  const transfer = new Uint8Array(frames * 8 * frameBytes)
+  const onWatermark = () => {
+    const read = rtAudio.read(transfer)
+    if (read > 0) rtAudio.write(transfer.subarray(0, read * frameBytes))
+  }
+
+  const callback = modeName === 'buffered' ? onWatermark : modeName === 'worker' ? null : onPeriod
+
+  const actualFrames = rtAudio.openStream(
+    { deviceId: outputDevice, nChannels: channels },
+    { deviceId: inputDevice, nChannels: channels },
+    formats[formatName],
+    sampleRate,
+    frames,
+    options,
+    callback
+  )
+
+  if (modeName === 'buffered') {
+    rtAudio.write(new Uint8Array(frames * 2 * frameBytes))
+  }
+
+  rtAudio.startStream()
+
+  setTimeout(() => {
+    const stats = rtAudio.getStreamStats()
+    const latency = rtAudio.getStreamLatency()
+
+    rtAudio.stopStream()
+    clearInterval(heapSampler)
+    gcObserver.disconnect()
+
+    // Let a period that is still queued for JS finish before closing.
+    setImmediate(() => {
+      rtAudio.closeStream()
+
+      resolve({
+        api: apiName,
+        frames,
+        'actual frames': actualFrames,
+        channels,
+        format: formatName,
+        mode: modeName,
+        'callbacks/s': Math.round(stats.callbacks / seconds),
+        'expected/s': Math.round(sampleRate / frames),
+        'jitter p50 us': jitter.length ? percentile(jitter, 0.5).toFixed(0) : '-',
+        'jitter p99 us': jitter.length ? percentile(jitter, 0.99).toFixed(0) : '-',
+        'jitter p99.9 us': jitter.length ? percentile(jitter, 0.999).toFixed(0) : '-',
+        'dispatch p99 us': stats.dispatchLatency.count ? stats.dispatchLatency.p99 : '-',
+        'turnaround p99 us': stats.turnaround.p99,
+        'latency ms': Number((latency / sampleRate * 1000).toFixed(2)),
+        'xruns': stats.inputOverflows + stats.outputUnderflows + stats.ringUnderruns,
+        'heap kB/s': Number((heapAllocated / 1024 / seconds).toFixed(1)),
+        'gc/s': Number((gcCount / seconds).toFixed(2)),
+        'gc ms/s': Number((gcTime / seconds).toFixed(2)),
+      })
+    })
+  }, seconds * 1000)
+})
+
+const main = async () => {
+  const results = []
+  const compiled = RtAudio.getCompiledApi()
+
+  for (const apiName of apiNames) {
+    if (apis[apiName] === undefined) {
+      throw new Error(`Unknown API ${apiName}, use one of ${Object.keys(apis).join(', ')}.`)
+    }
+
+    if (apis[apiName] !== RtAudioApi.UNSPECIFIED && !compiled.includes(apis[apiName])) {
+      console.error(`Skipping ${apiName}, the binding was built without it.`)
+      continue
+    }
+
+    for (const modeName of modeNames)
+      for (const formatName of formatNames)
+        for (const channels of channelCounts)
+          for (const frames of frameSizes)
+            results.push(await run({ apiName, frames, channels, formatName, modeName }))
+  }
+
+  if (args.json) {
+    console.log(JSON.stringify(results, null, 2))
+  } else {
+    console.log(`Benchmark suite, ${seconds} s per run @ ${sampleRate} Hz\n`)
+    console.table(results)
+  }
+}
+
+main().catch((err) => {
+  console.error(err.message)
+  process.exit(1)
+})
@@ -0,0 +1,6 @@
+'use strict'
+
+// Stream callback used by bench-suite.js for the worker mode runs.
+module.exports = (output, input) => {
+  if (output && input) output.set(input.subarray(0, output.length))
+}
@@ -0,0 +1,127 @@
+'use strict'
+
+// Callback benchmark. It runs a duplex stream on the default devices twice, once
+// allocating fresh callback buffers every period and once with `bufferPoolSize`,
+// and prints buffer allocations, GC activity and callback timings for both runs.
+
+// Usage: node test/callback-bench.js [seconds per run] [bufferFrames]
+
+// Note: like echo.js, this script expects default output and input devices that
+// support 32-bit 48000 Hz streams.
+
+const { PerformanceObserver } = require('perf_hooks')
+const v8 = require('v8')
+const { RtAudio, RtAudioFormat } = require('..')
+
+const seconds = Number(process.argv[2] || 5)
+const bufferFrames = Number(process.argv[3] || 64)
+const sampleRate = 48000
+const channels = 2
+
+const percentile = (values, p) => {
+  if (values.length === 0) return 0
+  const sorted = Float64Array.from(values).sort()
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))]
+}
+
+const run = (label, bufferPoolSize) => new Promise((resolve) => {
+  const rtAudio = new RtAudio()
+  const outputDevice = rtAudio.getDefaultOutputDevice()
+  const inputDevice = rtAudio.getDefaultInputDevice()
+
+  if (!outputDevice || !inputDevice) {
+    console.error(`No default ${!outputDevice ? 'output' : 'input'} device found.`)
+    process.exit(1)
+  }
+
+  const seenBuffers = new WeakSet()
+  const intervals = []
+  const durations = []
+  let allocatedBuffers = 0
+  let callbacks = 0
+  let lastCall = 0n
+  let gcCount = 0
+  let gcTime = 0
+  let heapAllocated = 0
+  let lastHeapUsed = v8.getHeapStatistics().used_heap_size
+
+  const gcObserver = new PerformanceObserver((list) => {
+    for (const entry of list.getEntries()) {
+      gcCount++
+      gcTime += entry.duration
+    }
+  })
+  gcObserver.observe({ entryTypes: ['gc'] })
+
+  // Estimate the allocation rate by summing up heap growth between samples.
+  const heapSampler = setInterval(() => {
+    const used = v8.getHeapStatistics().used_heap_size
+    if (used > lastHeapUsed) heapAllocated += used - lastHeapUsed
+    lastHeapUsed = used
+  }, 5)
+
+  rtAudio.openStream(
+    { deviceId: outputDevice, nChannels: channels },
+    { deviceId: inputDevice, nChannels: channels },
+    RtAudioFormat.RTAUDIO_SINT32,
+    sampleRate,
+    bufferFrames,
+    { bufferPoolSize },
+    (output, input) => {
+      const start = process.hrtime.bigint()
+
+      if (lastCall !== 0n) intervals.push(Number(start - lastCall) / 1e3)
+      lastCall = start
+
+      for (const buffer of [output.buffer, input.buffer]) {
+        if (!seenBuffers.has(buffer)) {
+          seenBuffers.add(buffer)
+          allocatedBuffers++
+        }
+      }
+
+      output.set(input, 0)
+      callbacks++
+
+      durations.push(Number(process.hrtime.bigint() - start) / 1e3)
+    }
+  )
+
+  rtAudio.startStream()
+
+  setTimeout(() => {
+    const stats = rtAudio.getStreamStats()
+    rtAudio.stopStream()
+    rtAudio.closeStream()
+    clearInterval(heapSampler)
+    gcObserver.disconnect()
+
+    resolve({
+      label,
+      'callbacks/s': (callbacks / seconds).toFixed(0),
+      'buffers allocated/s': (allocatedBuffers / seconds).toFixed(0),
+      'heap allocated kB/s': (heapAllocated / 1024 / seconds).toFixed(1),
+      'gc/s': (gcCount / seconds).toFixed(2),
+      'gc ms/s': (gcTime / seconds).toFixed(2),
+      'callback p50 us': percentile(durations, 0.5).toFixed(1),
+      'callback p99 us': percentile(durations, 0.99).toFixed(1),
+      'interval p50 us': percentile(intervals, 0.5).toFixed(0),
+      'interval p99 us': percentile(intervals, 0.99).toFixed(0),
+      'dispatch p99 us': stats.dispatchLatency.p99.toFixed(0),
+      'turnaround p99 us': stats.turnaround.p99.toFixed(0),
+      'xruns': stats.inputOverflows + stats.outputUnderflows,
+    })
+  }, seconds * 1000)
+})
+
+const main = async () => {
+  console.log(`Callback benchmark, ${bufferFrames} frames @ ${sampleRate} Hz, ${channels} channels\n`)
+
+  const results = []
+  results.push(await run('allocate per period', 0))
+  results.push(await run('bufferPoolSize = 4', 4))
+
+  console.table(results)
+}
+
+main()
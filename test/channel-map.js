@@ -0,0 +1,55 @@
+'use strict'
+
+// Channel map example. It opens a duplex stream on the default devices with every
+// channel they have, but hands JS only the first input channel and plays it back on
+// the first two output channels. Each callback only copies one channel in and out.
+
+// Usage: node test/channel-map.js [seconds]
+
+// Note: the default devices have to support float32 48000 Hz streams.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const seconds = Number(process.argv[2] || 10)
+
+const rtAudio = new RtAudio()
+const devices = rtAudio.getDevices()
+const input = devices.find((device) => device.id === rtAudio.getDefaultInputDevice())
+const output = devices.find((device) => device.id === rtAudio.getDefaultOutputDevice())
+
+if (!input || !output || output.outputChannels < 2) {
+  console.error('No default input and stereo output device found.')
+  process.exit(1)
+}
+
+let callbacks = 0
+
+rtAudio.openStream(
+  { deviceId: output.id, nChannels: output.outputChannels },
+  { deviceId: input.id, nChannels: input.inputChannels },
+  RtAudioFormat.RTAUDIO_FLOAT32,
+  48000,
+  256,
+  {
+    typedBuffers: true,
+    bufferPoolSize: 2,
+    inputChannelMap: [0],
+    outputChannelMap: [[0, 1]],
+  },
+  (outputBuffer, inputBuffer) => {
+    callbacks++
+    outputBuffer.set(inputBuffer)
+  }
+)
+
+rtAudio.startStream()
+
+console.log(
+  `Device channels ${input.inputChannels} in, ${output.outputChannels} out, JS sees 1 in, 1 out.`
+)
+
+setTimeout(() => {
+  rtAudio.stopStream()
+  rtAudio.closeStream()
+  console.log(`${callbacks} callbacks`)
+}, seconds * 1000)
@@ -0,0 +1,74 @@
+'use strict'
+
+// Sample conversion benchmark. It converts a block of random float32 samples to every
+// RtAudioFormat and back, once with the SIMD kernels the CPU supports and once with the
+// scalar reference kernels, and prints throughput and the largest difference between
+// the two. No audio device is needed.
+
+// Usage: node test/convert-bench.js [samples] [iterations]
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const samples = Number(process.argv[2] || 1 << 16)
+const iterations = Number(process.argv[3] || 200)
+
+const formats = {
+  RTAUDIO_SINT8: Int8Array,
+  RTAUDIO_SINT16: Int16Array,
+  RTAUDIO_SINT24: null,
+  RTAUDIO_SINT32: Int32Array,
+  RTAUDIO_FLOAT64: Float64Array,
+}
+
+const bytesPerSample = { RTAUDIO_SINT24: 3 }
+
+const time = (fn) => {
+  fn()
+  const start = process.hrtime.bigint()
+  for (let i = 0; i < iterations; i++) fn()
+  return Number(process.hrtime.bigint() - start) / 1e9
+}
+
+const main = () => {
+  const source = new Float32Array(samples).map(() => Math.random() * 2.2 - 1.1)
+  const results = []
+
+  console.log(`Sample conversion, ${samples} samples x ${iterations}, kernels: ${RtAudio.getSampleConversionIsa()}\n`)
+
+  for (const [name, TypedArray] of Object.entries(formats)) {
+    const format = RtAudioFormat[name]
+    const size = bytesPerSample[name] || TypedArray.BYTES_PER_ELEMENT
+    const simd = new Uint8Array(samples * size)
+    const reference = new Uint8Array(samples * size)
+    const back = new Float32Array(samples)
+    const backReference = new Float32Array(samples)
+
+    const toSimd = time(() => RtAudio.convertSamples(source, RtAudioFormat.RTAUDIO_FLOAT32, simd, format))
+    const toReference = time(() =>
+      RtAudio.convertSamples(source, RtAudioFormat.RTAUDIO_FLOAT32, reference, format, { reference: true }))
+    const fromSimd = time(() => RtAudio.convertSamples(simd, format, back, RtAudioFormat.RTAUDIO_FLOAT32))
+    const fromReference = time(() =>
+      RtAudio.convertSamples(reference, format, backReference, RtAudioFormat.RTAUDIO_FLOAT32, { reference: true }))
+
+    let maxError = 0
+    for (let i = 0; i < samples; i++) {
+      maxError = Math.max(maxError, Math.abs(back[i] - backReference[i]))
+    }
+
+    const rate = (seconds) => (samples * iterations / seconds / 1e6).toFixed(0)
+
+    results.push({
+      format: name,
+      'f32 -> fmt Msamples/s': rate(toSimd),
+      'f32 -> fmt scalar': rate(toReference),
+      'fmt -> f32 Msamples/s': rate(fromSimd),
+      'fmt -> f32 scalar': rate(fromReference),
+      'speed-up': ((toReference + fromReference) / (toSimd + fromSimd)).toFixed(1) + 'x',
+      'max error': maxError.toExponential(2),
+    })
+  }
+
+  console.table(results)
+}
+
+main()
@@ -0,0 +1,32 @@
+'use strict'
+
+// Device change example. It lists the devices without blocking the event loop, then
+// prints every device that gets connected or disconnected.
+
+// Usage: node test/devices.js [seconds]
+
+const { RtAudio } = require('..')
+
+const seconds = Number(process.argv[2] || 60)
+
+const rtAudio = new RtAudio()
+
+const describe = (device) =>
+  `${device.id}: ${device.name} (${device.outputChannels} out, ${device.inputChannels} in)`
+
+rtAudio.getDevicesAsync().then((devices) => {
+  console.log('Devices:')
+  devices.forEach((device) => console.log(`  ${describe(device)}`))
+
+  rtAudio.setDeviceChangeCallback((event) => {
+    event.added.forEach((device) => console.log(`Added ${describe(device)}`))
+    event.removed.forEach((device) => console.log(`Removed ${describe(device)}`))
+
+    if (event.added.length === 0 && event.removed.length === 0) {
+      console.log('Devices changed, e.g. the default device')
+    }
+  }, 500)
+})
+
+// The watcher doesn't keep the process alive by itself.
+setTimeout(() => rtAudio.setDeviceChangeCallback(null), seconds * 1000)
@@ -0,0 +1,86 @@
+'use strict'
+
+// Codec loopback example. The input is encoded natively, the packets arrive in JS in
+// batches and are queued straight back into a decoder that plays them on the output,
+// like the two ends of a call on one machine. No PCM crosses into JS. The packet rate
+// and bitrate are printed every second.
+
+// Usage: node test/encode.js [opus|flac] [seconds]
+
+// Note: needs libopus or libFLAC installed, and default input and output devices that
+// support int16 48000 Hz streams. Use headphones, the loop feeds back otherwise.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const codec = process.argv[2] || 'opus'
+const seconds = Number(process.argv[3] || 10)
+const sampleRate = 48000
+const bufferFrames = 480
+
+const rtAudio = new RtAudio()
+const inputDevice = rtAudio.getDefaultInputDevice()
+const outputDevice = rtAudio.getDefaultOutputDevice()
+
+if (!inputDevice || !outputDevice) {
+  console.error('No default input or output device found.')
+  process.exit(1)
+}
+
+rtAudio.openStream(
+  { deviceId: outputDevice, nChannels: 1 },
+  { deviceId: inputDevice, nChannels: 1 },
+  RtAudioFormat.RTAUDIO_SINT16,
+  sampleRate,
+  bufferFrames,
+  null,
+  null
+)
+
+const codecOptions = codec === 'opus'
+  ? { codec, bitrate: 32000, frameDuration: 20, application: 'voip' }
+  : { codec, compressionLevel: 5 }
+
+let packets = 0
+let bytes = 0
+let stopped = false
+
+// Two Opus packets ride out the batching.
+rtAudio.startDecoder({ ...codecOptions, prebufferFrames: sampleRate / 25 }, (event, detail) => {
+  if (event === 'error') console.error('decoder:', detail.message)
+})
+
+rtAudio.startEncoder({ ...codecOptions, batchInterval: 40 }, (event, detail) => {
+  if (event === 'error') {
+    console.error('encoder:', detail.message)
+    return
+  }
+
+  for (const packet of detail) {
+    packets++
+    bytes += packet.data.length
+    // The last batch arrives after stopping.
+    if (!stopped) rtAudio.queueEncoded(packet.data)
+  }
+})
+
+rtAudio.startStream()
+
+const reporter = setInterval(() => {
+  console.log(`${packets} packets/s, ${((bytes * 8) / 1000).toFixed(1)} kbit/s`)
+  packets = 0
+  bytes = 0
+}, 1000)
+
+setTimeout(() => {
+  clearInterval(reporter)
+  stopped = true
+
+  const encoder = rtAudio.stopEncoder()
+  const decoder = rtAudio.stopDecoder()
+
+  console.log('encoder:', encoder)
+  console.log('decoder:', decoder)
+
+  rtAudio.stopStream()
+  rtAudio.closeStream()
+}, seconds * 1000)
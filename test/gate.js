@@ -0,0 +1,64 @@
+'use strict'
+
+// Silence gate example. It captures the default input device with the silence gate
+// enabled, so the callback only runs while there is sound, and prints gate events and
+// how many periods never reached JS.
+
+// Usage: node test/gate.js [threshold dBFS] [seconds]
+
+// Note: the default input device has to support int16 48000 Hz streams.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const threshold = Number(process.argv[2] || -40)
+const seconds = Number(process.argv[3] || 20)
+const sampleRate = 48000
+
+const rtAudio = new RtAudio()
+const inputDevice = rtAudio.getDefaultInputDevice()
+
+if (!inputDevice) {
+  console.error('No default input device found.')
+  process.exit(1)
+}
+
+let deliveredFrames = 0
+
+rtAudio.openStream(
+  null,
+  { deviceId: inputDevice, nChannels: 1 },
+  RtAudioFormat.RTAUDIO_SINT16,
+  sampleRate,
+  480,
+  {
+    gate: {
+      threshold,
+      hold: 0.5,
+      preRoll: 0.3,
+      vad: true,
+      callback: (event, streamTime, level) => {
+        console.log(`${streamTime.toFixed(3)} s: gate ${event}, level ${level.toFixed(1)} dBFS`)
+      },
+    },
+  },
+  (output, input, nFrames) => {
+    deliveredFrames += nFrames
+  }
+)
+
+rtAudio.startStream()
+
+const reporter = setInterval(() => {
+  const stats = rtAudio.getGateStats()
+
+  console.log(
+    `${stats.open ? 'open  ' : 'closed'} level ${stats.level.toFixed(1)} dBFS, noise floor ${stats.noiseFloor.toFixed(1)} dBFS, ` +
+    `suppressed ${stats.suppressedPeriods}, delivered ${stats.deliveredPeriods} periods (${deliveredFrames} frames)`
+  )
+}, 1000)
+
+setTimeout(() => {
+  clearInterval(reporter)
+  rtAudio.stopStream()
+  rtAudio.closeStream()
+}, seconds * 1000)
@@ -0,0 +1,64 @@
+'use strict'
+
+// Native echo. Like echo.js it plays the default input on the default output, but
+// through a processing graph on the audio thread instead of a JS callback: the input
+// is high-passed, mixed with a feedback delay, and the echo level sweeps up and down
+// from JS while it runs.
+
+// Usage: node test/graph-echo.js [seconds]
+
+// Note: this script expects default output and input devices that support 16-bit
+// 48000 Hz streams.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const seconds = Number(process.argv[2] || 10)
+const sampleRate = 48000
+const bufferFrames = 128
+
+const rtAudio = new RtAudio()
+const outputDevice = rtAudio.getDefaultOutputDevice()
+const inputDevice = rtAudio.getDefaultInputDevice()
+
+if (!outputDevice || !inputDevice) {
+  console.error(`No default ${!outputDevice ? 'output' : 'input'} device found.`)
+  process.exit(1)
+}
+
+rtAudio.openStream(
+  { deviceId: outputDevice, nChannels: 2 },
+  { deviceId: inputDevice, nChannels: 1 },
+  RtAudioFormat.RTAUDIO_SINT16,
+  sampleRate,
+  bufferFrames,
+  null,
+  null
+)
+
+rtAudio.setProcessingGraph([
+  { type: 'input' },
+  { type: 'biquad', input: 0, filter: 'highpass', frequency: 80 },
+  { type: 'delay', input: 1, delay: sampleRate * 0.3, feedback: 0.35 },
+  { type: 'mix', inputs: [1, 2], gains: [1, 0.5] },
+])
+
+rtAudio.startStream()
+
+let phase = 0
+
+const sweep = setInterval(() => {
+  phase += 0.1
+  rtAudio.setGraphParameter(3, 'gain', 0.5 + 0.4 * Math.sin(phase), 1)
+}, 100)
+
+setInterval(() => {
+  const stats = rtAudio.getStreamStats()
+  console.log(`turnaround p50 ${stats.turnaround.p50.toFixed(1)} us, p99 ${stats.turnaround.p99.toFixed(1)} us`)
+}, 1000)
+
+setTimeout(() => {
+  clearInterval(sweep)
+  rtAudio.stopStream()
+  rtAudio.closeStream()
+  process.exit(0)
+}, seconds * 1000)
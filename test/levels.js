@@ -0,0 +1,62 @@
+'use strict'
+
+// Metering example. It opens an input stream without a callback and meters it 30 times
+// a second with the native analyzer, printing the peak and RMS level of every channel
+// and the loudest frequency.
+
+// Usage: node test/levels.js [seconds]
+
+// Note: the default input device has to support int16 48000 Hz streams.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const seconds = Number(process.argv[2] || 10)
+const sampleRate = 48000
+const fftSize = 4096
+
+const rtAudio = new RtAudio()
+const inputDevice = rtAudio.getDefaultInputDevice()
+
+if (!inputDevice) {
+  console.error('No default input device found.')
+  process.exit(1)
+}
+
+rtAudio.openStream(
+  null,
+  { deviceId: inputDevice, nChannels: 2 },
+  RtAudioFormat.RTAUDIO_SINT16,
+  sampleRate,
+  512,
+  {},
+  null
+)
+
+const dBFS = (value) => (value > 0 ? 20 * Math.log10(value) : -Infinity).toFixed(1).padStart(6)
+
+rtAudio.startAnalysis({ rate: 30, fftSize }, (results) => {
+  const channels = (results.length - fftSize / 2) / 2
+  const levels = []
+  let loudest = 1
+
+  for (let c = 0; c < channels; c++) {
+    levels.push(`${dBFS(results[c])} / ${dBFS(results[channels + c])}`)
+  }
+
+  for (let k = 2; k < fftSize / 2; k++) {
+    if (results[channels * 2 + k] > results[channels * 2 + loudest]) loudest = k
+  }
+
+  process.stdout.write(
+    `\rpeak / rms dBFS ${levels.join(', ')}, loudest ${((loudest * sampleRate) / fftSize).toFixed(0).padStart(5)} Hz`
+  )
+})
+
+rtAudio.startStream()
+
+setTimeout(() => {
+  rtAudio.stopAnalysis()
+  rtAudio.stopStream()
+  rtAudio.closeStream()
+  process.stdout.write('\n')
+}, seconds * 1000)
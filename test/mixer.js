@@ -0,0 +1,92 @@
+'use strict'
+
+// Mixer example. It opens an output stream without a callback and plays a number of
+// sine voices through the native mixer, each with its own start time, pan and gain,
+// topping their queues up from a timer. Mixer statistics are printed every second.
+
+// Usage: node test/mixer.js [voices] [seconds]
+
+// Note: the default output device has to support float32 48000 Hz streams.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const voiceCount = Number(process.argv[2] || 16)
+const seconds = Number(process.argv[3] || 10)
+const sampleRate = 48000
+const bufferFrames = 256
+const chunkFrames = 2048
+
+const rtAudio = new RtAudio()
+const outputDevice = rtAudio.getDefaultOutputDevice()
+
+if (!outputDevice) {
+  console.error('No default output device found.')
+  process.exit(1)
+}
+
+rtAudio.openStream(
+  { deviceId: outputDevice, nChannels: 2 },
+  null,
+  RtAudioFormat.RTAUDIO_FLOAT32,
+  sampleRate,
+  bufferFrames,
+  { maxVoices: voiceCount },
+  null
+)
+
+rtAudio.startStream()
+
+const now = rtAudio.getMixerStats().frame
+const chunk = new Float32Array(chunkFrames)
+const voices = []
+
+for (let i = 0; i < voiceCount; i++) {
+  voices.push({
+    id: rtAudio.createVoice({
+      gain: 0.5 / voiceCount,
+      pan: voiceCount === 1 ? 0 : (i / (voiceCount - 1)) * 2 - 1,
+      // Stagger the entries by a tenth of a second.
+      startFrame: now + i * sampleRate / 10,
+    }),
+    frequency: 110 * Math.pow(2, i / 12),
+    phase: 0,
+  })
+}
+
+const feed = () => {
+  for (const voice of voices) {
+    while (rtAudio.getVoiceQueuedFrames(voice.id) < sampleRate / 4) {
+      for (let i = 0; i < chunkFrames; i++) {
+        chunk[i] = Math.sin(voice.phase)
+        voice.phase += (2 * Math.PI * voice.frequency) / sampleRate
+      }
+
+      voice.phase %= 2 * Math.PI
+      rtAudio.queueVoice(voice.id, chunk)
+    }
+  }
+}
+
+feed()
+const feeder = setInterval(feed, 20)
+
+const reporter = setInterval(() => {
+  const stats = rtAudio.getMixerStats()
+
+  console.log(
+    `voices ${stats.activeVoices}/${stats.voices}, render mean ${stats.renderTime.mean.toFixed(1)} us, ` +
+    `p99 ${stats.renderTime.p99.toFixed(1)} us, load ${(stats.load * 100).toFixed(2)}%, underruns ${stats.underruns}`
+  )
+}, 1000)
+
+setTimeout(() => {
+  clearInterval(feeder)
+  clearInterval(reporter)
+
+  for (const voice of voices) rtAudio.removeVoice(voice.id)
+
+  setTimeout(() => {
+    rtAudio.stopStream()
+    rtAudio.closeStream()
+  }, 100)
+}, seconds * 1000)
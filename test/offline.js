@@ -0,0 +1,58 @@
+'use strict'
+
+// Offline rendering example. It renders a WAV file through a gain callback on the
+// offline device, as fast as the callback allows, writes the result to another WAV
+// file and prints how much faster than realtime it was.
+
+// Usage: node test/offline.js <input.wav> <output.wav> [channels] [gain]
+
+// Note: the input has to be a 48000 Hz WAV file with the given number of channels.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const inputPath = process.argv[2]
+const outputPath = process.argv[3]
+const channels = Number(process.argv[4] || 2)
+const gain = Number(process.argv[5] || 0.5)
+
+if (!inputPath || !outputPath) {
+  console.error('Usage: node test/offline.js <input.wav> <output.wav> [channels] [gain]')
+  process.exit(1)
+}
+
+const rtAudio = new RtAudio()
+
+// Offline streams ignore the device IDs, they only have to be valid IDs.
+rtAudio.openStream(
+  { deviceId: 1, nChannels: channels },
+  { deviceId: 1, nChannels: channels },
+  RtAudioFormat.RTAUDIO_FLOAT32,
+  48000,
+  1024,
+  {
+    typedBuffers: true,
+    offline: {
+      input: inputPath,
+      output: outputPath,
+      callback: (result) => {
+        if (result.error) {
+          console.error(result.error)
+        }
+
+        console.log(
+          `Rendered ${result.duration.toFixed(2)} s in ${result.elapsed.toFixed(3)} s, ` +
+          `${result.speedup.toFixed(1)}x realtime`
+        )
+
+        rtAudio.closeStream()
+      },
+    },
+  },
+  (output, input) => {
+    for (let i = 0; i < output.length; i++) {
+      output[i] = input[i] * gain
+    }
+  }
+)
+
+rtAudio.startStream()
@@ -0,0 +1,76 @@
+'use strict'
+
+// Warm restart example. It plays a sine wave and moves the stream to the new default
+// output device whenever the default changes, without rebuilding the callback, and
+// prints how long each restart took until audio flowed again.
+
+// Usage: node test/restart.js [seconds]
+
+// Note: the output devices have to support float32 48000 Hz streams.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const seconds = Number(process.argv[2] || 60)
+const sampleRate = 48000
+
+const rtAudio = new RtAudio()
+
+let phase = 0
+
+const printStartup = (label) => {
+  const stats = rtAudio.getStartupStats()
+
+  console.log(
+    `${label}: open ${stats.open.toFixed(1)} ms, start ${stats.start.toFixed(1)} ms, ` +
+    `first callback after ${stats.openToFirstCallback === null ? '-' : stats.openToFirstCallback.toFixed(1)} ms`
+  )
+}
+
+const main = async () => {
+  let outputDevice = rtAudio.getDefaultOutputDevice()
+  // Moves run one after the other, stream operations can't overlap.
+  let moving = Promise.resolve()
+
+  await rtAudio.openStreamAsync(
+    { deviceId: outputDevice, nChannels: 1 },
+    null,
+    RtAudioFormat.RTAUDIO_FLOAT32,
+    sampleRate,
+    480,
+    { typedBuffers: true },
+    (output) => {
+      for (let i = 0; i < output.length; i++) {
+        output[i] = 0.1 * Math.sin(phase)
+        phase += (2 * Math.PI * 440) / sampleRate
+      }
+    }
+  )
+
+  await rtAudio.startStreamAsync()
+  setTimeout(() => printStartup('Opened'), 200)
+
+  rtAudio.setDeviceChangeCallback((event) => {
+    const device = event.devices.find((device) => device.isDefaultOutput)
+
+    if (!device) return
+
+    moving = moving
+      .then(async () => {
+        if (device.id === outputDevice) return
+
+        await rtAudio.reconfigureStream({ deviceId: device.id, nChannels: 1 })
+        outputDevice = device.id
+        setTimeout(() => printStartup(`Moved to ${device.name}`), 200)
+      })
+      .catch((err) => console.error(`Couldn't move to ${device.name}: ${err.message}`))
+  })
+
+  setTimeout(async () => {
+    rtAudio.setDeviceChangeCallback(null)
+    await moving
+    await rtAudio.stopStreamAsync()
+    await rtAudio.closeStreamAsync()
+  }, seconds * 1000)
+}
+
+main()
@@ -0,0 +1,87 @@
+'use strict'
+
+// Scheduling example. It loads a short click as a clip and schedules a metronome on
+// wall clock beats: every beat is a `process.hrtime` time converted to a stream frame,
+// and the mixer starts the click at exactly that frame. Clips are scheduled half a
+// second ahead, the stream clock is printed every second.
+
+// Usage: node test/schedule.js [bpm] [seconds]
+
+// Note: the default output device has to support float32 48000 Hz streams.
+
+const { RtAudio, RtAudioFormat } = require('..')
+
+const bpm = Number(process.argv[2] || 120)
+const seconds = Number(process.argv[3] || 10)
+const sampleRate = 48000
+const bufferFrames = 256
+const beat = BigInt(Math.round(60e9 / bpm))
+const lookahead = 500000000n
+
+const rtAudio = new RtAudio()
+const outputDevice = rtAudio.getDefaultOutputDevice()
+
+if (!outputDevice) {
+  console.error('No default output device found.')
+  process.exit(1)
+}
+
+rtAudio.openStream(
+  { deviceId: outputDevice, nChannels: 2 },
+  null,
+  RtAudioFormat.RTAUDIO_FLOAT32,
+  sampleRate,
+  bufferFrames,
+  { maxVoices: 8 },
+  null
+)
+
+// A 20 ms 1 kHz click with an exponential decay.
+const click = new Float32Array(sampleRate / 50)
+for (let i = 0; i < click.length; i++) {
+  click[i] = Math.sin((2 * Math.PI * 1000 * i) / sampleRate) * Math.exp(-i / (sampleRate / 400))
+}
+
+const clip = rtAudio.loadClip(click)
+let nextBeat = 0n
+
+const schedule = () => {
+  // The clock starts with the first period.
+  if (!rtAudio.getStreamClock()) return
+
+  const now = process.hrtime.bigint()
+
+  if (nextBeat === 0n) nextBeat = now + lookahead
+
+  while (nextBeat < now + lookahead) {
+    rtAudio.scheduleClip(clip, { startFrame: rtAudio.hrtimeToStreamFrame(nextBeat), gain: 0.5 })
+    nextBeat += beat
+  }
+}
+
+rtAudio.startStream()
+
+const scheduler = setInterval(schedule, 50)
+
+const reporter = setInterval(() => {
+  const clock = rtAudio.getStreamClock()
+  const stats = rtAudio.getMixerStats()
+
+  if (clock) {
+    console.log(
+      `frame ${clock.frame}, measured rate ${clock.sampleRate.toFixed(2)} Hz, ` +
+      `voices ${stats.voices}, late starts ${stats.lateStarts}`
+    )
+  }
+}, 1000)
+
+setTimeout(() => {
+  clearInterval(scheduler)
+  clearInterval(reporter)
+
+  setTimeout(() => {
+    rtAudio.stopStream()
+    rtAudio.closeStream()
+    rtAudio.unloadClip(clip)
+  }, 600)
+}, seconds * 1000)
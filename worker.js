@@ -0,0 +1,72 @@
+"use strict"
+
+// Bootstrap of streams opened with the `worker` option. It loads the user's callback
+// script and runs it for every period, on this thread instead of the main one.
+
+const { workerData, parentPort } = require('worker_threads')
+const { NodeRtAudioWorkerPort } = require('./binding')
+
+const {
+  script,
+  control,
+  output,
+  input,
+  format,
+  outputChannels,
+  inputChannels,
+  typedBuffers,
+  nonInterleaved,
+} = workerData
+
+const exported = require(script)
+const callback = typeof exported === 'function' ? exported : exported.default
+
+if (typeof callback !== 'function') {
+  throw new TypeError(`${script} should export the stream callback function.`)
+}
+
+const typedArrays = { 0x1: Int8Array, 0x2: Int16Array, 0x8: Int32Array, 0x10: Float32Array, 0x20: Float64Array }
+
+// Same views the main thread callback gets, see the `typedBuffers` option.
+const createView = (buffer, channels) => {
+  if (buffer === null) return null
+
+  const TypedArray = (typedBuffers && typedArrays[format]) || Uint8Array
+
+  if (!typedBuffers || !nonInterleaved) return new TypedArray(buffer)
+
+  const channelByteCount = buffer.byteLength / channels
+
+  return Array.from({ length: channels }, (_, i) =>
+    new TypedArray(buffer, i * channelByteCount, channelByteCount / TypedArray.BYTES_PER_ELEMENT))
+}
+
+const state = new Float64Array(control)
+const port = new NodeRtAudioWorkerPort(state)
+const outputView = createView(output, outputChannels)
+const inputView = createView(input, inputChannels)
+
+const run = () => {
+  // Process periods back to back. When the stream is idle, yield to the event loop so
+  // that the script still gets its messages and timers.
+  for (;;) {
+    const ready = port.wait(20)
+
+    if (ready === 0) return // the stream was closed
+    if (ready < 0) return setImmediate(run)
+
+    let value = 0
+
+    try {
+      value = callback(outputView, inputView, state[0], state[1], state[2])
+    } finally {
+      port.done(value)
+    }
+
+    if (value) {
+      parentPort.postMessage('stop')
+    }
+  }
+}
+
+run()